@@ -206,7 +206,7 @@ desktop_call_when_ready (NautilusDirectory         *directory,
 
 
     merged_callback->merged_file_list = g_list_concat (NULL,
-                                                       nautilus_file_list_copy (directory->details->file_list));
+                                                       nautilus_directory_get_all_files (directory));
 
     /* Put it in the hash table. */
     g_hash_table_insert (desktop->details->callbacks,
@@ -332,7 +332,7 @@ desktop_monitor_add (NautilusDirectory         *directory,
 
     /* Handle the desktop part */
     merged_callback_list = g_list_concat (merged_callback_list,
-                                          nautilus_file_list_copy (directory->details->file_list));
+                                          nautilus_directory_get_all_files (directory));
 
 
     if (callback != NULL)
@@ -400,7 +400,7 @@ desktop_is_not_empty (NautilusDirectory *directory)
         return TRUE;
     }
 
-    return directory->details->file_list != NULL;
+    return directory->details->files->len > 0;
 }
 
 static GList *
@@ -415,6 +415,16 @@ desktop_get_file_list (NautilusDirectory *directory)
     return g_list_concat (real_dir_file_list, desktop_dir_file_list);
 }
 
+static void
+desktop_foreach_file (NautilusDirectory            *directory,
+                      NautilusDirectoryForeachFunc  func,
+                      gpointer                      callback_data)
+{
+    nautilus_directory_foreach_file (NAUTILUS_DESKTOP_DIRECTORY (directory)->details->real_directory,
+                                     func, callback_data);
+    NAUTILUS_DIRECTORY_CLASS (nautilus_desktop_directory_parent_class)->foreach_file (directory, func, callback_data);
+}
+
 NautilusDirectory *
 nautilus_desktop_directory_get_real_directory (NautilusDesktopDirectory *desktop)
 {
@@ -585,4 +595,5 @@ nautilus_desktop_directory_class_init (NautilusDesktopDirectoryClass *class)
      * in addition to the list of standard desktop icons on the desktop.
      */
     directory_class->get_file_list = desktop_get_file_list;
+    directory_class->foreach_file = desktop_foreach_file;
 }
@@ -164,6 +164,9 @@ static void          handle_vadjustment_changed (GtkAdjustment           *adjust
                                                  NautilusCanvasContainer *container);
 static GList *nautilus_canvas_container_get_selected_icons (NautilusCanvasContainer *container);
 static void          nautilus_canvas_container_update_visible_icons (NautilusCanvasContainer *container);
+static void          nautilus_canvas_container_set_icon_visibility (NautilusCanvasContainer     *container,
+                                                                    NautilusCanvasIcon          *icon,
+                                                                    NautilusCanvasIconVisibility visibility);
 static void          reveal_icon (NautilusCanvasContainer *container,
                                   NautilusCanvasIcon      *icon);
 
@@ -6160,6 +6163,8 @@ nautilus_canvas_container_clear (NautilusCanvasContainer *container)
 
     for (p = details->icons; p != NULL; p = p->next)
     {
+        nautilus_canvas_container_set_icon_visibility (container, p->data,
+                                                       NAUTILUS_CANVAS_ICON_NOT_SHOWN);
         icon_free (p->data);
     }
     g_list_free (details->icons);
@@ -6446,6 +6451,10 @@ icon_destroy (NautilusCanvasContainer *container,
         details->stretch_icon = NULL;
     }
 
+    /* Other views of the file may still want its thumbnail. */
+    nautilus_canvas_container_set_icon_visibility (container, icon,
+                                                   NAUTILUS_CANVAS_ICON_NOT_SHOWN);
+
     icon_free (icon);
 
     if (was_selected)
@@ -6558,6 +6567,24 @@ nautilus_canvas_container_prioritize_thumbnailing (NautilusCanvasContainer *cont
     klass->prioritize_thumbnailing (container, icon->data);
 }
 
+static void
+nautilus_canvas_container_set_icon_visibility (NautilusCanvasContainer     *container,
+                                               NautilusCanvasIcon          *icon,
+                                               NautilusCanvasIconVisibility visibility)
+{
+    NautilusCanvasContainerClass *klass;
+    NautilusCanvasIconVisibility old_visibility;
+
+    old_visibility = icon->visibility;
+    icon->visibility = visibility;
+
+    klass = NAUTILUS_CANVAS_CONTAINER_GET_CLASS (container);
+    if (klass->set_icon_visibility != NULL)
+    {
+        klass->set_icon_visibility (container, icon->data, old_visibility, visibility);
+    }
+}
+
 static void
 nautilus_canvas_container_update_visible_icons (NautilusCanvasContainer *container)
 {
@@ -6567,8 +6594,9 @@ nautilus_canvas_container_update_visible_icons (NautilusCanvasContainer *contain
     double x0, y0, x1, y1;
     GList *node;
     NautilusCanvasIcon *icon;
-    gboolean visible;
+    gboolean visible, near_visible;
     GtkAllocation allocation;
+    double near_x, near_y;
 
     hadj = gtk_scrollable_get_hadjustment (GTK_SCROLLABLE (container));
     vadj = gtk_scrollable_get_vadjustment (GTK_SCROLLABLE (container));
@@ -6585,6 +6613,12 @@ nautilus_canvas_container_update_visible_icons (NautilusCanvasContainer *contain
     eel_canvas_c2w (EEL_CANVAS (container),
                     max_x, max_y, &max_x, &max_y);
 
+    /* Icons within a page of the visible area are likely to be
+     * scrolled to next.
+     */
+    near_x = max_x - min_x;
+    near_y = max_y - min_y;
+
     /* Do the iteration in reverse to get the render-order from top to
      * bottom for the prioritized thumbnails.
      */
@@ -6609,21 +6643,29 @@ nautilus_canvas_container_update_visible_icons (NautilusCanvasContainer *contain
             if (nautilus_canvas_container_is_layout_vertical (container))
             {
                 visible = x1 >= min_x && x0 <= max_x;
+                near_visible = x1 >= min_x - near_x && x0 <= max_x + near_x;
             }
             else
             {
                 visible = y1 >= min_y && y0 <= max_y;
+                near_visible = y1 >= min_y - near_y && y0 <= max_y + near_y;
             }
 
             if (visible)
             {
                 nautilus_canvas_item_set_is_visible (icon->item, TRUE);
+                nautilus_canvas_container_set_icon_visibility (container, icon,
+                                                               NAUTILUS_CANVAS_ICON_VISIBLE);
                 nautilus_canvas_container_prioritize_thumbnailing (container,
                                                                    icon);
             }
             else
             {
                 nautilus_canvas_item_set_is_visible (icon->item, FALSE);
+                nautilus_canvas_container_set_icon_visibility (container, icon,
+                                                               near_visible ?
+                                                               NAUTILUS_CANVAS_ICON_NEAR_VISIBLE :
+                                                               NAUTILUS_CANVAS_ICON_OFFSCREEN);
             }
         }
     }
@@ -54,6 +54,13 @@ typedef struct {
 	double scale;
 } NautilusCanvasPosition;
 
+typedef enum {
+	NAUTILUS_CANVAS_ICON_NOT_SHOWN,		/* not laid out yet, or removed */
+	NAUTILUS_CANVAS_ICON_VISIBLE,
+	NAUTILUS_CANVAS_ICON_NEAR_VISIBLE,	/* within a page of the visible area */
+	NAUTILUS_CANVAS_ICON_OFFSCREEN
+} NautilusCanvasIconVisibility;
+
 #define	NAUTILUS_CANVAS_CONTAINER_TYPESELECT_FLUSH_DELAY 1000000
 
 typedef struct NautilusCanvasContainerDetails NautilusCanvasContainerDetails;
@@ -148,6 +155,10 @@ typedef struct {
 						     NautilusCanvasIconData *canvas_b);
 	void         (* prioritize_thumbnailing)  (NautilusCanvasContainer *container,
 						   NautilusCanvasIconData *data);
+	void         (* set_icon_visibility)      (NautilusCanvasContainer *container,
+						   NautilusCanvasIconData *data,
+						   NautilusCanvasIconVisibility old_visibility,
+						   NautilusCanvasIconVisibility visibility);
 
 	/* Queries on icons for subclass/client.
 	 * These must be implemented => These are signals !
@@ -64,6 +64,9 @@ typedef struct {
 	eel_boolean_bit is_visible : 1;
 
 	eel_boolean_bit has_lazy_position : 1;
+
+	/* The visibility last told to the subclass. */
+	NautilusCanvasIconVisibility visibility;
 } NautilusCanvasIcon;
 
 
@@ -109,6 +109,53 @@ nautilus_canvas_view_container_prioritize_thumbnailing (NautilusCanvasContainer
     }
 }
 
+static void
+nautilus_canvas_view_container_set_icon_visibility (NautilusCanvasContainer     *container,
+                                                    NautilusCanvasIconData      *data,
+                                                    NautilusCanvasIconVisibility old_visibility,
+                                                    NautilusCanvasIconVisibility visibility)
+{
+    NautilusFile *file;
+    gboolean was_offscreen, is_offscreen;
+    char *uri;
+
+    file = (NautilusFile *) data;
+
+    g_assert (NAUTILUS_IS_FILE (file));
+
+    /* Thumbnails of files near the visible area are still loaded, so
+     * they are ready when scrolled to. Other views may still show the
+     * file, so each one only takes back what it told the file before.
+     */
+    was_offscreen = old_visibility == NAUTILUS_CANVAS_ICON_OFFSCREEN;
+    is_offscreen = visibility == NAUTILUS_CANVAS_ICON_OFFSCREEN;
+    if (old_visibility == NAUTILUS_CANVAS_ICON_NOT_SHOWN ||
+        visibility == NAUTILUS_CANVAS_ICON_NOT_SHOWN ||
+        was_offscreen != is_offscreen)
+    {
+        if (old_visibility != NAUTILUS_CANVAS_ICON_NOT_SHOWN)
+        {
+            nautilus_file_remove_view_visibility (file, was_offscreen);
+        }
+        if (visibility != NAUTILUS_CANVAS_ICON_NOT_SHOWN)
+        {
+            nautilus_file_add_view_visibility (file, is_offscreen);
+        }
+    }
+
+    /* Visible files are prioritized in prioritize_thumbnailing(). */
+    if ((visibility == NAUTILUS_CANVAS_ICON_NEAR_VISIBLE || is_offscreen) &&
+        nautilus_file_is_thumbnailing (file))
+    {
+        uri = nautilus_file_get_uri (file);
+        nautilus_thumbnail_set_priority (uri,
+                                         visibility == NAUTILUS_CANVAS_ICON_NEAR_VISIBLE ?
+                                         NAUTILUS_THUMBNAIL_PRIORITY_NEAR_VISIBLE :
+                                         NAUTILUS_THUMBNAIL_PRIORITY_DEFAULT);
+        g_free (uri);
+    }
+}
+
 static GQuark *
 get_quark_from_strv (gchar **value)
 {
@@ -341,6 +388,7 @@ nautilus_canvas_view_container_class_init (NautilusCanvasViewContainerClass *kla
     ic_class->get_icon_images = nautilus_canvas_view_container_get_icon_images;
     ic_class->get_icon_description = nautilus_canvas_view_container_get_icon_description;
     ic_class->prioritize_thumbnailing = nautilus_canvas_view_container_prioritize_thumbnailing;
+    ic_class->set_icon_visibility = nautilus_canvas_view_container_set_icon_visibility;
 
     ic_class->compare_icons = nautilus_canvas_view_container_compare_icons;
     ic_class->compare_icons_by_name = nautilus_canvas_view_container_compare_icons_by_name;
@@ -0,0 +1,684 @@
+/*
+ *  nautilus-deep-count.c: Count the contents of a local directory tree
+ *  with several threads.
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License as
+ *  published by the Free Software Foundation; either version 2 of the
+ *  License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public
+ *  License along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+#include "nautilus-deep-count.h"
+
+#include "nautilus-directory-size-cache.h"
+#include "nautilus-inode-set.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/syscall.h>
+#else
+#include <dirent.h>
+#endif
+
+/* Each count reads directories with up to this many threads at once.
+ * More don't help, as they all end up waiting for the same disk.
+ */
+#define MAX_DEEP_COUNT_THREADS 8
+
+/* Check for cancellation after this many entries of a directory. */
+#define ENTRIES_PER_CANCELLATION_CHECK 256
+
+#define DIRENT_BUFFER_SIZE (32 * 1024)
+
+/* Directories changed more recently than this may still change within
+ * the same second, so their mtime can't tell their counts are stale.
+ */
+#define MIN_CACHEABLE_AGE_SECS 2
+
+/* A directory waiting to be counted. */
+typedef struct
+{
+    char *path;
+    guint64 device;
+    guint64 inode;
+    gint64 mtime;
+    gboolean cacheable;
+} DirectoryNode;
+
+struct NautilusDeepCount
+{
+    GCancellable *cancellable;
+    gboolean skip_hidden_files;
+    dev_t device;
+
+    NautilusDeepCountCallback progress_callback;
+    NautilusDeepCountCallback done_callback;
+    gpointer callback_data;
+    guint progress_timeout_id;
+
+    /* Each count has threads of its own, as they wait for the count to
+     * finish, and another count must not queue up behind them.
+     */
+    GThreadPool *threads;
+
+    /* Lock mutex when accessing the rest. */
+    GMutex mutex;
+    GCond cond;
+    GQueue directories;     /* DirectoryNodes waiting to be read */
+    guint directories_being_read;
+    guint threads_running;
+    NautilusInodeSet *seen_inodes;
+
+    NautilusDirectorySize totals;
+};
+
+/* What a thread found in one directory, added to the totals at once. */
+typedef struct
+{
+    NautilusDirectorySize size;
+    GList *subdirectories;
+} DirectoryTotals;
+
+typedef struct
+{
+    int fd;
+#ifdef __linux__
+    guint64 buffer[DIRENT_BUFFER_SIZE / sizeof (guint64)];
+    long length;
+    long position;
+#else
+    DIR *dir;
+#endif
+} DirectoryReader;
+
+#ifdef __linux__
+/* The kernel's record, glibc only wraps getdents64() since 2.30. */
+struct linux_dirent64
+{
+    guint64 d_ino;
+    gint64 d_off;
+    unsigned short d_reclen;
+    unsigned char d_type;
+    char d_name[];
+};
+#endif
+
+static guint
+get_max_deep_count_threads (void)
+{
+    return CLAMP (g_get_num_processors (), 2, MAX_DEEP_COUNT_THREADS);
+}
+
+static void
+add_size (NautilusDirectorySize       *size,
+          const NautilusDirectorySize *other)
+{
+    size->directory_count += other->directory_count;
+    size->file_count += other->file_count;
+    size->unreadable_directory_count += other->unreadable_directory_count;
+    size->total_size += other->total_size;
+}
+
+/* Takes ownership of @path. */
+static DirectoryNode *
+directory_node_new (char              *path,
+                    const struct stat *statbuf)
+{
+    DirectoryNode *node;
+
+    node = g_new0 (DirectoryNode, 1);
+    node->path = path;
+
+    if (statbuf != NULL)
+    {
+        node->device = statbuf->st_dev;
+        node->inode = statbuf->st_ino;
+        node->mtime = statbuf->st_mtime;
+        node->cacheable = statbuf->st_mtime < time (NULL) - MIN_CACHEABLE_AGE_SECS;
+    }
+
+    return node;
+}
+
+static void
+directory_node_free (DirectoryNode *node)
+{
+    g_free (node->path);
+    g_free (node);
+}
+
+/* Takes ownership of @fd. */
+static gboolean
+directory_reader_open (DirectoryReader *reader,
+                       int              fd)
+{
+    reader->fd = fd;
+#ifdef __linux__
+    reader->length = 0;
+    reader->position = 0;
+#else
+    reader->dir = fdopendir (fd);
+    if (reader->dir == NULL)
+    {
+        close (fd);
+        return FALSE;
+    }
+#endif
+
+    return TRUE;
+}
+
+static const char *
+directory_reader_next (DirectoryReader *reader)
+{
+#ifdef __linux__
+    struct linux_dirent64 *entry;
+
+    if (reader->position >= reader->length)
+    {
+        do
+        {
+            reader->length = syscall (SYS_getdents64, reader->fd,
+                                      reader->buffer, sizeof (reader->buffer));
+        }
+        while (reader->length < 0 && errno == EINTR);
+
+        reader->position = 0;
+        if (reader->length <= 0)
+        {
+            return NULL;
+        }
+    }
+
+    entry = (struct linux_dirent64 *) ((char *) reader->buffer + reader->position);
+    reader->position += entry->d_reclen;
+
+    return entry->d_name;
+#else
+    struct dirent *entry;
+
+    entry = readdir (reader->dir);
+
+    return entry != NULL ? entry->d_name : NULL;
+#endif
+}
+
+static void
+directory_reader_close (DirectoryReader *reader)
+{
+#ifdef __linux__
+    close (reader->fd);
+#else
+    closedir (reader->dir);
+#endif
+}
+
+/* The names listed in the .hidden file of a directory, like GIO reads
+ * them for standard::is-hidden.
+ */
+static GHashTable *
+read_hidden_names (int dir_fd)
+{
+    GHashTable *names;
+    GString *contents;
+    char buffer[4096];
+    char **lines;
+    ssize_t length;
+    int fd, i;
+
+    fd = openat (dir_fd, ".hidden", O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+    {
+        return NULL;
+    }
+
+    contents = g_string_new (NULL);
+    while ((length = read (fd, buffer, sizeof (buffer))) > 0)
+    {
+        g_string_append_len (contents, buffer, length);
+    }
+    close (fd);
+
+    names = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+    lines = g_strsplit (contents->str, "\n", -1);
+    for (i = 0; lines[i] != NULL; i++)
+    {
+        if (lines[i][0] != '\0')
+        {
+            g_hash_table_add (names, lines[i]);
+        }
+        else
+        {
+            g_free (lines[i]);
+        }
+    }
+    g_free (lines);
+    g_string_free (contents, TRUE);
+
+    return names;
+}
+
+/* Same as should_skip_file() in nautilus-directory-async.c. */
+static gboolean
+should_skip_name (NautilusDeepCount *deep_count,
+                  GHashTable        *hidden_names,
+                  const char        *name)
+{
+    if (!deep_count->skip_hidden_files)
+    {
+        return FALSE;
+    }
+
+    return name[0] == '.' ||
+           g_str_has_suffix (name, "~") ||
+           (hidden_names != NULL && g_hash_table_contains (hidden_names, name));
+}
+
+static gboolean
+seen_inode (NautilusDeepCount *deep_count,
+            struct stat       *statbuf)
+{
+    gboolean seen;
+
+    /* Directories can't be hard linked, and files with a single link
+     * can't be reached twice.
+     */
+    if (S_ISDIR (statbuf->st_mode) || statbuf->st_nlink <= 1)
+    {
+        return FALSE;
+    }
+
+    g_mutex_lock (&deep_count->mutex);
+    seen = !nautilus_inode_set_add (deep_count->seen_inodes,
+                                    statbuf->st_dev, statbuf->st_ino);
+    g_mutex_unlock (&deep_count->mutex);
+
+    return seen;
+}
+
+/* Takes what the directory size cache knows about the directory, if it
+ * didn't change since. Returns FALSE if the directory has to be read.
+ */
+static gboolean
+count_cached_directory (NautilusDeepCount *deep_count,
+                        DirectoryNode     *node,
+                        int                fd,
+                        DirectoryTotals   *totals)
+{
+    NautilusDirectorySize size;
+    struct stat statbuf;
+    GList *subdirectories;
+    char **names;
+    guint i;
+
+    if (!nautilus_directory_size_cache_lookup (node->device,
+                                               node->inode,
+                                               node->mtime,
+                                               deep_count->skip_hidden_files,
+                                               &size,
+                                               &names))
+    {
+        return FALSE;
+    }
+
+    subdirectories = NULL;
+    for (i = 0; names[i] != NULL; i++)
+    {
+        /* Removed while counting, the directory has to be read again. */
+        if (fstatat (fd, names[i], &statbuf, AT_SYMLINK_NOFOLLOW) != 0 ||
+            !S_ISDIR (statbuf.st_mode) ||
+            statbuf.st_dev != deep_count->device)
+        {
+            g_list_free_full (subdirectories, (GDestroyNotify) directory_node_free);
+            g_strfreev (names);
+            return FALSE;
+        }
+
+        subdirectories = g_list_prepend (subdirectories,
+                                         directory_node_new (g_build_filename (node->path, names[i], NULL),
+                                                             &statbuf));
+    }
+    g_strfreev (names);
+
+    add_size (&totals->size, &size);
+    totals->subdirectories = subdirectories;
+
+    return TRUE;
+}
+
+static void
+count_directory (NautilusDeepCount *deep_count,
+                 DirectoryNode     *node,
+                 DirectoryTotals   *totals)
+{
+    DirectoryNode *subdirectory;
+    DirectoryReader reader;
+    GHashTable *hidden_names;
+    GPtrArray *subdirectory_names;
+    struct stat statbuf;
+    const char *name;
+    gboolean cacheable;
+    guint n_entries;
+    int fd;
+
+    fd = openat (AT_FDCWD, node->path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd < 0)
+    {
+        totals->size.unreadable_directory_count += 1;
+        return;
+    }
+
+    if (node->cacheable && count_cached_directory (deep_count, node, fd, totals))
+    {
+        close (fd);
+        return;
+    }
+
+    hidden_names = NULL;
+    if (deep_count->skip_hidden_files)
+    {
+        hidden_names = read_hidden_names (fd);
+    }
+
+    if (!directory_reader_open (&reader, fd))
+    {
+        totals->size.unreadable_directory_count += 1;
+        g_clear_pointer (&hidden_names, g_hash_table_destroy);
+        return;
+    }
+
+    cacheable = node->cacheable;
+    subdirectory_names = g_ptr_array_new ();
+
+    n_entries = 0;
+    while ((name = directory_reader_next (&reader)) != NULL)
+    {
+        if (++n_entries % ENTRIES_PER_CANCELLATION_CHECK == 0 &&
+            g_cancellable_is_cancelled (deep_count->cancellable))
+        {
+            /* Counts of interrupted directories are incomplete. */
+            cacheable = FALSE;
+            break;
+        }
+
+        if (strcmp (name, ".") == 0 || strcmp (name, "..") == 0 ||
+            should_skip_name (deep_count, hidden_names, name))
+        {
+            continue;
+        }
+
+        /* Gone already, GIO wouldn't list it either. */
+        if (fstatat (reader.fd, name, &statbuf, AT_SYMLINK_NOFOLLOW) != 0)
+        {
+            continue;
+        }
+
+        if (S_ISDIR (statbuf.st_mode))
+        {
+            totals->size.directory_count += 1;
+
+            /* Only descend into directories on the same filesystem. */
+            if (statbuf.st_dev == deep_count->device)
+            {
+                subdirectory = directory_node_new (g_build_filename (node->path, name, NULL),
+                                                   &statbuf);
+                totals->subdirectories = g_list_prepend (totals->subdirectories, subdirectory);
+                g_ptr_array_add (subdirectory_names, strrchr (subdirectory->path, '/') + 1);
+            }
+        }
+        else
+        {
+            /* Even non-regular files count as files. */
+            totals->size.file_count += 1;
+
+            /* A cached count can't know which of its hard links were
+             * already seen elsewhere in the tree.
+             */
+            if (statbuf.st_nlink > 1)
+            {
+                cacheable = FALSE;
+            }
+        }
+
+        if (!seen_inode (deep_count, &statbuf))
+        {
+            totals->size.total_size += statbuf.st_size;
+        }
+    }
+
+    directory_reader_close (&reader);
+    g_clear_pointer (&hidden_names, g_hash_table_destroy);
+
+    if (cacheable)
+    {
+        g_ptr_array_add (subdirectory_names, NULL);
+        nautilus_directory_size_cache_store (node->device,
+                                             node->inode,
+                                             node->mtime,
+                                             deep_count->skip_hidden_files,
+                                             &totals->size,
+                                             (const char * const *) subdirectory_names->pdata);
+    }
+    g_ptr_array_free (subdirectory_names, TRUE);
+}
+
+static gboolean
+deep_count_done_idle_callback (gpointer user_data)
+{
+    NautilusDeepCount *deep_count;
+
+    deep_count = user_data;
+
+    if (deep_count->progress_timeout_id != 0)
+    {
+        g_source_remove (deep_count->progress_timeout_id);
+        deep_count->progress_timeout_id = 0;
+    }
+
+    deep_count->done_callback (deep_count, deep_count->callback_data);
+
+    return G_SOURCE_REMOVE;
+}
+
+static gboolean
+deep_count_progress_timeout_callback (gpointer user_data)
+{
+    NautilusDeepCount *deep_count;
+
+    deep_count = user_data;
+
+    deep_count->progress_callback (deep_count, deep_count->callback_data);
+
+    return G_SOURCE_CONTINUE;
+}
+
+/* Each thread takes directories from the shared queue until it is empty
+ * and no other thread is reading a directory that could add more.
+ */
+static void
+deep_count_thread_func (gpointer data,
+                        gpointer user_data)
+{
+    NautilusDeepCount *deep_count;
+    DirectoryTotals totals;
+    DirectoryNode *node;
+    GList *l;
+    gboolean last;
+
+    deep_count = data;
+
+    g_mutex_lock (&deep_count->mutex);
+
+    for (;;)
+    {
+        while (g_queue_is_empty (&deep_count->directories) &&
+               deep_count->directories_being_read > 0 &&
+               !g_cancellable_is_cancelled (deep_count->cancellable))
+        {
+            g_cond_wait (&deep_count->cond, &deep_count->mutex);
+        }
+
+        if (g_cancellable_is_cancelled (deep_count->cancellable) ||
+            g_queue_is_empty (&deep_count->directories))
+        {
+            break;
+        }
+
+        node = g_queue_pop_head (&deep_count->directories);
+        deep_count->directories_being_read++;
+
+        g_mutex_unlock (&deep_count->mutex);
+
+        memset (&totals, 0, sizeof (totals));
+        count_directory (deep_count, node, &totals);
+        directory_node_free (node);
+
+        g_mutex_lock (&deep_count->mutex);
+
+        add_size (&deep_count->totals, &totals.size);
+
+        /* Depth first keeps the queue short. */
+        for (l = totals.subdirectories; l != NULL; l = l->next)
+        {
+            g_queue_push_head (&deep_count->directories, l->data);
+        }
+        g_list_free (totals.subdirectories);
+
+        deep_count->directories_being_read--;
+        g_cond_broadcast (&deep_count->cond);
+    }
+
+    deep_count->threads_running--;
+    last = deep_count->threads_running == 0;
+
+    g_mutex_unlock (&deep_count->mutex);
+
+    if (last)
+    {
+        g_idle_add (deep_count_done_idle_callback, deep_count);
+    }
+}
+
+NautilusDeepCount *
+nautilus_deep_count_new (const char                *path,
+                         gboolean                   skip_hidden_files,
+                         GCancellable              *cancellable,
+                         NautilusDeepCountCallback  progress_callback,
+                         NautilusDeepCountCallback  done_callback,
+                         gpointer                   callback_data)
+{
+    NautilusDeepCount *deep_count;
+    DirectoryNode *root;
+    struct stat statbuf;
+    guint i, n_threads;
+
+    g_return_val_if_fail (path != NULL, NULL);
+    g_return_val_if_fail (done_callback != NULL, NULL);
+
+    deep_count = g_new0 (NautilusDeepCount, 1);
+    deep_count->cancellable = cancellable != NULL ? g_object_ref (cancellable) : g_cancellable_new ();
+    deep_count->skip_hidden_files = skip_hidden_files;
+    deep_count->progress_callback = progress_callback;
+    deep_count->done_callback = done_callback;
+    deep_count->callback_data = callback_data;
+
+    g_mutex_init (&deep_count->mutex);
+    g_cond_init (&deep_count->cond);
+    deep_count->seen_inodes = nautilus_inode_set_new ();
+
+    if (stat (path, &statbuf) == 0)
+    {
+        deep_count->device = statbuf.st_dev;
+        root = directory_node_new (g_strdup (path), &statbuf);
+    }
+    else
+    {
+        root = directory_node_new (g_strdup (path), NULL);
+    }
+
+    g_queue_push_tail (&deep_count->directories, root);
+
+    if (progress_callback != NULL)
+    {
+        deep_count->progress_timeout_id =
+            g_timeout_add (NAUTILUS_DEEP_COUNT_UPDATE_INTERVAL_MSEC,
+                           deep_count_progress_timeout_callback,
+                           deep_count);
+    }
+
+    n_threads = get_max_deep_count_threads ();
+    deep_count->threads = g_thread_pool_new (deep_count_thread_func, NULL,
+                                             n_threads, FALSE, NULL);
+
+    /* Set before any of them can finish. */
+    deep_count->threads_running = n_threads;
+    for (i = 0; i < n_threads; i++)
+    {
+        g_thread_pool_push (deep_count->threads, deep_count, NULL);
+    }
+
+    return deep_count;
+}
+
+void
+nautilus_deep_count_free (NautilusDeepCount *deep_count)
+{
+    DirectoryNode *node;
+
+    g_return_if_fail (deep_count->threads_running == 0);
+
+    /* The threads may still be on their way out. */
+    g_thread_pool_free (deep_count->threads, FALSE, TRUE);
+
+    while ((node = g_queue_pop_head (&deep_count->directories)) != NULL)
+    {
+        directory_node_free (node);
+    }
+    nautilus_inode_set_free (deep_count->seen_inodes);
+    g_mutex_clear (&deep_count->mutex);
+    g_cond_clear (&deep_count->cond);
+    g_object_unref (deep_count->cancellable);
+    g_free (deep_count);
+}
+
+void
+nautilus_deep_count_get_totals (NautilusDeepCount *deep_count,
+                                guint             *directory_count,
+                                guint             *file_count,
+                                guint             *unreadable_directory_count,
+                                goffset           *total_size)
+{
+    g_mutex_lock (&deep_count->mutex);
+
+    if (directory_count != NULL)
+    {
+        *directory_count = deep_count->totals.directory_count;
+    }
+    if (file_count != NULL)
+    {
+        *file_count = deep_count->totals.file_count;
+    }
+    if (unreadable_directory_count != NULL)
+    {
+        *unreadable_directory_count = deep_count->totals.unreadable_directory_count;
+    }
+    if (total_size != NULL)
+    {
+        *total_size = deep_count->totals.total_size;
+    }
+
+    g_mutex_unlock (&deep_count->mutex);
+}
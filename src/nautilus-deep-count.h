@@ -0,0 +1,54 @@
+/*
+   nautilus-deep-count.h: Count the contents of a local directory tree
+   with several threads.
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of the
+   License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public
+   License along with this program; if not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef NAUTILUS_DEEP_COUNT_H
+#define NAUTILUS_DEEP_COUNT_H
+
+#include <gio/gio.h>
+
+/* Don't tell clients about counts in progress more often than this. */
+#define NAUTILUS_DEEP_COUNT_UPDATE_INTERVAL_MSEC 250
+
+typedef struct NautilusDeepCount NautilusDeepCount;
+
+typedef void (* NautilusDeepCountCallback) (NautilusDeepCount *deep_count,
+					    gpointer           callback_data);
+
+/* Starts counting the tree at @path right away. Only directories on the
+ * same filesystem as @path are descended into, and hard linked files
+ * only add their size once, like the GIO based count does.
+ *
+ * @progress_callback is called from the main loop now and then while
+ * counting. @done_callback is called exactly once when counting
+ * finished or was cancelled, after which the count can be freed.
+ */
+NautilusDeepCount *nautilus_deep_count_new        (const char                *path,
+						   gboolean                   skip_hidden_files,
+						   GCancellable              *cancellable,
+						   NautilusDeepCountCallback  progress_callback,
+						   NautilusDeepCountCallback  done_callback,
+						   gpointer                   callback_data);
+void               nautilus_deep_count_free       (NautilusDeepCount         *deep_count);
+
+void               nautilus_deep_count_get_totals (NautilusDeepCount         *deep_count,
+						   guint                     *directory_count,
+						   guint                     *file_count,
+						   guint                     *unreadable_directory_count,
+						   goffset                   *total_size);
+
+#endif /* NAUTILUS_DEEP_COUNT_H */
@@ -21,11 +21,13 @@
 
 #include <config.h>
 
+#include "nautilus-deep-count.h"
 #include "nautilus-directory-notify.h"
 #include "nautilus-directory-private.h"
 #include "nautilus-file-attributes.h"
 #include "nautilus-file-private.h"
 #include "nautilus-file-utilities.h"
+#include "nautilus-inode-set.h"
 #include "nautilus-signaller.h"
 #include "nautilus-global-preferences.h"
 #include "nautilus-link.h"
@@ -54,8 +56,26 @@
 
 #define DIRECTORY_LOAD_ITEMS_PER_CALLBACK 100
 
-/* Keep async. jobs down to this number for all directories. */
-#define MAX_ASYNC_JOBS 10
+/* Turn loaded file infos into files for at most this long at a time,
+ * so that loading huge directories doesn't hold up redrawing. The
+ * clock is only checked every few entries.
+ */
+#define DEQUEUE_PENDING_TIME_SLICE_USEC (8 * 1000)
+#define DEQUEUE_PENDING_ENTRIES_PER_TIME_CHECK 32
+
+/* Jobs that take longer than this on average are latency bound, so
+ * we grow the budget to keep more of them in flight.
+ */
+#define ASYNC_JOB_TARGET_LATENCY_USEC (4 * 1000)
+
+/* Number of requests of one kind a single directory keeps in flight. */
+#define JOBS_PER_KIND_LOCAL 4
+#define JOBS_PER_KIND_REMOTE 16
+
+/* Thumbnails are decoded by up to this many threads of their own, for
+ * all directories, so they never hold up the GIO worker threads.
+ */
+#define MAX_THUMBNAIL_LOAD_THREADS 8
 
 struct TopLeftTextReadState
 {
@@ -77,8 +97,12 @@ struct ThumbnailState
     NautilusDirectory *directory;
     GCancellable *cancellable;
     NautilusFile *file;
-    gboolean trying_original;
     gboolean tried_original;
+
+    /* Only read by the loading thread */
+    GFile *original;
+    GFile *thumbnail;
+    int max_size;
 };
 
 struct MountState
@@ -93,6 +117,7 @@ struct FilesystemInfoState
     NautilusDirectory *directory;
     GCancellable *cancellable;
     NautilusFile *file;
+    char *filesystem_id;
 };
 
 struct DirectoryLoadState
@@ -117,7 +142,9 @@ struct MimeListState
 struct GetInfoState
 {
     NautilusDirectory *directory;
+    NautilusFile *file;
     GCancellable *cancellable;
+    gint64 start_time;
 };
 
 struct NewFilesState
@@ -134,6 +161,7 @@ struct DirectoryCountState
     GCancellable *cancellable;
     GFileEnumerator *enumerator;
     int file_count;
+    gint64 start_time;
 };
 
 struct DeepCountState
@@ -143,8 +171,10 @@ struct DeepCountState
     GFileEnumerator *enumerator;
     GFile *deep_count_location;
     GList *deep_count_subdirectories;
-    GArray *seen_deep_count_inodes;
+    NautilusInodeSet *seen_deep_count_inodes;
     char *fs_id;
+    gint64 last_update_time;
+    NautilusDeepCount *native_count;     /* used instead of the above for local paths */
 };
 
 
@@ -182,11 +212,22 @@ typedef struct
     NautilusOperationResult result;
 } InfoProviderResponse;
 
+typedef enum
+{
+    ASYNC_JOB_PRIORITY_HIGH,
+    ASYNC_JOB_PRIORITY_LOW
+} AsyncJobPriority;
+
 typedef gboolean (*RequestCheck) (Request);
 typedef gboolean (*FileCheck) (NautilusFile *);
 
-/* Current number of async. jobs. */
+/* Current number of async. jobs, and how many of those are low
+ * priority.
+ */
 static int async_job_count;
+static int async_low_priority_job_count;
+static int async_job_budget = MIN_ASYNC_JOBS;
+static gint64 async_job_average_latency;
 static GHashTable *waiting_directories;
 #ifdef DEBUG_ASYNC_JOBS
 static GHashTable *async_jobs;
@@ -370,8 +411,10 @@ nautilus_directory_verify_request_counts (NautilusDirectory *directory)
  */
 static gboolean
 async_job_start (NautilusDirectory *directory,
-                 const char        *job)
+                 const char        *job,
+                 AsyncJobPriority   priority)
 {
+    int limit;
 #ifdef DEBUG_ASYNC_JOBS
     char *key;
 #endif
@@ -383,7 +426,13 @@ async_job_start (NautilusDirectory *directory,
     g_assert (async_job_count >= 0);
     g_assert (async_job_count <= MAX_ASYNC_JOBS);
 
-    if (async_job_count >= MAX_ASYNC_JOBS)
+    limit = async_job_budget;
+    if (priority == ASYNC_JOB_PRIORITY_LOW)
+    {
+        limit = MAX (1, limit * ASYNC_JOB_LOW_PRIORITY_SHARE / 100);
+    }
+
+    if (async_job_count >= limit)
     {
         if (waiting_directories == NULL)
         {
@@ -417,13 +466,18 @@ async_job_start (NautilusDirectory *directory,
 #endif
 
     async_job_count += 1;
+    if (priority == ASYNC_JOB_PRIORITY_LOW)
+    {
+        async_low_priority_job_count += 1;
+    }
     return TRUE;
 }
 
 /* End a job. */
 static void
 async_job_end (NautilusDirectory *directory,
-               const char        *job)
+               const char        *job,
+               AsyncJobPriority   priority)
 {
 #ifdef DEBUG_ASYNC_JOBS
     char *key;
@@ -458,6 +512,77 @@ async_job_end (NautilusDirectory *directory,
 #endif
 
     async_job_count -= 1;
+    if (priority == ASYNC_JOB_PRIORITY_LOW)
+    {
+        g_assert (async_low_priority_job_count > 0);
+        async_low_priority_job_count -= 1;
+    }
+}
+
+/* Feed the time a job took into the budget. Slow jobs mean we are
+ * waiting on the network (or a slow disk) rather than on the CPU, and
+ * having more requests in flight hides that latency.
+ */
+static void
+async_job_record_latency (gint64 start_time)
+{
+    gint64 latency;
+    gint64 budget;
+
+    latency = g_get_monotonic_time () - start_time;
+
+    if (async_job_average_latency == 0)
+    {
+        async_job_average_latency = latency;
+    }
+    else
+    {
+        /* Exponentially weighted moving average, weight 1/8. */
+        async_job_average_latency += (latency - async_job_average_latency) / 8;
+    }
+
+    budget = MIN_ASYNC_JOBS +
+             MIN_ASYNC_JOBS * async_job_average_latency / ASYNC_JOB_TARGET_LATENCY_USEC;
+    async_job_budget = CLAMP (budget, MIN_ASYNC_JOBS, MAX_ASYNC_JOBS);
+}
+
+int
+nautilus_directory_get_async_job_count (void)
+{
+    return async_job_count;
+}
+
+int
+nautilus_directory_get_async_job_budget (void)
+{
+    return async_job_budget;
+}
+
+int
+nautilus_directory_get_async_low_priority_job_count (void)
+{
+    return async_low_priority_job_count;
+}
+
+guint
+nautilus_directory_get_jobs_per_kind (NautilusDirectory *directory)
+{
+    /* Remote requests are latency bound, so keep more of them going. */
+    if (directory->details->jobs_per_kind == 0)
+    {
+        directory->details->jobs_per_kind =
+            nautilus_directory_is_local_or_fuse (directory) ?
+            JOBS_PER_KIND_LOCAL : JOBS_PER_KIND_REMOTE;
+    }
+
+    return directory->details->jobs_per_kind;
+}
+
+guint
+nautilus_directory_get_jobs_in_flight (NautilusDirectory *directory)
+{
+    return MAX (g_list_length (directory->details->get_info_in_progress),
+                g_list_length (directory->details->count_in_progress));
 }
 
 /* Helper to get one value from a hash table. */
@@ -504,7 +629,7 @@ async_job_wake_up (void)
     }
 
     already_waking_up = TRUE;
-    while (async_job_count < MAX_ASYNC_JOBS)
+    while (async_job_count < async_job_budget)
     {
         value = get_one_value (waiting_directories);
         if (value == NULL)
@@ -518,13 +643,23 @@ async_job_wake_up (void)
     already_waking_up = FALSE;
 }
 
+static void
+directory_count_cancel_one (NautilusDirectory   *directory,
+                            DirectoryCountState *state)
+{
+    /* The callback notices the cancellation and ends the job. */
+    g_cancellable_cancel (state->cancellable);
+    directory->details->count_in_progress =
+        g_list_remove (directory->details->count_in_progress, state);
+}
+
 static void
 directory_count_cancel (NautilusDirectory *directory)
 {
-    if (directory->details->count_in_progress != NULL)
+    while (directory->details->count_in_progress != NULL)
     {
-        g_cancellable_cancel (directory->details->count_in_progress->cancellable);
-        directory->details->count_in_progress = NULL;
+        directory_count_cancel_one (directory,
+                                    directory->details->count_in_progress->data);
     }
 }
 
@@ -543,7 +678,7 @@ deep_count_cancel (NautilusDirectory *directory)
         directory->details->deep_count_in_progress = NULL;
         directory->details->deep_count_file = NULL;
 
-        async_job_end (directory, "deep count");
+        async_job_end (directory, "deep count", ASYNC_JOB_PRIORITY_LOW);
     }
 }
 
@@ -564,19 +699,33 @@ link_info_cancel (NautilusDirectory *directory)
         g_cancellable_cancel (directory->details->link_info_read_state->cancellable);
         directory->details->link_info_read_state->directory = NULL;
         directory->details->link_info_read_state = NULL;
-        async_job_end (directory, "link info");
+        async_job_end (directory, "link info", ASYNC_JOB_PRIORITY_HIGH);
     }
 }
 
+static void
+thumbnail_cancel_one (NautilusDirectory *directory,
+                      ThumbnailState    *state)
+{
+    /* The loading thread runs to completion, the callback then frees
+     * the state and drops the pixbuf.
+     */
+    g_cancellable_cancel (state->cancellable);
+    state->directory = NULL;
+    state->file = NULL;
+    directory->details->thumbnail_states =
+        g_list_remove (directory->details->thumbnail_states, state);
+
+    async_job_end (directory, "thumbnail", ASYNC_JOB_PRIORITY_LOW);
+}
+
 static void
 thumbnail_cancel (NautilusDirectory *directory)
 {
-    if (directory->details->thumbnail_state != NULL)
+    while (directory->details->thumbnail_states != NULL)
     {
-        g_cancellable_cancel (directory->details->thumbnail_state->cancellable);
-        directory->details->thumbnail_state->directory = NULL;
-        directory->details->thumbnail_state = NULL;
-        async_job_end (directory, "thumbnail");
+        thumbnail_cancel_one (directory,
+                              directory->details->thumbnail_states->data);
     }
 }
 
@@ -588,21 +737,30 @@ mount_cancel (NautilusDirectory *directory)
         g_cancellable_cancel (directory->details->mount_state->cancellable);
         directory->details->mount_state->directory = NULL;
         directory->details->mount_state = NULL;
-        async_job_end (directory, "mount");
+        async_job_end (directory, "mount", ASYNC_JOB_PRIORITY_LOW);
     }
 }
 
+static void
+file_info_cancel_one (NautilusDirectory *directory,
+                      GetInfoState      *state)
+{
+    g_cancellable_cancel (state->cancellable);
+    state->directory = NULL;
+    state->file = NULL;
+    directory->details->get_info_in_progress =
+        g_list_remove (directory->details->get_info_in_progress, state);
+
+    async_job_end (directory, "file info", ASYNC_JOB_PRIORITY_HIGH);
+}
+
 static void
 file_info_cancel (NautilusDirectory *directory)
 {
-    if (directory->details->get_info_in_progress != NULL)
+    while (directory->details->get_info_in_progress != NULL)
     {
-        g_cancellable_cancel (directory->details->get_info_in_progress->cancellable);
-        directory->details->get_info_in_progress->directory = NULL;
-        directory->details->get_info_in_progress = NULL;
-        directory->details->get_info_file = NULL;
-
-        async_job_end (directory, "file info");
+        file_info_cancel_one (directory,
+                              directory->details->get_info_in_progress->data);
     }
 }
 
@@ -878,10 +1036,12 @@ set_file_unconfirmed (NautilusFile *file,
     if (unconfirmed)
     {
         directory->details->confirmed_file_count--;
+        g_hash_table_add (directory->details->unconfirmed_files, file);
     }
     else
     {
         directory->details->confirmed_file_count++;
+        g_hash_table_remove (directory->details->unconfirmed_files, file);
     }
 }
 
@@ -894,8 +1054,7 @@ show_hidden_files_changed_callback (gpointer callback_data)
 }
 
 static gboolean
-should_skip_file (NautilusDirectory *directory,
-                  GFileInfo         *info)
+get_show_hidden_files (void)
 {
     static gboolean show_hidden_files_changed_callback_installed = FALSE;
 
@@ -913,7 +1072,14 @@ should_skip_file (NautilusDirectory *directory,
         show_hidden_files_changed_callback (NULL);
     }
 
-    if (!show_hidden_files &&
+    return show_hidden_files;
+}
+
+static gboolean
+should_skip_file (NautilusDirectory *directory,
+                  GFileInfo         *info)
+{
+    if (!get_show_hidden_files () &&
         (g_file_info_get_is_hidden (info) ||
          g_file_info_get_is_backup (info)))
     {
@@ -923,70 +1089,96 @@ should_skip_file (NautilusDirectory *directory,
     return FALSE;
 }
 
+/* Files the load didn't bring in still need their info. */
+static void
+queue_files_left_to_load (NautilusDirectory *directory)
+{
+    if (directory->details->file_info_left_to_load)
+    {
+        directory->details->file_info_left_to_load = FALSE;
+        add_all_files_to_work_queue (directory);
+    }
+}
+
+/* Marks the files the load didn't come across as gone. */
+static GList *
+sweep_unconfirmed_files (NautilusDirectory *directory,
+                         GList             *changed_files)
+{
+    GList *unconfirmed_files, *node;
+    NautilusFile *file;
+
+    /* Going gone takes the files out of the set. */
+    unconfirmed_files = g_hash_table_get_keys (directory->details->unconfirmed_files);
+    for (node = unconfirmed_files; node != NULL; node = node->next)
+    {
+        file = NAUTILUS_FILE (node->data);
+
+        nautilus_file_ref (file);
+        changed_files = g_list_prepend (changed_files, file);
+
+        nautilus_file_mark_gone (file);
+    }
+    g_list_free (unconfirmed_files);
+
+    return changed_files;
+}
+
 static gboolean
 dequeue_pending_idle_callback (gpointer callback_data)
 {
     NautilusDirectory *directory;
-    GList *pending_file_info;
-    GList *node, *next;
+    GPtrArray *pending_file_info;
     NautilusFile *file;
     GList *changed_files, *added_files;
     GFileInfo *file_info;
-    const char *mimetype, *name;
-    DirectoryLoadState *dir_load_state;
+    const char *name;
+    gint64 deadline;
+    gboolean done;
+    guint i;
 
     directory = NAUTILUS_DIRECTORY (callback_data);
 
     nautilus_directory_ref (directory);
 
-    nautilus_profile_start ("nitems %d", g_list_length (directory->details->pending_file_info));
-
-    directory->details->dequeue_pending_idle_id = 0;
+    pending_file_info = directory->details->pending_file_info;
 
-    /* Handle the files in the order we saw them. */
-    pending_file_info = g_list_reverse (directory->details->pending_file_info);
-    directory->details->pending_file_info = NULL;
+    nautilus_profile_start ("nitems %u", pending_file_info->len);
 
     /* If we are no longer monitoring, then throw away these. */
     if (!nautilus_directory_is_file_list_monitored (directory))
     {
+        g_ptr_array_set_size (pending_file_info, 0);
+        directory->details->dequeue_pending_idle_id = 0;
+        queue_files_left_to_load (directory);
         nautilus_directory_async_state_changed (directory);
-        goto drain;
+
+        nautilus_profile_end (NULL);
+        nautilus_directory_unref (directory);
+        return G_SOURCE_REMOVE;
     }
 
     added_files = NULL;
     changed_files = NULL;
 
-    dir_load_state = directory->details->directory_load_in_progress;
+    deadline = g_get_monotonic_time () + DEQUEUE_PENDING_TIME_SLICE_USEC;
 
-    /* Build a list of NautilusFile objects. */
-    for (node = pending_file_info; node != NULL; node = node->next)
+    /* Handle the files in the order we saw them, as many as fit in
+     * this time slice.
+     */
+    for (i = 0; i < pending_file_info->len; i++)
     {
-        file_info = node->data;
-
-        name = g_file_info_get_name (file_info);
-
-        /* Update the file count. */
-        /* FIXME bugzilla.gnome.org 45063: This could count a
-         * file twice if we get it from both load_directory
-         * and from new_files_callback. Not too hard to fix by
-         * moving this into the actual callback instead of
-         * waiting for the idle function.
-         */
-        if (dir_load_state &&
-            !should_skip_file (directory, file_info))
+        if (i > 0 &&
+            i % DEQUEUE_PENDING_ENTRIES_PER_TIME_CHECK == 0 &&
+            g_get_monotonic_time () >= deadline)
         {
-            dir_load_state->load_file_count += 1;
-
-            /* Add the MIME type to the set. */
-            mimetype = g_file_info_get_content_type (file_info);
-            if (mimetype != NULL)
-            {
-                istr_set_insert (dir_load_state->load_mime_list_hash,
-                                 mimetype);
-            }
+            break;
         }
 
+        file_info = g_ptr_array_index (pending_file_info, i);
+
+        name = g_file_info_get_name (file_info);
+
         /* check if the file already exists */
         file = nautilus_directory_find_file_by_name (directory, name);
         if (file != NULL)
@@ -999,7 +1191,10 @@ dequeue_pending_idle_callback (gpointer callback_data)
                 /* We consider this newly added even if its in the list.
                  * This can happen if someone called nautilus_file_get_by_uri()
                  * on a file in the folder before the add signal was
-                 * emitted */
+                 * emitted. Take the info we have at hand, so it doesn't
+                 * have to be got again.
+                 */
+                nautilus_file_update_info (file, file_info);
                 nautilus_file_ref (file);
                 file->details->is_added = TRUE;
                 added_files = g_list_prepend (added_files, file);
@@ -1021,63 +1216,44 @@ dequeue_pending_idle_callback (gpointer callback_data)
         }
     }
 
+    g_ptr_array_remove_range (pending_file_info, 0, i);
+    done = pending_file_info->len == 0;
+
     /* If we are done loading, then we assume that any unconfirmed
      * files are gone.
      */
-    if (directory->details->directory_loaded)
+    if (done && directory->details->directory_loaded)
     {
-        for (node = directory->details->file_list;
-             node != NULL; node = next)
-        {
-            file = NAUTILUS_FILE (node->data);
-            next = node->next;
-
-            if (file->details->unconfirmed)
-            {
-                nautilus_file_ref (file);
-                changed_files = g_list_prepend (changed_files, file);
-
-                nautilus_file_mark_gone (file);
-            }
-        }
+        changed_files = sweep_unconfirmed_files (directory, changed_files);
     }
 
-    /* Send the changed and added signals. */
+    /* Send the changed and added signals, one batch per time slice. */
     nautilus_directory_emit_change_signals (directory, changed_files);
     nautilus_file_list_free (changed_files);
     nautilus_directory_emit_files_added (directory, added_files);
     nautilus_file_list_free (added_files);
 
-    if (directory->details->directory_loaded &&
+    if (done &&
+        directory->details->directory_loaded &&
         !directory->details->directory_loaded_sent_notification)
     {
         /* Send the done_loading signal. */
         nautilus_directory_emit_done_loading (directory);
 
-        if (dir_load_state)
-        {
-            file = dir_load_state->load_directory_file;
-
-            file->details->directory_count = dir_load_state->load_file_count;
-            file->details->directory_count_is_up_to_date = TRUE;
-            file->details->got_directory_count = TRUE;
-
-            file->details->got_mime_list = TRUE;
-            file->details->mime_list_is_up_to_date = TRUE;
-            g_list_free_full (file->details->mime_list, g_free);
-            file->details->mime_list = istr_set_get_as_list
-                                           (dir_load_state->load_mime_list_hash);
-
-            nautilus_file_changed (file);
-        }
-
         nautilus_directory_async_state_changed (directory);
 
         directory->details->directory_loaded_sent_notification = TRUE;
     }
 
-drain:
-    g_list_free_full (pending_file_info, g_object_unref);
+    if (done)
+    {
+        directory->details->dequeue_pending_idle_id = 0;
+
+        if (directory->details->directory_load_in_progress == NULL)
+        {
+            queue_files_left_to_load (directory);
+        }
+    }
 
     /* Get the state machine running again. */
     nautilus_directory_async_state_changed (directory);
@@ -1085,7 +1261,8 @@ drain:
     nautilus_profile_end (NULL);
 
     nautilus_directory_unref (directory);
-    return FALSE;
+
+    return done ? G_SOURCE_REMOVE : G_SOURCE_CONTINUE;
 }
 
 void
@@ -1102,6 +1279,9 @@ static void
 directory_load_one (NautilusDirectory *directory,
                     GFileInfo         *info)
 {
+    DirectoryLoadState *state;
+    const char *mimetype;
+
     if (info == NULL)
     {
         return;
@@ -1118,10 +1298,24 @@ directory_load_one (NautilusDirectory *directory,
         return;
     }
 
+    /* Count the file right away, so it can't be counted twice if it
+     * also comes in through new_files_callback.
+     */
+    state = directory->details->directory_load_in_progress;
+    if (state != NULL && !should_skip_file (directory, info))
+    {
+        state->load_file_count += 1;
+
+        /* Add the MIME type to the set. */
+        mimetype = g_file_info_get_content_type (info);
+        if (mimetype != NULL)
+        {
+            istr_set_insert (state->load_mime_list_hash, mimetype);
+        }
+    }
+
     /* Arrange for the "loading" part of the work. */
-    g_object_ref (info);
-    directory->details->pending_file_info
-        = g_list_prepend (directory->details->pending_file_info, info);
+    g_ptr_array_add (directory->details->pending_file_info, g_object_ref (info));
     nautilus_directory_schedule_dequeue_pending (directory);
 }
 
@@ -1144,7 +1338,7 @@ directory_load_cancel (NautilusDirectory *directory)
         g_cancellable_cancel (state->cancellable);
         state->directory = NULL;
         directory->details->directory_load_in_progress = NULL;
-        async_job_end (directory, "file list");
+        async_job_end (directory, "file list", ASYNC_JOB_PRIORITY_HIGH);
     }
 }
 
@@ -1159,18 +1353,18 @@ file_list_cancel (NautilusDirectory *directory)
         directory->details->dequeue_pending_idle_id = 0;
     }
 
-    if (directory->details->pending_file_info != NULL)
-    {
-        g_list_free_full (directory->details->pending_file_info, g_object_unref);
-        directory->details->pending_file_info = NULL;
-    }
+    g_ptr_array_set_size (directory->details->pending_file_info, 0);
+
+    queue_files_left_to_load (directory);
 }
 
 static void
 directory_load_done (NautilusDirectory *directory,
                      GError            *error)
 {
-    GList *node;
+    DirectoryLoadState *state;
+    NautilusFile *file;
+    GList *unconfirmed_files, *node;
 
     nautilus_profile_start (NULL);
     g_object_ref (directory);
@@ -1186,23 +1380,41 @@ directory_load_done (NautilusDirectory *directory,
          * they won't be marked "gone" later -- we don't know enough
          * about them to know whether they are really gone.
          */
-        for (node = directory->details->file_list;
-             node != NULL; node = node->next)
+        unconfirmed_files = g_hash_table_get_keys (directory->details->unconfirmed_files);
+        for (node = unconfirmed_files; node != NULL; node = node->next)
         {
             set_file_unconfirmed (NAUTILUS_FILE (node->data), FALSE);
         }
+        g_list_free (unconfirmed_files);
 
         nautilus_directory_emit_load_error (directory, error);
     }
 
-    /* Call the idle function right away. */
-    if (directory->details->dequeue_pending_idle_id != 0)
+    state = directory->details->directory_load_in_progress;
+    if (state != NULL)
     {
-        g_source_remove (directory->details->dequeue_pending_idle_id);
+        file = state->load_directory_file;
+
+        file->details->directory_count = state->load_file_count;
+        file->details->directory_count_is_up_to_date = TRUE;
+        file->details->got_directory_count = TRUE;
+
+        file->details->got_mime_list = TRUE;
+        file->details->mime_list_is_up_to_date = TRUE;
+        g_list_free_full (file->details->mime_list, g_free);
+        file->details->mime_list = istr_set_get_as_list
+                                       (state->load_mime_list_hash);
+
+        nautilus_file_changed (file);
     }
-    dequeue_pending_idle_callback (directory);
+
+    /* Files still pending are dequeued a time slice at a time, the
+     * last one sends the done_loading signal.
+     */
+    nautilus_directory_schedule_dequeue_pending (directory);
 
     directory_load_cancel (directory);
+    nautilus_directory_async_state_changed (directory);
 
     g_object_unref (directory);
     nautilus_profile_end (NULL);
@@ -1666,6 +1878,9 @@ nautilus_async_destroying_file (NautilusFile *file)
     GList *node, *next;
     ReadyCallback *callback;
     Monitor *monitor;
+    DirectoryCountState *count_state;
+    GetInfoState *get_info_state;
+    ThumbnailState *thumbnail_state;
 
     directory = file->details->directory;
     changed = FALSE;
@@ -1706,11 +1921,14 @@ nautilus_async_destroying_file (NautilusFile *file)
     /* Check if it's a file that's currently being worked on.
      * If so, make that NULL so it gets canceled right away.
      */
-    if (directory->details->count_in_progress != NULL &&
-        directory->details->count_in_progress->count_file == file)
+    for (node = directory->details->count_in_progress; node != NULL; node = node->next)
     {
-        directory->details->count_in_progress->count_file = NULL;
-        changed = TRUE;
+        count_state = node->data;
+        if (count_state->count_file == file)
+        {
+            count_state->count_file = NULL;
+            changed = TRUE;
+        }
     }
     if (directory->details->deep_count_file == file)
     {
@@ -1723,10 +1941,14 @@ nautilus_async_destroying_file (NautilusFile *file)
         directory->details->mime_list_in_progress->mime_list_file = NULL;
         changed = TRUE;
     }
-    if (directory->details->get_info_file == file)
+    for (node = directory->details->get_info_in_progress; node != NULL; node = node->next)
     {
-        directory->details->get_info_file = NULL;
-        changed = TRUE;
+        get_info_state = node->data;
+        if (get_info_state->file == file)
+        {
+            get_info_state->file = NULL;
+            changed = TRUE;
+        }
     }
     if (directory->details->link_info_read_state != NULL &&
         directory->details->link_info_read_state->file == file)
@@ -1740,11 +1962,14 @@ nautilus_async_destroying_file (NautilusFile *file)
         changed = TRUE;
     }
 
-    if (directory->details->thumbnail_state != NULL &&
-        directory->details->thumbnail_state->file == file)
+    for (node = directory->details->thumbnail_states; node != NULL; node = node->next)
     {
-        directory->details->thumbnail_state->file = NULL;
-        changed = TRUE;
+        thumbnail_state = node->data;
+        if (thumbnail_state->file == file)
+        {
+            thumbnail_state->file = NULL;
+            changed = TRUE;
+        }
     }
 
     if (directory->details->mount_state != NULL &&
@@ -1846,6 +2071,7 @@ static gboolean
 lacks_thumbnail (NautilusFile *file)
 {
     return nautilus_file_should_show_thumbnail (file) &&
+           !nautilus_file_is_offscreen (file) &&
            file->details->thumbnail_path != NULL &&
            !file->details->thumbnail_is_up_to_date;
 }
@@ -1874,16 +2100,16 @@ has_problem (NautilusDirectory *directory,
              NautilusFile      *file,
              FileCheck          problem)
 {
-    GList *node;
+    guint i;
 
     if (file != NULL)
     {
         return (*problem)(file);
     }
 
-    for (node = directory->details->file_list; node != NULL; node = node->next)
+    for (i = 0; i < directory->details->files->len; i++)
     {
-        if ((*problem)(node->data))
+        if ((*problem)(g_ptr_array_index (directory->details->files, i)))
         {
             return TRUE;
         }
@@ -2123,13 +2349,11 @@ nautilus_directory_is_file_list_monitored (NautilusDirectory *directory)
 static void
 mark_all_files_unconfirmed (NautilusDirectory *directory)
 {
-    GList *node;
-    NautilusFile *file;
+    guint i;
 
-    for (node = directory->details->file_list; node != NULL; node = node->next)
+    for (i = 0; i < directory->details->files->len; i++)
     {
-        file = node->data;
-        set_file_unconfirmed (file, TRUE);
+        set_file_unconfirmed (g_ptr_array_index (directory->details->files, i), TRUE);
     }
 }
 
@@ -2268,7 +2492,7 @@ start_monitoring_file_list (NautilusDirectory *directory)
     {
         g_assert (!directory->details->directory_load_in_progress);
         directory->details->file_list_monitored = TRUE;
-        nautilus_file_list_ref (directory->details->file_list);
+        g_ptr_array_foreach (directory->details->files, (GFunc) nautilus_file_ref, NULL);
     }
 
     if (directory->details->directory_loaded ||
@@ -2277,13 +2501,16 @@ start_monitoring_file_list (NautilusDirectory *directory)
         return;
     }
 
-    if (!async_job_start (directory, "file list"))
+    if (!async_job_start (directory, "file list", ASYNC_JOB_PRIORITY_HIGH))
     {
         return;
     }
 
     mark_all_files_unconfirmed (directory);
 
+    /* Reloading is when filesystem changes like remounts get noticed. */
+    g_clear_pointer (&directory->details->filesystem_infos, g_hash_table_destroy);
+
     state = g_new0 (DirectoryLoadState, 1);
     state->directory = directory;
     state->cancellable = g_cancellable_new ();
@@ -2315,6 +2542,9 @@ start_monitoring_file_list (NautilusDirectory *directory)
 void
 nautilus_directory_stop_monitoring_file_list (NautilusDirectory *directory)
 {
+    GPtrArray *files;
+    guint i;
+
     if (!directory->details->file_list_monitored)
     {
         g_assert (directory->details->directory_load_in_progress == NULL);
@@ -2323,7 +2553,16 @@ nautilus_directory_stop_monitoring_file_list (NautilusDirectory *directory)
 
     directory->details->file_list_monitored = FALSE;
     file_list_cancel (directory);
-    nautilus_file_list_unref (directory->details->file_list);
+
+    /* Dropping the last ref removes a file from the array, which moves
+     * the last file into its place. Going backwards, that one has been
+     * unreffed already.
+     */
+    files = directory->details->files;
+    for (i = files->len; i > 0; i--)
+    {
+        nautilus_file_unref (g_ptr_array_index (files, i - 1));
+    }
     directory->details->directory_loaded = FALSE;
 }
 
@@ -2376,13 +2615,13 @@ static void
 nautilus_directory_invalidate_file_attributes (NautilusDirectory      *directory,
                                                NautilusFileAttributes  file_attributes)
 {
-    GList *node;
+    guint i;
 
     cancel_loading_attributes (directory, file_attributes);
 
-    for (node = directory->details->file_list; node != NULL; node = node->next)
+    for (i = 0; i < directory->details->files->len; i++)
     {
-        nautilus_file_invalidate_attributes_internal (NAUTILUS_FILE (node->data),
+        nautilus_file_invalidate_attributes_internal (g_ptr_array_index (directory->details->files, i),
                                                       file_attributes);
     }
 
@@ -2496,10 +2735,15 @@ static void
 directory_count_stop (NautilusDirectory *directory)
 {
     NautilusFile *file;
+    DirectoryCountState *state;
+    GList *node, *next;
 
-    if (directory->details->count_in_progress != NULL)
+    for (node = directory->details->count_in_progress; node != NULL; node = next)
     {
-        file = directory->details->count_in_progress->count_file;
+        next = node->next;
+        state = node->data;
+
+        file = state->count_file;
         if (file != NULL)
         {
             g_assert (NAUTILUS_IS_FILE (file));
@@ -2508,13 +2752,32 @@ directory_count_stop (NautilusDirectory *directory)
                           should_get_directory_count_now,
                           REQUEST_DIRECTORY_COUNT))
             {
-                return;
+                continue;
             }
         }
 
         /* The count is not wanted, so stop it. */
-        directory_count_cancel (directory);
+        directory_count_cancel_one (directory, state);
+    }
+}
+
+static DirectoryCountState *
+find_directory_count_state (NautilusDirectory *directory,
+                            NautilusFile      *file)
+{
+    DirectoryCountState *state;
+    GList *node;
+
+    for (node = directory->details->count_in_progress; node != NULL; node = node->next)
+    {
+        state = node->data;
+        if (state->count_file == file)
+        {
+            return state;
+        }
     }
+
+    return NULL;
 }
 
 static guint
@@ -2537,11 +2800,16 @@ count_non_skipped_files (GList *list)
 }
 
 static void
-count_children_done (NautilusDirectory *directory,
-                     NautilusFile      *count_file,
-                     gboolean           succeeded,
-                     int                count)
+count_children_done (DirectoryCountState *state,
+                     gboolean             succeeded,
+                     int                  count)
 {
+    NautilusDirectory *directory;
+    NautilusFile *count_file;
+
+    directory = state->directory;
+    count_file = state->count_file;
+
     g_assert (NAUTILUS_IS_FILE (count_file));
 
     count_file->details->directory_count_is_up_to_date = TRUE;
@@ -2559,7 +2827,9 @@ count_children_done (NautilusDirectory *directory,
         count_file->details->got_directory_count = TRUE;
         count_file->details->directory_count = count;
     }
-    directory->details->count_in_progress = NULL;
+    directory->details->count_in_progress =
+        g_list_remove (directory->details->count_in_progress, state);
+    async_job_record_latency (state->start_time);
 
     /* Send file-changed even if count failed, so interested parties can
      * distinguish between unknowable and not-yet-known cases.
@@ -2567,7 +2837,7 @@ count_children_done (NautilusDirectory *directory,
     nautilus_file_changed (count_file);
 
     /* Start up the next one. */
-    async_job_end (directory, "directory count");
+    async_job_end (directory, "directory count", ASYNC_JOB_PRIORITY_LOW);
     nautilus_directory_async_state_changed (directory);
 }
 
@@ -2605,7 +2875,7 @@ count_more_files_callback (GObject      *source_object,
     {
         /* Operation was cancelled. Bail out */
 
-        async_job_end (directory, "directory count");
+        async_job_end (directory, "directory count", ASYNC_JOB_PRIORITY_LOW);
         nautilus_directory_async_state_changed (directory);
 
         directory_count_state_free (state);
@@ -2613,8 +2883,7 @@ count_more_files_callback (GObject      *source_object,
         return;
     }
 
-    g_assert (directory->details->count_in_progress != NULL);
-    g_assert (directory->details->count_in_progress == state);
+    g_assert (g_list_find (directory->details->count_in_progress, state) != NULL);
 
     error = NULL;
     files = g_file_enumerator_next_files_finish (state->enumerator,
@@ -2624,8 +2893,7 @@ count_more_files_callback (GObject      *source_object,
 
     if (files == NULL)
     {
-        count_children_done (directory, state->count_file,
-                             TRUE, state->file_count);
+        count_children_done (state, TRUE, state->file_count);
         directory_count_state_free (state);
     }
     else
@@ -2663,7 +2931,7 @@ count_children_callback (GObject      *source_object,
         /* Operation was cancelled. Bail out */
         directory = state->directory;
 
-        async_job_end (directory, "directory count");
+        async_job_end (directory, "directory count", ASYNC_JOB_PRIORITY_LOW);
         nautilus_directory_async_state_changed (directory);
 
         directory_count_state_free (state);
@@ -2677,9 +2945,7 @@ count_children_callback (GObject      *source_object,
 
     if (enumerator == NULL)
     {
-        count_children_done (state->directory,
-                             state->count_file,
-                             FALSE, 0);
+        count_children_done (state, FALSE, 0);
         g_error_free (error);
         directory_count_state_free (state);
         return;
@@ -2704,12 +2970,6 @@ directory_count_start (NautilusDirectory *directory,
     DirectoryCountState *state;
     GFile *location;
 
-    if (directory->details->count_in_progress != NULL)
-    {
-        *doing_io = TRUE;
-        return;
-    }
-
     if (!is_needy (file,
                    should_get_directory_count_now,
                    REQUEST_DIRECTORY_COUNT))
@@ -2718,6 +2978,13 @@ directory_count_start (NautilusDirectory *directory,
     }
     *doing_io = TRUE;
 
+    /* Already counting this one, or the pipeline is full. */
+    if (find_directory_count_state (directory, file) != NULL ||
+        g_list_length (directory->details->count_in_progress) >= nautilus_directory_get_jobs_per_kind (directory))
+    {
+        return;
+    }
+
     if (!nautilus_file_is_directory (file))
     {
         file->details->directory_count_is_up_to_date = TRUE;
@@ -2728,7 +2995,7 @@ directory_count_start (NautilusDirectory *directory,
         return;
     }
 
-    if (!async_job_start (directory, "directory count"))
+    if (!async_job_start (directory, "directory count", ASYNC_JOB_PRIORITY_LOW))
     {
         return;
     }
@@ -2738,8 +3005,10 @@ directory_count_start (NautilusDirectory *directory,
     state->count_file = file;
     state->directory = nautilus_directory_ref (directory);
     state->cancellable = g_cancellable_new ();
+    state->start_time = g_get_monotonic_time ();
 
-    directory->details->count_in_progress = state;
+    directory->details->count_in_progress =
+        g_list_prepend (directory->details->count_in_progress, state);
 
     location = nautilus_file_get_location (file);
 #ifdef DEBUG_LOAD_DIRECTORY
@@ -2763,41 +3032,33 @@ directory_count_start (NautilusDirectory *directory,
     g_object_unref (location);
 }
 
-static inline gboolean
+/* Returns TRUE if the file is a hard link to an inode counted before.
+ * Only files with more than one link can be seen again, so only those
+ * are remembered.
+ */
+static gboolean
 seen_inode (DeepCountState *state,
             GFileInfo      *info)
 {
-    guint64 inode, inode2;
-    guint i;
-
-    inode = g_file_info_get_attribute_uint64 (info, G_FILE_ATTRIBUTE_UNIX_INODE);
+    guint64 inode;
+    guint32 device;
 
-    if (inode != 0)
+    /* Directories can't be hard linked. */
+    if (g_file_info_get_file_type (info) == G_FILE_TYPE_DIRECTORY)
     {
-        for (i = 0; i < state->seen_deep_count_inodes->len; i++)
-        {
-            inode2 = g_array_index (state->seen_deep_count_inodes, guint64, i);
-            if (inode == inode2)
-            {
-                return TRUE;
-            }
-        }
+        return FALSE;
     }
 
-    return FALSE;
-}
-
-static inline void
-mark_inode_as_seen (DeepCountState *state,
-                    GFileInfo      *info)
-{
-    guint64 inode;
-
-    inode = g_file_info_get_attribute_uint64 (info, G_FILE_ATTRIBUTE_UNIX_INODE);
-    if (inode != 0)
+    if (g_file_info_has_attribute (info, G_FILE_ATTRIBUTE_UNIX_NLINK) &&
+        g_file_info_get_attribute_uint32 (info, G_FILE_ATTRIBUTE_UNIX_NLINK) <= 1)
     {
-        g_array_append_val (state->seen_deep_count_inodes, inode);
+        return FALSE;
     }
+
+    inode = g_file_info_get_attribute_uint64 (info, G_FILE_ATTRIBUTE_UNIX_INODE);
+    device = g_file_info_get_attribute_uint32 (info, G_FILE_ATTRIBUTE_UNIX_DEVICE);
+
+    return !nautilus_inode_set_add (state->seen_deep_count_inodes, device, inode);
 }
 
 static void
@@ -2815,10 +3076,6 @@ deep_count_one (DeepCountState *state,
     }
 
     is_seen_inode = seen_inode (state, info);
-    if (!is_seen_inode)
-    {
-        mark_inode_as_seen (state, info);
-    }
 
     file = state->directory->details->deep_count_file;
 
@@ -2868,7 +3125,11 @@ deep_count_state_free (DeepCountState *state)
         g_object_unref (state->deep_count_location);
     }
     g_list_free_full (state->deep_count_subdirectories, g_object_unref);
-    g_array_free (state->seen_deep_count_inodes, TRUE);
+    nautilus_inode_set_free (state->seen_deep_count_inodes);
+    if (state->native_count != NULL)
+    {
+        nautilus_deep_count_free (state->native_count);
+    }
     g_free (state->fs_id);
     g_free (state);
 }
@@ -2880,6 +3141,7 @@ deep_count_next_dir (DeepCountState *state)
     NautilusFile *file;
     NautilusDirectory *directory;
     gboolean done;
+    gint64 now;
 
     directory = state->directory;
 
@@ -2907,16 +3169,101 @@ deep_count_next_dir (DeepCountState *state)
         done = TRUE;
     }
 
-    nautilus_file_updated_deep_count_in_progress (file);
-
-    if (done)
+    /* Counting small directories is faster than clients can redraw. */
+    now = g_get_monotonic_time ();
+    if (done ||
+        now - state->last_update_time >= NAUTILUS_DEEP_COUNT_UPDATE_INTERVAL_MSEC * 1000)
+    {
+        if (!done)
+        {
+            state->last_update_time = now;
+        }
+        nautilus_file_updated_deep_count_in_progress (file);
+    }
+
+    if (done)
     {
         nautilus_file_changed (file);
-        async_job_end (directory, "deep count");
+        async_job_end (directory, "deep count", ASYNC_JOB_PRIORITY_LOW);
         nautilus_directory_async_state_changed (directory);
     }
 }
 
+static void
+deep_count_native_progress (NautilusDeepCount *native_count,
+                            gpointer           callback_data)
+{
+    DeepCountState *state;
+    NautilusFile *file;
+
+    state = callback_data;
+
+    if (state->directory == NULL ||
+        state->directory->details->deep_count_file == NULL)
+    {
+        /* Cancelled, waiting for the threads to notice. */
+        return;
+    }
+
+    file = state->directory->details->deep_count_file;
+    nautilus_deep_count_get_totals (native_count,
+                                    &file->details->deep_directory_count,
+                                    &file->details->deep_file_count,
+                                    &file->details->deep_unreadable_count,
+                                    &file->details->deep_size);
+
+    nautilus_file_updated_deep_count_in_progress (file);
+}
+
+static void
+deep_count_native_done (NautilusDeepCount *native_count,
+                        gpointer           callback_data)
+{
+    DeepCountState *state;
+    NautilusDirectory *directory;
+    NautilusFile *file;
+
+    state = callback_data;
+
+    if (state->directory == NULL)
+    {
+        /* Operation was cancelled. Bail out */
+        deep_count_state_free (state);
+        return;
+    }
+
+    directory = nautilus_directory_ref (state->directory);
+
+    g_assert (directory->details->deep_count_in_progress == state);
+
+    file = directory->details->deep_count_file;
+    directory->details->deep_count_file = NULL;
+    directory->details->deep_count_in_progress = NULL;
+
+    if (file != NULL)
+    {
+        nautilus_deep_count_get_totals (native_count,
+                                        &file->details->deep_directory_count,
+                                        &file->details->deep_file_count,
+                                        &file->details->deep_unreadable_count,
+                                        &file->details->deep_size);
+        file->details->deep_counts_status = NAUTILUS_REQUEST_DONE;
+    }
+
+    deep_count_state_free (state);
+
+    if (file != NULL)
+    {
+        nautilus_file_updated_deep_count_in_progress (file);
+        nautilus_file_changed (file);
+    }
+
+    async_job_end (directory, "deep count", ASYNC_JOB_PRIORITY_LOW);
+    nautilus_directory_async_state_changed (directory);
+
+    nautilus_directory_unref (directory);
+}
+
 static void
 deep_count_more_files_callback (GObject      *source_object,
                                 GAsyncResult *res,
@@ -3031,7 +3378,9 @@ deep_count_load (DeepCountState *state,
                                      G_FILE_ATTRIBUTE_STANDARD_IS_HIDDEN ","
                                      G_FILE_ATTRIBUTE_STANDARD_IS_BACKUP ","
                                      G_FILE_ATTRIBUTE_ID_FILESYSTEM ","
-                                     G_FILE_ATTRIBUTE_UNIX_INODE,
+                                     G_FILE_ATTRIBUTE_UNIX_INODE ","
+                                     G_FILE_ATTRIBUTE_UNIX_DEVICE ","
+                                     G_FILE_ATTRIBUTE_UNIX_NLINK,
                                      G_FILE_QUERY_INFO_NOFOLLOW_SYMLINKS,     /* flags */
                                      G_PRIORITY_LOW,     /* prio */
                                      state->cancellable,
@@ -3091,12 +3440,7 @@ deep_count_start (NautilusDirectory *directory,
 {
     GFile *location;
     DeepCountState *state;
-
-    if (directory->details->deep_count_in_progress != NULL)
-    {
-        *doing_io = TRUE;
-        return;
-    }
+    char *path;
 
     if (!is_needy (file,
                    lacks_deep_count,
@@ -3106,6 +3450,12 @@ deep_count_start (NautilusDirectory *directory,
     }
     *doing_io = TRUE;
 
+    /* Only one of these at a time, the file has to wait its turn. */
+    if (directory->details->deep_count_in_progress != NULL)
+    {
+        return;
+    }
+
     if (!nautilus_file_is_directory (file))
     {
         file->details->deep_counts_status = NAUTILUS_REQUEST_DONE;
@@ -3114,7 +3464,7 @@ deep_count_start (NautilusDirectory *directory,
         return;
     }
 
-    if (!async_job_start (directory, "deep count"))
+    if (!async_job_start (directory, "deep count", ASYNC_JOB_PRIORITY_LOW))
     {
         return;
     }
@@ -3130,12 +3480,31 @@ deep_count_start (NautilusDirectory *directory,
     state = g_new0 (DeepCountState, 1);
     state->directory = directory;
     state->cancellable = g_cancellable_new ();
-    state->seen_deep_count_inodes = g_array_new (FALSE, TRUE, sizeof (guint64));
+    state->seen_deep_count_inodes = nautilus_inode_set_new ();
     state->fs_id = NULL;
 
     directory->details->deep_count_in_progress = state;
 
     location = nautilus_file_get_location (file);
+
+    /* Local trees are counted by several threads at once, reading the
+     * directories natively. Everything else goes through GIO, one
+     * directory at a time, GVfs FUSE mounts included.
+     */
+    if (g_file_is_native (location))
+    {
+        path = g_file_get_path (location);
+        state->native_count = nautilus_deep_count_new (path,
+                                                       !get_show_hidden_files (),
+                                                       state->cancellable,
+                                                       deep_count_native_progress,
+                                                       deep_count_native_done,
+                                                       state);
+        g_free (path);
+        g_object_unref (location);
+        return;
+    }
+
     g_file_query_info_async (location,
                              G_FILE_ATTRIBUTE_ID_FILESYSTEM,
                              G_FILE_QUERY_INFO_NOFOLLOW_SYMLINKS,
@@ -3223,7 +3592,7 @@ mime_list_done (MimeListState *state,
     nautilus_file_changed (file);
 
     /* Start up the next one. */
-    async_job_end (directory, "MIME list");
+    async_job_end (directory, "MIME list", ASYNC_JOB_PRIORITY_LOW);
     nautilus_directory_async_state_changed (directory);
 }
 
@@ -3265,7 +3634,7 @@ mime_list_callback (GObject      *source_object,
         /* Operation was cancelled. Bail out */
         directory->details->mime_list_in_progress = NULL;
 
-        async_job_end (directory, "MIME list");
+        async_job_end (directory, "MIME list", ASYNC_JOB_PRIORITY_LOW);
         nautilus_directory_async_state_changed (directory);
 
         mime_list_state_free (state);
@@ -3328,7 +3697,7 @@ list_mime_enum_callback (GObject      *source_object,
         directory = state->directory;
         directory->details->mime_list_in_progress = NULL;
 
-        async_job_end (directory, "MIME list");
+        async_job_end (directory, "MIME list", ASYNC_JOB_PRIORITY_LOW);
         nautilus_directory_async_state_changed (directory);
 
         mime_list_state_free (state);
@@ -3369,12 +3738,6 @@ mime_list_start (NautilusDirectory *directory,
 
     mime_list_stop (directory);
 
-    if (directory->details->mime_list_in_progress != NULL)
-    {
-        *doing_io = TRUE;
-        return;
-    }
-
     /* Figure out which file to get a mime list for. */
     if (!is_needy (file,
                    should_get_mime_list,
@@ -3384,6 +3747,11 @@ mime_list_start (NautilusDirectory *directory,
     }
     *doing_io = TRUE;
 
+    if (directory->details->mime_list_in_progress != NULL)
+    {
+        return;
+    }
+
     if (!nautilus_file_is_directory (file))
     {
         g_list_free (file->details->mime_list);
@@ -3395,7 +3763,7 @@ mime_list_start (NautilusDirectory *directory,
         return;
     }
 
-    if (!async_job_start (directory, "MIME list"))
+    if (!async_job_start (directory, "MIME list", ASYNC_JOB_PRIORITY_LOW))
     {
         return;
     }
@@ -3458,11 +3826,12 @@ query_info_callback (GObject      *source_object,
 
     directory = nautilus_directory_ref (state->directory);
 
-    get_info_file = directory->details->get_info_file;
+    get_info_file = state->file;
     g_assert (NAUTILUS_IS_FILE (get_info_file));
 
-    directory->details->get_info_file = NULL;
-    directory->details->get_info_in_progress = NULL;
+    directory->details->get_info_in_progress =
+        g_list_remove (directory->details->get_info_in_progress, state);
+    async_job_record_latency (state->start_time);
 
     /* ref here because we might be removing the last ref when we
      * mark the file gone below, but we need to keep a ref at
@@ -3494,7 +3863,7 @@ query_info_callback (GObject      *source_object,
     nautilus_file_changed (get_info_file);
     nautilus_file_unref (get_info_file);
 
-    async_job_end (directory, "file info");
+    async_job_end (directory, "file info", ASYNC_JOB_PRIORITY_HIGH);
     nautilus_directory_async_state_changed (directory);
 
     nautilus_directory_unref (directory);
@@ -3506,25 +3875,49 @@ static void
 file_info_stop (NautilusDirectory *directory)
 {
     NautilusFile *file;
+    GetInfoState *state;
+    GList *node, *next;
 
-    if (directory->details->get_info_in_progress != NULL)
+    for (node = directory->details->get_info_in_progress; node != NULL; node = next)
     {
-        file = directory->details->get_info_file;
+        next = node->next;
+        state = node->data;
+
+        file = state->file;
         if (file != NULL)
         {
             g_assert (NAUTILUS_IS_FILE (file));
             g_assert (file->details->directory == directory);
             if (is_needy (file, lacks_info, REQUEST_FILE_INFO))
             {
-                return;
+                continue;
             }
         }
 
         /* The info is not wanted, so stop it. */
-        file_info_cancel (directory);
+        file_info_cancel_one (directory, state);
     }
 }
 
+static GetInfoState *
+find_file_info_state (NautilusDirectory *directory,
+                      NautilusFile      *file)
+{
+    GetInfoState *state;
+    GList *node;
+
+    for (node = directory->details->get_info_in_progress; node != NULL; node = node->next)
+    {
+        state = node->data;
+        if (state->file == file)
+        {
+            return state;
+        }
+    }
+
+    return NULL;
+}
+
 static void
 file_info_start (NautilusDirectory *directory,
                  NautilusFile      *file,
@@ -3533,26 +3926,38 @@ file_info_start (NautilusDirectory *directory,
     GFile *location;
     GetInfoState *state;
 
-    file_info_stop (directory);
-
-    if (directory->details->get_info_in_progress != NULL)
+    if (!is_needy (file, lacks_info, REQUEST_FILE_INFO))
     {
-        *doing_io = TRUE;
         return;
     }
 
-    if (!is_needy (file, lacks_info, REQUEST_FILE_INFO))
+    /* The directory load in progress asks for the same attributes as
+     * we would, so files it hasn't reached yet get their info from it,
+     * rather than with a round-trip each. Anything it doesn't bring in
+     * is queued again once it is done.
+     */
+    if (file->details->unconfirmed &&
+        (directory->details->directory_load_in_progress != NULL ||
+         directory->details->dequeue_pending_idle_id != 0))
     {
+        directory->details->file_info_left_to_load = TRUE;
         return;
     }
+
     *doing_io = TRUE;
 
-    if (!async_job_start (directory, "file info"))
+    /* Already in flight, or the pipeline is full. */
+    if (find_file_info_state (directory, file) != NULL ||
+        g_list_length (directory->details->get_info_in_progress) >= nautilus_directory_get_jobs_per_kind (directory))
+    {
+        return;
+    }
+
+    if (!async_job_start (directory, "file info", ASYNC_JOB_PRIORITY_HIGH))
     {
         return;
     }
 
-    directory->details->get_info_file = file;
     file->details->get_info_failed = FALSE;
     if (file->details->get_info_error)
     {
@@ -3562,9 +3967,12 @@ file_info_start (NautilusDirectory *directory,
 
     state = g_new (GetInfoState, 1);
     state->directory = directory;
+    state->file = file;
     state->cancellable = g_cancellable_new ();
+    state->start_time = g_get_monotonic_time ();
 
-    directory->details->get_info_in_progress = state;
+    directory->details->get_info_in_progress =
+        g_list_prepend (directory->details->get_info_in_progress, state);
 
     location = nautilus_file_get_location (file);
     g_file_query_info_async (location,
@@ -3763,7 +4171,7 @@ link_info_nautilus_link_read_callback (GObject      *source_object,
                                           NULL, NULL);
 
     state->directory->details->link_info_read_state = NULL;
-    async_job_end (state->directory, "link info");
+    async_job_end (state->directory, "link info", ASYNC_JOB_PRIORITY_HIGH);
 
     link_info_got_data (state->directory, state->file, result, file_size, file_contents);
 
@@ -3786,12 +4194,6 @@ link_info_start (NautilusDirectory *directory,
     gboolean nautilus_style_link;
     LinkInfoReadState *state;
 
-    if (directory->details->link_info_read_state != NULL)
-    {
-        *doing_io = TRUE;
-        return;
-    }
-
     if (!is_needy (file,
                    lacks_link_info,
                    REQUEST_LINK_INFO))
@@ -3800,6 +4202,11 @@ link_info_start (NautilusDirectory *directory,
     }
     *doing_io = TRUE;
 
+    if (directory->details->link_info_read_state != NULL)
+    {
+        return;
+    }
+
     /* Figure out if it is a link. */
     nautilus_style_link = nautilus_file_is_nautilus_link (file);
     location = nautilus_file_get_location (file);
@@ -3811,7 +4218,7 @@ link_info_start (NautilusDirectory *directory,
     }
     else
     {
-        if (!async_job_start (directory, "link info"))
+        if (!async_job_start (directory, "link info", ASYNC_JOB_PRIORITY_HIGH))
         {
             g_object_unref (location);
             return;
@@ -3889,11 +4296,15 @@ static void
 thumbnail_stop (NautilusDirectory *directory)
 {
     NautilusFile *file;
+    ThumbnailState *state;
+    GList *node, *next;
 
-    if (directory->details->thumbnail_state != NULL)
+    for (node = directory->details->thumbnail_states; node != NULL; node = next)
     {
-        file = directory->details->thumbnail_state->file;
+        next = node->next;
+        state = node->data;
 
+        file = state->file;
         if (file != NULL)
         {
             g_assert (NAUTILUS_IS_FILE (file));
@@ -3902,15 +4313,46 @@ thumbnail_stop (NautilusDirectory *directory)
                           lacks_thumbnail,
                           REQUEST_THUMBNAIL))
             {
-                return;
+                continue;
             }
         }
 
-        /* The link info is not wanted, so stop it. */
-        thumbnail_cancel (directory);
+        /* The thumbnail is not wanted, or the file scrolled out of
+         * view, so stop it.
+         */
+        thumbnail_cancel_one (directory, state);
     }
 }
 
+static ThumbnailState *
+find_thumbnail_state (NautilusDirectory *directory,
+                      NautilusFile      *file)
+{
+    ThumbnailState *state;
+    GList *node;
+
+    for (node = directory->details->thumbnail_states; node != NULL; node = node->next)
+    {
+        state = node->data;
+        if (state->file == file)
+        {
+            return state;
+        }
+    }
+
+    return NULL;
+}
+
+/* Decoding is CPU bound, so keep every thread of thumbnail_load_pool
+ * busy even for local directories.
+ */
+static guint
+thumbnail_get_max_in_flight (NautilusDirectory *directory)
+{
+    return MAX (nautilus_directory_get_jobs_per_kind (directory),
+                g_get_num_processors ());
+}
+
 static void
 thumbnail_got_pixbuf (NautilusDirectory *directory,
                       NautilusFile      *file,
@@ -3935,6 +4377,8 @@ thumbnail_got_pixbuf (NautilusDirectory *directory,
 static void
 thumbnail_state_free (ThumbnailState *state)
 {
+    g_clear_object (&state->original);
+    g_clear_object (&state->thumbnail);
     g_object_unref (state->cancellable);
     g_free (state);
 }
@@ -3953,8 +4397,7 @@ thumbnail_loader_size_prepared (GdkPixbufLoader *loader,
 
     aspect_ratio = ((double) width) / height;
 
-    /* cf. nautilus_file_get_icon() */
-    max_thumbnail_size = NAUTILUS_CANVAS_ICON_SIZE_LARGEST * cached_thumbnail_size / NAUTILUS_CANVAS_ICON_SIZE_SMALL;
+    max_thumbnail_size = GPOINTER_TO_INT (user_data);
     if (MAX (width, height) > max_thumbnail_size)
     {
         if (width > height)
@@ -3972,9 +4415,47 @@ thumbnail_loader_size_prepared (GdkPixbufLoader *loader,
     }
 }
 
+/* Not all loaders honor gdk_pixbuf_loader_set_size(), so make sure
+ * nothing bigger than needed is handed back to the main thread.
+ */
+static GdkPixbuf *
+scale_pixbuf_down (GdkPixbuf *pixbuf,
+                   int        max_size)
+{
+    GdkPixbuf *scaled;
+    const char *thumb_mtime_str;
+    int width, height;
+    double scale;
+
+    width = gdk_pixbuf_get_width (pixbuf);
+    height = gdk_pixbuf_get_height (pixbuf);
+    if (MAX (width, height) <= max_size)
+    {
+        return pixbuf;
+    }
+
+    scale = (double) max_size / MAX (width, height);
+    scaled = gdk_pixbuf_scale_simple (pixbuf,
+                                      MAX (width * scale, 1),
+                                      MAX (height * scale, 1),
+                                      GDK_INTERP_BILINEAR);
+
+    /* thumbnail_done() checks this against the file. */
+    thumb_mtime_str = gdk_pixbuf_get_option (pixbuf, "tEXt::Thumb::MTime");
+    if (scaled != NULL && thumb_mtime_str != NULL)
+    {
+        gdk_pixbuf_set_option (scaled, "tEXt::Thumb::MTime", thumb_mtime_str);
+    }
+
+    g_object_unref (pixbuf);
+
+    return scaled;
+}
+
 static GdkPixbuf *
 get_pixbuf_for_content (goffset  file_len,
-                        char    *file_contents)
+                        char    *file_contents,
+                        int      max_size)
 {
     gboolean res;
     GdkPixbuf *pixbuf, *pixbuf2;
@@ -3985,7 +4466,7 @@ get_pixbuf_for_content (goffset  file_len,
     loader = gdk_pixbuf_loader_new ();
     g_signal_connect (loader, "size-prepared",
                       G_CALLBACK (thumbnail_loader_size_prepared),
-                      NULL);
+                      GINT_TO_POINTER (max_size));
 
     /* For some reason we have to write in chunks, or gdk-pixbuf fails */
     res = TRUE;
@@ -4010,69 +4491,111 @@ get_pixbuf_for_content (goffset  file_len,
     {
         pixbuf2 = gdk_pixbuf_apply_embedded_orientation (pixbuf);
         g_object_unref (pixbuf);
-        pixbuf = pixbuf2;
+        pixbuf = scale_pixbuf_down (pixbuf2, max_size);
+    }
+    return pixbuf;
+}
+
+static GdkPixbuf *
+thumbnail_load_pixbuf (GFile        *location,
+                       int           max_size,
+                       GCancellable *cancellable)
+{
+    char *file_contents;
+    gsize file_size;
+    GdkPixbuf *pixbuf;
+
+    if (!g_file_load_contents (location, cancellable,
+                               &file_contents, &file_size,
+                               NULL, NULL))
+    {
+        return NULL;
     }
+
+    pixbuf = get_pixbuf_for_content (file_size, file_contents, max_size);
+    g_free (file_contents);
+
     return pixbuf;
 }
 
+static GThreadPool *thumbnail_load_pool = NULL;
+
+/* Runs in a thread of thumbnail_load_pool, so it must not touch the
+ * directory or the file, only the locations and the size copied into
+ * the state. Takes the reference to @data.
+ */
+static void
+thumbnail_load_thread_func (gpointer data,
+                            gpointer user_data)
+{
+    ThumbnailState *state;
+    GCancellable *cancellable;
+    GdkPixbuf *pixbuf;
+    GTask *task;
+
+    task = data;
+    state = g_task_get_task_data (task);
+    cancellable = g_task_get_cancellable (task);
+    pixbuf = NULL;
+
+    /* Scrolled away or stopped while waiting for a thread. */
+    if (g_task_return_error_if_cancelled (task))
+    {
+        g_object_unref (task);
+        return;
+    }
+
+    if (state->original != NULL)
+    {
+        pixbuf = thumbnail_load_pixbuf (state->original, state->max_size, cancellable);
+    }
+    if (pixbuf == NULL && !g_cancellable_is_cancelled (cancellable))
+    {
+        pixbuf = thumbnail_load_pixbuf (state->thumbnail, state->max_size, cancellable);
+    }
+
+    g_task_return_pointer (task, pixbuf, g_object_unref);
+    g_object_unref (task);
+}
 
 static void
-thumbnail_read_callback (GObject      *source_object,
+thumbnail_load_callback (GObject      *source_object,
                          GAsyncResult *res,
                          gpointer      user_data)
 {
     ThumbnailState *state;
-    gsize file_size;
-    char *file_contents;
-    gboolean result;
     NautilusDirectory *directory;
     GdkPixbuf *pixbuf;
-    GFile *location;
 
     state = user_data;
 
+    pixbuf = g_task_propagate_pointer (G_TASK (res), NULL);
+
     if (state->directory == NULL)
     {
         /* Operation was cancelled. Bail out */
+        g_clear_object (&pixbuf);
         thumbnail_state_free (state);
         return;
     }
 
     directory = nautilus_directory_ref (state->directory);
 
-    result = g_file_load_contents_finish (G_FILE (source_object),
-                                          res,
-                                          &file_contents, &file_size,
-                                          NULL, NULL);
+    directory->details->thumbnail_states =
+        g_list_remove (directory->details->thumbnail_states, state);
+    async_job_end (directory, "thumbnail", ASYNC_JOB_PRIORITY_LOW);
 
-    pixbuf = NULL;
-    if (result)
+    if (state->file != NULL)
     {
-        pixbuf = get_pixbuf_for_content (file_size, file_contents);
-        g_free (file_contents);
-    }
-
-    if (pixbuf == NULL && state->trying_original)
-    {
-        state->trying_original = FALSE;
-
-        location = g_file_new_for_path (state->file->details->thumbnail_path);
-        g_file_load_contents_async (location,
-                                    state->cancellable,
-                                    thumbnail_read_callback,
-                                    state);
-        g_object_unref (location);
+        thumbnail_got_pixbuf (directory, state->file, pixbuf, state->tried_original);
     }
     else
     {
-        state->directory->details->thumbnail_state = NULL;
-        async_job_end (state->directory, "thumbnail");
-
-        thumbnail_got_pixbuf (state->directory, state->file, pixbuf, state->tried_original);
-
-        thumbnail_state_free (state);
+        g_clear_object (&pixbuf);
     }
 
+    thumbnail_state_free (state);
+
     nautilus_directory_unref (directory);
 }
 
@@ -4081,14 +4604,8 @@ thumbnail_start (NautilusDirectory *directory,
                  NautilusFile      *file,
                  gboolean          *doing_io)
 {
-    GFile *location;
     ThumbnailState *state;
-
-    if (directory->details->thumbnail_state != NULL)
-    {
-        *doing_io = TRUE;
-        return;
-    }
+    GTask *task;
 
     if (!is_needy (file,
                    lacks_thumbnail,
@@ -4098,7 +4615,14 @@ thumbnail_start (NautilusDirectory *directory,
     }
     *doing_io = TRUE;
 
-    if (!async_job_start (directory, "thumbnail"))
+    /* Already loading this one, or enough are in flight. */
+    if (find_thumbnail_state (directory, file) != NULL ||
+        g_list_length (directory->details->thumbnail_states) >= thumbnail_get_max_in_flight (directory))
+    {
+        return;
+    }
+
+    if (!async_job_start (directory, "thumbnail", ASYNC_JOB_PRIORITY_LOW))
     {
         return;
     }
@@ -4107,25 +4631,30 @@ thumbnail_start (NautilusDirectory *directory,
     state->directory = directory;
     state->file = file;
     state->cancellable = g_cancellable_new ();
+    state->thumbnail = g_file_new_for_path (file->details->thumbnail_path);
+
+    /* cf. nautilus_file_get_icon() */
+    state->max_size = NAUTILUS_CANVAS_ICON_SIZE_LARGEST * cached_thumbnail_size / NAUTILUS_CANVAS_ICON_SIZE_SMALL;
 
     if (file->details->thumbnail_wants_original)
     {
         state->tried_original = TRUE;
-        state->trying_original = TRUE;
-        location = nautilus_file_get_location (file);
+        state->original = nautilus_file_get_location (file);
     }
-    else
+
+    directory->details->thumbnail_states =
+        g_list_prepend (directory->details->thumbnail_states, state);
+
+    if (thumbnail_load_pool == NULL)
     {
-        location = g_file_new_for_path (file->details->thumbnail_path);
+        thumbnail_load_pool = g_thread_pool_new (thumbnail_load_thread_func, NULL,
+                                                 CLAMP (g_get_num_processors (), 2, MAX_THUMBNAIL_LOAD_THREADS),
+                                                 FALSE, NULL);
     }
 
-    directory->details->thumbnail_state = state;
-
-    g_file_load_contents_async (location,
-                                state->cancellable,
-                                thumbnail_read_callback,
-                                state);
-    g_object_unref (location);
+    task = g_task_new (NULL, state->cancellable, thumbnail_load_callback, state);
+    g_task_set_task_data (task, state, NULL);
+    g_thread_pool_push (thumbnail_load_pool, task, NULL);
 }
 
 static void
@@ -4171,7 +4700,7 @@ got_mount (MountState *state,
     directory = nautilus_directory_ref (state->directory);
 
     state->directory->details->mount_state = NULL;
-    async_job_end (state->directory, "mount");
+    async_job_end (state->directory, "mount", ASYNC_JOB_PRIORITY_LOW);
 
     file = nautilus_file_ref (state->file);
 
@@ -4276,12 +4805,6 @@ mount_start (NautilusDirectory *directory,
     GFile *location;
     MountState *state;
 
-    if (directory->details->mount_state != NULL)
-    {
-        *doing_io = TRUE;
-        return;
-    }
-
     if (!is_needy (file,
                    lacks_mount,
                    REQUEST_MOUNT))
@@ -4290,7 +4813,12 @@ mount_start (NautilusDirectory *directory,
     }
     *doing_io = TRUE;
 
-    if (!async_job_start (directory, "mount"))
+    if (directory->details->mount_state != NULL)
+    {
+        return;
+    }
+
+    if (!async_job_start (directory, "mount", ASYNC_JOB_PRIORITY_LOW))
     {
         return;
     }
@@ -4343,7 +4871,7 @@ filesystem_info_cancel (NautilusDirectory *directory)
         g_cancellable_cancel (directory->details->filesystem_info_state->cancellable);
         directory->details->filesystem_info_state->directory = NULL;
         directory->details->filesystem_info_state = NULL;
-        async_job_end (directory, "filesystem info");
+        async_job_end (directory, "filesystem info", ASYNC_JOB_PRIORITY_LOW);
     }
 }
 
@@ -4377,38 +4905,59 @@ static void
 filesystem_info_state_free (FilesystemInfoState *state)
 {
     g_object_unref (state->cancellable);
+    g_free (state->filesystem_id);
     g_free (state);
 }
 
+static void
+set_filesystem_info (NautilusFile *file,
+                     GFileInfo    *info)
+{
+    const char *filesystem_type;
+
+    file->details->filesystem_use_preview =
+        g_file_info_get_attribute_uint32 (info, G_FILE_ATTRIBUTE_FILESYSTEM_USE_PREVIEW);
+    file->details->filesystem_readonly =
+        g_file_info_get_attribute_boolean (info, G_FILE_ATTRIBUTE_FILESYSTEM_READONLY);
+    filesystem_type = g_file_info_get_attribute_string (info, G_FILE_ATTRIBUTE_FILESYSTEM_TYPE);
+    if (g_strcmp0 (eel_ref_str_peek (file->details->filesystem_type), filesystem_type) != 0)
+    {
+        eel_ref_str_unref (file->details->filesystem_type);
+        file->details->filesystem_type = eel_ref_str_get_unique (filesystem_type);
+    }
+}
+
 static void
 got_filesystem_info (FilesystemInfoState *state,
                      GFileInfo           *info)
 {
     NautilusDirectory *directory;
     NautilusFile *file;
-    const char *filesystem_type;
 
     /* careful here, info may be NULL */
 
     directory = nautilus_directory_ref (state->directory);
 
     state->directory->details->filesystem_info_state = NULL;
-    async_job_end (state->directory, "filesystem info");
+    async_job_end (state->directory, "filesystem info", ASYNC_JOB_PRIORITY_LOW);
 
     file = nautilus_file_ref (state->file);
 
     file->details->filesystem_info_is_up_to_date = TRUE;
     if (info != NULL)
     {
-        file->details->filesystem_use_preview =
-            g_file_info_get_attribute_uint32 (info, G_FILE_ATTRIBUTE_FILESYSTEM_USE_PREVIEW);
-        file->details->filesystem_readonly =
-            g_file_info_get_attribute_boolean (info, G_FILE_ATTRIBUTE_FILESYSTEM_READONLY);
-        filesystem_type = g_file_info_get_attribute_string (info, G_FILE_ATTRIBUTE_FILESYSTEM_TYPE);
-        if (g_strcmp0 (eel_ref_str_peek (file->details->filesystem_type), filesystem_type) != 0)
+        set_filesystem_info (file, info);
+
+        if (state->filesystem_id != NULL)
         {
-            eel_ref_str_unref (file->details->filesystem_type);
-            file->details->filesystem_type = eel_ref_str_get_unique (filesystem_type);
+            if (directory->details->filesystem_infos == NULL)
+            {
+                directory->details->filesystem_infos =
+                    g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_object_unref);
+            }
+            g_hash_table_replace (directory->details->filesystem_infos,
+                                  g_strdup (state->filesystem_id),
+                                  g_object_ref (info));
         }
     }
 
@@ -4455,12 +5004,8 @@ filesystem_info_start (NautilusDirectory *directory,
 {
     GFile *location;
     FilesystemInfoState *state;
-
-    if (directory->details->filesystem_info_state != NULL)
-    {
-        *doing_io = TRUE;
-        return;
-    }
+    const char *filesystem_id;
+    GFileInfo *info;
 
     if (!is_needy (file,
                    lacks_filesystem_info,
@@ -4468,9 +5013,30 @@ filesystem_info_start (NautilusDirectory *directory,
     {
         return;
     }
+
+    /* Most files are on the same filesystem as their neighbours, so
+     * don't ask again for each of them.
+     */
+    filesystem_id = eel_ref_str_peek (file->details->filesystem_id);
+    if (filesystem_id != NULL && directory->details->filesystem_infos != NULL)
+    {
+        info = g_hash_table_lookup (directory->details->filesystem_infos, filesystem_id);
+        if (info != NULL)
+        {
+            file->details->filesystem_info_is_up_to_date = TRUE;
+            set_filesystem_info (file, info);
+            return;
+        }
+    }
+
     *doing_io = TRUE;
 
-    if (!async_job_start (directory, "filesystem info"))
+    if (directory->details->filesystem_info_state != NULL)
+    {
+        return;
+    }
+
+    if (!async_job_start (directory, "filesystem info", ASYNC_JOB_PRIORITY_LOW))
     {
         return;
     }
@@ -4479,6 +5045,7 @@ filesystem_info_start (NautilusDirectory *directory,
     state->directory = directory;
     state->file = file;
     state->cancellable = g_cancellable_new ();
+    state->filesystem_id = g_strdup (filesystem_id);
 
     location = nautilus_file_get_location (file);
 
@@ -4516,7 +5083,7 @@ extension_info_cancel (NautilusDirectory *directory)
         directory->details->extension_info_provider = NULL;
         directory->details->extension_info_idle = 0;
 
-        async_job_end (directory, "extension info");
+        async_job_end (directory, "extension info", ASYNC_JOB_PRIORITY_LOW);
     }
 }
 
@@ -4579,7 +5146,7 @@ info_provider_idle_callback (gpointer user_data)
     else
     {
         NautilusFile *file;
-        async_job_end (directory, "extension info");
+        async_job_end (directory, "extension info", ASYNC_JOB_PRIORITY_LOW);
 
         file = directory->details->extension_info_file;
 
@@ -4636,7 +5203,7 @@ extension_info_start (NautilusDirectory *directory,
     }
     *doing_io = TRUE;
 
-    if (!async_job_start (directory, "extension info"))
+    if (!async_job_start (directory, "extension info", ASYNC_JOB_PRIORITY_LOW))
     {
         return;
     }
@@ -4661,7 +5228,7 @@ extension_info_start (NautilusDirectory *directory,
         result == NAUTILUS_OPERATION_FAILED)
     {
         finish_info_provider (directory, file, provider);
-        async_job_end (directory, "extension info");
+        async_job_end (directory, "extension info", ASYNC_JOB_PRIORITY_LOW);
     }
     else
     {
@@ -4674,8 +5241,9 @@ extension_info_start (NautilusDirectory *directory,
 static void
 start_or_stop_io (NautilusDirectory *directory)
 {
-    NautilusFile *file;
-    gboolean doing_io;
+    NautilusFile *file, *next;
+    gboolean doing_io, busy;
+    guint busy_files, max_busy_files;
 
     /* Start or stop reading files. */
     file_list_start_or_stop (directory);
@@ -4691,43 +5259,79 @@ start_or_stop_io (NautilusDirectory *directory)
     thumbnail_stop (directory);
     filesystem_info_stop (directory);
 
+    /* Files that are still waiting for I/O stay on the queue, but we
+     * look past them so that several requests can be in flight. Don't
+     * look further than the pipeline is deep, so each pass stays cheap
+     * no matter how long the queue is.
+     */
+    max_busy_files = nautilus_directory_get_jobs_per_kind (directory);
+
     doing_io = FALSE;
+    busy_files = 0;
     /* Take files that are all done off the queue. */
-    while (!nautilus_file_queue_is_empty (directory->details->high_priority_queue))
+    file = nautilus_file_queue_head (directory->details->high_priority_queue);
+    while (file != NULL)
     {
-        file = nautilus_file_queue_head (directory->details->high_priority_queue);
-
         /* Start getting attributes if possible */
-        file_info_start (directory, file, &doing_io);
-        link_info_start (directory, file, &doing_io);
+        busy = FALSE;
+        file_info_start (directory, file, &busy);
+        link_info_start (directory, file, &busy);
 
-        if (doing_io)
+        next = nautilus_file_queue_next (directory->details->high_priority_queue, file);
+        if (busy)
         {
-            return;
+            doing_io = TRUE;
+            if (++busy_files >= max_busy_files)
+            {
+                return;
+            }
+        }
+        else
+        {
+            move_file_to_low_priority_queue (directory, file);
         }
 
-        move_file_to_low_priority_queue (directory, file);
+        file = next;
     }
 
-    /* High priority queue must be empty */
-    while (!nautilus_file_queue_is_empty (directory->details->low_priority_queue))
+    if (doing_io)
     {
-        file = nautilus_file_queue_head (directory->details->low_priority_queue);
+        return;
+    }
 
+    /* High priority queue must be empty */
+    file = nautilus_file_queue_head (directory->details->low_priority_queue);
+    while (file != NULL)
+    {
         /* Start getting attributes if possible */
-        mount_start (directory, file, &doing_io);
-        directory_count_start (directory, file, &doing_io);
-        deep_count_start (directory, file, &doing_io);
-        mime_list_start (directory, file, &doing_io);
-        thumbnail_start (directory, file, &doing_io);
-        filesystem_info_start (directory, file, &doing_io);
-
-        if (doing_io)
+        busy = FALSE;
+        mount_start (directory, file, &busy);
+        directory_count_start (directory, file, &busy);
+        deep_count_start (directory, file, &busy);
+        mime_list_start (directory, file, &busy);
+        thumbnail_start (directory, file, &busy);
+        filesystem_info_start (directory, file, &busy);
+
+        next = nautilus_file_queue_next (directory->details->low_priority_queue, file);
+        if (busy)
         {
-            return;
+            doing_io = TRUE;
+            if (++busy_files >= max_busy_files)
+            {
+                return;
+            }
+        }
+        else
+        {
+            move_file_to_extension_queue (directory, file);
         }
 
-        move_file_to_extension_queue (directory, file);
+        file = next;
+    }
+
+    if (doing_io)
+    {
+        return;
     }
 
     /* Low priority queue must be empty */
@@ -4814,10 +5418,12 @@ static void
 cancel_directory_count_for_file (NautilusDirectory *directory,
                                  NautilusFile      *file)
 {
-    if (directory->details->count_in_progress != NULL &&
-        directory->details->count_in_progress->count_file == file)
+    DirectoryCountState *state;
+
+    state = find_directory_count_state (directory, file);
+    if (state != NULL)
     {
-        directory_count_cancel (directory);
+        directory_count_cancel_one (directory, state);
     }
 }
 
@@ -4846,9 +5452,12 @@ static void
 cancel_file_info_for_file (NautilusDirectory *directory,
                            NautilusFile      *file)
 {
-    if (directory->details->get_info_file == file)
+    GetInfoState *state;
+
+    state = find_file_info_state (directory, file);
+    if (state != NULL)
     {
-        file_info_cancel (directory);
+        file_info_cancel_one (directory, state);
     }
 }
 
@@ -4856,10 +5465,12 @@ static void
 cancel_thumbnail_for_file (NautilusDirectory *directory,
                            NautilusFile      *file)
 {
-    if (directory->details->thumbnail_state != NULL &&
-        directory->details->thumbnail_state->file == file)
+    ThumbnailState *state;
+
+    state = find_thumbnail_state (directory, file);
+    if (state != NULL)
     {
-        thumbnail_cancel (directory);
+        thumbnail_cancel_one (directory, state);
     }
 }
 
@@ -5009,14 +5620,12 @@ nautilus_directory_add_file_to_work_queue (NautilusDirectory *directory,
 static void
 add_all_files_to_work_queue (NautilusDirectory *directory)
 {
-    GList *node;
-    NautilusFile *file;
+    guint i;
 
-    for (node = directory->details->file_list; node != NULL; node = node->next)
+    for (i = 0; i < directory->details->files->len; i++)
     {
-        file = NAUTILUS_FILE (node->data);
-
-        nautilus_directory_add_file_to_work_queue (directory, file);
+        nautilus_directory_add_file_to_work_queue (directory,
+                                                   g_ptr_array_index (directory->details->files, i));
     }
 }
 
@@ -55,6 +55,19 @@ typedef enum {
 	REQUEST_TYPE_LAST
 } RequestType;
 
+/* Keep async. jobs between these numbers for all directories. The
+ * actual budget floats in between, depending on how long the jobs we
+ * issue take to complete, see async_job_record_latency().
+ */
+#define MIN_ASYNC_JOBS 10
+#define MAX_ASYNC_JOBS 64
+
+/* Low priority jobs (counts, thumbnails, ...) only get this share of
+ * the budget in percent, so file info for newly shown files never has
+ * to wait for them.
+ */
+#define ASYNC_JOB_LOW_PRIORITY_SHARE 75
+
 /* A request for information about one or more files. */
 typedef guint32 Request;
 typedef gint32 RequestCounter[REQUEST_TYPE_LAST];
@@ -69,8 +82,8 @@ struct NautilusDirectoryDetails
 
 	/* The file objects. */
 	NautilusFile *as_file;
-	GList *file_list;
-	GHashTable *file_hash;
+	GPtrArray *files;      /* in no particular order, removal moves the last file into the hole */
+	GHashTable *file_hash; /* name -> NautilusFile */
 
 	/* Queues of files needing some I/O done. */
 	NautilusFileQueue *high_priority_queue;
@@ -96,33 +109,46 @@ struct NautilusDirectoryDetails
 	gboolean directory_loaded;
 	gboolean directory_loaded_sent_notification;
 	DirectoryLoadState *directory_load_in_progress;
+	/* Some files are waiting for the load in progress to bring in
+	 * their info, instead of getting it one by one.
+	 */
+	gboolean file_info_left_to_load;
 
-	GList *pending_file_info; /* list of GnomeVFSFileInfo's that are pending */
+	GPtrArray *pending_file_info; /* GFileInfos waiting to become files, in order */
 	int confirmed_file_count;
+	GHashTable *unconfirmed_files; /* set of NautilusFile * */
         guint dequeue_pending_idle_id;
 
 	GList *new_files_in_progress; /* list of NewFilesState * */
 
-	DirectoryCountState *count_in_progress;
+	/* Upper bound for requests of one kind in flight for this
+	 * directory, see nautilus_directory_get_jobs_per_kind().
+	 */
+	guint jobs_per_kind;
+
+	GList *count_in_progress; /* list of DirectoryCountState * */
 
 	NautilusFile *deep_count_file;
 	DeepCountState *deep_count_in_progress;
 
 	MimeListState *mime_list_in_progress;
 
-	NautilusFile *get_info_file;
-	GetInfoState *get_info_in_progress;
+	GList *get_info_in_progress; /* list of GetInfoState * */
 
 	NautilusFile *extension_info_file;
 	NautilusInfoProvider *extension_info_provider;
 	NautilusOperationHandle *extension_info_in_progress;
 	guint extension_info_idle;
 
-	ThumbnailState *thumbnail_state;
+	GList *thumbnail_states; /* list of ThumbnailState * */
 
 	MountState *mount_state;
 
 	FilesystemInfoState *filesystem_info_state;
+	/* Filesystem info by filesystem id, files on the same filesystem
+	 * share it. Dropped when the directory is loaded again.
+	 */
+	GHashTable *filesystem_infos;
 	
 	LinkInfoReadState *link_info_read_state;
 
@@ -203,6 +229,8 @@ void               nautilus_directory_add_file                        (NautilusD
 								       NautilusFile              *file);
 void               nautilus_directory_remove_file                     (NautilusDirectory         *directory,
 								       NautilusFile              *file);
+/* Unlike get_file_list, includes files still waiting for their info. */
+GList *            nautilus_directory_get_all_files                   (NautilusDirectory         *directory);
 FileMonitors *     nautilus_directory_remove_file_monitors            (NautilusDirectory         *directory,
 								       NautilusFile              *file);
 void               nautilus_directory_add_file_monitors               (NautilusDirectory         *directory,
@@ -210,11 +238,11 @@ void               nautilus_directory_add_file_monitors               (NautilusD
 								       FileMonitors              *monitors);
 void               nautilus_directory_add_file                        (NautilusDirectory         *directory,
 								       NautilusFile              *file);
-GList *            nautilus_directory_begin_file_name_change          (NautilusDirectory         *directory,
+gboolean           nautilus_directory_begin_file_name_change          (NautilusDirectory         *directory,
 								       NautilusFile              *file);
 void               nautilus_directory_end_file_name_change            (NautilusDirectory         *directory,
 								       NautilusFile              *file,
-								       GList                     *node);
+								       gboolean                   in_hash_table);
 void               nautilus_directory_moved                           (const char                *from_uri,
 								       const char                *to_uri);
 /* Interface to the work queue. */
@@ -227,3 +255,8 @@ void               nautilus_directory_remove_file_from_work_queue     (NautilusD
 
 /* debugging functions */
 int                nautilus_directory_number_outstanding              (void);
+int                nautilus_directory_get_async_job_count             (void);
+int                nautilus_directory_get_async_job_budget            (void);
+int                nautilus_directory_get_async_low_priority_job_count (void);
+guint              nautilus_directory_get_jobs_per_kind               (NautilusDirectory         *directory);
+guint              nautilus_directory_get_jobs_in_flight              (NautilusDirectory         *directory);
@@ -0,0 +1,414 @@
+/*
+ *  nautilus-directory-size-cache.c: Deep counts of local directories,
+ *  kept across sessions.
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License as
+ *  published by the Free Software Foundation; either version 2 of the
+ *  License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public
+ *  License along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+#include "nautilus-directory-size-cache.h"
+
+#include <glib/gstdio.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#define CACHE_FILE_MAGIC 0x4353444e /* "NDSC" */
+#define CACHE_FILE_VERSION 2
+
+/* Start over when there are more entries than this, which is about 20 MB. */
+#define MAX_CACHE_ENTRIES 200000
+
+/* Files rewritten in place don't change the mtime of their directory,
+ * so don't trust an entry for longer than this.
+ */
+#define MAX_ENTRY_AGE_SECS (10 * 60)
+
+/* Write the cache out this long after the last change. */
+#define SAVE_DELAY_SECS 5
+
+/* Stored as is, the file is only read back on the same machine, each
+ * entry followed by the names of its subdirectories.
+ */
+typedef struct
+{
+    guint64 device;
+    guint64 inode;
+    gint64 mtime;
+    gint64 store_time;
+    guint32 skip_hidden_files;
+    guint32 directory_count;
+    guint32 file_count;
+    guint32 unreadable_directory_count;
+    gint64 total_size;
+    guint32 subdirectories_size;
+    guint32 padding;
+} CacheEntry;
+
+typedef struct
+{
+    CacheEntry entry;
+    char *subdirectories;    /* nul separated */
+} CachedDirectory;
+
+typedef struct
+{
+    guint32 magic;
+    guint32 version;
+    guint32 entry_size;
+    guint32 n_entries;
+} CacheFileHeader;
+
+/* Lock cache_mutex when accessing these. */
+static GMutex cache_mutex;
+static GHashTable *cache = NULL;     /* CachedDirectory * -> itself */
+static guint save_timeout_id = 0;
+static GThreadPool *invalidate_pool = NULL;
+
+static guint
+cached_directory_hash (gconstpointer key)
+{
+    const CacheEntry *entry = &((const CachedDirectory *) key)->entry;
+
+    return (guint) (entry->inode ^ (entry->inode >> 32) ^ (entry->device * 31));
+}
+
+static gboolean
+cached_directory_equal (gconstpointer a,
+                        gconstpointer b)
+{
+    const CacheEntry *entry_a = &((const CachedDirectory *) a)->entry;
+    const CacheEntry *entry_b = &((const CachedDirectory *) b)->entry;
+
+    return entry_a->device == entry_b->device &&
+           entry_a->inode == entry_b->inode;
+}
+
+static void
+cached_directory_free (CachedDirectory *directory)
+{
+    g_free (directory->subdirectories);
+    g_free (directory);
+}
+
+static char *
+get_cache_file_path (void)
+{
+    return g_build_filename (g_get_user_cache_dir (), "nautilus", "directory-sizes", NULL);
+}
+
+static void
+load_cache (void)
+{
+    CacheFileHeader header;
+    CachedDirectory *directory;
+    char *path, *contents;
+    gsize length, offset;
+    guint32 i;
+
+    cache = g_hash_table_new_full (cached_directory_hash, cached_directory_equal,
+                                   (GDestroyNotify) cached_directory_free, NULL);
+
+    path = get_cache_file_path ();
+    if (!g_file_get_contents (path, &contents, &length, NULL))
+    {
+        g_free (path);
+        return;
+    }
+    g_free (path);
+
+    if (length < sizeof (header))
+    {
+        g_free (contents);
+        return;
+    }
+
+    memcpy (&header, contents, sizeof (header));
+    if (header.magic != CACHE_FILE_MAGIC ||
+        header.version != CACHE_FILE_VERSION ||
+        header.entry_size != sizeof (CacheEntry))
+    {
+        g_free (contents);
+        return;
+    }
+
+    offset = sizeof (header);
+    for (i = 0; i < header.n_entries && length - offset >= sizeof (CacheEntry); i++)
+    {
+        directory = g_new (CachedDirectory, 1);
+        memcpy (&directory->entry, contents + offset, sizeof (CacheEntry));
+        offset += sizeof (CacheEntry);
+
+        /* A broken file must not make lookups read out of bounds. */
+        if (directory->entry.subdirectories_size > length - offset ||
+            (directory->entry.subdirectories_size > 0 &&
+             contents[offset + directory->entry.subdirectories_size - 1] != '\0'))
+        {
+            g_free (directory);
+            g_hash_table_remove_all (cache);
+            break;
+        }
+
+        directory->subdirectories = g_memdup (contents + offset,
+                                              directory->entry.subdirectories_size);
+        offset += directory->entry.subdirectories_size;
+        g_hash_table_add (cache, directory);
+    }
+
+    g_free (contents);
+}
+
+/* Lock cache_mutex when calling this. */
+static GHashTable *
+get_cache (void)
+{
+    if (cache == NULL)
+    {
+        load_cache ();
+    }
+
+    return cache;
+}
+
+static void
+save_cache_thread_func (GTask        *task,
+                        gpointer      source_object,
+                        gpointer      task_data,
+                        GCancellable *cancellable)
+{
+    GByteArray *contents;
+    char *path, *dirname;
+
+    contents = task_data;
+    path = get_cache_file_path ();
+    dirname = g_path_get_dirname (path);
+
+    if (g_mkdir_with_parents (dirname, 0700) == 0)
+    {
+        g_file_set_contents (path, (char *) contents->data, contents->len, NULL);
+    }
+
+    g_free (dirname);
+    g_free (path);
+}
+
+static gboolean
+save_cache_timeout_callback (gpointer user_data)
+{
+    CacheFileHeader header;
+    CachedDirectory *directory;
+    GByteArray *contents;
+    GHashTableIter iter;
+    GTask *task;
+
+    g_mutex_lock (&cache_mutex);
+
+    save_timeout_id = 0;
+
+    header.magic = CACHE_FILE_MAGIC;
+    header.version = CACHE_FILE_VERSION;
+    header.entry_size = sizeof (CacheEntry);
+    header.n_entries = g_hash_table_size (cache);
+
+    contents = g_byte_array_sized_new (sizeof (header) + header.n_entries * sizeof (CacheEntry));
+    g_byte_array_append (contents, (guint8 *) &header, sizeof (header));
+
+    g_hash_table_iter_init (&iter, cache);
+    while (g_hash_table_iter_next (&iter, (gpointer *) &directory, NULL))
+    {
+        g_byte_array_append (contents, (guint8 *) &directory->entry, sizeof (CacheEntry));
+        g_byte_array_append (contents, (guint8 *) directory->subdirectories,
+                             directory->entry.subdirectories_size);
+    }
+
+    g_mutex_unlock (&cache_mutex);
+
+    /* Writing out a few MB is not something to do in the main loop. */
+    task = g_task_new (NULL, NULL, NULL, NULL);
+    g_task_set_task_data (task, contents, (GDestroyNotify) g_byte_array_unref);
+    g_task_run_in_thread (task, save_cache_thread_func);
+    g_object_unref (task);
+
+    return G_SOURCE_REMOVE;
+}
+
+/* Lock cache_mutex when calling this. */
+static void
+schedule_save (void)
+{
+    if (save_timeout_id == 0)
+    {
+        save_timeout_id = g_timeout_add_seconds (SAVE_DELAY_SECS,
+                                                 save_cache_timeout_callback,
+                                                 NULL);
+    }
+}
+
+gboolean
+nautilus_directory_size_cache_lookup (guint64                 device,
+                                      guint64                 inode,
+                                      gint64                  mtime,
+                                      gboolean                skip_hidden_files,
+                                      NautilusDirectorySize  *size,
+                                      char                 ***subdirectories)
+{
+    CachedDirectory key, *directory;
+    GPtrArray *names;
+    const char *name, *end;
+    gboolean found;
+
+    key.entry.device = device;
+    key.entry.inode = inode;
+    found = FALSE;
+
+    g_mutex_lock (&cache_mutex);
+
+    directory = g_hash_table_lookup (get_cache (), &key);
+    if (directory != NULL &&
+        directory->entry.mtime == mtime &&
+        directory->entry.skip_hidden_files == (skip_hidden_files ? 1 : 0) &&
+        g_get_real_time () / G_USEC_PER_SEC - directory->entry.store_time < MAX_ENTRY_AGE_SECS)
+    {
+        size->directory_count = directory->entry.directory_count;
+        size->file_count = directory->entry.file_count;
+        size->unreadable_directory_count = directory->entry.unreadable_directory_count;
+        size->total_size = directory->entry.total_size;
+
+        names = g_ptr_array_new ();
+        name = directory->subdirectories;
+        end = directory->subdirectories + directory->entry.subdirectories_size;
+        for (; name < end; name += strlen (name) + 1)
+        {
+            g_ptr_array_add (names, g_strdup (name));
+        }
+        g_ptr_array_add (names, NULL);
+        *subdirectories = (char **) g_ptr_array_free (names, FALSE);
+
+        found = TRUE;
+    }
+
+    g_mutex_unlock (&cache_mutex);
+
+    return found;
+}
+
+void
+nautilus_directory_size_cache_store (guint64                      device,
+                                     guint64                      inode,
+                                     gint64                       mtime,
+                                     gboolean                     skip_hidden_files,
+                                     const NautilusDirectorySize *size,
+                                     const char * const          *subdirectories)
+{
+    CachedDirectory *directory;
+    GString *names;
+    guint i;
+
+    names = g_string_new (NULL);
+    for (i = 0; subdirectories[i] != NULL; i++)
+    {
+        g_string_append_len (names, subdirectories[i], strlen (subdirectories[i]) + 1);
+    }
+
+    directory = g_new (CachedDirectory, 1);
+    memset (&directory->entry, 0, sizeof (CacheEntry));
+    directory->entry.device = device;
+    directory->entry.inode = inode;
+    directory->entry.mtime = mtime;
+    directory->entry.store_time = g_get_real_time () / G_USEC_PER_SEC;
+    directory->entry.skip_hidden_files = skip_hidden_files ? 1 : 0;
+    directory->entry.directory_count = size->directory_count;
+    directory->entry.file_count = size->file_count;
+    directory->entry.unreadable_directory_count = size->unreadable_directory_count;
+    directory->entry.total_size = size->total_size;
+    directory->entry.subdirectories_size = names->len;
+    directory->subdirectories = g_string_free (names, FALSE);
+
+    g_mutex_lock (&cache_mutex);
+
+    if (g_hash_table_size (get_cache ()) >= MAX_CACHE_ENTRIES)
+    {
+        g_hash_table_remove_all (cache);
+    }
+
+    g_hash_table_replace (cache, directory, directory);
+    schedule_save ();
+
+    g_mutex_unlock (&cache_mutex);
+}
+
+static void
+forget_directory (const char *path)
+{
+    CachedDirectory key;
+    struct stat statbuf;
+
+    if (g_stat (path, &statbuf) != 0 || !S_ISDIR (statbuf.st_mode))
+    {
+        return;
+    }
+
+    key.entry.device = statbuf.st_dev;
+    key.entry.inode = statbuf.st_ino;
+
+    g_mutex_lock (&cache_mutex);
+    if (g_hash_table_remove (get_cache (), &key))
+    {
+        schedule_save ();
+    }
+    g_mutex_unlock (&cache_mutex);
+}
+
+static void
+invalidate_func (gpointer data,
+                 gpointer user_data)
+{
+    char *path, *parent;
+
+    path = data;
+    parent = g_path_get_dirname (path);
+
+    /* Entries only hold what is directly in a directory, so a change
+     * only affects the directory it happened in, and the location itself
+     * if it is one. The location may be gone already.
+     */
+    forget_directory (path);
+    forget_directory (parent);
+
+    g_free (parent);
+    g_free (path);
+}
+
+void
+nautilus_directory_size_cache_invalidate (GFile *location)
+{
+    char *path;
+
+    path = g_file_get_path (location);
+    if (path == NULL)
+    {
+        return;
+    }
+
+    /* Called for every change Nautilus hears of, on the main thread, so
+     * the directories are looked up by another one, in order.
+     */
+    g_mutex_lock (&cache_mutex);
+    if (invalidate_pool == NULL)
+    {
+        invalidate_pool = g_thread_pool_new (invalidate_func, NULL, 1, FALSE, NULL);
+    }
+    g_mutex_unlock (&cache_mutex);
+
+    g_thread_pool_push (invalidate_pool, path, NULL);
+}
@@ -0,0 +1,60 @@
+/*
+   nautilus-directory-size-cache.h: Deep counts of local directories,
+   kept across sessions.
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of the
+   License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public
+   License along with this program; if not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef NAUTILUS_DIRECTORY_SIZE_CACHE_H
+#define NAUTILUS_DIRECTORY_SIZE_CACHE_H
+
+#include <gio/gio.h>
+
+typedef struct
+{
+	guint directory_count;
+	guint file_count;
+	guint unreadable_directory_count;
+	goffset total_size;
+} NautilusDirectorySize;
+
+/* What is directly in a directory: its files and subdirectories, their
+ * sizes, and the names of the subdirectories on the same filesystem.
+ * Directories are identified by device and inode, an entry is only
+ * valid as long as the directory has the mtime it was stored with, and
+ * for a few minutes at most, as files rewritten in place don't change
+ * it. Counting a tree still visits every directory, but only reads the
+ * ones that changed.
+ *
+ * All of these can be called from any thread.
+ */
+gboolean nautilus_directory_size_cache_lookup     (guint64                      device,
+						   guint64                      inode,
+						   gint64                       mtime,
+						   gboolean                     skip_hidden_files,
+						   NautilusDirectorySize       *size,
+						   char                      ***subdirectories);
+void     nautilus_directory_size_cache_store      (guint64                      device,
+						   guint64                      inode,
+						   gint64                       mtime,
+						   gboolean                     skip_hidden_files,
+						   const NautilusDirectorySize *size,
+						   const char * const          *subdirectories);
+
+/* Forgets the directory containing @location, and @location itself.
+ * The directories are looked up in another thread.
+ */
+void     nautilus_directory_size_cache_invalidate (GFile                       *location);
+
+#endif /* NAUTILUS_DIRECTORY_SIZE_CACHE_H */
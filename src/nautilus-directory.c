@@ -62,6 +62,9 @@ static GHashTable *directories;
 static void               nautilus_directory_finalize (GObject *object);
 static NautilusDirectory *nautilus_directory_new (GFile *location);
 static GList *real_get_file_list (NautilusDirectory *directory);
+static void real_foreach_file (NautilusDirectory            *directory,
+                               NautilusDirectoryForeachFunc  func,
+                               gpointer                      callback_data);
 static gboolean           real_is_editable (NautilusDirectory *directory);
 static void               set_directory_location (NautilusDirectory *directory,
                                                   GFile             *location);
@@ -174,6 +177,7 @@ nautilus_directory_class_init (NautilusDirectoryClass *klass)
                              G_PARAM_CONSTRUCT_ONLY | G_PARAM_READWRITE);
 
     klass->get_file_list = real_get_file_list;
+    klass->foreach_file = real_foreach_file;
     klass->is_editable = real_is_editable;
     klass->handles_location = real_handles_location;
 
@@ -185,7 +189,10 @@ static void
 nautilus_directory_init (NautilusDirectory *directory)
 {
     directory->details = G_TYPE_INSTANCE_GET_PRIVATE ((directory), NAUTILUS_TYPE_DIRECTORY, NautilusDirectoryDetails);
+    directory->details->files = g_ptr_array_new ();
     directory->details->file_hash = g_hash_table_new (g_str_hash, g_str_equal);
+    directory->details->pending_file_info = g_ptr_array_new_with_free_func (g_object_unref);
+    directory->details->unconfirmed_files = g_hash_table_new (NULL, NULL);
     directory->details->high_priority_queue = nautilus_file_queue_new ();
     directory->details->low_priority_queue = nautilus_file_queue_new ();
     directory->details->extension_queue = nautilus_file_queue_new ();
@@ -256,8 +263,10 @@ nautilus_directory_finalize (GObject *object)
         g_object_unref (directory->details->location);
     }
 
-    g_assert (directory->details->file_list == NULL);
+    g_assert (directory->details->files->len == 0);
+    g_ptr_array_free (directory->details->files, TRUE);
     g_hash_table_destroy (directory->details->file_hash);
+    g_clear_pointer (&directory->details->filesystem_infos, g_hash_table_destroy);
 
     nautilus_file_queue_destroy (directory->details->high_priority_queue);
     nautilus_file_queue_destroy (directory->details->low_priority_queue);
@@ -265,7 +274,8 @@ nautilus_directory_finalize (GObject *object)
     g_assert (directory->details->directory_load_in_progress == NULL);
     g_assert (directory->details->count_in_progress == NULL);
     g_assert (directory->details->dequeue_pending_idle_id == 0);
-    g_list_free_full (directory->details->pending_file_info, g_object_unref);
+    g_ptr_array_unref (directory->details->pending_file_info);
+    g_hash_table_destroy (directory->details->unconfirmed_files);
 
     G_OBJECT_CLASS (nautilus_directory_parent_class)->finalize (object);
 }
@@ -312,13 +322,12 @@ emit_change_signals_for_all_files (NautilusDirectory *directory)
 {
     GList *files;
 
-    files = g_list_copy (directory->details->file_list);
+    files = nautilus_directory_get_all_files (directory);
     if (directory->details->as_file != NULL)
     {
-        files = g_list_prepend (files, directory->details->as_file);
+        files = g_list_prepend (files, nautilus_file_ref (directory->details->as_file));
     }
 
-    nautilus_file_list_ref (files);
     nautilus_directory_emit_change_signals (directory, files);
 
     nautilus_file_list_free (files);
@@ -794,57 +803,53 @@ nautilus_directory_are_all_files_seen (NautilusDirectory *directory)
 
 static void
 add_to_hash_table (NautilusDirectory *directory,
-                   NautilusFile      *file,
-                   GList             *node)
+                   NautilusFile      *file)
 {
     const char *name;
 
     name = eel_ref_str_peek (file->details->name);
 
-    g_assert (node != NULL);
     g_assert (g_hash_table_lookup (directory->details->file_hash,
                                    name) == NULL);
-    g_hash_table_insert (directory->details->file_hash, (char *) name, node);
+    g_hash_table_insert (directory->details->file_hash, (char *) name, file);
 }
 
-static GList *
+static gboolean
 extract_from_hash_table (NautilusDirectory *directory,
                          NautilusFile      *file)
 {
     const char *name;
-    GList *node;
 
     name = eel_ref_str_peek (file->details->name);
     if (name == NULL)
     {
-        return NULL;
+        return FALSE;
     }
 
-    /* Find the list node in the hash table. */
-    node = g_hash_table_lookup (directory->details->file_hash, name);
-    g_hash_table_remove (directory->details->file_hash, name);
-
-    return node;
+    return g_hash_table_remove (directory->details->file_hash, name);
 }
 
 void
 nautilus_directory_add_file (NautilusDirectory *directory,
                              NautilusFile      *file)
 {
-    GList *node;
     gboolean add_to_work_queue;
 
     g_assert (NAUTILUS_IS_DIRECTORY (directory));
     g_assert (NAUTILUS_IS_FILE (file));
     g_assert (file->details->name != NULL);
 
-    /* Add to list. */
-    node = g_list_prepend (directory->details->file_list, file);
-    directory->details->file_list = node;
+    /* Add to the array, remembering where so removal doesn't have to look. */
+    file->details->directory_index = directory->details->files->len;
+    g_ptr_array_add (directory->details->files, file);
 
     /* Add to hash table. */
-    add_to_hash_table (directory, file, node);
+    add_to_hash_table (directory, file);
 
+    if (file->details->unconfirmed)
+    {
+        g_hash_table_add (directory->details->unconfirmed_files, file);
+    }
     directory->details->confirmed_file_count++;
 
     add_to_work_queue = FALSE;
@@ -872,21 +877,28 @@ void
 nautilus_directory_remove_file (NautilusDirectory *directory,
                                 NautilusFile      *file)
 {
-    GList *node;
+    GPtrArray *files;
+    NautilusFile *last;
+    guint index;
 
     g_assert (NAUTILUS_IS_DIRECTORY (directory));
     g_assert (NAUTILUS_IS_FILE (file));
     g_assert (file->details->name != NULL);
 
-    /* Find the list node in the hash table. */
-    node = extract_from_hash_table (directory, file);
-    g_assert (node != NULL);
-    g_assert (node->data == file);
+    if (!extract_from_hash_table (directory, file))
+    {
+        g_assert_not_reached ();
+    }
+
+    /* Move the last file into the hole. */
+    files = directory->details->files;
+    index = file->details->directory_index;
+    g_assert (index < files->len);
+    g_assert (g_ptr_array_index (files, index) == file);
 
-    /* Remove the item from the list. */
-    directory->details->file_list = g_list_remove_link
-                                        (directory->details->file_list, node);
-    g_list_free_1 (node);
+    last = g_ptr_array_index (files, files->len - 1);
+    last->details->directory_index = index;
+    g_ptr_array_remove_index_fast (files, index);
 
     nautilus_directory_remove_file_from_work_queue (directory, file);
 
@@ -894,6 +906,10 @@ nautilus_directory_remove_file (NautilusDirectory *directory,
     {
         directory->details->confirmed_file_count--;
     }
+    else
+    {
+        g_hash_table_remove (directory->details->unconfirmed_files, file);
+    }
 
     /* Unref if we are monitoring. */
     if (nautilus_directory_is_file_list_monitored (directory))
@@ -902,23 +918,23 @@ nautilus_directory_remove_file (NautilusDirectory *directory,
     }
 }
 
-GList *
+gboolean
 nautilus_directory_begin_file_name_change (NautilusDirectory *directory,
                                            NautilusFile      *file)
 {
-    /* Find the list node in the hash table. */
+    /* Take the file out of the hash table under its old name. */
     return extract_from_hash_table (directory, file);
 }
 
 void
 nautilus_directory_end_file_name_change (NautilusDirectory *directory,
                                          NautilusFile      *file,
-                                         GList             *node)
+                                         gboolean           in_hash_table)
 {
-    /* Add the list node to the hash table. */
-    if (node != NULL)
+    /* Put it back under the new one. */
+    if (in_hash_table)
     {
-        add_to_hash_table (directory, file, node);
+        add_to_hash_table (directory, file);
     }
 }
 
@@ -926,14 +942,10 @@ NautilusFile *
 nautilus_directory_find_file_by_name (NautilusDirectory *directory,
                                       const char        *name)
 {
-    GList *node;
-
     g_return_val_if_fail (NAUTILUS_IS_DIRECTORY (directory), NULL);
     g_return_val_if_fail (name != NULL, NULL);
 
-    node = g_hash_table_lookup (directory->details->file_hash,
-                                name);
-    return node == NULL ? NULL : NAUTILUS_FILE (node->data);
+    return g_hash_table_lookup (directory->details->file_hash, name);
 }
 
 void
@@ -1446,7 +1458,7 @@ nautilus_directory_moved_internal (GFile *old_location,
             }
             affected_files = g_list_concat
                                  (affected_files,
-                                 nautilus_file_list_copy (directory->details->file_list));
+                                 nautilus_directory_get_all_files (directory));
         }
 
         nautilus_directory_unref (directory);
@@ -1813,13 +1825,67 @@ nautilus_directory_get_file_list (NautilusDirectory *directory)
 static GList *
 real_get_file_list (NautilusDirectory *directory)
 {
-    GList *tentative_files, *non_tentative_files;
+    GList *files;
+    NautilusFile *file;
+    guint i;
 
-    tentative_files = nautilus_file_list_filter (directory->details->file_list,
-                                                 &non_tentative_files, is_tentative, NULL);
-    nautilus_file_list_free (tentative_files);
+    files = NULL;
+    for (i = 0; i < directory->details->files->len; i++)
+    {
+        file = g_ptr_array_index (directory->details->files, i);
+        if (!is_tentative (file, NULL))
+        {
+            files = g_list_prepend (files, nautilus_file_ref (file));
+        }
+    }
+
+    return files;
+}
+
+void
+nautilus_directory_foreach_file (NautilusDirectory            *directory,
+                                 NautilusDirectoryForeachFunc  func,
+                                 gpointer                      callback_data)
+{
+    g_return_if_fail (NAUTILUS_IS_DIRECTORY (directory));
+    g_return_if_fail (func != NULL);
+
+    NAUTILUS_DIRECTORY_CLASS (G_OBJECT_GET_CLASS (directory))->foreach_file
+        (directory, func, callback_data);
+}
+
+static void
+real_foreach_file (NautilusDirectory            *directory,
+                   NautilusDirectoryForeachFunc  func,
+                   gpointer                      callback_data)
+{
+    NautilusFile *file;
+    guint i;
+
+    for (i = 0; i < directory->details->files->len; i++)
+    {
+        file = g_ptr_array_index (directory->details->files, i);
+        if (!is_tentative (file, NULL))
+        {
+            (*func)(file, callback_data);
+        }
+    }
+}
+
+GList *
+nautilus_directory_get_all_files (NautilusDirectory *directory)
+{
+    GList *files;
+    guint i;
+
+    files = NULL;
+    for (i = 0; i < directory->details->files->len; i++)
+    {
+        files = g_list_prepend (files,
+                                nautilus_file_ref (g_ptr_array_index (directory->details->files, i)));
+    }
 
-    return non_tentative_files;
+    return files;
 }
 
 static gboolean
@@ -2065,7 +2131,7 @@ nautilus_self_check_directory (void)
         gtk_main_iteration ();
     }
 
-    EEL_CHECK_BOOLEAN_RESULT (directory->details->file_list == NULL, TRUE);
+    EEL_CHECK_BOOLEAN_RESULT (directory->details->files->len == 0, TRUE);
 
     EEL_CHECK_INTEGER_RESULT (g_hash_table_size (directories), 1);
 
@@ -70,6 +70,9 @@ typedef void (*NautilusDirectoryCallback) (NautilusDirectory *directory,
 					   GList             *files,
 					   gpointer           callback_data);
 
+typedef void (*NautilusDirectoryForeachFunc) (NautilusFile *file,
+					      gpointer      callback_data);
+
 typedef struct
 {
 	GObjectClass parent_class;
@@ -134,6 +137,13 @@ typedef struct
 	 */
 	GList *	 (* get_file_list)	 (NautilusDirectory *directory);
 
+	/* foreach_file must visit the same files get_file_list returns,
+	 * subclasses overriding one override the other too.
+	 */
+	void	 (* foreach_file)	 (NautilusDirectory            *directory,
+					  NautilusDirectoryForeachFunc  func,
+					  gpointer                      callback_data);
+
 	/* Should return FALSE if the directory is read-only and doesn't
 	 * allow setting of metadata.
 	 * An example of this is the search directory.
@@ -210,6 +220,14 @@ void               nautilus_directory_force_reload             (NautilusDirector
 /* Get a list of all files currently known in the directory. */
 GList *            nautilus_directory_get_file_list            (NautilusDirectory         *directory);
 
+/* Calls func on each of the files get_file_list would return, without
+ * copying the list or taking refs. func must not add files to or
+ * remove files from the directory.
+ */
+void               nautilus_directory_foreach_file             (NautilusDirectory            *directory,
+								NautilusDirectoryForeachFunc  func,
+								gpointer                      callback_data);
+
 GList *            nautilus_directory_match_pattern            (NautilusDirectory         *directory,
 							        const char *glob);
 
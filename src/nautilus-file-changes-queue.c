@@ -21,6 +21,8 @@
 #include "nautilus-file-changes-queue.h"
 
 #include "nautilus-directory-notify.h"
+#include "nautilus-directory-size-cache.h"
+#include "nautilus-file-name-index.h"
 
 typedef enum
 {
@@ -46,6 +48,10 @@ typedef struct
 {
     GList *head;
     GList *tail;
+    /* GFile -> link of the queued added, changed or removed change for
+     * it, so later events for the same file can be folded into it.
+     */
+    GHashTable *pending;
     GMutex mutex;
 } NautilusFileChangesQueue;
 
@@ -55,11 +61,101 @@ nautilus_file_changes_queue_new (void)
     NautilusFileChangesQueue *result;
 
     result = g_new0 (NautilusFileChangesQueue, 1);
+    result->pending = g_hash_table_new (g_file_hash, (GEqualFunc) g_file_equal);
     g_mutex_init (&result->mutex);
 
     return result;
 }
 
+static void
+nautilus_file_change_free (NautilusFileChange *change)
+{
+    g_clear_object (&change->from);
+    g_clear_object (&change->to);
+    g_free (change);
+}
+
+static gboolean
+is_coalescable (NautilusFileChange *change)
+{
+    return change->kind == CHANGE_FILE_ADDED ||
+           change->kind == CHANGE_FILE_CHANGED ||
+           change->kind == CHANGE_FILE_REMOVED;
+}
+
+/* Lock queue->mutex when calling this. */
+static void
+remove_pending_change (NautilusFileChangesQueue *queue,
+                       GList                    *link)
+{
+    NautilusFileChange *change;
+
+    change = link->data;
+    g_hash_table_remove (queue->pending, change->from);
+
+    if (queue->tail == link)
+    {
+        queue->tail = link->prev;
+    }
+    queue->head = g_list_delete_link (queue->head, link);
+
+    nautilus_file_change_free (change);
+}
+
+/* Lock queue->mutex when calling this. Folds @new_item into the change
+ * already queued for the same file, if any, and returns FALSE if nothing
+ * is left to queue:
+ *
+ *   added, then changed or added      -> added
+ *   changed, then changed             -> changed
+ *   changed, then added               -> added
+ *   anything, then removed            -> removed
+ *   removed, then added or changed    -> added
+ *
+ * Nobody looks at the queue before it is consumed, so the events in
+ * between don't matter.
+ */
+static gboolean
+coalesce_change (NautilusFileChangesQueue *queue,
+                 NautilusFileChange       *new_item)
+{
+    NautilusFileChange *pending;
+    GList *link;
+
+    link = g_hash_table_lookup (queue->pending, new_item->from);
+    if (link == NULL)
+    {
+        return TRUE;
+    }
+
+    pending = link->data;
+
+    if (new_item->kind == CHANGE_FILE_REMOVED)
+    {
+        /* Not cancelled out when the pending change is an addition,
+         * which may be for a file that is shown already, say because
+         * it was overwritten.
+         */
+        remove_pending_change (queue, link);
+        return TRUE;
+    }
+
+    if (pending->kind == CHANGE_FILE_REMOVED)
+    {
+        /* Additions of files that are known already count as changes. */
+        remove_pending_change (queue, link);
+        new_item->kind = CHANGE_FILE_ADDED;
+        return TRUE;
+    }
+
+    if (new_item->kind == CHANGE_FILE_ADDED)
+    {
+        pending->kind = CHANGE_FILE_ADDED;
+    }
+
+    return FALSE;
+}
+
 static NautilusFileChangesQueue *
 nautilus_file_changes_queue_get (void)
 {
@@ -80,12 +176,31 @@ nautilus_file_changes_queue_add_common (NautilusFileChangesQueue *queue,
     /* enqueue the new queue item while locking down the list */
     g_mutex_lock (&queue->mutex);
 
+    if (is_coalescable (new_item) && !coalesce_change (queue, new_item))
+    {
+        g_mutex_unlock (&queue->mutex);
+        nautilus_file_change_free (new_item);
+        return;
+    }
+
+    /* Moves are never folded, and neither is anything across them. */
+    if (new_item->kind == CHANGE_FILE_MOVED)
+    {
+        g_hash_table_remove (queue->pending, new_item->from);
+        g_hash_table_remove (queue->pending, new_item->to);
+    }
+
     queue->head = g_list_prepend (queue->head, new_item);
     if (queue->tail == NULL)
     {
         queue->tail = queue->head;
     }
 
+    if (is_coalescable (new_item))
+    {
+        g_hash_table_insert (queue->pending, new_item->from, queue->head);
+    }
+
     g_mutex_unlock (&queue->mutex);
 }
 
@@ -101,6 +216,9 @@ nautilus_file_changes_queue_file_added (GFile *location)
     new_item->kind = CHANGE_FILE_ADDED;
     new_item->from = g_object_ref (location);
     nautilus_file_changes_queue_add_common (queue, new_item);
+
+    nautilus_directory_size_cache_invalidate (location);
+    nautilus_file_name_index_file_added (location);
 }
 
 void
@@ -115,6 +233,9 @@ nautilus_file_changes_queue_file_changed (GFile *location)
     new_item->kind = CHANGE_FILE_CHANGED;
     new_item->from = g_object_ref (location);
     nautilus_file_changes_queue_add_common (queue, new_item);
+
+    nautilus_directory_size_cache_invalidate (location);
+    nautilus_file_name_index_file_changed (location);
 }
 
 void
@@ -129,6 +250,9 @@ nautilus_file_changes_queue_file_removed (GFile *location)
     new_item->kind = CHANGE_FILE_REMOVED;
     new_item->from = g_object_ref (location);
     nautilus_file_changes_queue_add_common (queue, new_item);
+
+    nautilus_directory_size_cache_invalidate (location);
+    nautilus_file_name_index_file_removed (location);
 }
 
 void
@@ -145,6 +269,10 @@ nautilus_file_changes_queue_file_moved (GFile *from,
     new_item->from = g_object_ref (from);
     new_item->to = g_object_ref (to);
     nautilus_file_changes_queue_add_common (queue, new_item);
+
+    nautilus_directory_size_cache_invalidate (from);
+    nautilus_directory_size_cache_invalidate (to);
+    nautilus_file_name_index_file_moved (from, to);
 }
 
 void
@@ -198,6 +326,11 @@ nautilus_file_changes_queue_get_change (NautilusFileChangesQueue *queue)
     {
         new_tail = queue->tail->prev;
         result = queue->tail->data;
+        if (is_coalescable (result) &&
+            g_hash_table_lookup (queue->pending, result->from) == queue->tail)
+        {
+            g_hash_table_remove (queue->pending, result->from);
+        }
         queue->head = g_list_remove_link (queue->head,
                                           queue->tail);
         g_list_free_1 (queue->tail);
@@ -211,9 +344,29 @@ nautilus_file_changes_queue_get_change (NautilusFileChangesQueue *queue)
 
 enum
 {
-    CONSUME_CHANGES_MAX_CHUNK = 20
+    /* Send changes off in batches of at most this many, so that views
+     * catch up while a storm of changes is consumed.
+     */
+    CONSUME_CHANGES_MAX_BATCH = 1000
 };
 
+/* Unless all changes are to be consumed, return to the main loop after
+ * about this long and leave the rest for later.
+ */
+#define CONSUME_CHANGES_TIME_SLICE_USEC (10 * 1000)
+
+/* The changes to send off together. */
+typedef struct
+{
+    GList *additions;
+    GList *changes;
+    GList *deletions;
+    GList *moves;
+    GList *position_set_requests;
+    GHashTable *locations;      /* of the additions, changes and deletions */
+    guint size;
+} ChangeBatch;
+
 static void
 pairs_list_free (GList *pairs)
 {
@@ -249,183 +402,200 @@ position_set_list_free (GList *list)
     g_list_free_full (list, g_free);
 }
 
-/* go through changes in the change queue, send ones with the same kind
- * in a list to the different nautilus_directory_notify calls
+static void
+change_batch_flush (ChangeBatch *batch)
+{
+    /* Each file is in the batch once at most, so the order of sending
+     * off additions, changes and deletions doesn't matter.
+     */
+    if (batch->deletions != NULL)
+    {
+        batch->deletions = g_list_reverse (batch->deletions);
+        nautilus_directory_notify_files_removed (batch->deletions);
+        g_list_free_full (batch->deletions, g_object_unref);
+        batch->deletions = NULL;
+    }
+    if (batch->moves != NULL)
+    {
+        batch->moves = g_list_reverse (batch->moves);
+        nautilus_directory_notify_files_moved (batch->moves);
+        pairs_list_free (batch->moves);
+        batch->moves = NULL;
+    }
+    if (batch->additions != NULL)
+    {
+        batch->additions = g_list_reverse (batch->additions);
+        nautilus_directory_notify_files_added (batch->additions);
+        g_list_free_full (batch->additions, g_object_unref);
+        batch->additions = NULL;
+    }
+    if (batch->changes != NULL)
+    {
+        batch->changes = g_list_reverse (batch->changes);
+        nautilus_directory_notify_files_changed (batch->changes);
+        g_list_free_full (batch->changes, g_object_unref);
+        batch->changes = NULL;
+    }
+    if (batch->position_set_requests != NULL)
+    {
+        batch->position_set_requests = g_list_reverse (batch->position_set_requests);
+        nautilus_directory_schedule_position_set (batch->position_set_requests);
+        position_set_list_free (batch->position_set_requests);
+        batch->position_set_requests = NULL;
+    }
+
+    g_hash_table_remove_all (batch->locations);
+    batch->size = 0;
+}
+
+/* Moves can't be mixed with other changes, their order matters. The
+ * same goes for changes to a file that is in the batch already, which
+ * happens when it changed again while the queue was being consumed.
  */
-void
-nautilus_file_changes_consume_changes (gboolean consume_all)
+static gboolean
+change_batch_needs_flush (ChangeBatch        *batch,
+                          NautilusFileChange *change)
 {
-    NautilusFileChange *change;
-    GList *additions, *changes, *deletions, *moves;
-    GList *position_set_requests;
-    GFilePair *pair;
-    NautilusFileChangesQueuePosition *position_set;
-    guint chunk_count;
-    NautilusFileChangesQueue *queue;
-    gboolean flush_needed;
+    switch (change->kind)
+    {
+        case CHANGE_FILE_ADDED:
+        case CHANGE_FILE_CHANGED:
+        case CHANGE_FILE_REMOVED:
+        {
+            return batch->moves != NULL ||
+                   g_hash_table_contains (batch->locations, change->from);
+        }
 
+        case CHANGE_FILE_MOVED:
+        {
+            return batch->additions != NULL ||
+                   batch->changes != NULL ||
+                   batch->deletions != NULL;
+        }
 
-    additions = NULL;
-    changes = NULL;
-    deletions = NULL;
-    moves = NULL;
-    position_set_requests = NULL;
+        default:
+        {
+            return FALSE;
+        }
+    }
+}
 
-    queue = nautilus_file_changes_queue_get ();
+/* Takes ownership of @change. */
+static void
+change_batch_add (ChangeBatch        *batch,
+                  NautilusFileChange *change)
+{
+    NautilusFileChangesQueuePosition *position_set;
+    GFilePair *pair;
 
-    /* Consume changes from the queue, stuffing them into one of three lists,
-     * keep doing it while the changes are of the same kind, then send them off.
-     * This is to ensure that the changes get sent off in the same order that they
-     * arrived.
-     */
-    for (chunk_count = 0;; chunk_count++)
+    switch (change->kind)
     {
-        change = nautilus_file_changes_queue_get_change (queue);
+        case CHANGE_FILE_ADDED:
+        {
+            batch->additions = g_list_prepend (batch->additions, change->from);
+            g_hash_table_add (batch->locations, change->from);
+        }
+        break;
 
-        /* figure out if we need to flush the pending changes that we collected sofar */
+        case CHANGE_FILE_CHANGED:
+        {
+            batch->changes = g_list_prepend (batch->changes, change->from);
+            g_hash_table_add (batch->locations, change->from);
+        }
+        break;
 
-        if (change == NULL)
+        case CHANGE_FILE_REMOVED:
         {
-            flush_needed = TRUE;
-            /* no changes left, flush everything */
+            batch->deletions = g_list_prepend (batch->deletions, change->from);
+            g_hash_table_add (batch->locations, change->from);
         }
-        else
+        break;
+
+        case CHANGE_FILE_MOVED:
         {
-            flush_needed = additions != NULL
-                           && change->kind != CHANGE_FILE_ADDED
-                           && change->kind != CHANGE_POSITION_SET
-                           && change->kind != CHANGE_POSITION_REMOVE;
-
-            flush_needed |= changes != NULL
-                            && change->kind != CHANGE_FILE_CHANGED;
-
-            flush_needed |= moves != NULL
-                            && change->kind != CHANGE_FILE_MOVED
-                            && change->kind != CHANGE_POSITION_SET
-                            && change->kind != CHANGE_POSITION_REMOVE;
-
-            flush_needed |= deletions != NULL
-                            && change->kind != CHANGE_FILE_REMOVED;
-
-            flush_needed |= position_set_requests != NULL
-                            && change->kind != CHANGE_POSITION_SET
-                            && change->kind != CHANGE_POSITION_REMOVE
-                            && change->kind != CHANGE_FILE_ADDED
-                            && change->kind != CHANGE_FILE_MOVED;
-
-            flush_needed |= !consume_all && chunk_count >= CONSUME_CHANGES_MAX_CHUNK;
-            /* we have reached the chunk maximum */
+            pair = g_new (GFilePair, 1);
+            pair->from = change->from;
+            pair->to = change->to;
+            batch->moves = g_list_prepend (batch->moves, pair);
         }
+        break;
 
-        if (flush_needed)
+        case CHANGE_POSITION_SET:
         {
-            /* Send changes we collected off.
-             * At one time we may only have one of the lists
-             * contain changes.
-             */
-
-            if (deletions != NULL)
-            {
-                deletions = g_list_reverse (deletions);
-                nautilus_directory_notify_files_removed (deletions);
-                g_list_free_full (deletions, g_object_unref);
-                deletions = NULL;
-            }
-            if (moves != NULL)
-            {
-                moves = g_list_reverse (moves);
-                nautilus_directory_notify_files_moved (moves);
-                pairs_list_free (moves);
-                moves = NULL;
-            }
-            if (additions != NULL)
-            {
-                additions = g_list_reverse (additions);
-                nautilus_directory_notify_files_added (additions);
-                g_list_free_full (additions, g_object_unref);
-                additions = NULL;
-            }
-            if (changes != NULL)
-            {
-                changes = g_list_reverse (changes);
-                nautilus_directory_notify_files_changed (changes);
-                g_list_free_full (changes, g_object_unref);
-                changes = NULL;
-            }
-            if (position_set_requests != NULL)
-            {
-                position_set_requests = g_list_reverse (position_set_requests);
-                nautilus_directory_schedule_position_set (position_set_requests);
-                position_set_list_free (position_set_requests);
-                position_set_requests = NULL;
-            }
+            position_set = g_new (NautilusFileChangesQueuePosition, 1);
+            position_set->location = change->from;
+            position_set->set = TRUE;
+            position_set->point = change->point;
+            position_set->screen = change->screen;
+            batch->position_set_requests = g_list_prepend (batch->position_set_requests,
+                                                           position_set);
         }
+        break;
 
-        if (change == NULL)
+        case CHANGE_POSITION_REMOVE:
         {
-            /* we are done */
-            return;
+            position_set = g_new (NautilusFileChangesQueuePosition, 1);
+            position_set->location = change->from;
+            position_set->set = FALSE;
+            batch->position_set_requests = g_list_prepend (batch->position_set_requests,
+                                                           position_set);
         }
+        break;
 
-        /* add the new change to the list */
-        switch (change->kind)
+        default:
         {
-            case CHANGE_FILE_ADDED:
-            {
-                additions = g_list_prepend (additions, change->from);
-            }
-            break;
+            g_assert_not_reached ();
+        }
+        break;
+    }
 
-            case CHANGE_FILE_CHANGED:
-            {
-                changes = g_list_prepend (changes, change->from);
-            }
-            break;
+    batch->size++;
+    g_free (change);
+}
 
-            case CHANGE_FILE_REMOVED:
-            {
-                deletions = g_list_prepend (deletions, change->from);
-            }
-            break;
+/* Go through changes in the change queue and send them off in batches
+ * to the different nautilus_directory_notify calls. Unless @consume_all
+ * is set, this returns after a time slice, and TRUE if there may be
+ * changes left to consume.
+ */
+gboolean
+nautilus_file_changes_consume_changes (gboolean consume_all)
+{
+    NautilusFileChangesQueue *queue;
+    NautilusFileChange *change;
+    ChangeBatch batch = { 0 };
+    gboolean changes_left;
+    gint64 deadline;
 
-            case CHANGE_FILE_MOVED:
-            {
-                pair = g_new (GFilePair, 1);
-                pair->from = change->from;
-                pair->to = change->to;
-                moves = g_list_prepend (moves, pair);
-            }
-            break;
+    queue = nautilus_file_changes_queue_get ();
 
-            case CHANGE_POSITION_SET:
-            {
-                position_set = g_new (NautilusFileChangesQueuePosition, 1);
-                position_set->location = change->from;
-                position_set->set = TRUE;
-                position_set->point = change->point;
-                position_set->screen = change->screen;
-                position_set_requests = g_list_prepend (position_set_requests,
-                                                        position_set);
-            }
-            break;
+    batch.locations = g_hash_table_new (g_file_hash, (GEqualFunc) g_file_equal);
+    deadline = g_get_monotonic_time () + CONSUME_CHANGES_TIME_SLICE_USEC;
+    changes_left = FALSE;
 
-            case CHANGE_POSITION_REMOVE:
-            {
-                position_set = g_new (NautilusFileChangesQueuePosition, 1);
-                position_set->location = change->from;
-                position_set->set = FALSE;
-                position_set_requests = g_list_prepend (position_set_requests,
-                                                        position_set);
-            }
-            break;
+    while ((change = nautilus_file_changes_queue_get_change (queue)) != NULL)
+    {
+        if (change_batch_needs_flush (&batch, change))
+        {
+            change_batch_flush (&batch);
+        }
 
-            default:
-            {
-                g_assert_not_reached ();
-            }
-            break;
+        change_batch_add (&batch, change);
+
+        if (batch.size >= CONSUME_CHANGES_MAX_BATCH)
+        {
+            change_batch_flush (&batch);
         }
 
-        g_free (change);
+        if (!consume_all && g_get_monotonic_time () >= deadline)
+        {
+            changes_left = TRUE;
+            break;
+        }
     }
+
+    change_batch_flush (&batch);
+    g_hash_table_destroy (batch.locations);
+
+    return changes_left;
 }
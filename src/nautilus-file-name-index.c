@@ -0,0 +1,1667 @@
+/*
+ *  nautilus-file-name-index.c: Names of local files, kept on disk so
+ *  searches don't have to walk the tree.
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License as
+ *  published by the Free Software Foundation; either version 2 of the
+ *  License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public
+ *  License along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+#include "nautilus-file-name-index.h"
+
+#include "nautilus-search-hit.h"
+#include "nautilus-query-predicate.h"
+#define DEBUG_FLAG NAUTILUS_DEBUG_SEARCH
+#include "nautilus-debug.h"
+
+#include <glib/gstdio.h>
+#include <string.h>
+
+#define INDEX_FILE_MAGIC 0x49464e4e /* "NNFI" */
+#define INDEX_FILE_VERSION 3
+
+/* An index nobody searched with for this long is unloaded and stops
+ * following changes, until it is asked for again.
+ */
+#define MAX_UNUSED_SECS (60 * 60)
+
+/* Scan again rather than pile up more changes than this on a scan. */
+#define MAX_CHANGES 20000
+
+/* Give up on trees bigger than this, the index would be over 100 MB. */
+#define MAX_INDEX_ENTRIES 2000000
+
+/* Check whether the search was cancelled every this many entries. */
+#define CANCEL_CHECK_INTERVAL 16384
+
+#define NO_ENTRY G_MAXUINT32
+#define NO_MIME_TYPE G_MAXUINT32
+
+enum
+{
+    ENTRY_IS_DIRECTORY = 1 << 0,
+    ENTRY_IS_HIDDEN = 1 << 1,
+    /* The name isn't UTF-8, match its display name instead. */
+    ENTRY_NEEDS_DISPLAY_NAME = 1 << 2,
+    /* A directory on another device, what is in it isn't indexed. */
+    ENTRY_IS_MOUNT_POINT = 1 << 3,
+};
+
+/* Entries are stored as is, the file is only read back on the same
+ * machine. The children of a directory are next to each other, sorted
+ * by name, and come after the directory itself. Entry 0 is the root.
+ */
+typedef struct
+{
+    guint32 parent;
+    guint32 first_child;
+    guint32 n_children;
+    guint32 name;          /* offset in the name table */
+    guint32 mime_type;     /* index in the mime type table */
+    guint32 flags;
+    gint64 mtime;
+    gint64 atime;
+    guint64 size;
+} IndexEntry;
+
+/* Followed by the entries, the names, the mime types and the path of
+ * the root, all strings nul terminated.
+ */
+typedef struct
+{
+    guint32 magic;
+    guint32 version;
+    guint32 entry_size;
+    guint32 n_entries;
+    guint32 names_size;
+    guint32 n_mime_types;
+    guint32 mime_types_size;
+    guint32 root_size;
+    gint64 scan_time;
+} IndexFileHeader;
+
+/* One scan of the tree, mapped from disk. Never changes, so searches
+ * can hold on to it while the next scan replaces it.
+ */
+typedef struct
+{
+    gint ref_count;
+    GMappedFile *file;
+    const IndexEntry *entries;
+    guint32 n_entries;
+    const char *names;
+    const char **mime_types;
+    guint32 n_mime_types;
+    gint64 scan_time;
+} IndexSnapshot;
+
+/* What happened to a path since the last scan. */
+typedef struct
+{
+    char *path;              /* relative to the root */
+    gboolean exists;
+
+    /* Set if the path was removed, so whatever the scan found below it
+     * is gone, even if the path was created again.
+     */
+    gboolean replaces_subtree;
+
+    guint32 flags;
+    char *mime_type;
+    gint64 mtime;
+    gint64 atime;
+    guint64 size;
+} IndexChange;
+
+struct NautilusFileNameIndex
+{
+    GFile *root;
+    char *root_path;
+    /* Only used by the index thread. */
+    guint32 device;
+
+    /* Lock indexes_mutex when accessing these. */
+    gboolean active;
+    gint64 last_used;
+
+    /* Lock mutex when accessing the rest. */
+    GMutex mutex;
+    IndexSnapshot *snapshot;
+    GHashTable *changes;     /* relative path -> IndexChange */
+    gboolean scan_pending;
+    /* Whether a scan finished since the index was loaded. The one from
+     * disk misses what changed while Nautilus wasn't running.
+     */
+    gboolean scanned;
+};
+
+typedef enum
+{
+    INDEX_JOB_LOAD,
+    INDEX_JOB_SCAN,
+    INDEX_JOB_UPDATE,
+    INDEX_JOB_UPDATE_TREE,
+    INDEX_JOB_REMOVE,
+    INDEX_JOB_UNLOAD,
+} IndexJobKind;
+
+typedef struct
+{
+    NautilusFileNameIndex *index;
+    IndexJobKind kind;
+    GFile *location;
+} IndexJob;
+
+#define INDEX_ATTRIBUTES \
+    G_FILE_ATTRIBUTE_STANDARD_NAME "," \
+    G_FILE_ATTRIBUTE_STANDARD_DISPLAY_NAME "," \
+    G_FILE_ATTRIBUTE_STANDARD_IS_BACKUP "," \
+    G_FILE_ATTRIBUTE_STANDARD_IS_HIDDEN "," \
+    G_FILE_ATTRIBUTE_STANDARD_TYPE "," \
+    G_FILE_ATTRIBUTE_STANDARD_FAST_CONTENT_TYPE "," \
+    G_FILE_ATTRIBUTE_STANDARD_SIZE "," \
+    G_FILE_ATTRIBUTE_TIME_MODIFIED "," \
+    G_FILE_ATTRIBUTE_TIME_ACCESS "," \
+    G_FILE_ATTRIBUTE_ID_FILE "," \
+    G_FILE_ATTRIBUTE_UNIX_DEVICE
+
+/* Lock indexes_mutex when accessing these. */
+static GMutex indexes_mutex;
+static GList *indexes = NULL;
+
+/* All jobs of all indexes are run one after the other by one thread,
+ * so changes are applied in order and never race with a scan.
+ */
+static GThreadPool *index_pool = NULL;
+
+static void
+index_snapshot_unref (IndexSnapshot *snapshot)
+{
+    if (!g_atomic_int_dec_and_test (&snapshot->ref_count))
+    {
+        return;
+    }
+
+    g_free (snapshot->mime_types);
+    g_mapped_file_unref (snapshot->file);
+    g_free (snapshot);
+}
+
+static IndexSnapshot *
+index_snapshot_ref (IndexSnapshot *snapshot)
+{
+    g_atomic_int_inc (&snapshot->ref_count);
+
+    return snapshot;
+}
+
+static gboolean
+entries_are_valid (const IndexEntry *entries,
+                   guint32           n_entries,
+                   guint32           names_size,
+                   guint32           n_mime_types)
+{
+    const IndexEntry *entry;
+    guint32 i;
+
+    if (entries[0].parent != NO_ENTRY)
+    {
+        return FALSE;
+    }
+
+    for (i = 0; i < n_entries; i++)
+    {
+        entry = &entries[i];
+        if ((i > 0 && entry->parent >= i) ||
+            entry->n_children > n_entries ||
+            entry->name >= names_size ||
+            (entry->mime_type != NO_MIME_TYPE && entry->mime_type >= n_mime_types) ||
+            (entry->n_children > 0 &&
+             (entry->first_child <= i || entry->first_child > n_entries - entry->n_children)))
+        {
+            return FALSE;
+        }
+    }
+
+    return TRUE;
+}
+
+/* Returns NULL if the file is not an index of root_path. Everything is
+ * checked, a broken file must not make searches read out of bounds.
+ */
+static IndexSnapshot *
+index_snapshot_new (GMappedFile *file,
+                    const char  *root_path)
+{
+    IndexSnapshot *snapshot;
+    IndexFileHeader header;
+    const char *contents, *names, *mime_types, *root, *p;
+    gsize length, offset;
+    guint32 i;
+
+    contents = g_mapped_file_get_contents (file);
+    length = g_mapped_file_get_length (file);
+
+    if (length < sizeof (header))
+    {
+        return NULL;
+    }
+
+    memcpy (&header, contents, sizeof (header));
+    if (header.magic != INDEX_FILE_MAGIC ||
+        header.version != INDEX_FILE_VERSION ||
+        header.entry_size != sizeof (IndexEntry) ||
+        header.n_entries == 0 ||
+        header.n_entries > MAX_INDEX_ENTRIES ||
+        header.names_size == 0 ||
+        header.root_size == 0 ||
+        length != sizeof (header) + (gsize) header.n_entries * sizeof (IndexEntry) +
+        header.names_size + header.mime_types_size + header.root_size)
+    {
+        return NULL;
+    }
+
+    offset = sizeof (header) + (gsize) header.n_entries * sizeof (IndexEntry);
+    names = contents + offset;
+    offset += header.names_size;
+    mime_types = contents + offset;
+    offset += header.mime_types_size;
+    root = contents + offset;
+
+    if (names[header.names_size - 1] != '\0' ||
+        (header.mime_types_size > 0 && mime_types[header.mime_types_size - 1] != '\0') ||
+        root[header.root_size - 1] != '\0' ||
+        strcmp (root, root_path) != 0 ||
+        !entries_are_valid ((const IndexEntry *) (contents + sizeof (header)),
+                            header.n_entries, header.names_size, header.n_mime_types))
+    {
+        return NULL;
+    }
+
+    snapshot = g_new0 (IndexSnapshot, 1);
+    snapshot->ref_count = 1;
+    snapshot->file = g_mapped_file_ref (file);
+    snapshot->entries = (const IndexEntry *) (contents + sizeof (header));
+    snapshot->n_entries = header.n_entries;
+    snapshot->names = names;
+    snapshot->n_mime_types = header.n_mime_types;
+    snapshot->scan_time = header.scan_time;
+
+    snapshot->mime_types = g_new (const char *, MAX (header.n_mime_types, 1));
+    p = mime_types;
+    for (i = 0; i < header.n_mime_types; i++)
+    {
+        if (p >= mime_types + header.mime_types_size)
+        {
+            index_snapshot_unref (snapshot);
+            return NULL;
+        }
+        snapshot->mime_types[i] = p;
+        p += strlen (p) + 1;
+    }
+
+    return snapshot;
+}
+
+/* Returns the entry for a path relative to the root, or NO_ENTRY. */
+static guint32
+index_snapshot_lookup (IndexSnapshot *snapshot,
+                       const char    *path)
+{
+    const IndexEntry *entry;
+    const char *end;
+    guint32 id, low, high, middle;
+    gsize length;
+    int cmp;
+
+    id = 0;
+    while (*path != '\0')
+    {
+        end = strchr (path, '/');
+        length = end != NULL ? (gsize) (end - path) : strlen (path);
+
+        /* Binary search in the sorted children. */
+        entry = &snapshot->entries[id];
+        low = entry->first_child;
+        high = entry->first_child + entry->n_children;
+        id = NO_ENTRY;
+        while (low < high)
+        {
+            middle = low + (high - low) / 2;
+            cmp = strncmp (snapshot->names + snapshot->entries[middle].name, path, length);
+            if (cmp == 0 && snapshot->names[snapshot->entries[middle].name + length] != '\0')
+            {
+                cmp = 1;
+            }
+
+            if (cmp == 0)
+            {
+                id = middle;
+                break;
+            }
+            else if (cmp < 0)
+            {
+                low = middle + 1;
+            }
+            else
+            {
+                high = middle;
+            }
+        }
+
+        if (id == NO_ENTRY)
+        {
+            return NO_ENTRY;
+        }
+
+        path += length;
+        if (*path == '/')
+        {
+            path++;
+        }
+    }
+
+    return id;
+}
+
+static char *
+index_snapshot_get_path (IndexSnapshot *snapshot,
+                         guint32        id)
+{
+    GPtrArray *names;
+    GString *path;
+    guint i;
+
+    names = g_ptr_array_new ();
+    for (; id != 0; id = snapshot->entries[id].parent)
+    {
+        g_ptr_array_add (names, (gpointer) (snapshot->names + snapshot->entries[id].name));
+    }
+
+    path = g_string_new (NULL);
+    for (i = names->len; i > 0; i--)
+    {
+        g_string_append (path, g_ptr_array_index (names, i - 1));
+        if (i > 1)
+        {
+            g_string_append_c (path, '/');
+        }
+    }
+    g_ptr_array_free (names, TRUE);
+
+    return g_string_free (path, FALSE);
+}
+
+static char *
+get_index_file_path (NautilusFileNameIndex *index)
+{
+    char *checksum, *path;
+
+    checksum = g_compute_checksum_for_string (G_CHECKSUM_SHA1, index->root_path, -1);
+    path = g_build_filename (g_get_user_cache_dir (), "nautilus", "file-name-index", checksum, NULL);
+    g_free (checksum);
+
+    return path;
+}
+
+/* Whether @info is on the device of the root. Mounts below the root
+ * are left out, like the parents of the root are.
+ */
+static gboolean
+is_on_root_device (NautilusFileNameIndex *index,
+                   GFileInfo             *info)
+{
+    return g_file_info_get_attribute_uint32 (info, G_FILE_ATTRIBUTE_UNIX_DEVICE) == index->device;
+}
+
+static guint32
+get_flags (NautilusFileNameIndex *index,
+           GFileInfo             *info)
+{
+    guint32 flags;
+    const char *name, *display_name;
+
+    flags = 0;
+    if (g_file_info_get_file_type (info) == G_FILE_TYPE_DIRECTORY)
+    {
+        flags |= ENTRY_IS_DIRECTORY;
+        if (!is_on_root_device (index, info))
+        {
+            flags |= ENTRY_IS_MOUNT_POINT;
+        }
+    }
+    if (g_file_info_get_is_hidden (info) || g_file_info_get_is_backup (info))
+    {
+        flags |= ENTRY_IS_HIDDEN;
+    }
+
+    name = g_file_info_get_name (info);
+    display_name = g_file_info_get_display_name (info);
+    if (display_name != NULL && strcmp (name, display_name) != 0)
+    {
+        flags |= ENTRY_NEEDS_DISPLAY_NAME;
+    }
+
+    return flags;
+}
+
+static void
+index_change_free (IndexChange *change)
+{
+    g_free (change->path);
+    g_free (change->mime_type);
+    g_free (change);
+}
+
+static NautilusFileNameIndex *
+file_name_index_new (GFile *root)
+{
+    NautilusFileNameIndex *index;
+
+    index = g_new0 (NautilusFileNameIndex, 1);
+    index->root = g_object_ref (root);
+    index->root_path = g_file_get_path (root);
+    g_mutex_init (&index->mutex);
+    index->changes = g_hash_table_new_full (g_str_hash, g_str_equal,
+                                            NULL, (GDestroyNotify) index_change_free);
+
+    return index;
+}
+
+static void
+push_job (NautilusFileNameIndex *index,
+          IndexJobKind           kind,
+          GFile                 *location)
+{
+    IndexJob *job;
+
+    job = g_new0 (IndexJob, 1);
+    job->index = index;
+    job->kind = kind;
+    job->location = location != NULL ? g_object_ref (location) : NULL;
+
+    g_thread_pool_push (index_pool, job, NULL);
+}
+
+/* Lock index->mutex when calling this. */
+static void
+schedule_scan (NautilusFileNameIndex *index)
+{
+    if (!index->scan_pending)
+    {
+        index->scan_pending = TRUE;
+        push_job (index, INDEX_JOB_SCAN, NULL);
+    }
+}
+
+/* Everything a scan finds before it is written out. */
+typedef struct
+{
+    GArray *entries;
+    GString *names;
+    GHashTable *mime_type_ids;   /* mime type -> id + 1 */
+    GString *mime_types;
+} IndexBuilder;
+
+typedef struct
+{
+    guint32 id;
+    GFile *location;
+} ScanDirectory;
+
+static guint32
+index_builder_add_mime_type (IndexBuilder *builder,
+                             const char   *mime_type)
+{
+    gpointer id;
+
+    if (mime_type == NULL)
+    {
+        return NO_MIME_TYPE;
+    }
+
+    id = g_hash_table_lookup (builder->mime_type_ids, mime_type);
+    if (id == NULL)
+    {
+        id = GUINT_TO_POINTER (g_hash_table_size (builder->mime_type_ids) + 1);
+        g_hash_table_insert (builder->mime_type_ids, g_strdup (mime_type), id);
+        g_string_append_len (builder->mime_types, mime_type, strlen (mime_type) + 1);
+    }
+
+    return GPOINTER_TO_UINT (id) - 1;
+}
+
+static void
+index_builder_add_entry (IndexBuilder          *builder,
+                         NautilusFileNameIndex *index,
+                         guint32                parent,
+                         GFileInfo             *info)
+{
+    IndexEntry entry;
+    const char *name;
+
+    name = g_file_info_get_name (info);
+
+    entry.parent = parent;
+    entry.first_child = 0;
+    entry.n_children = 0;
+    entry.name = builder->names->len;
+    entry.mime_type = index_builder_add_mime_type (builder, g_file_info_get_attribute_string (info, G_FILE_ATTRIBUTE_STANDARD_FAST_CONTENT_TYPE));
+    entry.flags = get_flags (index, info);
+    entry.mtime = g_file_info_get_attribute_uint64 (info, G_FILE_ATTRIBUTE_TIME_MODIFIED);
+    entry.atime = g_file_info_get_attribute_uint64 (info, G_FILE_ATTRIBUTE_TIME_ACCESS);
+    entry.size = g_file_info_get_size (info);
+
+    g_string_append_len (builder->names, name, strlen (name) + 1);
+    g_array_append_val (builder->entries, entry);
+}
+
+static int
+compare_infos_by_name (gconstpointer a,
+                       gconstpointer b)
+{
+    GFileInfo *info_a = *(GFileInfo **) a;
+    GFileInfo *info_b = *(GFileInfo **) b;
+
+    return strcmp (g_file_info_get_name (info_a), g_file_info_get_name (info_b));
+}
+
+static void
+scan_directory_free (ScanDirectory *directory)
+{
+    g_object_unref (directory->location);
+    g_free (directory);
+}
+
+/* Walks the tree breadth first, so parents come before their children.
+ * It doesn't go into mounts below the root, and only once into each
+ * directory, so bind mounts can't make it loop. Returns FALSE if the
+ * tree has too many files.
+ */
+static gboolean
+scan_tree (NautilusFileNameIndex *index,
+           IndexBuilder          *builder)
+{
+    GQueue directories = G_QUEUE_INIT;
+    ScanDirectory *directory, *subdirectory;
+    GFileEnumerator *enumerator;
+    GFileInfo *root_info, *info;
+    GPtrArray *children;
+    GHashTable *visited;
+    IndexEntry *parent;
+    const char *id;
+    guint32 first_child, i;
+    gboolean too_big;
+
+    root_info = g_file_query_info (index->root, INDEX_ATTRIBUTES,
+                                   G_FILE_QUERY_INFO_NOFOLLOW_SYMLINKS, NULL, NULL);
+    if (root_info == NULL)
+    {
+        return FALSE;
+    }
+
+    index->device = g_file_info_get_attribute_uint32 (root_info, G_FILE_ATTRIBUTE_UNIX_DEVICE);
+    index_builder_add_entry (builder, index, NO_ENTRY, root_info);
+
+    visited = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+    id = g_file_info_get_attribute_string (root_info, G_FILE_ATTRIBUTE_ID_FILE);
+    if (id != NULL)
+    {
+        g_hash_table_add (visited, g_strdup (id));
+    }
+
+    directory = g_new0 (ScanDirectory, 1);
+    directory->id = 0;
+    directory->location = g_object_ref (index->root);
+    g_queue_push_tail (&directories, directory);
+
+    too_big = FALSE;
+    children = g_ptr_array_new_with_free_func (g_object_unref);
+
+    while (!too_big && (directory = g_queue_pop_head (&directories)) != NULL)
+    {
+        enumerator = g_file_enumerate_children (directory->location, INDEX_ATTRIBUTES,
+                                                G_FILE_QUERY_INFO_NOFOLLOW_SYMLINKS,
+                                                NULL, NULL);
+        if (enumerator != NULL)
+        {
+            while ((info = g_file_enumerator_next_file (enumerator, NULL, NULL)) != NULL)
+            {
+                g_ptr_array_add (children, info);
+            }
+            g_object_unref (enumerator);
+        }
+
+        first_child = builder->entries->len;
+        if (first_child + children->len > MAX_INDEX_ENTRIES)
+        {
+            too_big = TRUE;
+        }
+        else
+        {
+            g_ptr_array_sort (children, compare_infos_by_name);
+
+            for (i = 0; i < children->len; i++)
+            {
+                info = g_ptr_array_index (children, i);
+                index_builder_add_entry (builder, index, directory->id, info);
+
+                if (g_file_info_get_file_type (info) != G_FILE_TYPE_DIRECTORY ||
+                    !is_on_root_device (index, info))
+                {
+                    continue;
+                }
+
+                id = g_file_info_get_attribute_string (info, G_FILE_ATTRIBUTE_ID_FILE);
+                if (id == NULL || g_hash_table_add (visited, g_strdup (id)))
+                {
+                    subdirectory = g_new0 (ScanDirectory, 1);
+                    subdirectory->id = first_child + i;
+                    subdirectory->location = g_file_get_child (directory->location,
+                                                               g_file_info_get_name (info));
+                    g_queue_push_tail (&directories, subdirectory);
+                }
+            }
+
+            parent = &g_array_index (builder->entries, IndexEntry, directory->id);
+            parent->first_child = first_child;
+            parent->n_children = children->len;
+        }
+
+        g_ptr_array_set_size (children, 0);
+        scan_directory_free (directory);
+    }
+
+    g_queue_free_full (&directories, (GDestroyNotify) scan_directory_free);
+    g_hash_table_destroy (visited);
+    g_ptr_array_unref (children);
+    g_object_unref (root_info);
+
+    return !too_big;
+}
+
+static gboolean
+write_index_file (NautilusFileNameIndex *index,
+                  IndexBuilder          *builder,
+                  gint64                 scan_time,
+                  const char            *path)
+{
+    IndexFileHeader header;
+    GFileOutputStream *stream;
+    GOutputStream *output;
+    GFile *file;
+    char *dirname, *temp_path;
+    gboolean success;
+
+    dirname = g_path_get_dirname (path);
+    if (g_mkdir_with_parents (dirname, 0700) != 0)
+    {
+        g_free (dirname);
+        return FALSE;
+    }
+    g_free (dirname);
+
+    header.magic = INDEX_FILE_MAGIC;
+    header.version = INDEX_FILE_VERSION;
+    header.entry_size = sizeof (IndexEntry);
+    header.n_entries = builder->entries->len;
+    header.names_size = builder->names->len;
+    header.n_mime_types = g_hash_table_size (builder->mime_type_ids);
+    header.mime_types_size = builder->mime_types->len;
+    header.root_size = strlen (index->root_path) + 1;
+    header.scan_time = scan_time;
+
+    /* Written next to the index and renamed over it once complete, so
+     * searches mapping the old one are not disturbed.
+     */
+    temp_path = g_strconcat (path, ".new", NULL);
+    file = g_file_new_for_path (temp_path);
+    stream = g_file_replace (file, NULL, FALSE, G_FILE_CREATE_PRIVATE, NULL, NULL);
+    g_object_unref (file);
+    if (stream == NULL)
+    {
+        g_free (temp_path);
+        return FALSE;
+    }
+
+    output = G_OUTPUT_STREAM (stream);
+    success = g_output_stream_write_all (output, &header, sizeof (header), NULL, NULL, NULL) &&
+              g_output_stream_write_all (output, builder->entries->data,
+                                         (gsize) builder->entries->len * sizeof (IndexEntry),
+                                         NULL, NULL, NULL) &&
+              g_output_stream_write_all (output, builder->names->str, builder->names->len,
+                                         NULL, NULL, NULL) &&
+              g_output_stream_write_all (output, builder->mime_types->str, builder->mime_types->len,
+                                         NULL, NULL, NULL) &&
+              g_output_stream_write_all (output, index->root_path, header.root_size,
+                                         NULL, NULL, NULL);
+    success = g_output_stream_close (output, NULL, NULL) && success;
+    g_object_unref (stream);
+
+    if (success)
+    {
+        success = g_rename (temp_path, path) == 0;
+    }
+    if (!success)
+    {
+        g_unlink (temp_path);
+    }
+    g_free (temp_path);
+
+    return success;
+}
+
+static IndexSnapshot *
+load_index_file (NautilusFileNameIndex *index,
+                 const char            *path)
+{
+    IndexSnapshot *snapshot;
+    GMappedFile *file;
+
+    file = g_mapped_file_new (path, FALSE, NULL);
+    if (file == NULL)
+    {
+        return NULL;
+    }
+
+    snapshot = index_snapshot_new (file, index->root_path);
+    g_mapped_file_unref (file);
+
+    return snapshot;
+}
+
+/* Lock index->mutex when calling this. */
+static void
+set_snapshot (NautilusFileNameIndex *index,
+              IndexSnapshot         *snapshot)
+{
+    if (index->snapshot != NULL)
+    {
+        index_snapshot_unref (index->snapshot);
+    }
+    index->snapshot = snapshot;
+}
+
+static void
+run_scan (NautilusFileNameIndex *index)
+{
+    IndexBuilder builder;
+    IndexSnapshot *snapshot;
+    gint64 scan_time;
+    char *path;
+
+    DEBUG ("Scanning %s for the file name index", index->root_path);
+
+    builder.entries = g_array_new (FALSE, FALSE, sizeof (IndexEntry));
+    builder.names = g_string_new (NULL);
+    builder.mime_type_ids = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+    builder.mime_types = g_string_new (NULL);
+
+    scan_time = g_get_real_time () / G_USEC_PER_SEC;
+    path = get_index_file_path (index);
+    snapshot = NULL;
+
+    if (scan_tree (index, &builder) &&
+        write_index_file (index, &builder, scan_time, path))
+    {
+        snapshot = load_index_file (index, path);
+    }
+
+    g_array_free (builder.entries, TRUE);
+    g_string_free (builder.names, TRUE);
+    g_hash_table_destroy (builder.mime_type_ids);
+    g_string_free (builder.mime_types, TRUE);
+    g_free (path);
+
+    DEBUG ("Scanned %s, %u entries", index->root_path,
+           snapshot != NULL ? snapshot->n_entries : 0);
+
+    g_mutex_lock (&index->mutex);
+
+    /* Changes are applied by this thread too, so all of those applied
+     * so far happened before the scan and it saw them.
+     */
+    if (snapshot != NULL)
+    {
+        set_snapshot (index, snapshot);
+        g_hash_table_remove_all (index->changes);
+        index->scanned = TRUE;
+    }
+    index->scan_pending = FALSE;
+
+    g_mutex_unlock (&index->mutex);
+}
+
+/* The index file is used until the tree is scanned again, which only
+ * happens here and when too many changes piled up. In between, the
+ * index follows the changes reported through the file changes queue,
+ * by Nautilus itself and by the monitors of the folders it shows.
+ */
+static void
+run_load (NautilusFileNameIndex *index)
+{
+    IndexSnapshot *snapshot;
+    GFileInfo *info;
+    char *path;
+
+    /* Changes can come before the scan. */
+    info = g_file_query_info (index->root, G_FILE_ATTRIBUTE_UNIX_DEVICE,
+                              G_FILE_QUERY_INFO_NOFOLLOW_SYMLINKS, NULL, NULL);
+    if (info != NULL)
+    {
+        index->device = g_file_info_get_attribute_uint32 (info, G_FILE_ATTRIBUTE_UNIX_DEVICE);
+        g_object_unref (info);
+    }
+
+    path = get_index_file_path (index);
+    snapshot = load_index_file (index, path);
+    g_free (path);
+
+    g_mutex_lock (&index->mutex);
+
+    if (snapshot != NULL)
+    {
+        set_snapshot (index, snapshot);
+    }
+    schedule_scan (index);
+
+    g_mutex_unlock (&index->mutex);
+}
+
+static void
+run_unload (NautilusFileNameIndex *index)
+{
+    g_mutex_lock (&index->mutex);
+    set_snapshot (index, NULL);
+    g_hash_table_remove_all (index->changes);
+    index->scanned = FALSE;
+    g_mutex_unlock (&index->mutex);
+}
+
+/* Lock index->mutex when calling this. */
+static void
+add_change (NautilusFileNameIndex *index,
+            IndexChange           *change)
+{
+    IndexChange *old;
+
+    old = g_hash_table_lookup (index->changes, change->path);
+    if (old != NULL)
+    {
+        change->replaces_subtree |= old->replaces_subtree;
+    }
+
+    g_hash_table_replace (index->changes, change->path, change);
+
+    if (g_hash_table_size (index->changes) > MAX_CHANGES)
+    {
+        schedule_scan (index);
+    }
+}
+
+static void
+remove_path (NautilusFileNameIndex *index,
+             const char            *path)
+{
+    GHashTableIter iter;
+    IndexChange *change;
+    gsize length;
+
+    length = strlen (path);
+
+    g_mutex_lock (&index->mutex);
+
+    g_hash_table_iter_init (&iter, index->changes);
+    while (g_hash_table_iter_next (&iter, NULL, (gpointer *) &change))
+    {
+        if (strncmp (change->path, path, length) == 0 && change->path[length] == '/')
+        {
+            g_hash_table_iter_remove (&iter);
+        }
+    }
+
+    change = g_new0 (IndexChange, 1);
+    change->path = g_strdup (path);
+    change->exists = FALSE;
+    change->replaces_subtree = TRUE;
+    add_change (index, change);
+
+    g_mutex_unlock (&index->mutex);
+}
+
+static void
+update_path (NautilusFileNameIndex *index,
+             const char            *path,
+             GFileInfo             *info)
+{
+    IndexChange *change;
+
+    change = g_new0 (IndexChange, 1);
+    change->path = g_strdup (path);
+    change->exists = TRUE;
+    change->flags = get_flags (index, info);
+    change->mime_type = g_strdup (g_file_info_get_attribute_string (info, G_FILE_ATTRIBUTE_STANDARD_FAST_CONTENT_TYPE));
+    change->mtime = g_file_info_get_attribute_uint64 (info, G_FILE_ATTRIBUTE_TIME_MODIFIED);
+    change->atime = g_file_info_get_attribute_uint64 (info, G_FILE_ATTRIBUTE_TIME_ACCESS);
+    change->size = g_file_info_get_size (info);
+
+    g_mutex_lock (&index->mutex);
+    add_change (index, change);
+    g_mutex_unlock (&index->mutex);
+}
+
+static gboolean
+is_scan_pending (NautilusFileNameIndex *index)
+{
+    gboolean scan_pending;
+
+    g_mutex_lock (&index->mutex);
+    scan_pending = index->scan_pending;
+    g_mutex_unlock (&index->mutex);
+
+    return scan_pending;
+}
+
+/* Adds everything below a new directory, until a scan is due anyway. */
+static void
+update_tree (NautilusFileNameIndex *index,
+             GFile                 *location)
+{
+    GQueue directories = G_QUEUE_INIT;
+    GFileEnumerator *enumerator;
+    GFileInfo *info;
+    GFile *directory, *child;
+    char *child_path;
+
+    g_queue_push_tail (&directories, g_object_ref (location));
+
+    while (!is_scan_pending (index) &&
+           (directory = g_queue_pop_head (&directories)) != NULL)
+    {
+        enumerator = g_file_enumerate_children (directory, INDEX_ATTRIBUTES,
+                                                G_FILE_QUERY_INFO_NOFOLLOW_SYMLINKS,
+                                                NULL, NULL);
+        while (enumerator != NULL &&
+               (info = g_file_enumerator_next_file (enumerator, NULL, NULL)) != NULL)
+        {
+            child = g_file_get_child (directory, g_file_info_get_name (info));
+            child_path = g_file_get_relative_path (index->root, child);
+            update_path (index, child_path, info);
+            g_free (child_path);
+
+            if (g_file_info_get_file_type (info) == G_FILE_TYPE_DIRECTORY &&
+                is_on_root_device (index, info))
+            {
+                g_queue_push_tail (&directories, child);
+            }
+            else
+            {
+                g_object_unref (child);
+            }
+            g_object_unref (info);
+        }
+
+        g_clear_object (&enumerator);
+        g_object_unref (directory);
+    }
+
+    g_queue_free_full (&directories, g_object_unref);
+}
+
+static void
+run_update (NautilusFileNameIndex *index,
+            GFile                 *location,
+            gboolean               recursive)
+{
+    GFileInfo *info;
+    char *path;
+
+    path = g_file_get_relative_path (index->root, location);
+    if (path == NULL)
+    {
+        return;
+    }
+
+    info = g_file_query_info (location, INDEX_ATTRIBUTES,
+                              G_FILE_QUERY_INFO_NOFOLLOW_SYMLINKS, NULL, NULL);
+    if (info == NULL)
+    {
+        remove_path (index, path);
+    }
+    else
+    {
+        update_path (index, path, info);
+        if (recursive && g_file_info_get_file_type (info) == G_FILE_TYPE_DIRECTORY &&
+            is_on_root_device (index, info))
+        {
+            update_tree (index, location);
+        }
+        g_object_unref (info);
+    }
+
+    g_free (path);
+}
+
+static void
+run_remove (NautilusFileNameIndex *index,
+            GFile                 *location)
+{
+    char *path;
+
+    path = g_file_get_relative_path (index->root, location);
+    if (path != NULL)
+    {
+        remove_path (index, path);
+        g_free (path);
+    }
+}
+
+static void
+index_job_func (gpointer data,
+                gpointer user_data)
+{
+    IndexJob *job = data;
+
+    switch (job->kind)
+    {
+        case INDEX_JOB_LOAD:
+        {
+            run_load (job->index);
+        }
+        break;
+
+        case INDEX_JOB_SCAN:
+        {
+            run_scan (job->index);
+        }
+        break;
+
+        case INDEX_JOB_UPDATE:
+        case INDEX_JOB_UPDATE_TREE:
+        {
+            run_update (job->index, job->location,
+                        job->kind == INDEX_JOB_UPDATE_TREE);
+        }
+        break;
+
+        case INDEX_JOB_REMOVE:
+        {
+            run_remove (job->index, job->location);
+        }
+        break;
+
+        case INDEX_JOB_UNLOAD:
+        {
+            run_unload (job->index);
+        }
+        break;
+    }
+
+    g_clear_object (&job->location);
+    g_free (job);
+}
+
+/* Lock indexes_mutex when calling this. */
+static NautilusFileNameIndex *
+find_index (GFile *location)
+{
+    NautilusFileNameIndex *index;
+    GList *l;
+
+    for (l = indexes; l != NULL; l = l->next)
+    {
+        index = l->data;
+        if (g_file_equal (index->root, location) ||
+            g_file_has_prefix (location, index->root))
+        {
+            return index;
+        }
+    }
+
+    return NULL;
+}
+
+/* Returns the root of the index @location would be in, or NULL if it
+ * isn't indexed. Only the home directory is, as a whole.
+ */
+static GFile *
+get_index_root (GFile *location)
+{
+    GFile *home;
+
+    home = g_file_new_for_path (g_get_home_dir ());
+    if (g_file_equal (location, home) || g_file_has_prefix (location, home))
+    {
+        return home;
+    }
+
+    g_object_unref (home);
+
+    return NULL;
+}
+
+NautilusFileNameIndex *
+nautilus_file_name_index_lookup (GFile *location)
+{
+    NautilusFileNameIndex *index;
+
+    if (!g_file_is_native (location))
+    {
+        return NULL;
+    }
+
+    g_mutex_lock (&indexes_mutex);
+
+    index = find_index (location);
+    if (index != NULL && index->active)
+    {
+        index->last_used = g_get_monotonic_time ();
+    }
+    else
+    {
+        index = NULL;
+    }
+
+    g_mutex_unlock (&indexes_mutex);
+
+    return index;
+}
+
+void
+nautilus_file_name_index_prepare (GFile *location)
+{
+    NautilusFileNameIndex *index;
+    GFile *root;
+
+    if (!g_file_is_native (location))
+    {
+        return;
+    }
+
+    root = get_index_root (location);
+    if (root == NULL)
+    {
+        return;
+    }
+
+    g_mutex_lock (&indexes_mutex);
+
+    if (index_pool == NULL)
+    {
+        index_pool = g_thread_pool_new (index_job_func, NULL, 1, FALSE, NULL);
+    }
+
+    index = find_index (root);
+    if (index == NULL)
+    {
+        index = file_name_index_new (root);
+        indexes = g_list_prepend (indexes, index);
+    }
+
+    if (!index->active)
+    {
+        DEBUG ("Loading the file name index of %s", index->root_path);
+
+        index->active = TRUE;
+        push_job (index, INDEX_JOB_LOAD, NULL);
+    }
+    index->last_used = g_get_monotonic_time ();
+
+    g_mutex_unlock (&indexes_mutex);
+
+    g_object_unref (root);
+}
+
+gboolean
+nautilus_file_name_index_is_ready (NautilusFileNameIndex *index)
+{
+    gboolean ready;
+
+    g_mutex_lock (&index->mutex);
+    ready = index->snapshot != NULL && index->scanned;
+    g_mutex_unlock (&index->mutex);
+
+    return ready;
+}
+
+/* Lock index->mutex when calling this. */
+static guint32
+get_path_flags (NautilusFileNameIndex *index,
+                const char            *path)
+{
+    IndexChange *change;
+    guint32 id;
+
+    change = g_hash_table_lookup (index->changes, path);
+    if (change != NULL)
+    {
+        return change->exists ? change->flags : 0;
+    }
+
+    id = index_snapshot_lookup (index->snapshot, path);
+
+    return id != NO_ENTRY ? index->snapshot->entries[id].flags : 0;
+}
+
+gboolean
+nautilus_file_name_index_covers (NautilusFileNameIndex *index,
+                                 GFile                 *location)
+{
+    char *path, *p;
+    gboolean covers;
+
+    if (g_file_equal (location, index->root))
+    {
+        path = g_strdup ("");
+    }
+    else
+    {
+        path = g_file_get_relative_path (index->root, location);
+        if (path == NULL)
+        {
+            return FALSE;
+        }
+    }
+
+    g_mutex_lock (&index->mutex);
+
+    covers = index->snapshot != NULL;
+
+    /* The location and each folder above it, below the root. */
+    for (p = path; covers && *p != '\0'; p++)
+    {
+        if (*p == '/')
+        {
+            *p = '\0';
+            covers = (get_path_flags (index, path) & ENTRY_IS_MOUNT_POINT) == 0;
+            *p = '/';
+        }
+    }
+    if (covers && *path != '\0')
+    {
+        covers = (get_path_flags (index, path) & ENTRY_IS_MOUNT_POINT) == 0;
+    }
+
+    g_mutex_unlock (&index->mutex);
+
+    g_free (path);
+
+    return covers;
+}
+
+/* What a search is looking for. */
+typedef struct
+{
+    NautilusFileNameIndex *index;
+    NautilusQueryMatcher *matcher;
+    NautilusQueryPredicate *predicate;
+    gboolean show_hidden;
+    gboolean recursive;
+    GList *hits;
+} IndexSearch;
+
+enum
+{
+    /* Removed since the scan, and everything below it with it. */
+    STATE_GONE = 1 << 0,
+    /* Changed since the scan, the change is used instead. */
+    STATE_REPLACED = 1 << 1,
+    /* Below the search location, and not in a hidden directory unless
+     * hidden files are shown.
+     */
+    STATE_IN_SCOPE = 1 << 2,
+};
+
+static void
+add_hit (IndexSearch *search,
+         const char  *path,
+         gdouble      match,
+         gint64       mtime)
+{
+    NautilusSearchHit *hit;
+    GDateTime *date;
+    GFile *location;
+    char *uri;
+
+    location = g_file_resolve_relative_path (search->index->root, path);
+    uri = g_file_get_uri (location);
+    hit = nautilus_search_hit_new (uri);
+    g_free (uri);
+    g_object_unref (location);
+
+    nautilus_search_hit_set_fts_rank (hit, match);
+    date = g_date_time_new_from_unix_local (mtime);
+    nautilus_search_hit_set_modification_time (hit, date);
+    g_date_time_unref (date);
+
+    search->hits = g_list_prepend (search->hits, hit);
+}
+
+static gdouble
+match_name (IndexSearch *search,
+            const char  *name,
+            guint32      flags)
+{
+    char *display_name;
+    gdouble match;
+
+    if ((flags & ENTRY_NEEDS_DISPLAY_NAME) == 0)
+    {
+        return nautilus_query_matcher_match (search->matcher, name);
+    }
+
+    display_name = g_filename_display_name (name);
+    match = nautilus_query_matcher_match (search->matcher, display_name);
+    g_free (display_name);
+
+    return match;
+}
+
+/* Whether some part of a path, relative to the search location, would
+ * have been skipped as hidden by a walk of the tree.
+ */
+static gboolean
+path_is_hidden (const char *path)
+{
+    const char *p;
+    gsize length;
+
+    for (p = path; *p != '\0'; p += length + (p[length] == '/' ? 1 : 0))
+    {
+        length = strcspn (p, "/");
+        if (p[0] == '.' || (length > 0 && p[length - 1] == '~'))
+        {
+            return TRUE;
+        }
+    }
+
+    return FALSE;
+}
+
+/* Lock index->mutex when calling this. Marks the entries of the
+ * snapshot that changed in state.
+ */
+static void
+search_changes (IndexSearch   *search,
+                IndexSnapshot *snapshot,
+                const char    *location_path,
+                guint8        *state)
+{
+    GHashTableIter iter;
+    IndexChange *change;
+    const char *below, *name;
+    gdouble match;
+    gsize length;
+    guint32 id;
+
+    length = strlen (location_path);
+
+    g_hash_table_iter_init (&iter, search->index->changes);
+    while (g_hash_table_iter_next (&iter, NULL, (gpointer *) &change))
+    {
+        if (snapshot != NULL)
+        {
+            id = index_snapshot_lookup (snapshot, change->path);
+            if (id != NO_ENTRY)
+            {
+                state[id] |= change->replaces_subtree ? STATE_GONE : STATE_REPLACED;
+            }
+        }
+
+        if (!change->exists)
+        {
+            continue;
+        }
+
+        if (length == 0)
+        {
+            below = change->path;
+        }
+        else if (strncmp (change->path, location_path, length) == 0 &&
+                 change->path[length] == '/')
+        {
+            below = change->path + length + 1;
+        }
+        else
+        {
+            continue;
+        }
+
+        if ((!search->recursive && strchr (below, '/') != NULL) ||
+            (!search->show_hidden && path_is_hidden (below)))
+        {
+            continue;
+        }
+
+        name = strrchr (change->path, '/');
+        name = name != NULL ? name + 1 : change->path;
+
+        if (!nautilus_query_predicate_matches_date (search->predicate, change->mtime, change->atime))
+        {
+            continue;
+        }
+
+        match = match_name (search, name, change->flags);
+        if (match > -1 &&
+            nautilus_query_predicate_matches_mime_type (search->predicate, change->mime_type))
+        {
+            add_hit (search, change->path, match, change->mtime);
+        }
+    }
+}
+
+static void
+search_snapshot (IndexSearch   *search,
+                 IndexSnapshot *snapshot,
+                 guint32        start,
+                 guint8        *state,
+                 GCancellable  *cancellable)
+{
+    const IndexEntry *entry;
+    gboolean *mime_type_matches;
+    gdouble match;
+    guint32 id, end;
+    char *path;
+
+    if (snapshot->entries[start].n_children == 0)
+    {
+        return;
+    }
+
+    /* Removing the location or anything above it removes everything. */
+    for (id = start; id != NO_ENTRY; id = snapshot->entries[id].parent)
+    {
+        if (state[id] & STATE_GONE)
+        {
+            return;
+        }
+    }
+
+    mime_type_matches = NULL;
+    if (nautilus_query_predicate_has_mime_types (search->predicate))
+    {
+        mime_type_matches = g_new0 (gboolean, MAX (snapshot->n_mime_types, 1));
+        for (id = 0; id < snapshot->n_mime_types; id++)
+        {
+            mime_type_matches[id] = nautilus_query_predicate_matches_mime_type (search->predicate,
+                                                                                snapshot->mime_types[id]);
+        }
+    }
+
+    /* Parents come before their children, so everything below the
+     * location is after its first child, and the state of the parent
+     * is known by the time a child is looked at.
+     */
+    state[start] |= STATE_IN_SCOPE;
+    id = snapshot->entries[start].first_child;
+    end = search->recursive ? snapshot->n_entries : id + snapshot->entries[start].n_children;
+
+    for (; id < end; id++)
+    {
+        if (id % CANCEL_CHECK_INTERVAL == 0 && g_cancellable_is_cancelled (cancellable))
+        {
+            break;
+        }
+
+        entry = &snapshot->entries[id];
+        state[id] |= state[entry->parent] & STATE_GONE;
+
+        if ((state[entry->parent] & STATE_IN_SCOPE) == 0 ||
+            (state[id] & STATE_GONE) != 0 ||
+            (!search->show_hidden && (entry->flags & ENTRY_IS_HIDDEN) != 0))
+        {
+            continue;
+        }
+
+        state[id] |= STATE_IN_SCOPE;
+
+        if ((state[id] & STATE_REPLACED) != 0)
+        {
+            continue;
+        }
+
+        /* Cheapest checks first. */
+        if ((mime_type_matches != NULL &&
+             (entry->mime_type == NO_MIME_TYPE || !mime_type_matches[entry->mime_type])) ||
+            !nautilus_query_predicate_matches_date (search->predicate, entry->mtime, entry->atime))
+        {
+            continue;
+        }
+
+        match = match_name (search, snapshot->names + entry->name, entry->flags);
+        if (match > -1)
+        {
+            path = index_snapshot_get_path (snapshot, id);
+            add_hit (search, path, match, entry->mtime);
+            g_free (path);
+        }
+    }
+
+    g_free (mime_type_matches);
+}
+
+GList *
+nautilus_file_name_index_search (NautilusFileNameIndex *index,
+                                 NautilusQuery         *query,
+                                 GCancellable          *cancellable)
+{
+    IndexSearch search;
+    IndexSnapshot *snapshot;
+    GFile *location;
+    char *location_path;
+    guint8 *state;
+    guint32 start;
+
+    location = nautilus_query_get_location (query);
+    if (g_file_equal (location, index->root))
+    {
+        location_path = g_strdup ("");
+    }
+    else
+    {
+        location_path = g_file_get_relative_path (index->root, location);
+    }
+    g_object_unref (location);
+
+    if (location_path == NULL)
+    {
+        return NULL;
+    }
+
+    search.index = index;
+    search.matcher = nautilus_query_get_matcher (query);
+    search.predicate = nautilus_query_predicate_new (query);
+    search.show_hidden = nautilus_query_get_show_hidden_files (query);
+    search.recursive = nautilus_query_get_recursive (query);
+    search.hits = NULL;
+
+    g_mutex_lock (&index->mutex);
+
+    snapshot = index->snapshot != NULL ? index_snapshot_ref (index->snapshot) : NULL;
+    state = snapshot != NULL ? g_malloc0 (snapshot->n_entries) : NULL;
+    search_changes (&search, snapshot, location_path, state);
+
+    g_mutex_unlock (&index->mutex);
+
+    /* The snapshot doesn't change, no need to keep others waiting. */
+    if (snapshot != NULL)
+    {
+        start = index_snapshot_lookup (snapshot, location_path);
+        if (start != NO_ENTRY)
+        {
+            search_snapshot (&search, snapshot, start, state, cancellable);
+        }
+
+        g_free (state);
+        index_snapshot_unref (snapshot);
+    }
+
+    g_free (location_path);
+    nautilus_query_matcher_unref (search.matcher);
+    nautilus_query_predicate_free (search.predicate);
+
+    return search.hits;
+}
+
+static void
+push_change (GFile        *location,
+             IndexJobKind  kind)
+{
+    NautilusFileNameIndex *index;
+
+    g_mutex_lock (&indexes_mutex);
+
+    index = find_index (location);
+    if (index != NULL && index->active)
+    {
+        if (g_get_monotonic_time () - index->last_used > MAX_UNUSED_SECS * G_USEC_PER_SEC)
+        {
+            DEBUG ("Unloading the unused file name index of %s", index->root_path);
+
+            index->active = FALSE;
+            push_job (index, INDEX_JOB_UNLOAD, NULL);
+        }
+        else
+        {
+            push_job (index, kind, location);
+        }
+    }
+
+    g_mutex_unlock (&indexes_mutex);
+}
+
+void
+nautilus_file_name_index_file_added (GFile *location)
+{
+    push_change (location, INDEX_JOB_UPDATE_TREE);
+}
+
+void
+nautilus_file_name_index_file_changed (GFile *location)
+{
+    push_change (location, INDEX_JOB_UPDATE);
+}
+
+void
+nautilus_file_name_index_file_removed (GFile *location)
+{
+    push_change (location, INDEX_JOB_REMOVE);
+}
+
+void
+nautilus_file_name_index_file_moved (GFile *from,
+                                     GFile *to)
+{
+    push_change (from, INDEX_JOB_REMOVE);
+    push_change (to, INDEX_JOB_UPDATE_TREE);
+}
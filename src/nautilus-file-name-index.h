@@ -0,0 +1,71 @@
+/*
+   nautilus-file-name-index.h: Names of local files, kept on disk so
+   searches don't have to walk the tree.
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of the
+   License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public
+   License along with this program; if not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef NAUTILUS_FILE_NAME_INDEX_H
+#define NAUTILUS_FILE_NAME_INDEX_H
+
+#include <gio/gio.h>
+#include "nautilus-query.h"
+
+/* An index covers one root, only the home directory for now, without
+ * the mounts below it. It is a scan of the tree mapped from disk, with
+ * the changes reported through the file changes queue since then on
+ * top, see nautilus-file-changes-queue.c. The tree is scanned again in
+ * the background when the index is loaded, and when too many changes
+ * piled up.
+ *
+ * Indexes nobody searched with for a while are unloaded, but never
+ * freed. All of these can be called from any thread.
+ */
+typedef struct NautilusFileNameIndex NautilusFileNameIndex;
+
+/* Returns the loaded index @location is in, or NULL. Doesn't make or
+ * load one, so it is cheap enough for the main thread.
+ */
+NautilusFileNameIndex *nautilus_file_name_index_lookup       (GFile                 *location);
+
+/* Starts loading the index @location would be in, in the background,
+ * if there is one for it.
+ */
+void                   nautilus_file_name_index_prepare      (GFile                 *location);
+
+/* Whether the index was scanned since it was loaded, and only missed
+ * changes made by other programs in folders Nautilus doesn't show.
+ */
+gboolean               nautilus_file_name_index_is_ready     (NautilusFileNameIndex *index);
+
+/* Whether @location has a snapshot to search, and isn't in a mount
+ * below the root.
+ */
+gboolean               nautilus_file_name_index_covers       (NautilusFileNameIndex *index,
+							      GFile                 *location);
+
+/* Returns the NautilusSearchHits for @query, which has to be in the
+ * root of the index.
+ */
+GList *                nautilus_file_name_index_search       (NautilusFileNameIndex *index,
+							      NautilusQuery         *query,
+							      GCancellable          *cancellable);
+
+void                   nautilus_file_name_index_file_added   (GFile                 *location);
+void                   nautilus_file_name_index_file_changed (GFile                 *location);
+void                   nautilus_file_name_index_file_removed (GFile                 *location);
+void                   nautilus_file_name_index_file_moved   (GFile                 *from,
+							      GFile                 *to);
+
+#endif /* NAUTILUS_FILE_NAME_INDEX_H */
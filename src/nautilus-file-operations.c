@@ -31,6 +31,16 @@
 #include <unistd.h>
 #include <sys/types.h>
 #include <stdlib.h>
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#ifdef __linux__
+#include <sys/ioctl.h>
+#include <sys/sendfile.h>
+#include <sys/syscall.h>
+#include <linux/fs.h>
+#endif
 
 #include "nautilus-file-operations.h"
 
@@ -58,6 +68,7 @@
 #include "nautilus-link.h"
 #include "nautilus-trash-monitor.h"
 #include "nautilus-file-utilities.h"
+#include "nautilus-inode-set.h"
 #include "nautilus-file-undo-operations.h"
 #include "nautilus-file-undo-manager.h"
 
@@ -81,6 +92,8 @@ typedef struct
     gboolean delete_all;
 } CommonJob;
 
+typedef struct CopyPool CopyPool;
+
 typedef struct
 {
     CommonJob common;
@@ -95,6 +108,7 @@ typedef struct
     gchar *target_name;
     NautilusCopyCallback done_callback;
     gpointer done_callback_data;
+    CopyPool *copy_pool;
 } CopyMoveJob;
 
 typedef struct
@@ -163,12 +177,18 @@ typedef enum
     OP_KIND_COMPRESS
 } OpKind;
 
+typedef struct SourceScanner SourceScanner;
+
 typedef struct
 {
     int num_files;
     goffset num_bytes;
     int num_files_since_progress;
     OpKind op;
+    /* Set while the sources are still counted in the background, the
+     * totals only grow until then.
+     */
+    SourceScanner *scanner;
 } SourceInfo;
 
 typedef struct
@@ -255,6 +275,14 @@ static void scan_sources (GList      *files,
                           SourceInfo *source_info,
                           CommonJob  *job,
                           OpKind      kind);
+static void scan_sources_in_background (GList      *files,
+                                        SourceInfo *source_info,
+                                        CommonJob  *job,
+                                        OpKind      kind);
+static gboolean source_info_update (SourceInfo *source_info);
+static gboolean source_info_finish (SourceInfo   *source_info,
+                                    TransferInfo *transfer_info);
+static void source_info_clear (SourceInfo *source_info);
 
 
 static void empty_trash_thread_func (GTask        *task,
@@ -1617,12 +1645,15 @@ report_delete_progress (CommonJob    *job,
     double elapsed, transfer_rate;
     int remaining_time;
     gint64 now;
+    gboolean counting;
     char *details;
     char *status;
     DeleteJob *delete_job;
 
     delete_job = (DeleteJob *) job;
     now = g_get_monotonic_time ();
+    source_info_update (source_info);
+    counting = source_info->scanner != NULL;
     files_left = source_info->num_files - transfer_info->num_files;
 
     /* Races and whatnot could cause this to be negative... */
@@ -1631,6 +1662,12 @@ report_delete_progress (CommonJob    *job,
         files_left = 0;
     }
 
+    /* ...and while the sources are still counted there are more to come */
+    if (counting && files_left == 0)
+    {
+        files_left = 1;
+    }
+
     /* If the number of files left is 0, we want to update the status without
      * considering this time, since we want to change the status to completed
      * and probably we won't get more calls to this function */
@@ -1691,7 +1728,8 @@ report_delete_progress (CommonJob    *job,
         }
     }
 
-    if (elapsed < SECONDS_NEEDED_FOR_RELIABLE_TRANSFER_RATE)
+    /* There is no telling how long it takes without the total */
+    if (counting || elapsed < SECONDS_NEEDED_FOR_RELIABLE_TRANSFER_RATE)
     {
         if (files_left > 0)
         {
@@ -1752,6 +1790,12 @@ report_delete_progress (CommonJob    *job,
     }
     nautilus_progress_info_take_details (job->progress, details);
 
+    if (counting)
+    {
+        nautilus_progress_info_pulse_progress (job->progress);
+        return;
+    }
+
     if (elapsed > SECONDS_NEEDED_FOR_APROXIMATE_TRANSFER_RATE)
     {
         nautilus_progress_info_set_remaining_time (job->progress,
@@ -1935,6 +1979,295 @@ file_deleted_callback (GFile    *file,
     }
 }
 
+/* Local trees are deleted with unlinkat() relative to open directories,
+ * instead of a GFile and a lookup of the whole path per file, and the
+ * folders right in a deleted one are deleted by several threads at
+ * once. Anything the threads fail to delete is left for the GIO path,
+ * which asks about errors. Only folders are told about as they go, so
+ * views of them don't stay around, files go with their folder.
+ */
+#define NATIVE_DELETE_MAX_THREADS 4
+
+typedef struct
+{
+    DeleteData *data;
+    GThreadPool *threads;
+
+    GMutex mutex;
+    GCond cond;
+    guint n_pending;
+    gboolean failed;
+
+    /* Deleted so far, and how many of those are in the transfer info */
+    gint num_files;
+    gint num_files_reported;
+} NativeDelete;
+
+typedef struct
+{
+    GFile *parent;
+    int parent_fd;
+    char *name;
+} NativeDeleteSubtree;
+
+static gboolean native_delete_dir_at (NativeDelete *native,
+                                      GFile        *parent,
+                                      int           parent_fd,
+                                      const char   *name);
+
+/* Job thread only. */
+static void
+native_delete_report (NativeDelete *native)
+{
+    gint num_files;
+
+    num_files = g_atomic_int_get (&native->num_files);
+    native->data->transfer_info->num_files += num_files - native->num_files_reported;
+    native->num_files_reported = num_files;
+
+    report_delete_progress (native->data->job,
+                            native->data->source_info,
+                            native->data->transfer_info);
+}
+
+static void
+native_delete_thread_func (gpointer data,
+                           gpointer user_data)
+{
+    NativeDeleteSubtree *subtree;
+    NativeDelete *native;
+    gboolean success;
+
+    subtree = data;
+    native = user_data;
+
+    success = native_delete_dir_at (native, subtree->parent, subtree->parent_fd, subtree->name);
+
+    g_mutex_lock (&native->mutex);
+    if (!success)
+    {
+        native->failed = TRUE;
+    }
+    native->n_pending--;
+    g_cond_signal (&native->cond);
+    g_mutex_unlock (&native->mutex);
+
+    g_object_unref (subtree->parent);
+    g_free (subtree->name);
+    g_free (subtree);
+}
+
+/* Deletes what is in the directory @location, and closes @fd. With
+ * @parallel set, on the job thread only, the directories in it are
+ * handed to the threads.
+ */
+static gboolean
+native_delete_contents (NativeDelete *native,
+                        GFile        *location,
+                        int           fd,
+                        gboolean      parallel)
+{
+    CommonJob *job;
+    DIR *dir;
+    struct dirent *entry;
+    NativeDeleteSubtree *subtree;
+    gboolean success;
+    int errsv;
+
+    job = native->data->job;
+
+    dir = fdopendir (fd);
+    if (dir == NULL)
+    {
+        close (fd);
+        return FALSE;
+    }
+
+    success = TRUE;
+    while (!job_aborted (job))
+    {
+        errno = 0;
+        entry = readdir (dir);
+        if (entry == NULL)
+        {
+            errsv = errno;
+            success = success && errsv == 0;
+            break;
+        }
+
+        if (strcmp (entry->d_name, ".") == 0 ||
+            strcmp (entry->d_name, "..") == 0)
+        {
+            continue;
+        }
+
+        if (entry->d_type == DT_DIR && parallel)
+        {
+            subtree = g_new (NativeDeleteSubtree, 1);
+            subtree->parent = g_object_ref (location);
+            subtree->parent_fd = dirfd (dir);
+            subtree->name = g_strdup (entry->d_name);
+
+            g_mutex_lock (&native->mutex);
+            native->n_pending++;
+            g_mutex_unlock (&native->mutex);
+
+            g_thread_pool_push (native->threads, subtree, NULL);
+        }
+        else if (entry->d_type == DT_DIR)
+        {
+            success = native_delete_dir_at (native, location, dirfd (dir), entry->d_name) && success;
+        }
+        else if (unlinkat (dirfd (dir), entry->d_name, 0) == 0)
+        {
+            g_atomic_int_inc (&native->num_files);
+        }
+        else if (errno == EISDIR || errno == EPERM)
+        {
+            /* No type from readdir(), so it may be a directory after all */
+            success = native_delete_dir_at (native, location, dirfd (dir), entry->d_name) && success;
+        }
+        else
+        {
+            success = FALSE;
+        }
+
+        if (parallel)
+        {
+            native_delete_report (native);
+        }
+    }
+
+    if (parallel)
+    {
+        /* The threads need the directory open until they are done */
+        g_mutex_lock (&native->mutex);
+        while (native->n_pending > 0)
+        {
+            g_cond_wait_until (&native->cond, &native->mutex,
+                               g_get_monotonic_time () + G_USEC_PER_SEC / 10);
+
+            g_mutex_unlock (&native->mutex);
+            native_delete_report (native);
+            g_mutex_lock (&native->mutex);
+        }
+        success = success && !native->failed;
+        native->failed = FALSE;
+        g_mutex_unlock (&native->mutex);
+    }
+
+    closedir (dir);
+
+    return success && !job_aborted (job);
+}
+
+static gboolean
+native_delete_dir_at (NativeDelete *native,
+                      GFile        *parent,
+                      int           parent_fd,
+                      const char   *name)
+{
+    g_autoptr (GFile) location = NULL;
+    int fd;
+
+    if (job_aborted (native->data->job))
+    {
+        return FALSE;
+    }
+
+    fd = openat (parent_fd, name, O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+    if (fd < 0)
+    {
+        return FALSE;
+    }
+
+    location = g_file_get_child (parent, name);
+    if (!native_delete_contents (native, location, fd, FALSE) ||
+        unlinkat (parent_fd, name, AT_REMOVEDIR) != 0)
+    {
+        return FALSE;
+    }
+
+    g_atomic_int_inc (&native->num_files);
+    nautilus_file_changes_queue_file_removed (location);
+
+    return TRUE;
+}
+
+/* Returns TRUE if @file is gone. Otherwise, what is left of it is for
+ * delete_file_recursively(), non-native files included.
+ */
+static gboolean
+native_delete_file (NativeDelete *native,
+                    GFile        *file)
+{
+    g_autofree char *path = NULL;
+    gboolean success;
+    gint num_files;
+    int fd;
+
+    /* GVfs mounts have paths too, but are better left to the backend
+     * than worked on through FUSE by several threads.
+     */
+    if (!g_file_is_native (file))
+    {
+        return FALSE;
+    }
+
+    path = g_file_get_path (file);
+    num_files = g_atomic_int_get (&native->num_files);
+    success = FALSE;
+    if (unlink (path) == 0)
+    {
+        success = TRUE;
+    }
+    else if (errno == EISDIR || errno == EPERM)
+    {
+        fd = open (path, O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+        success = fd >= 0 &&
+                  native_delete_contents (native, file, fd, TRUE) &&
+                  rmdir (path) == 0;
+    }
+
+    if (success)
+    {
+        g_atomic_int_inc (&native->num_files);
+    }
+    else if (g_atomic_int_get (&native->num_files) != num_files)
+    {
+        /* Its folders were told about, but its count changed too */
+        nautilus_file_changes_queue_file_changed (file);
+    }
+    native_delete_report (native);
+
+    return success;
+}
+
+static NativeDelete *
+native_delete_new (DeleteData *data)
+{
+    NativeDelete *native;
+
+    native = g_new0 (NativeDelete, 1);
+    native->data = data;
+    g_mutex_init (&native->mutex);
+    g_cond_init (&native->cond);
+    native->threads = g_thread_pool_new (native_delete_thread_func, native,
+                                         CLAMP (g_get_num_processors (), 2, NATIVE_DELETE_MAX_THREADS),
+                                         FALSE, NULL);
+
+    return native;
+}
+
+static void
+native_delete_free (NativeDelete *native)
+{
+    g_thread_pool_free (native->threads, FALSE, TRUE);
+    g_mutex_clear (&native->mutex);
+    g_cond_clear (&native->cond);
+    g_free (native);
+}
+
 static void
 delete_files (CommonJob *job,
               GList     *files,
@@ -1945,18 +2278,20 @@ delete_files (CommonJob *job,
     SourceInfo source_info;
     TransferInfo transfer_info;
     DeleteData data;
+    NativeDelete *native_delete;
 
     if (job_aborted (job))
     {
         return;
     }
 
-    scan_sources (files,
-                  &source_info,
-                  job,
-                  OP_KIND_DELETE);
+    scan_sources_in_background (files,
+                                &source_info,
+                                job,
+                                OP_KIND_DELETE);
     if (job_aborted (job))
     {
+        source_info_clear (&source_info);
         return;
     }
 
@@ -1969,6 +2304,8 @@ delete_files (CommonJob *job,
     data.source_info = &source_info;
     data.transfer_info = &transfer_info;
 
+    native_delete = native_delete_new (&data);
+
     for (l = files;
          l != NULL && !job_aborted (job);
          l = l->next)
@@ -1983,6 +2320,18 @@ delete_files (CommonJob *job,
             continue;
         }
 
+        /* Files in it go with it, its folders were told about already */
+        if (native_delete_file (native_delete, file))
+        {
+            nautilus_file_changes_queue_file_removed (file);
+            continue;
+        }
+
+        if (job_aborted (job))
+        {
+            break;
+        }
+
         success = delete_file_recursively (file, job->cancellable,
                                            file_deleted_callback,
                                            &data);
@@ -1992,6 +2341,15 @@ delete_files (CommonJob *job,
             (*files_skipped)++;
         }
     }
+
+    native_delete_free (native_delete);
+
+    if (!job_aborted (job) &&
+        source_info_finish (&source_info, &transfer_info))
+    {
+        report_delete_progress (job, &source_info, &transfer_info);
+    }
+    source_info_clear (&source_info);
 }
 
 static void
@@ -3090,12 +3448,41 @@ get_scan_primary (OpKind kind)
     }
 }
 
+/* Files are told apart by device and inode, so a file reached twice by
+ * overlapping sources is counted once.
+ */
+#define SCAN_ATTRIBUTES \
+    G_FILE_ATTRIBUTE_STANDARD_TYPE "," \
+    G_FILE_ATTRIBUTE_STANDARD_SIZE "," \
+    G_FILE_ATTRIBUTE_UNIX_DEVICE "," \
+    G_FILE_ATTRIBUTE_UNIX_INODE "," \
+    G_FILE_ATTRIBUTE_UNIX_NLINK
+
+/* Returns FALSE if the file was scanned already. Files with several
+ * hard links are always new, as the jobs copy or delete every link on
+ * its own. So are files without an inode, on most remote locations.
+ */
+static gboolean
+add_scanned_file (NautilusInodeSet *scanned,
+                  GFileInfo        *info)
+{
+    if (g_file_info_get_file_type (info) != G_FILE_TYPE_DIRECTORY &&
+        g_file_info_get_attribute_uint32 (info, G_FILE_ATTRIBUTE_UNIX_NLINK) > 1)
+    {
+        return TRUE;
+    }
+
+    return nautilus_inode_set_add (scanned,
+                                   g_file_info_get_attribute_uint32 (info, G_FILE_ATTRIBUTE_UNIX_DEVICE),
+                                   g_file_info_get_attribute_uint64 (info, G_FILE_ATTRIBUTE_UNIX_INODE));
+}
+
 static void
-scan_dir (GFile      *dir,
-          SourceInfo *source_info,
-          CommonJob  *job,
-          GQueue     *dirs,
-          GHashTable *scanned)
+scan_dir (GFile            *dir,
+          SourceInfo       *source_info,
+          CommonJob        *job,
+          GQueue           *dirs,
+          NautilusInodeSet *scanned)
 {
     GFileInfo *info;
     GError *error;
@@ -3111,8 +3498,7 @@ retry:
     error = NULL;
     enumerator = g_file_enumerate_children (dir,
                                             G_FILE_ATTRIBUTE_STANDARD_NAME ","
-                                            G_FILE_ATTRIBUTE_STANDARD_TYPE ","
-                                            G_FILE_ATTRIBUTE_STANDARD_SIZE,
+                                            SCAN_ATTRIBUTES,
                                             G_FILE_QUERY_INFO_NOFOLLOW_SYMLINKS,
                                             job->cancellable,
                                             &error);
@@ -3121,16 +3507,8 @@ retry:
         error = NULL;
         while ((info = g_file_enumerator_next_file (enumerator, job->cancellable, &error)) != NULL)
         {
-            g_autoptr (GFile) file = NULL;
-            g_autofree char *file_uri = NULL;
-
-            file = g_file_enumerator_get_child (enumerator, info);
-            file_uri = g_file_get_uri (file);
-
-            if (!g_hash_table_contains (scanned, file_uri))
+            if (add_scanned_file (scanned, info))
             {
-                g_hash_table_add (scanned, g_strdup (file_uri));
-
                 count_file (info, job, source_info);
 
                 if (g_file_info_get_file_type (info) == G_FILE_TYPE_DIRECTORY)
@@ -3266,10 +3644,10 @@ retry:
 }
 
 static void
-scan_file (GFile      *file,
-           SourceInfo *source_info,
-           CommonJob  *job,
-           GHashTable *scanned)
+scan_file (GFile            *file,
+           SourceInfo       *source_info,
+           CommonJob        *job,
+           NautilusInodeSet *scanned)
 {
     GFileInfo *info;
     GError *error;
@@ -3285,21 +3663,15 @@ scan_file (GFile      *file,
 retry:
     error = NULL;
     info = g_file_query_info (file,
-                              G_FILE_ATTRIBUTE_STANDARD_TYPE ","
-                              G_FILE_ATTRIBUTE_STANDARD_SIZE,
+                              SCAN_ATTRIBUTES,
                               G_FILE_QUERY_INFO_NOFOLLOW_SYMLINKS,
                               job->cancellable,
                               &error);
 
     if (info)
     {
-        g_autofree char *file_uri = NULL;
-
-        file_uri = g_file_get_uri (file);
-        if (!g_hash_table_contains (scanned, file_uri))
+        if (add_scanned_file (scanned, info))
         {
-            g_hash_table_add (scanned, g_strdup (file_uri));
-
             count_file (info, job, source_info);
 
             /* trashing operation doesn't recurse */
@@ -3394,15 +3766,12 @@ scan_sources (GList      *files,
 {
     GList *l;
     GFile *file;
-    g_autoptr (GHashTable) scanned = NULL;
+    NautilusInodeSet *scanned;
 
     memset (source_info, 0, sizeof (SourceInfo));
     source_info->op = kind;
 
-    scanned = g_hash_table_new_full (g_str_hash,
-                                     g_str_equal,
-                                     (GDestroyNotify) g_free,
-                                     NULL);
+    scanned = nautilus_inode_set_new ();
 
     report_preparing_count_progress (job, source_info);
 
@@ -3416,66 +3785,326 @@ scan_sources (GList      *files,
                    scanned);
     }
 
+    nautilus_inode_set_free (scanned);
+
     /* Make sure we report the final count */
     report_preparing_count_progress (job, source_info);
 }
 
-static void
-verify_destination (CommonJob  *job,
-                    GFile      *dest,
-                    char      **dest_fs_id,
-                    goffset     required_size)
+/* Sources that take longer than this to count are counted in the
+ * background, while the job already works on them.
+ */
+#define SCAN_SOURCES_WAIT_USEC (G_USEC_PER_SEC / 2)
+
+/* Counts sources in a thread of its own. It doesn't ask about errors,
+ * the job runs into the same ones and asks then.
+ */
+struct SourceScanner
 {
-    GFileInfo *info, *fsinfo;
-    GError *error;
-    guint64 free_size;
-    guint64 size_difference;
-    char *primary, *secondary, *details;
-    int response;
-    GFileType file_type;
-    gboolean dest_is_symlink = FALSE;
+    GList *files;
+    OpKind op;
+    GCancellable *cancellable;
+    GThread *thread;
 
-    if (dest_fs_id)
+    GMutex mutex;
+    GCond cond;
+    int num_files;
+    goffset num_bytes;
+    gboolean done;
+};
+
+static void
+source_scanner_publish (SourceScanner *scanner,
+                        int            num_files,
+                        goffset        num_bytes,
+                        gboolean       done)
+{
+    g_mutex_lock (&scanner->mutex);
+    scanner->num_files = num_files;
+    scanner->num_bytes = num_bytes;
+    scanner->done = done;
+    if (done)
     {
-        *dest_fs_id = NULL;
+        g_cond_signal (&scanner->cond);
     }
+    g_mutex_unlock (&scanner->mutex);
+}
 
-retry:
+static gpointer
+source_scanner_thread_func (gpointer user_data)
+{
+    SourceScanner *scanner;
+    NautilusInodeSet *scanned;
+    GFileEnumerator *enumerator;
+    GQueue dirs = G_QUEUE_INIT;
+    GFileInfo *info;
+    GFile *dir;
+    GList *l;
+    int num_files, num_files_since_publish;
+    goffset num_bytes;
 
-    error = NULL;
-    info = g_file_query_info (dest,
-                              G_FILE_ATTRIBUTE_STANDARD_TYPE ","
-                              G_FILE_ATTRIBUTE_ID_FILESYSTEM,
-                              dest_is_symlink ? G_FILE_QUERY_INFO_NONE : G_FILE_QUERY_INFO_NOFOLLOW_SYMLINKS,
-                              job->cancellable,
-                              &error);
+    scanner = user_data;
+    scanned = nautilus_inode_set_new ();
+    num_files = 0;
+    num_files_since_publish = 0;
+    num_bytes = 0;
 
-    if (info == NULL)
+    for (l = scanner->files;
+         l != NULL && !g_cancellable_is_cancelled (scanner->cancellable);
+         l = l->next)
     {
-        g_autofree gchar *basename = NULL;
-
-        if (IS_IO_ERROR (error, CANCELLED))
+        info = g_file_query_info (l->data,
+                                  SCAN_ATTRIBUTES,
+                                  G_FILE_QUERY_INFO_NOFOLLOW_SYMLINKS,
+                                  scanner->cancellable,
+                                  NULL);
+        if (info == NULL)
         {
-            g_error_free (error);
-            return;
+            continue;
         }
 
-        basename = get_basename (dest);
-        primary = g_strdup_printf (_("Error while copying to “%s”."), basename);
-        details = NULL;
-
-        if (IS_IO_ERROR (error, PERMISSION_DENIED))
+        if (add_scanned_file (scanned, info))
         {
-            secondary = g_strdup (_("You do not have permissions to access the destination folder."));
+            num_files++;
+            num_bytes += g_file_info_get_size (info);
+
+            /* trashing operation doesn't recurse */
+            if (g_file_info_get_file_type (info) == G_FILE_TYPE_DIRECTORY &&
+                scanner->op != OP_KIND_TRASH)
+            {
+                g_queue_push_head (&dirs, g_object_ref (l->data));
+            }
         }
-        else
+        g_object_unref (info);
+
+        if (num_files_since_publish++ > 100)
         {
-            secondary = g_strdup (_("There was an error getting information about the destination."));
-            details = error->message;
+            source_scanner_publish (scanner, num_files, num_bytes, FALSE);
+            num_files_since_publish = 0;
         }
 
-        response = run_error (job,
-                              primary,
+        while (!g_cancellable_is_cancelled (scanner->cancellable) &&
+               (dir = g_queue_pop_head (&dirs)) != NULL)
+        {
+            enumerator = g_file_enumerate_children (dir,
+                                                    G_FILE_ATTRIBUTE_STANDARD_NAME ","
+                                                    SCAN_ATTRIBUTES,
+                                                    G_FILE_QUERY_INFO_NOFOLLOW_SYMLINKS,
+                                                    scanner->cancellable,
+                                                    NULL);
+            if (enumerator != NULL)
+            {
+                while ((info = g_file_enumerator_next_file (enumerator, scanner->cancellable, NULL)) != NULL)
+                {
+                    if (add_scanned_file (scanned, info))
+                    {
+                        num_files++;
+                        num_bytes += g_file_info_get_size (info);
+
+                        if (g_file_info_get_file_type (info) == G_FILE_TYPE_DIRECTORY)
+                        {
+                            /* Push to head, since we want depth-first */
+                            g_queue_push_head (&dirs,
+                                               g_file_get_child (dir, g_file_info_get_name (info)));
+                        }
+                    }
+                    g_object_unref (info);
+
+                    if (num_files_since_publish++ > 100)
+                    {
+                        source_scanner_publish (scanner, num_files, num_bytes, FALSE);
+                        num_files_since_publish = 0;
+                    }
+                }
+                g_file_enumerator_close (enumerator, scanner->cancellable, NULL);
+                g_object_unref (enumerator);
+            }
+            g_object_unref (dir);
+        }
+    }
+
+    /* Free all from queue if we exited early */
+    g_queue_foreach (&dirs, (GFunc) g_object_unref, NULL);
+    g_queue_clear (&dirs);
+    nautilus_inode_set_free (scanned);
+
+    source_scanner_publish (scanner, num_files, num_bytes, TRUE);
+
+    return NULL;
+}
+
+static void
+source_scanner_free (SourceScanner *scanner)
+{
+    g_cancellable_cancel (scanner->cancellable);
+    g_thread_join (scanner->thread);
+
+    g_list_free_full (scanner->files, g_object_unref);
+    g_object_unref (scanner->cancellable);
+    g_mutex_clear (&scanner->mutex);
+    g_cond_clear (&scanner->cond);
+    g_free (scanner);
+}
+
+/* Like scan_sources(), but only waits a moment for the count. Sources
+ * that take longer are counted in the background while the job goes on,
+ * see source_info_update(). Either way, source_info_clear() has to be
+ * called when the job is done with @source_info.
+ */
+static void
+scan_sources_in_background (GList      *files,
+                            SourceInfo *source_info,
+                            CommonJob  *job,
+                            OpKind      kind)
+{
+    SourceScanner *scanner;
+    gint64 end_time;
+
+    memset (source_info, 0, sizeof (SourceInfo));
+    source_info->op = kind;
+
+    report_preparing_count_progress (job, source_info);
+
+    scanner = g_new0 (SourceScanner, 1);
+    scanner->files = g_list_copy_deep (files, (GCopyFunc) g_object_ref, NULL);
+    scanner->op = kind;
+    scanner->cancellable = g_cancellable_new ();
+    g_mutex_init (&scanner->mutex);
+    g_cond_init (&scanner->cond);
+    scanner->thread = g_thread_new ("nautilus-scan-sources",
+                                    source_scanner_thread_func,
+                                    scanner);
+
+    source_info->scanner = scanner;
+
+    end_time = g_get_monotonic_time () + SCAN_SOURCES_WAIT_USEC;
+    g_mutex_lock (&scanner->mutex);
+    while (!scanner->done &&
+           g_cond_wait_until (&scanner->cond, &scanner->mutex, end_time))
+    {
+    }
+    g_mutex_unlock (&scanner->mutex);
+
+    source_info_update (source_info);
+
+    report_preparing_count_progress (job, source_info);
+}
+
+/* Brings in the totals counted in the background so far. Returns TRUE
+ * only the one time they turn out to be final.
+ */
+static gboolean
+source_info_update (SourceInfo *source_info)
+{
+    SourceScanner *scanner;
+    gboolean done;
+
+    scanner = source_info->scanner;
+    if (scanner == NULL)
+    {
+        return FALSE;
+    }
+
+    g_mutex_lock (&scanner->mutex);
+    source_info->num_files = scanner->num_files;
+    source_info->num_bytes = scanner->num_bytes;
+    done = scanner->done;
+    g_mutex_unlock (&scanner->mutex);
+
+    if (done)
+    {
+        source_scanner_free (scanner);
+        source_info->scanner = NULL;
+    }
+
+    return done;
+}
+
+/* Called when the job got through all of the sources. If they are not
+ * all counted by then, what it got through is the total. Returns FALSE
+ * if the total was known already, TRUE if it has to be reported again.
+ */
+static gboolean
+source_info_finish (SourceInfo   *source_info,
+                    TransferInfo *transfer_info)
+{
+    if (source_info->scanner == NULL)
+    {
+        return FALSE;
+    }
+
+    if (!source_info_update (source_info))
+    {
+        source_info_clear (source_info);
+        source_info->num_files = transfer_info->num_files;
+        source_info->num_bytes = MAX (source_info->num_bytes, transfer_info->num_bytes);
+    }
+
+    return TRUE;
+}
+
+static void
+source_info_clear (SourceInfo *source_info)
+{
+    g_clear_pointer (&source_info->scanner, source_scanner_free);
+}
+
+static void
+verify_destination (CommonJob  *job,
+                    GFile      *dest,
+                    char      **dest_fs_id,
+                    goffset     required_size)
+{
+    GFileInfo *info, *fsinfo;
+    GError *error;
+    guint64 free_size;
+    guint64 size_difference;
+    char *primary, *secondary, *details;
+    int response;
+    GFileType file_type;
+    gboolean dest_is_symlink = FALSE;
+
+    if (dest_fs_id)
+    {
+        *dest_fs_id = NULL;
+    }
+
+retry:
+
+    error = NULL;
+    info = g_file_query_info (dest,
+                              G_FILE_ATTRIBUTE_STANDARD_TYPE ","
+                              G_FILE_ATTRIBUTE_ID_FILESYSTEM,
+                              dest_is_symlink ? G_FILE_QUERY_INFO_NONE : G_FILE_QUERY_INFO_NOFOLLOW_SYMLINKS,
+                              job->cancellable,
+                              &error);
+
+    if (info == NULL)
+    {
+        g_autofree gchar *basename = NULL;
+
+        if (IS_IO_ERROR (error, CANCELLED))
+        {
+            g_error_free (error);
+            return;
+        }
+
+        basename = get_basename (dest);
+        primary = g_strdup_printf (_("Error while copying to “%s”."), basename);
+        details = NULL;
+
+        if (IS_IO_ERROR (error, PERMISSION_DENIED))
+        {
+            secondary = g_strdup (_("You do not have permissions to access the destination folder."));
+        }
+        else
+        {
+            secondary = g_strdup (_("There was an error getting information about the destination."));
+            details = error->message;
+        }
+
+        response = run_error (job,
+                              primary,
                               secondary,
                               details,
                               FALSE,
@@ -3633,6 +4262,37 @@ retry:
     g_object_unref (fsinfo);
 }
 
+/* Sources counted in the background might not fit after all, see
+ * scan_sources_in_background().
+ */
+static void
+verify_remaining_space (CopyMoveJob  *copy_job,
+                        SourceInfo   *source_info,
+                        TransferInfo *transfer_info)
+{
+    GFile *dest;
+
+    if (source_info->num_bytes <= transfer_info->num_bytes)
+    {
+        return;
+    }
+
+    if (copy_job->destination != NULL)
+    {
+        dest = g_object_ref (copy_job->destination);
+    }
+    else
+    {
+        dest = g_file_get_parent (copy_job->files->data);
+    }
+
+    verify_destination ((CommonJob *) copy_job,
+                        dest,
+                        NULL,
+                        source_info->num_bytes - transfer_info->num_bytes);
+    g_object_unref (dest);
+}
+
 static void
 report_copy_progress (CopyMoveJob  *copy_job,
                       SourceInfo   *source_info,
@@ -3645,6 +4305,7 @@ report_copy_progress (CopyMoveJob  *copy_job,
     guint64 now;
     CommonJob *job;
     gboolean is_move;
+    gboolean counting;
     gchar *status;
     char *details;
     gchar *tmp;
@@ -3655,6 +4316,12 @@ report_copy_progress (CopyMoveJob  *copy_job,
 
     now = g_get_monotonic_time ();
 
+    if (source_info_update (source_info))
+    {
+        verify_remaining_space (copy_job, source_info, transfer_info);
+    }
+    counting = source_info->scanner != NULL;
+
     files_left = source_info->num_files - transfer_info->num_files;
 
     /* Races and whatnot could cause this to be negative... */
@@ -3663,6 +4330,12 @@ report_copy_progress (CopyMoveJob  *copy_job,
         files_left = 0;
     }
 
+    /* ...and while the sources are still counted there are more to come */
+    if (counting && files_left == 0)
+    {
+        files_left = 1;
+    }
+
     /* If the number of files left is 0, we want to update the status without
      * considering this time, since we want to change the status to completed
      * and probably we won't get more calls to this function */
@@ -3853,8 +4526,10 @@ report_copy_progress (CopyMoveJob  *copy_job,
         }
     }
 
-    if (elapsed < SECONDS_NEEDED_FOR_RELIABLE_TRANSFER_RATE &&
-        transfer_rate > 0)
+    /* There is no telling how long it takes without the total */
+    if (counting ||
+        (elapsed < SECONDS_NEEDED_FOR_RELIABLE_TRANSFER_RATE &&
+         transfer_rate > 0))
     {
         if (source_info->num_files == 1)
         {
@@ -3961,6 +4636,12 @@ report_copy_progress (CopyMoveJob  *copy_job,
     }
     nautilus_progress_info_take_details (job->progress, details);
 
+    if (counting)
+    {
+        nautilus_progress_info_pulse_progress (job->progress);
+        return;
+    }
+
     if (elapsed > SECONDS_NEEDED_FOR_APROXIMATE_TRANSFER_RATE)
     {
         nautilus_progress_info_set_remaining_time (job->progress,
@@ -4579,6 +5260,658 @@ retry:
     return CREATE_DEST_DIR_SUCCESS;
 }
 
+typedef enum
+{
+    NATIVE_COPY_DONE,
+    NATIVE_COPY_FAILED,
+    NATIVE_COPY_UNSUPPORTED
+} NativeCopyResult;
+
+/* Bytes handed to the kernel at a time, between progress reports and
+ * checks for cancellation.
+ */
+#define NATIVE_COPY_CHUNK_SIZE (16 * 1024 * 1024)
+
+/* Copies a local regular file by asking the kernel to clone it, which
+ * shares the blocks on btrfs and XFS, or else to copy it without going
+ * through user space, which lets NFS copy on the server. Anything else,
+ * overwriting included, is left to g_file_copy().
+ */
+static NativeCopyResult
+native_copy_file (GFile                  *src,
+                  GFile                  *dest,
+                  GFileCopyFlags          flags,
+                  GCancellable           *cancellable,
+                  GFileProgressCallback   progress_callback,
+                  gpointer                progress_callback_data,
+                  GError                **error)
+{
+#ifdef __linux__
+    g_autofree char *src_path = NULL;
+    g_autofree char *dest_path = NULL;
+    struct stat src_stat;
+    int src_fd, dest_fd;
+    gboolean use_copy_file_range;
+    NativeCopyResult result;
+    goffset copied;
+    gssize n;
+    int errsv;
+
+    if ((flags & (G_FILE_COPY_OVERWRITE | G_FILE_COPY_BACKUP)) != 0)
+    {
+        return NATIVE_COPY_UNSUPPORTED;
+    }
+
+    /* GVfs mounts have paths too, but the copy is better done by the
+     * backend than through FUSE.
+     */
+    if (!g_file_is_native (src) || !g_file_is_native (dest))
+    {
+        return NATIVE_COPY_UNSUPPORTED;
+    }
+
+    src_path = g_file_get_path (src);
+    dest_path = g_file_get_path (dest);
+
+    /* Opening a FIFO would block until something writes to it, so
+     * only regular files are opened at all. Files in /proc and the
+     * like claim to be empty, and are read to the end by g_file_copy()
+     * instead. Symlinks are copied as such, and errors reading the
+     * source are reported the way g_file_copy() words them.
+     */
+    if (fstatat (AT_FDCWD, src_path, &src_stat,
+                 (flags & G_FILE_COPY_NOFOLLOW_SYMLINKS) ? AT_SYMLINK_NOFOLLOW : 0) != 0 ||
+        !S_ISREG (src_stat.st_mode) || src_stat.st_size == 0)
+    {
+        return NATIVE_COPY_UNSUPPORTED;
+    }
+
+    /* Non-blocking in case it was replaced meanwhile. */
+    src_fd = open (src_path,
+                   O_RDONLY | O_CLOEXEC | O_NONBLOCK |
+                   ((flags & G_FILE_COPY_NOFOLLOW_SYMLINKS) ? O_NOFOLLOW : 0));
+    if (src_fd < 0)
+    {
+        return NATIVE_COPY_UNSUPPORTED;
+    }
+    if (fstat (src_fd, &src_stat) != 0 || !S_ISREG (src_stat.st_mode) ||
+        src_stat.st_size == 0)
+    {
+        close (src_fd);
+        return NATIVE_COPY_UNSUPPORTED;
+    }
+
+    if (g_cancellable_set_error_if_cancelled (cancellable, error))
+    {
+        close (src_fd);
+        return NATIVE_COPY_FAILED;
+    }
+
+    dest_fd = open (dest_path,
+                    O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC,
+                    (flags & G_FILE_COPY_TARGET_DEFAULT_PERMS) ? 0666 : src_stat.st_mode & 07777);
+    if (dest_fd < 0)
+    {
+        g_autofree gchar *display_name = NULL;
+        GIOErrorEnum code;
+
+        errsv = errno;
+        close (src_fd);
+
+        if (errsv == EEXIST)
+        {
+            code = G_IO_ERROR_EXISTS;
+        }
+        else if (errsv == EINVAL)
+        {
+            /* Names FAT and the like can't store */
+            code = G_IO_ERROR_INVALID_FILENAME;
+        }
+        else
+        {
+            code = g_io_error_from_errno (errsv);
+        }
+
+        display_name = g_filename_display_name (dest_path);
+        g_set_error (error, G_IO_ERROR, code,
+                     _("Error opening file “%s”: %s"),
+                     display_name, g_strerror (errsv));
+        return NATIVE_COPY_FAILED;
+    }
+
+    result = NATIVE_COPY_DONE;
+    copied = 0;
+
+#ifdef FICLONE
+    if (ioctl (dest_fd, FICLONE, src_fd) == 0)
+    {
+        copied = src_stat.st_size;
+    }
+#endif
+
+    /* Both advance the file offsets, so one can take over from the
+     * other halfway through.
+     */
+    use_copy_file_range = TRUE;
+    while (copied < src_stat.st_size)
+    {
+        if (g_cancellable_set_error_if_cancelled (cancellable, error))
+        {
+            result = NATIVE_COPY_FAILED;
+            break;
+        }
+
+        n = -1;
+        errno = ENOSYS;
+        if (use_copy_file_range)
+        {
+#ifdef SYS_copy_file_range
+            n = syscall (SYS_copy_file_range, src_fd, NULL, dest_fd, NULL,
+                         MIN (src_stat.st_size - copied, NATIVE_COPY_CHUNK_SIZE), 0);
+#endif
+            if (n < 0 &&
+                (errno == ENOSYS || errno == EXDEV ||
+                 errno == EOPNOTSUPP || errno == EINVAL))
+            {
+                use_copy_file_range = FALSE;
+                continue;
+            }
+        }
+        else
+        {
+            n = sendfile (dest_fd, src_fd, NULL,
+                          MIN (src_stat.st_size - copied, NATIVE_COPY_CHUNK_SIZE));
+            if (n < 0 && copied == 0 &&
+                (errno == ENOSYS || errno == EINVAL))
+            {
+                result = NATIVE_COPY_UNSUPPORTED;
+                break;
+            }
+        }
+
+        if (n < 0)
+        {
+            errsv = errno;
+            if (errsv == EINTR)
+            {
+                continue;
+            }
+
+            g_set_error (error, G_IO_ERROR, g_io_error_from_errno (errsv),
+                         _("Error writing to file: %s"),
+                         g_strerror (errsv));
+            result = NATIVE_COPY_FAILED;
+            break;
+        }
+        else if (n == 0 && copied == 0)
+        {
+            /* sysfs and some FUSE file systems give nothing through
+             * either call, though reading the file works.
+             */
+            if (use_copy_file_range)
+            {
+                use_copy_file_range = FALSE;
+                continue;
+            }
+            result = NATIVE_COPY_UNSUPPORTED;
+            break;
+        }
+        else if (n == 0)
+        {
+            /* The source got shorter meanwhile */
+            break;
+        }
+
+        copied += n;
+        if (progress_callback != NULL)
+        {
+            progress_callback (copied, src_stat.st_size, progress_callback_data);
+        }
+    }
+
+    close (src_fd);
+
+    /* Network file systems can report write errors only now */
+    if (close (dest_fd) != 0 && result == NATIVE_COPY_DONE)
+    {
+        errsv = errno;
+        g_set_error (error, G_IO_ERROR, g_io_error_from_errno (errsv),
+                     _("Error writing to file: %s"),
+                     g_strerror (errsv));
+        result = NATIVE_COPY_FAILED;
+    }
+
+    if (result != NATIVE_COPY_DONE)
+    {
+        g_unlink (dest_path);
+        return result;
+    }
+
+    if (progress_callback != NULL)
+    {
+        progress_callback (copied, src_stat.st_size, progress_callback_data);
+    }
+
+    /* Same as g_file_copy(), which doesn't fail over these either */
+    g_file_copy_attributes (src, dest,
+                            flags & (G_FILE_COPY_NOFOLLOW_SYMLINKS |
+                                     G_FILE_COPY_TARGET_DEFAULT_PERMS),
+                            cancellable, NULL);
+
+    return NATIVE_COPY_DONE;
+#else
+    return NATIVE_COPY_UNSUPPORTED;
+#endif
+}
+
+/* Same as g_file_copy(), but lets the kernel do the copying where it
+ * can, see native_copy_file().
+ */
+static gboolean
+copy_file (GFile                  *src,
+           GFile                  *dest,
+           GFileCopyFlags          flags,
+           GCancellable           *cancellable,
+           GFileProgressCallback   progress_callback,
+           gpointer                progress_callback_data,
+           GError                **error)
+{
+    switch (native_copy_file (src, dest, flags, cancellable,
+                              progress_callback, progress_callback_data,
+                              error))
+    {
+        case NATIVE_COPY_DONE:
+        {
+            return TRUE;
+        }
+
+        case NATIVE_COPY_FAILED:
+        {
+            return FALSE;
+        }
+
+        case NATIVE_COPY_UNSUPPORTED:
+        default:
+        {
+        }
+        break;
+    }
+
+    return g_file_copy (src, dest, flags, cancellable,
+                        progress_callback, progress_callback_data,
+                        error);
+}
+
+/* Small files are handed to a pool of threads, so a tree of many of
+ * them is not copied at the pace of one round trip per file. The job
+ * thread still walks the tree and makes the directories, in order.
+ * What the threads can't do without asking, conflicts and errors, is
+ * handed back to the job thread, which copies those files again the
+ * usual way, one prompt at a time. Only copies use it, moves go file by
+ * file.
+ */
+#define COPY_POOL_MAX_FILE_SIZE (1024 * 1024)
+#define COPY_POOL_MAX_LOCAL_THREADS 4
+
+/* Copies to and from remote locations are bound by latency rather than
+ * by the disk, so more of them are worth having in flight.
+ */
+#define COPY_POOL_REMOTE_THREADS 8
+
+/* Files queued per thread, so threads don't wait for the job thread to
+ * find the next one.
+ */
+#define COPY_POOL_FILES_PER_THREAD 4
+
+#define COPY_POOL_PROGRESS_INTERVAL (G_USEC_PER_SEC / 10)
+
+/* The files of one directory handed to the pool. The directory is not
+ * finished, its attributes copied, before they are all done.
+ */
+typedef struct
+{
+    guint n_pending;
+    gboolean skipped_file;
+    char **dest_fs_type;
+} CopyPoolDir;
+
+typedef struct
+{
+    CopyPool *pool;
+    CopyPoolDir *dir;
+    GFile *src;
+    GFile *dest_dir;
+    GFile *dest;
+    gboolean same_fs;
+    gboolean has_position;
+    GdkPoint position;
+    GHashTable *debuting_files;
+    goffset last_size;
+    gboolean dest_created;
+    GError *error;
+} CopyPoolItem;
+
+struct CopyPool
+{
+    CopyMoveJob *job;
+    GThreadPool *threads;
+    GAsyncQueue *done;
+    gboolean readonly_source_fs;
+    guint n_in_flight;
+    guint max_in_flight;
+
+    /* Copied by the threads, added to atomically, and how much of that
+     * the job thread added to the transfer info. Both wrap around, only
+     * the difference matters.
+     */
+    gsize num_bytes;
+    gsize num_bytes_taken;
+};
+
+static void
+copy_pool_add_bytes (CopyPool *pool,
+                     gssize    num_bytes)
+{
+    g_atomic_pointer_add (&pool->num_bytes, num_bytes);
+}
+
+static void
+copy_pool_progress_callback (goffset  current_num_bytes,
+                             goffset  total_num_bytes,
+                             gpointer user_data)
+{
+    CopyPoolItem *item;
+
+    item = user_data;
+
+    /* Copies are only reported once the destination was made. */
+    item->dest_created = TRUE;
+
+    if (current_num_bytes > item->last_size)
+    {
+        copy_pool_add_bytes (item->pool, current_num_bytes - item->last_size);
+        item->last_size = current_num_bytes;
+    }
+}
+
+static void
+copy_pool_thread_func (gpointer data,
+                       gpointer user_data)
+{
+    CopyPoolItem *item;
+    CopyPool *pool;
+    CommonJob *job;
+    GFileCopyFlags flags;
+    GFile *real;
+    gboolean res;
+
+    item = data;
+    pool = user_data;
+    job = (CommonJob *) pool->job;
+
+    if (g_cancellable_set_error_if_cancelled (job->cancellable, &item->error))
+    {
+        g_async_queue_push (pool->done, item);
+        return;
+    }
+
+    /* Never overwrite, existing files are for the job thread to ask about. */
+    flags = G_FILE_COPY_NOFOLLOW_SYMLINKS;
+    if (pool->readonly_source_fs)
+    {
+        flags |= G_FILE_COPY_TARGET_DEFAULT_PERMS;
+    }
+
+    res = copy_file (item->src, item->dest, flags, job->cancellable,
+                     copy_pool_progress_callback, item, &item->error);
+
+    if (res)
+    {
+        /* The file is there either way, so failing this is no error. */
+        real = map_possibly_volatile_file_to_real (item->dest, job->cancellable, NULL);
+        if (real != NULL)
+        {
+            g_object_unref (item->dest);
+            item->dest = real;
+        }
+    }
+
+    if (item->error != NULL)
+    {
+        /* The job thread starts over with this file, and must not find
+         * what this copy left behind and ask about overwriting it.
+         */
+        if (item->dest_created)
+        {
+            g_file_delete (item->dest, NULL, NULL);
+        }
+        copy_pool_add_bytes (pool, -item->last_size);
+        item->last_size = 0;
+    }
+
+    g_async_queue_push (pool->done, item);
+}
+
+static void
+copy_pool_item_free (CopyPoolItem *item)
+{
+    g_object_unref (item->src);
+    g_object_unref (item->dest_dir);
+    g_object_unref (item->dest);
+    g_clear_error (&item->error);
+    g_free (item);
+}
+
+static void
+copy_pool_take_bytes (CopyPool     *pool,
+                      TransferInfo *transfer_info)
+{
+    gsize num_bytes;
+
+    num_bytes = (gsize) g_atomic_pointer_get (&pool->num_bytes);
+    transfer_info->num_bytes += (gssize) (num_bytes - pool->num_bytes_taken);
+    pool->num_bytes_taken = num_bytes;
+}
+
+static void
+copy_pool_item_done (CopyPool     *pool,
+                     CopyPoolItem *item,
+                     SourceInfo   *source_info,
+                     TransferInfo *transfer_info)
+{
+    CopyMoveJob *copy_job;
+    CommonJob *job;
+    gboolean skipped_file;
+
+    copy_job = pool->job;
+    job = (CommonJob *) copy_job;
+
+    pool->n_in_flight--;
+    item->dir->n_pending--;
+
+    copy_pool_take_bytes (pool, transfer_info);
+
+    if (item->error == NULL)
+    {
+        transfer_info->num_files++;
+
+        if (item->debuting_files)
+        {
+            g_autofree gchar *dest_uri = NULL;
+
+            dest_uri = g_file_get_uri (item->dest);
+            if (item->has_position)
+            {
+                nautilus_file_changes_queue_schedule_position_set (item->dest, item->position, job->screen_num);
+            }
+            else if (eel_uri_is_desktop (dest_uri))
+            {
+                nautilus_file_changes_queue_schedule_position_remove (item->dest);
+            }
+
+            g_hash_table_replace (item->debuting_files, g_object_ref (item->dest), GINT_TO_POINTER (TRUE));
+        }
+        nautilus_file_changes_queue_file_added (item->dest);
+
+        if (job->undo_info != NULL)
+        {
+            nautilus_file_undo_info_ext_add_origin_target_pair (NAUTILUS_FILE_UNDO_INFO_EXT (job->undo_info),
+                                                                item->src, item->dest);
+        }
+    }
+    else if (job_aborted (job))
+    {
+        item->dir->skipped_file = TRUE;
+    }
+    else
+    {
+        skipped_file = FALSE;
+        copy_move_file (copy_job, item->src, item->dest_dir, item->same_fs, FALSE,
+                        item->dir->dest_fs_type, source_info, transfer_info,
+                        item->debuting_files,
+                        item->has_position ? &item->position : NULL,
+                        FALSE, &skipped_file, pool->readonly_source_fs);
+        if (skipped_file)
+        {
+            item->dir->skipped_file = TRUE;
+            transfer_add_file_to_count (item->src, job, transfer_info);
+        }
+    }
+
+    report_copy_progress (copy_job, source_info, transfer_info);
+
+    copy_pool_item_free (item);
+}
+
+/* Deals with the next file the threads are done with, or just reports
+ * the progress if none is done for a while.
+ */
+static void
+copy_pool_wait_one (CopyPool     *pool,
+                    SourceInfo   *source_info,
+                    TransferInfo *transfer_info)
+{
+    CopyPoolItem *item;
+
+    item = g_async_queue_timeout_pop (pool->done, COPY_POOL_PROGRESS_INTERVAL);
+    if (item != NULL)
+    {
+        copy_pool_item_done (pool, item, source_info, transfer_info);
+    }
+    else
+    {
+        copy_pool_take_bytes (pool, transfer_info);
+        report_copy_progress (pool->job, source_info, transfer_info);
+    }
+}
+
+static void
+copy_pool_wait_dir (CopyPool     *pool,
+                    CopyPoolDir  *dir,
+                    SourceInfo   *source_info,
+                    TransferInfo *transfer_info)
+{
+    while (dir->n_pending > 0)
+    {
+        copy_pool_wait_one (pool, source_info, transfer_info);
+    }
+}
+
+/* Returns FALSE if @src is not for the pool, the caller copies it then.
+ * @info needs the type and size of @src.
+ */
+static gboolean
+copy_pool_push (CopyPool     *pool,
+                CopyPoolDir  *dir,
+                GFile        *src,
+                GFileInfo    *info,
+                GFile        *dest_dir,
+                gboolean      same_fs,
+                GdkPoint     *position,
+                GHashTable   *debuting_files,
+                SourceInfo   *source_info,
+                TransferInfo *transfer_info)
+{
+    CopyMoveJob *copy_job;
+    CopyPoolItem *item;
+
+    copy_job = pool->job;
+
+    if (g_file_info_get_file_type (info) != G_FILE_TYPE_REGULAR ||
+        g_file_info_get_size (info) > COPY_POOL_MAX_FILE_SIZE ||
+        should_skip_file ((CommonJob *) copy_job, src) ||
+        /* Trusted desktop files are marked as such on the way */
+        (copy_job->desktop_location != NULL &&
+         g_file_equal (copy_job->desktop_location, dest_dir)))
+    {
+        return FALSE;
+    }
+
+    while (pool->n_in_flight >= pool->max_in_flight)
+    {
+        copy_pool_wait_one (pool, source_info, transfer_info);
+    }
+
+    item = g_new0 (CopyPoolItem, 1);
+    item->pool = pool;
+    item->dir = dir;
+    item->src = g_object_ref (src);
+    item->dest_dir = g_object_ref (dest_dir);
+    item->dest = get_target_file (src, dest_dir, *dir->dest_fs_type, same_fs);
+    item->same_fs = same_fs;
+    if (position != NULL)
+    {
+        item->has_position = TRUE;
+        item->position = *position;
+    }
+    item->debuting_files = debuting_files;
+
+    pool->n_in_flight++;
+    dir->n_pending++;
+    g_thread_pool_push (pool->threads, item, NULL);
+
+    return TRUE;
+}
+
+static CopyPool *
+copy_pool_new (CopyMoveJob *job,
+               gboolean     remote,
+               gboolean     readonly_source_fs)
+{
+    CopyPool *pool;
+    guint n_threads;
+
+    if (remote)
+    {
+        n_threads = COPY_POOL_REMOTE_THREADS;
+    }
+    else
+    {
+        n_threads = CLAMP (g_get_num_processors (), 2, COPY_POOL_MAX_LOCAL_THREADS);
+    }
+
+    pool = g_new0 (CopyPool, 1);
+    pool->job = job;
+    pool->readonly_source_fs = readonly_source_fs;
+    pool->max_in_flight = n_threads * COPY_POOL_FILES_PER_THREAD;
+    pool->done = g_async_queue_new ();
+    pool->threads = g_thread_pool_new (copy_pool_thread_func, pool,
+                                       n_threads, FALSE, NULL);
+
+    return pool;
+}
+
+/* All files have to be done already. */
+static void
+copy_pool_free (CopyPool *pool)
+{
+    g_assert (pool->n_in_flight == 0);
+
+    g_thread_pool_free (pool->threads, FALSE, TRUE);
+    g_async_queue_unref (pool->done);
+    g_free (pool);
+}
+
 /* a return value of FALSE means retry, i.e.
  * the destination has changed and the source
  * is expected to re-try the preceding
@@ -4609,6 +5942,7 @@ copy_move_directory (CopyMoveJob   *copy_job,
     gboolean local_skipped_file;
     CommonJob *job;
     GFileCopyFlags flags;
+    CopyPoolDir pool_dir;
 
     job = (CommonJob *) copy_job;
 
@@ -4647,11 +5981,17 @@ copy_move_directory (CopyMoveJob   *copy_job,
     local_skipped_file = FALSE;
     dest_fs_type = NULL;
 
+    pool_dir.n_pending = 0;
+    pool_dir.skipped_file = FALSE;
+    pool_dir.dest_fs_type = &dest_fs_type;
+
     skip_error = should_skip_readdir_error (job, src);
 retry:
     error = NULL;
     enumerator = g_file_enumerate_children (src,
-                                            G_FILE_ATTRIBUTE_STANDARD_NAME,
+                                            G_FILE_ATTRIBUTE_STANDARD_NAME ","
+                                            G_FILE_ATTRIBUTE_STANDARD_TYPE ","
+                                            G_FILE_ATTRIBUTE_STANDARD_SIZE,
                                             G_FILE_QUERY_INFO_NOFOLLOW_SYMLINKS,
                                             job->cancellable,
                                             &error);
@@ -4664,14 +6004,20 @@ retry:
         {
             src_file = g_file_get_child (src,
                                          g_file_info_get_name (info));
-            copy_move_file (copy_job, src_file, *dest, same_fs, FALSE, &dest_fs_type,
-                            source_info, transfer_info, NULL, NULL, FALSE, &local_skipped_file,
-                            readonly_source_fs);
-
-            if (local_skipped_file)
+            if (copy_job->copy_pool == NULL ||
+                !copy_pool_push (copy_job->copy_pool, &pool_dir, src_file, info,
+                                 *dest, same_fs, NULL, NULL,
+                                 source_info, transfer_info))
             {
-                transfer_add_file_to_count (src_file, job, transfer_info);
-                report_copy_progress (copy_job, source_info, transfer_info);
+                copy_move_file (copy_job, src_file, *dest, same_fs, FALSE, &dest_fs_type,
+                                source_info, transfer_info, NULL, NULL, FALSE, &local_skipped_file,
+                                readonly_source_fs);
+
+                if (local_skipped_file)
+                {
+                    transfer_add_file_to_count (src_file, job, transfer_info);
+                    report_copy_progress (copy_job, source_info, transfer_info);
+                }
             }
 
             g_object_unref (src_file);
@@ -4680,6 +6026,16 @@ retry:
         g_file_enumerator_close (enumerator, job->cancellable, NULL);
         g_object_unref (enumerator);
 
+        if (copy_job->copy_pool != NULL)
+        {
+            copy_pool_wait_dir (copy_job->copy_pool, &pool_dir,
+                                source_info, transfer_info);
+            if (pool_dir.skipped_file)
+            {
+                local_skipped_file = TRUE;
+            }
+        }
+
         if (error && IS_IO_ERROR (error, CANCELLED))
         {
             g_error_free (error);
@@ -4978,9 +6334,17 @@ copy_file_progress_callback (goffset  current_num_bytes,
     {
         pdata->transfer_info->num_bytes += new_size;
         pdata->last_size = current_num_bytes;
-        report_copy_progress (pdata->job,
-                              pdata->source_info,
-                              pdata->transfer_info);
+
+        /* GIO calls this for every chunk, reporting formats the text
+         * no more often than it can be seen anyway.
+         */
+        if (current_num_bytes == total_num_bytes ||
+            g_get_monotonic_time () - pdata->transfer_info->last_report_time >= PROGRESS_NOTIFY_INTERVAL)
+        {
+            report_copy_progress (pdata->job,
+                                  pdata->source_info,
+                                  pdata->transfer_info);
+        }
     }
 }
 
@@ -5297,12 +6661,12 @@ retry:
     }
     else
     {
-        res = g_file_copy (src, dest,
-                           flags,
-                           job->cancellable,
-                           copy_file_progress_callback,
-                           &pdata,
-                           &error);
+        res = copy_file (src, dest,
+                         flags,
+                         job->cancellable,
+                         copy_file_progress_callback,
+                         &pdata,
+                         &error);
     }
 
     if (res)
@@ -5679,9 +7043,12 @@ copy_files (CopyMoveJob  *job,
     char *dest_fs_type;
     GFileInfo *inf;
     gboolean readonly_source_fs;
+    gboolean remote;
+    CopyPoolDir pool_dir;
 
     dest_fs_type = NULL;
     readonly_source_fs = FALSE;
+    remote = FALSE;
 
     common = &job->common;
 
@@ -5691,15 +7058,43 @@ copy_files (CopyMoveJob  *job,
     source_dir = g_file_get_parent ((GFile *) job->files->data);
     if (source_dir)
     {
-        inf = g_file_query_filesystem_info (source_dir, "filesystem::readonly", NULL, NULL);
+        inf = g_file_query_filesystem_info (source_dir,
+                                            "filesystem::readonly,"
+                                            G_FILE_ATTRIBUTE_FILESYSTEM_REMOTE,
+                                            NULL, NULL);
         if (inf != NULL)
         {
             readonly_source_fs = g_file_info_get_attribute_boolean (inf, "filesystem::readonly");
+            remote = g_file_info_get_attribute_boolean (inf, G_FILE_ATTRIBUTE_FILESYSTEM_REMOTE);
             g_object_unref (inf);
         }
+        remote = remote || !g_file_is_native (source_dir);
         g_object_unref (source_dir);
     }
 
+    /* Duplicates and renamed copies pick their names one by one */
+    if (job->destination != NULL && job->target_name == NULL)
+    {
+        if (!remote)
+        {
+            inf = g_file_query_filesystem_info (job->destination,
+                                                G_FILE_ATTRIBUTE_FILESYSTEM_REMOTE,
+                                                common->cancellable, NULL);
+            if (inf != NULL)
+            {
+                remote = g_file_info_get_attribute_boolean (inf, G_FILE_ATTRIBUTE_FILESYSTEM_REMOTE);
+                g_object_unref (inf);
+            }
+            remote = remote || !g_file_is_native (job->destination);
+        }
+
+        job->copy_pool = copy_pool_new (job, remote, readonly_source_fs);
+    }
+
+    pool_dir.n_pending = 0;
+    pool_dir.skipped_file = FALSE;
+    pool_dir.dest_fs_type = &dest_fs_type;
+
     unique_names = (job->destination == NULL);
     i = 0;
     for (l = job->files;
@@ -5732,7 +7127,25 @@ copy_files (CopyMoveJob  *job,
         {
             dest = g_file_get_parent (src);
         }
-        if (dest)
+        inf = NULL;
+        if (dest && job->copy_pool != NULL)
+        {
+            inf = g_file_query_info (src,
+                                     G_FILE_ATTRIBUTE_STANDARD_TYPE ","
+                                     G_FILE_ATTRIBUTE_STANDARD_SIZE,
+                                     G_FILE_QUERY_INFO_NOFOLLOW_SYMLINKS,
+                                     common->cancellable,
+                                     NULL);
+        }
+
+        if (inf != NULL &&
+            copy_pool_push (job->copy_pool, &pool_dir, src, inf, dest,
+                            same_fs, point, job->debuting_files,
+                            source_info, transfer_info))
+        {
+            g_object_unref (dest);
+        }
+        else if (dest)
         {
             skipped_file = FALSE;
             copy_move_file (job, src, dest,
@@ -5750,9 +7163,17 @@ copy_files (CopyMoveJob  *job,
                 report_copy_progress (job, source_info, transfer_info);
             }
         }
+        g_clear_object (&inf);
         i++;
     }
 
+    if (job->copy_pool != NULL)
+    {
+        copy_pool_wait_dir (job->copy_pool, &pool_dir,
+                            source_info, transfer_info);
+        g_clear_pointer (&job->copy_pool, copy_pool_free);
+    }
+
     g_free (dest_fs_type);
 }
 
@@ -5811,10 +7232,10 @@ copy_task_thread_func (GTask        *task,
 
     nautilus_progress_info_start (job->common.progress);
 
-    scan_sources (job->files,
-                  &source_info,
-                  common,
-                  OP_KIND_COPY);
+    scan_sources_in_background (job->files,
+                                &source_info,
+                                common,
+                                OP_KIND_COPY);
     if (job_aborted (common))
     {
         goto aborted;
@@ -5849,7 +7270,14 @@ copy_task_thread_func (GTask        *task,
                 dest_fs_id,
                 &source_info, &transfer_info);
 
+    if (!job_aborted (common) &&
+        source_info_finish (&source_info, &transfer_info))
+    {
+        report_copy_progress (job, &source_info, &transfer_info);
+    }
+
 aborted:
+    source_info_clear (&source_info);
 
     g_free (dest_fs_id);
 }
@@ -6455,6 +7883,7 @@ move_task_thread_func (GTask        *task,
     dest_fs_type = NULL;
 
     fallbacks = NULL;
+    memset (&source_info, 0, sizeof (source_info));
 
     nautilus_progress_info_start (job->common.progress);
 
@@ -6478,10 +7907,10 @@ move_task_thread_func (GTask        *task,
      *  so scan for size */
 
     fallback_files = get_files_from_fallbacks (fallbacks);
-    scan_sources (fallback_files,
-                  &source_info,
-                  common,
-                  OP_KIND_MOVE);
+    scan_sources_in_background (fallback_files,
+                                &source_info,
+                                common,
+                                OP_KIND_MOVE);
 
     g_list_free (fallback_files);
 
@@ -6505,7 +7934,14 @@ move_task_thread_func (GTask        *task,
                 dest_fs_id, &dest_fs_type,
                 &source_info, &transfer_info);
 
+    if (!job_aborted (common) &&
+        source_info_finish (&source_info, &transfer_info))
+    {
+        report_copy_progress (job, &source_info, &transfer_info);
+    }
+
 aborted:
+    source_info_clear (&source_info);
     g_list_free_full (fallbacks, g_free);
 
     g_free (dest_fs_id);
@@ -44,6 +44,8 @@ typedef enum {
 struct NautilusFileDetails
 {
 	NautilusDirectory *directory;
+	/* Position in directory->details->files, valid while the file is in it. */
+	guint directory_index;
 	
 	eel_ref_str name;
 
@@ -53,6 +55,14 @@ struct NautilusFileDetails
 	eel_ref_str display_name;
 	char *display_name_collation_key;
 	char *directory_name_collation_key;
+
+	/* Sort keys, made the first time they are needed and dropped when
+	 * the file changes. Only the string attribute sorted by last is
+	 * kept, views sort by one at a time.
+	 */
+	char *type_collation_key;
+	GQuark sort_attribute;
+	char *sort_attribute_value;
 	eel_ref_str edit_name;
 
 	goffset size; /* -1 is unknown */
@@ -95,6 +105,12 @@ struct NautilusFileDetails
 	GdkPixbuf *scaled_thumbnail;
 	double thumbnail_scale;
 
+	/* How many canvas views have the file in or near view, and how
+	 * many have it far out of view.
+	 */
+	guint16 onscreen_view_count;
+	guint16 offscreen_view_count;
+
 	GList *mime_list; /* If this is a directory, the list of MIME types in it. */
 
 	/* Info you might get from a link (.desktop, .directory or nautilus link) */
@@ -144,6 +160,7 @@ struct NautilusFileDetails
 	 */
 	eel_boolean_bit loading_directory             : 1;
 	eel_boolean_bit got_file_info                 : 1;
+	eel_boolean_bit type_collation_key_known      : 1;
 	eel_boolean_bit get_info_failed               : 1;
 	eel_boolean_bit file_info_is_up_to_date       : 1;
 	
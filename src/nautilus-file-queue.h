@@ -44,6 +44,12 @@ void               nautilus_file_queue_remove   (NautilusFileQueue *queue,
 /* Get the file at the head of the queue without removing or unrefing it. */
 NautilusFile *     nautilus_file_queue_head     (NautilusFileQueue *queue);
 
+/* Get the file following @file in the queue in constant time, or NULL
+ * if @file is the tail or not in the queue at all.
+ */
+NautilusFile *     nautilus_file_queue_next     (NautilusFileQueue *queue,
+						 NautilusFile      *file);
+
 gboolean           nautilus_file_queue_is_empty (NautilusFileQueue *queue);
 
 #endif /* NAUTILUS_FILE_CHANGES_QUEUE_H */
@@ -866,6 +866,8 @@ finalize (GObject *object)
     eel_ref_str_unref (file->details->display_name);
     g_free (file->details->display_name_collation_key);
     g_free (file->details->directory_name_collation_key);
+    g_free (file->details->type_collation_key);
+    g_free (file->details->sort_attribute_value);
     eel_ref_str_unref (file->details->edit_name);
     if (file->details->icon)
     {
@@ -2622,7 +2624,7 @@ update_info_internal (NautilusFile *file,
                       GFileInfo    *info,
                       gboolean      update_name)
 {
-    GList *node;
+    gboolean in_hash_table;
     gboolean changed;
     gboolean is_symlink, is_hidden, is_mountpoint;
     gboolean has_permissions;
@@ -3092,8 +3094,8 @@ update_info_internal (NautilusFile *file,
         {
             changed = TRUE;
 
-            node = nautilus_directory_begin_file_name_change
-                       (file->details->directory, file);
+            in_hash_table = nautilus_directory_begin_file_name_change
+                                (file->details->directory, file);
 
             eel_ref_str_unref (file->details->name);
             if (g_strcmp0 (eel_ref_str_peek (file->details->display_name),
@@ -3117,7 +3119,7 @@ update_info_internal (NautilusFile *file,
             }
 
             nautilus_directory_end_file_name_change
-                (file->details->directory, file, node);
+                (file->details->directory, file, in_hash_table);
         }
     }
 
@@ -3150,7 +3152,7 @@ update_name_internal (NautilusFile *file,
                       const char   *name,
                       gboolean      in_directory)
 {
-    GList *node;
+    gboolean in_hash_table;
 
     g_assert (name != NULL);
 
@@ -3164,11 +3166,11 @@ update_name_internal (NautilusFile *file,
         return FALSE;
     }
 
-    node = NULL;
+    in_hash_table = FALSE;
     if (in_directory)
     {
-        node = nautilus_directory_begin_file_name_change
-                   (file->details->directory, file);
+        in_hash_table = nautilus_directory_begin_file_name_change
+                            (file->details->directory, file);
     }
 
     eel_ref_str_unref (file->details->name);
@@ -3182,7 +3184,7 @@ update_name_internal (NautilusFile *file,
     if (in_directory)
     {
         nautilus_directory_end_file_name_change
-            (file->details->directory, file, node);
+            (file->details->directory, file, in_hash_table);
     }
 
     return TRUE;
@@ -3593,15 +3595,58 @@ prepend_automatic_keywords (NautilusFile *file,
     return names;
 }
 
+static const char *
+get_type_collation_key (NautilusFile *file)
+{
+    char *type_string;
+
+    if (!file->details->type_collation_key_known)
+    {
+        type_string = nautilus_file_get_type_as_string (file);
+        if (type_string != NULL)
+        {
+            file->details->type_collation_key = g_utf8_collate_key (type_string, -1);
+        }
+        file->details->type_collation_key_known = TRUE;
+
+        g_free (type_string);
+    }
+
+    return file->details->type_collation_key;
+}
+
+static const char *
+get_sort_attribute_value (NautilusFile *file,
+                          GQuark        attribute)
+{
+    if (file->details->sort_attribute != attribute)
+    {
+        g_free (file->details->sort_attribute_value);
+        file->details->sort_attribute_value = nautilus_file_get_string_attribute_q (file, attribute);
+        file->details->sort_attribute = attribute;
+    }
+
+    return file->details->sort_attribute_value;
+}
+
+static void
+clear_sort_keys (NautilusFile *file)
+{
+    g_clear_pointer (&file->details->type_collation_key, g_free);
+    file->details->type_collation_key_known = FALSE;
+
+    g_clear_pointer (&file->details->sort_attribute_value, g_free);
+    file->details->sort_attribute = 0;
+}
+
 static int
 compare_by_type (NautilusFile *file_1,
                  NautilusFile *file_2)
 {
     gboolean is_directory_1;
     gboolean is_directory_2;
-    char *type_string_1;
-    char *type_string_2;
-    int result;
+    const char *key_1;
+    const char *key_2;
 
     /* Directories go first. Then, if mime types are identical,
      * don't bother getting strings (for speed). This assumes
@@ -3634,17 +3679,17 @@ compare_by_type (NautilusFile *file_1,
         return 0;
     }
 
-    type_string_1 = nautilus_file_get_type_as_string (file_1);
-    type_string_2 = nautilus_file_get_type_as_string (file_2);
+    key_1 = get_type_collation_key (file_1);
+    key_2 = get_type_collation_key (file_2);
 
-    if (type_string_1 == NULL || type_string_2 == NULL)
+    if (key_1 == NULL || key_2 == NULL)
     {
-        if (type_string_1 != NULL)
+        if (key_1 != NULL)
         {
             return -1;
         }
 
-        if (type_string_2 != NULL)
+        if (key_2 != NULL)
         {
             return 1;
         }
@@ -3652,12 +3697,7 @@ compare_by_type (NautilusFile *file_1,
         return 0;
     }
 
-    result = g_utf8_collate (type_string_1, type_string_2);
-
-    g_free (type_string_1);
-    g_free (type_string_2);
-
-    return result;
+    return strcmp (key_1, key_2);
 }
 
 static Knowledge
@@ -3929,76 +3969,71 @@ nautilus_file_compare_for_sort (NautilusFile         *file_1,
     return result;
 }
 
-int
-nautilus_file_compare_for_sort_by_attribute_q   (NautilusFile *file_1,
-                                                 NautilusFile *file_2,
-                                                 GQuark        attribute,
-                                                 gboolean      directories_first,
-                                                 gboolean      reversed)
+/* The sort type @attribute is compared by, NAUTILUS_FILE_SORT_NONE for
+ * attributes compared as strings.
+ */
+static NautilusFileSortType
+get_sort_type_for_attribute (GQuark attribute)
 {
-    int result;
-
-    if (file_1 == file_2)
-    {
-        return 0;
-    }
-
-    /* Convert certain attributes into NautilusFileSortTypes and use
-     * nautilus_file_compare_for_sort()
-     */
     if (attribute == 0 || attribute == attribute_name_q)
     {
-        return nautilus_file_compare_for_sort (file_1, file_2,
-                                               NAUTILUS_FILE_SORT_BY_DISPLAY_NAME,
-                                               directories_first,
-                                               reversed);
+        return NAUTILUS_FILE_SORT_BY_DISPLAY_NAME;
     }
     else if (attribute == attribute_size_q)
     {
-        return nautilus_file_compare_for_sort (file_1, file_2,
-                                               NAUTILUS_FILE_SORT_BY_SIZE,
-                                               directories_first,
-                                               reversed);
+        return NAUTILUS_FILE_SORT_BY_SIZE;
     }
     else if (attribute == attribute_type_q)
     {
-        return nautilus_file_compare_for_sort (file_1, file_2,
-                                               NAUTILUS_FILE_SORT_BY_TYPE,
-                                               directories_first,
-                                               reversed);
+        return NAUTILUS_FILE_SORT_BY_TYPE;
     }
     else if (attribute == attribute_modification_date_q || attribute == attribute_date_modified_q || attribute == attribute_date_modified_with_time_q || attribute == attribute_date_modified_full_q)
     {
-        return nautilus_file_compare_for_sort (file_1, file_2,
-                                               NAUTILUS_FILE_SORT_BY_MTIME,
-                                               directories_first,
-                                               reversed);
+        return NAUTILUS_FILE_SORT_BY_MTIME;
     }
     else if (attribute == attribute_accessed_date_q || attribute == attribute_date_accessed_q || attribute == attribute_date_accessed_full_q)
     {
-        return nautilus_file_compare_for_sort (file_1, file_2,
-                                               NAUTILUS_FILE_SORT_BY_ATIME,
-                                               directories_first,
-                                               reversed);
+        return NAUTILUS_FILE_SORT_BY_ATIME;
     }
     else if (attribute == attribute_trashed_on_q || attribute == attribute_trashed_on_full_q)
     {
-        return nautilus_file_compare_for_sort (file_1, file_2,
-                                               NAUTILUS_FILE_SORT_BY_TRASHED_TIME,
-                                               directories_first,
-                                               reversed);
+        return NAUTILUS_FILE_SORT_BY_TRASHED_TIME;
     }
     else if (attribute == attribute_search_relevance_q)
     {
-        return nautilus_file_compare_for_sort (file_1, file_2,
-                                               NAUTILUS_FILE_SORT_BY_SEARCH_RELEVANCE,
-                                               directories_first,
-                                               reversed);
+        return NAUTILUS_FILE_SORT_BY_SEARCH_RELEVANCE;
     }
     else if (attribute == attribute_recency_q)
+    {
+        return NAUTILUS_FILE_SORT_BY_RECENCY;
+    }
+
+    return NAUTILUS_FILE_SORT_NONE;
+}
+
+int
+nautilus_file_compare_for_sort_by_attribute_q   (NautilusFile *file_1,
+                                                 NautilusFile *file_2,
+                                                 GQuark        attribute,
+                                                 gboolean      directories_first,
+                                                 gboolean      reversed)
+{
+    NautilusFileSortType sort_type;
+    int result;
+
+    if (file_1 == file_2)
+    {
+        return 0;
+    }
+
+    /* Convert certain attributes into NautilusFileSortTypes and use
+     * nautilus_file_compare_for_sort()
+     */
+    sort_type = get_sort_type_for_attribute (attribute);
+    if (sort_type != NAUTILUS_FILE_SORT_NONE)
     {
         return nautilus_file_compare_for_sort (file_1, file_2,
-                                               NAUTILUS_FILE_SORT_BY_RECENCY,
+                                               sort_type,
                                                directories_first,
                                                reversed);
     }
@@ -4009,22 +4044,17 @@ nautilus_file_compare_for_sort_by_attribute_q   (NautilusFile *file_1,
 
     if (result == 0)
     {
-        char *value_1;
-        char *value_2;
+        const char *value_1;
+        const char *value_2;
 
-        value_1 = nautilus_file_get_string_attribute_q (file_1,
-                                                        attribute);
-        value_2 = nautilus_file_get_string_attribute_q (file_2,
-                                                        attribute);
+        value_1 = get_sort_attribute_value (file_1, attribute);
+        value_2 = get_sort_attribute_value (file_2, attribute);
 
         if (value_1 != NULL && value_2 != NULL)
         {
             result = strcmp (value_1, value_2);
         }
 
-        g_free (value_1);
-        g_free (value_2);
-
         if (reversed)
         {
             result = -result;
@@ -4047,6 +4077,32 @@ nautilus_file_compare_for_sort_by_attribute     (NautilusFile *file_1,
                                                           reversed);
 }
 
+void
+nautilus_file_prepare_sort_key_q (NautilusFile *file,
+                                  GQuark        attribute)
+{
+    switch (get_sort_type_for_attribute (attribute))
+    {
+        case NAUTILUS_FILE_SORT_BY_TYPE:
+        {
+            get_type_collation_key (file);
+        }
+        break;
+
+        case NAUTILUS_FILE_SORT_NONE:
+        {
+            get_sort_attribute_value (file, attribute);
+        }
+        break;
+
+        default:
+        {
+            /* Names have their keys already, the rest are numbers. */
+        }
+        break;
+    }
+}
+
 
 /**
  * nautilus_file_compare_name:
@@ -8525,6 +8581,9 @@ nautilus_file_emit_changed (NautilusFile *file)
 
     g_assert (NAUTILUS_IS_FILE (file));
 
+    /* Whatever changed might sort differently now. */
+    clear_sort_keys (file);
+
     /* Send out a signal. */
     g_signal_emit (file, signals[CHANGED], 0, file);
 
@@ -8767,6 +8826,71 @@ nautilus_file_set_is_thumbnailing (NautilusFile *file,
     file->details->is_thumbnailing = is_thumbnailing;
 }
 
+gboolean
+nautilus_file_is_offscreen (NautilusFile *file)
+{
+    g_return_val_if_fail (NAUTILUS_IS_FILE (file), FALSE);
+
+    return file->details->offscreen_view_count > 0 &&
+           file->details->onscreen_view_count == 0;
+}
+
+static void
+update_view_visibility (NautilusFile *file,
+                        gboolean      is_offscreen,
+                        int           delta)
+{
+    NautilusDirectory *directory;
+    gboolean was_offscreen;
+
+    was_offscreen = nautilus_file_is_offscreen (file);
+
+    if (is_offscreen)
+    {
+        file->details->offscreen_view_count += delta;
+    }
+    else
+    {
+        file->details->onscreen_view_count += delta;
+    }
+
+    if (was_offscreen == nautilus_file_is_offscreen (file))
+    {
+        return;
+    }
+
+    /* Let the directory cancel the thumbnail load, or pick it up again
+     * when the file scrolls back into view.
+     */
+    directory = file->details->directory;
+    if (directory != NULL)
+    {
+        nautilus_directory_add_file_to_work_queue (directory, file);
+        nautilus_directory_async_state_changed (directory);
+    }
+}
+
+void
+nautilus_file_add_view_visibility (NautilusFile *file,
+                                   gboolean      is_offscreen)
+{
+    g_return_if_fail (NAUTILUS_IS_FILE (file));
+
+    update_view_visibility (file, is_offscreen, 1);
+}
+
+void
+nautilus_file_remove_view_visibility (NautilusFile *file,
+                                      gboolean      is_offscreen)
+{
+    g_return_if_fail (NAUTILUS_IS_FILE (file));
+    g_return_if_fail (is_offscreen ?
+                      file->details->offscreen_view_count > 0 :
+                      file->details->onscreen_view_count > 0);
+
+    update_view_visibility (file, is_offscreen, -1);
+}
+
 
 /**
  * nautilus_file_invalidate_attributes
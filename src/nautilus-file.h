@@ -435,6 +435,12 @@ int                     nautilus_file_compare_for_sort_by_attribute_q   (Nautilu
 									 GQuark                          attribute,
 									 gboolean                        directories_first,
 									 gboolean                        reversed);
+/* Makes the key sorting by @attribute compares @file by, which is
+ * otherwise made the first time a comparison needs it. Sorts call this
+ * for every file first.
+ */
+void                    nautilus_file_prepare_sort_key_q                (NautilusFile                   *file,
+									 GQuark                          attribute);
 gboolean                nautilus_file_is_date_sort_attribute_q          (GQuark                          attribute);
 
 int                     nautilus_file_compare_location                  (NautilusFile                    *file_1,
@@ -481,6 +487,15 @@ GdkPixbuf *             nautilus_file_get_icon_pixbuf                   (Nautilu
 gboolean                nautilus_file_opens_in_view                     (NautilusFile                   *file);
 /* Thumbnailing handling */
 gboolean                nautilus_file_is_thumbnailing                   (NautilusFile                   *file);
+/* Canvas views count the files they show in, as out of view or not,
+ * and out again the same way. Files out of view in every canvas view
+ * showing them do not get their thumbnail loaded.
+ */
+void                    nautilus_file_add_view_visibility               (NautilusFile                   *file,
+									 gboolean                        is_offscreen);
+void                    nautilus_file_remove_view_visibility            (NautilusFile                   *file,
+									 gboolean                        is_offscreen);
+gboolean                nautilus_file_is_offscreen                      (NautilusFile                   *file);
 
 /* Convenience functions for dealing with a list of NautilusFile objects that each have a ref.
  * These are just convenient names for functions that work on lists of GtkObject *.
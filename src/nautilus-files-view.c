@@ -5407,11 +5407,37 @@ nautilus_load_custom_accel_for_scripts (void)
     g_free (path);
 }
 
+static void
+prepend_shown_file (NautilusFile *file,
+                    gpointer      callback_data)
+{
+    GList **files = callback_data;
+
+    if (nautilus_file_should_show (file, FALSE, TRUE))
+    {
+        *files = g_list_prepend (*files, nautilus_file_ref (file));
+    }
+}
+
+/* Only refs the files that aren't hidden, unlike
+ * nautilus_directory_get_file_list() followed by a filter.
+ */
+static GList *
+get_shown_files (NautilusDirectory *directory)
+{
+    GList *files;
+
+    files = NULL;
+    nautilus_directory_foreach_file (directory, prepend_shown_file, &files);
+
+    return files;
+}
+
 static GMenu *
 update_directory_in_scripts_menu (NautilusFilesView *view,
                                   NautilusDirectory *directory)
 {
-    GList *file_list, *filtered, *node;
+    GList *filtered, *node;
     GMenu *menu, *children_menu;
     GMenuItem *menu_item;
     gboolean any_scripts;
@@ -5431,9 +5457,7 @@ update_directory_in_scripts_menu (NautilusFilesView *view,
         nautilus_load_custom_accel_for_scripts ();
     }
 
-    file_list = nautilus_directory_get_file_list (directory);
-    filtered = nautilus_file_list_filter_hidden (file_list, FALSE);
-    nautilus_file_list_free (file_list);
+    filtered = get_shown_files (directory);
     menu = g_menu_new ();
 
     filtered = nautilus_file_list_sort_by_display_name (filtered);
@@ -5658,7 +5682,7 @@ static GMenu *
 update_directory_in_templates_menu (NautilusFilesView *view,
                                     NautilusDirectory *directory)
 {
-    GList *file_list, *filtered, *node;
+    GList *filtered, *node;
     GMenu *menu, *children_menu;
     GMenuItem *menu_item;
     gboolean any_templates;
@@ -5671,9 +5695,7 @@ update_directory_in_templates_menu (NautilusFilesView *view,
     g_return_val_if_fail (NAUTILUS_IS_FILES_VIEW (view), NULL);
     g_return_val_if_fail (NAUTILUS_IS_DIRECTORY (directory), NULL);
 
-    file_list = nautilus_directory_get_file_list (directory);
-    filtered = nautilus_file_list_filter_hidden (file_list, FALSE);
-    nautilus_file_list_free (file_list);
+    filtered = get_shown_files (directory);
     templates_directory_uri = nautilus_get_templates_directory_uri ();
     menu = g_menu_new ();
 
@@ -0,0 +1,170 @@
+/*
+ *  nautilus-inode-set.c: Set of (device, inode) pairs.
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License as
+ *  published by the Free Software Foundation; either version 2 of the
+ *  License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public
+ *  License along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+#include "nautilus-inode-set.h"
+
+#define INITIAL_SIZE 64
+
+typedef struct
+{
+    guint64 device;
+    guint64 inode;     /* 0 marks an empty slot */
+} InodeSetEntry;
+
+struct NautilusInodeSet
+{
+    InodeSetEntry *entries;
+    gsize mask;     /* number of slots - 1, the number of slots is a power of 2 */
+    guint count;
+};
+
+static inline gsize
+hash_entry (guint64 device,
+            guint64 inode)
+{
+    guint64 hash;
+
+    /* Inodes are mostly sequential, so mix the bits well. */
+    hash = inode ^ (device * G_GUINT64_CONSTANT (0x9e3779b97f4a7c15));
+    hash ^= hash >> 33;
+    hash *= G_GUINT64_CONSTANT (0xff51afd7ed558ccd);
+    hash ^= hash >> 33;
+
+    return (gsize) hash;
+}
+
+/* Returns the slot holding the pair, or the empty slot it would go in. */
+static InodeSetEntry *
+lookup_entry (InodeSetEntry *entries,
+              gsize          mask,
+              guint64        device,
+              guint64        inode)
+{
+    InodeSetEntry *entry;
+    gsize i;
+
+    for (i = hash_entry (device, inode) & mask;; i = (i + 1) & mask)
+    {
+        entry = &entries[i];
+        if (entry->inode == 0 ||
+            (entry->inode == inode && entry->device == device))
+        {
+            return entry;
+        }
+    }
+}
+
+static void
+grow (NautilusInodeSet *set)
+{
+    InodeSetEntry *old_entries, *entry;
+    gsize old_mask, i;
+
+    old_entries = set->entries;
+    old_mask = set->mask;
+
+    set->mask = (old_mask + 1) * 2 - 1;
+    set->entries = g_new0 (InodeSetEntry, set->mask + 1);
+
+    for (i = 0; i <= old_mask; i++)
+    {
+        if (old_entries[i].inode != 0)
+        {
+            entry = lookup_entry (set->entries, set->mask,
+                                  old_entries[i].device,
+                                  old_entries[i].inode);
+            *entry = old_entries[i];
+        }
+    }
+
+    g_free (old_entries);
+}
+
+NautilusInodeSet *
+nautilus_inode_set_new (void)
+{
+    NautilusInodeSet *set;
+
+    set = g_new0 (NautilusInodeSet, 1);
+    set->mask = INITIAL_SIZE - 1;
+    set->entries = g_new0 (InodeSetEntry, INITIAL_SIZE);
+
+    return set;
+}
+
+void
+nautilus_inode_set_free (NautilusInodeSet *set)
+{
+    if (set == NULL)
+    {
+        return;
+    }
+
+    g_free (set->entries);
+    g_free (set);
+}
+
+gboolean
+nautilus_inode_set_add (NautilusInodeSet *set,
+                        guint64           device,
+                        guint64           inode)
+{
+    InodeSetEntry *entry;
+
+    if (inode == 0)
+    {
+        return TRUE;
+    }
+
+    entry = lookup_entry (set->entries, set->mask, device, inode);
+    if (entry->inode != 0)
+    {
+        return FALSE;
+    }
+
+    entry->device = device;
+    entry->inode = inode;
+    set->count++;
+
+    /* Keep the table at most half full, so probe sequences stay short. */
+    if (set->count * 2 > set->mask + 1)
+    {
+        grow (set);
+    }
+
+    return TRUE;
+}
+
+gboolean
+nautilus_inode_set_contains (NautilusInodeSet *set,
+                             guint64           device,
+                             guint64           inode)
+{
+    if (inode == 0)
+    {
+        return FALSE;
+    }
+
+    return lookup_entry (set->entries, set->mask, device, inode)->inode != 0;
+}
+
+guint
+nautilus_inode_set_size (NautilusInodeSet *set)
+{
+    return set->count;
+}
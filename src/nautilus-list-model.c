@@ -807,6 +807,10 @@ nautilus_list_model_sort_file_entries (NautilusListModel *model,
         GSequenceIter *ptr = g_sequence_get_iter_at_pos (files, i);
 
         file_entry = g_sequence_get (ptr);
+        if (file_entry->file != NULL)
+        {
+            nautilus_file_prepare_sort_key_q (file_entry->file, model->details->sort_attribute);
+        }
         if (file_entry->files != NULL)
         {
             gtk_tree_path_append_index (path, i);
@@ -934,105 +938,204 @@ add_dummy_row (NautilusListModel *model,
     gtk_tree_path_free (path);
 }
 
+static int
+file_entry_ptr_compare_func (gconstpointer a,
+                             gconstpointer b,
+                             gpointer      user_data)
+{
+    return nautilus_list_model_file_entry_compare_func (*(FileEntry **) a,
+                                                        *(FileEntry **) b,
+                                                        user_data);
+}
+
+/* Removes the loading row of a directory whose first files arrive. */
+static gboolean
+remove_dummy_row (NautilusListModel *model,
+                  FileEntry         *parent_entry)
+{
+    GSequenceIter *dummy_ptr;
+    FileEntry *dummy_entry;
+
+    if (g_sequence_get_length (parent_entry->files) != 1)
+    {
+        return FALSE;
+    }
+
+    dummy_ptr = g_sequence_get_iter_at_pos (parent_entry->files, 0);
+    dummy_entry = g_sequence_get (dummy_ptr);
+    if (dummy_entry->file != NULL)
+    {
+        return FALSE;
+    }
+
+    model->details->stamp++;
+    g_sequence_remove (dummy_ptr);
+
+    return TRUE;
+}
+
+static void
+file_entry_inserted (NautilusListModel *model,
+                     FileEntry         *file_entry,
+                     gboolean           replace_dummy)
+{
+    GtkTreeIter iter;
+    GtkTreePath *path;
+
+    iter.stamp = model->details->stamp;
+    iter.user_data = file_entry->ptr;
+
+    path = gtk_tree_model_get_path (GTK_TREE_MODEL (model), &iter);
+    if (replace_dummy)
+    {
+        gtk_tree_model_row_changed (GTK_TREE_MODEL (model), path, &iter);
+    }
+    else
+    {
+        gtk_tree_model_row_inserted (GTK_TREE_MODEL (model), path, &iter);
+    }
+
+    if (nautilus_file_is_directory (file_entry->file))
+    {
+        file_entry->files = g_sequence_new ((GDestroyNotify) file_entry_free);
+
+        add_dummy_row (model, file_entry);
+
+        gtk_tree_model_row_has_child_toggled (GTK_TREE_MODEL (model),
+                                              path, &iter);
+    }
+    gtk_tree_path_free (path);
+}
+
 gboolean
 nautilus_list_model_add_file (NautilusListModel *model,
                               NautilusFile      *file,
                               NautilusDirectory *directory)
 {
-    GtkTreeIter iter;
-    GtkTreePath *path;
-    FileEntry *file_entry;
+    GList list;
+
+    list.data = file;
+    list.next = NULL;
+    list.prev = NULL;
+
+    return nautilus_list_model_add_files (model, &list, directory) == 1;
+}
+
+guint
+nautilus_list_model_add_files (NautilusListModel *model,
+                               GList             *files,
+                               NautilusDirectory *directory)
+{
+    FileEntry *file_entry, *parent_entry;
     GSequenceIter *ptr, *parent_ptr;
-    GSequence *files;
-    gboolean replace_dummy;
+    GSequence *sequence;
     GHashTable *parent_hash;
+    GPtrArray *entries;
+    NautilusFile *file;
+    gboolean replace_dummy, merge;
+    guint n_added, i;
+    GList *l;
 
     parent_ptr = g_hash_table_lookup (model->details->directory_reverse_map,
                                       directory);
     if (parent_ptr)
     {
-        file_entry = g_sequence_get (parent_ptr);
-        ptr = g_hash_table_lookup (file_entry->reverse_map, file);
+        parent_entry = g_sequence_get (parent_ptr);
+        sequence = parent_entry->files;
+        parent_hash = parent_entry->reverse_map;
     }
     else
     {
-        file_entry = NULL;
-        ptr = g_hash_table_lookup (model->details->top_reverse_map, file);
+        parent_entry = NULL;
+        sequence = model->details->files;
+        parent_hash = model->details->top_reverse_map;
     }
 
-    if (ptr != NULL)
+    entries = g_ptr_array_new ();
+    for (l = files; l != NULL; l = l->next)
     {
-        g_warning ("file already in tree (parent_ptr: %p)!!!\n", parent_ptr);
-        return FALSE;
-    }
+        file = l->data;
 
-    file_entry = g_new0 (FileEntry, 1);
-    file_entry->file = nautilus_file_ref (file);
-    file_entry->parent = NULL;
-    file_entry->subdirectory = NULL;
-    file_entry->files = NULL;
+        if (g_hash_table_contains (parent_hash, file))
+        {
+            g_warning ("file already in tree (parent_ptr: %p)!!!\n", parent_ptr);
+            continue;
+        }
 
-    files = model->details->files;
-    parent_hash = model->details->top_reverse_map;
+        file_entry = g_new0 (FileEntry, 1);
+        file_entry->file = nautilus_file_ref (file);
+        file_entry->parent = parent_entry;
+        g_ptr_array_add (entries, file_entry);
 
-    replace_dummy = FALSE;
+        /* Claimed right away, so a file given twice gets one row. The
+         * row is filled in once it is in the sequence.
+         */
+        g_hash_table_insert (parent_hash, file_entry->file, NULL);
+    }
 
-    if (parent_ptr != NULL)
+    n_added = entries->len;
+    if (n_added == 0)
+    {
+        g_ptr_array_free (entries, TRUE);
+        return 0;
+    }
+
+    replace_dummy = FALSE;
+    if (parent_entry != NULL)
     {
-        file_entry->parent = g_sequence_get (parent_ptr);
         /* At this point we set loaded. Either we saw
          * "done" and ignored it waiting for this, or we do this
          * earlier, but then we replace the dummy row anyway,
          * so it doesn't matter */
-        file_entry->parent->loaded = 1;
-        parent_hash = file_entry->parent->reverse_map;
-        files = file_entry->parent->files;
-        if (g_sequence_get_length (files) == 1)
-        {
-            GSequenceIter *dummy_ptr = g_sequence_get_iter_at_pos (files, 0);
-            FileEntry *dummy_entry = g_sequence_get (dummy_ptr);
-            if (dummy_entry->file == NULL)
-            {
-                /* replace the dummy loading entry */
-                model->details->stamp++;
-                g_sequence_remove (dummy_ptr);
-
-                replace_dummy = TRUE;
-            }
-        }
+        parent_entry->loaded = 1;
+        replace_dummy = remove_dummy_row (model, parent_entry);
     }
 
-
-    file_entry->ptr = g_sequence_insert_sorted (files, file_entry,
-                                                nautilus_list_model_file_entry_compare_func, model);
-
-    g_hash_table_insert (parent_hash, file, file_entry->ptr);
-
-    iter.stamp = model->details->stamp;
-    iter.user_data = file_entry->ptr;
-
-    path = gtk_tree_model_get_path (GTK_TREE_MODEL (model), &iter);
-    if (replace_dummy)
-    {
-        gtk_tree_model_row_changed (GTK_TREE_MODEL (model), path, &iter);
-    }
-    else
+    /* Sorted, the new files can be merged in one walk over the
+     * existing ones. That is only worth it if there are enough of them
+     * compared to looking each one up.
+     */
+    for (i = 0; i < n_added; i++)
     {
-        gtk_tree_model_row_inserted (GTK_TREE_MODEL (model), path, &iter);
+        file_entry = g_ptr_array_index (entries, i);
+        nautilus_file_prepare_sort_key_q (file_entry->file, model->details->sort_attribute);
     }
+    g_ptr_array_sort_with_data (entries, file_entry_ptr_compare_func, model);
+    merge = n_added * g_bit_storage (g_sequence_get_length (sequence)) >=
+            g_sequence_get_length (sequence) + n_added;
 
-    if (nautilus_file_is_directory (file))
+    ptr = g_sequence_get_begin_iter (sequence);
+    for (i = 0; i < n_added; i++)
     {
-        file_entry->files = g_sequence_new ((GDestroyNotify) file_entry_free);
+        file_entry = g_ptr_array_index (entries, i);
 
-        add_dummy_row (model, file_entry);
+        if (merge)
+        {
+            while (!g_sequence_iter_is_end (ptr) &&
+                   nautilus_list_model_file_entry_compare_func (g_sequence_get (ptr), file_entry, model) <= 0)
+            {
+                ptr = g_sequence_iter_next (ptr);
+            }
+            file_entry->ptr = g_sequence_insert_before (ptr, file_entry);
+        }
+        else
+        {
+            file_entry->ptr = g_sequence_insert_sorted (sequence, file_entry,
+                                                        nautilus_list_model_file_entry_compare_func, model);
+        }
 
-        gtk_tree_model_row_has_child_toggled (GTK_TREE_MODEL (model),
-                                              path, &iter);
+        g_hash_table_insert (parent_hash, file_entry->file, file_entry->ptr);
+
+        /* GtkTreeModel has no way to tell about several rows at once,
+         * but each row is told about as soon as it is in, so the view
+         * never sees rows it wasn't told about.
+         */
+        file_entry_inserted (model, file_entry, replace_dummy && i == 0);
     }
-    gtk_tree_path_free (path);
 
-    return TRUE;
+    g_ptr_array_free (entries, TRUE);
+
+    return n_added;
 }
 
 void
@@ -70,6 +70,12 @@ GType    nautilus_list_model_get_type                          (void);
 gboolean nautilus_list_model_add_file                          (NautilusListModel          *model,
 								NautilusFile         *file,
 								NautilusDirectory    *directory);
+/* Adds files of one directory at once, merging them in if there are
+ * many. Returns how many were not in the model yet.
+ */
+guint    nautilus_list_model_add_files                         (NautilusListModel          *model,
+								GList                *files,
+								NautilusDirectory    *directory);
 void     nautilus_list_model_file_changed                      (NautilusListModel          *model,
 								NautilusFile         *file,
 								NautilusDirectory    *directory);
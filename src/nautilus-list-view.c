@@ -2067,13 +2067,9 @@ nautilus_list_view_add_files (NautilusFilesView *view,
                               NautilusDirectory *directory)
 {
     NautilusListModel *model;
-    GList *l;
 
     model = NAUTILUS_LIST_VIEW (view)->details->model;
-    for (l = files; l != NULL; l = l->next)
-    {
-        nautilus_list_model_add_file (model, NAUTILUS_FILE (l->data), directory);
-    }
+    nautilus_list_model_add_files (model, files, directory);
 }
 
 static char **
@@ -37,23 +37,36 @@ struct NautilusMonitor
     GFile *location;
 };
 
-static gboolean call_consume_changes_idle_id = 0;
+/* Changes are consumed at most this long after they happened, giving
+ * the change queue a chance to fold events for the same file.
+ */
+#define CONSUME_CHANGES_DELAY_MSEC 50
+
+static guint call_consume_changes_id = 0;
 
 static gboolean
-call_consume_changes_idle_cb (gpointer not_used)
+call_consume_changes_cb (gpointer not_used)
 {
-    nautilus_file_changes_consume_changes (TRUE);
-    call_consume_changes_idle_id = 0;
-    return FALSE;
+    /* Go on as soon as the main loop is idle again if there are more. */
+    if (nautilus_file_changes_consume_changes (FALSE))
+    {
+        call_consume_changes_id = g_idle_add (call_consume_changes_cb, NULL);
+    }
+    else
+    {
+        call_consume_changes_id = 0;
+    }
+
+    return G_SOURCE_REMOVE;
 }
 
 static void
 schedule_call_consume_changes (void)
 {
-    if (call_consume_changes_idle_id == 0)
+    if (call_consume_changes_id == 0)
     {
-        call_consume_changes_idle_id =
-            g_idle_add (call_consume_changes_idle_cb, NULL);
+        call_consume_changes_id =
+            g_timeout_add (CONSUME_CHANGES_DELAY_MSEC, call_consume_changes_cb, NULL);
     }
 }
 
@@ -83,15 +96,6 @@ dir_changed (GFileMonitor      *monitor,
              GFileMonitorEvent  event_type,
              gpointer           user_data)
 {
-    char *uri, *to_uri;
-
-    uri = g_file_get_uri (child);
-    to_uri = NULL;
-    if (other_file)
-    {
-        to_uri = g_file_get_uri (other_file);
-    }
-
     switch (event_type)
     {
         default:
@@ -122,9 +126,6 @@ dir_changed (GFileMonitor      *monitor,
         break;
     }
 
-    g_free (uri);
-    g_free (to_uri);
-
     schedule_call_consume_changes ();
 }
 
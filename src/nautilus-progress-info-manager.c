@@ -24,10 +24,14 @@
 
 #include "nautilus-progress-info-manager.h"
 
+/* How often the progress of running infos is looked at. */
+#define SAMPLE_INTERVAL_MSEC 100
+
 struct _NautilusProgressInfoManagerPriv
 {
     GList *progress_infos;
     GList *current_viewers;
+    guint sample_id;
 };
 
 enum
@@ -64,6 +68,11 @@ nautilus_progress_info_manager_finalize (GObject *obj)
     }
     g_list_free (self->priv->current_viewers);
 
+    if (self->priv->sample_id != 0)
+    {
+        g_source_remove (self->priv->sample_id);
+    }
+
     G_OBJECT_CLASS (nautilus_progress_info_manager_parent_class)->finalize (obj);
 }
 
@@ -132,6 +141,36 @@ nautilus_progress_info_manager_dup_singleton (void)
     return g_object_new (NAUTILUS_TYPE_PROGRESS_INFO_MANAGER, NULL);
 }
 
+static gboolean
+sample_infos (gpointer user_data)
+{
+    NautilusProgressInfoManager *self;
+    gboolean running;
+    GList *l;
+
+    self = user_data;
+    running = FALSE;
+
+    for (l = self->priv->progress_infos; l != NULL; l = l->next)
+    {
+        nautilus_progress_info_sample (l->data);
+
+        if (!(nautilus_progress_info_get_is_finished (l->data) ||
+              nautilus_progress_info_get_is_cancelled (l->data)))
+        {
+            running = TRUE;
+        }
+    }
+
+    if (!running)
+    {
+        self->priv->sample_id = 0;
+        return G_SOURCE_REMOVE;
+    }
+
+    return G_SOURCE_CONTINUE;
+}
+
 void
 nautilus_progress_info_manager_add_new_info (NautilusProgressInfoManager *self,
                                              NautilusProgressInfo        *info)
@@ -145,6 +184,11 @@ nautilus_progress_info_manager_add_new_info (NautilusProgressInfoManager *self,
     self->priv->progress_infos =
         g_list_prepend (self->priv->progress_infos, g_object_ref (info));
 
+    if (self->priv->sample_id == 0)
+    {
+        self->priv->sample_id = g_timeout_add (SAMPLE_INTERVAL_MSEC, sample_infos, self);
+    }
+
     g_signal_emit (self, signals[NEW_PROGRESS_INFO], 0, info);
 }
 
@@ -20,7 +20,6 @@
  */
 
 #include <config.h>
-#include <math.h>
 #include <glib/gi18n.h>
 #include <eel/eel-string.h>
 #include <eel/eel-glib-extensions.h>
@@ -40,6 +39,9 @@ enum
 
 #define SIGNAL_DELAY_MSEC 100
 
+/* Progress is kept in this many parts of the whole. */
+#define PROGRESS_SCALE 10000
+
 static guint signals[LAST_SIGNAL] = { 0 };
 
 struct _NautilusProgressInfo
@@ -54,10 +56,6 @@ struct _NautilusProgressInfo
 
     char *status;
     char *details;
-    double progress;
-    gdouble remaining_time;
-    gdouble elapsed_time;
-    gboolean activity_mode;
     gboolean started;
     gboolean finished;
     gboolean paused;
@@ -69,9 +67,22 @@ struct _NautilusProgressInfo
     gboolean finish_at_idle;
     gboolean cancel_at_idle;
     gboolean changed_at_idle;
-    gboolean progress_at_idle;
 
     GFile *destination;
+
+    /* Set by the job without the lock, as often as it likes, and looked
+     * at on the main thread ten times a second, see
+     * nautilus_progress_info_sample(). The progress is in
+     * 1/PROGRESS_SCALE, -1 in activity mode. Times are in seconds.
+     */
+    gint progress;
+    gint pulses;
+    gint remaining_time;
+    gint elapsed_time;
+
+    /* Main thread only */
+    gint sampled_progress;
+    gint sampled_pulses;
 };
 
 struct _NautilusProgressInfoClass
@@ -192,7 +203,6 @@ idle_callback (gpointer data)
     gboolean start_at_idle;
     gboolean finish_at_idle;
     gboolean changed_at_idle;
-    gboolean progress_at_idle;
     gboolean cancelled_at_idle;
     GSource *source;
 
@@ -225,13 +235,11 @@ idle_callback (gpointer data)
     start_at_idle = info->start_at_idle;
     finish_at_idle = info->finish_at_idle;
     changed_at_idle = info->changed_at_idle;
-    progress_at_idle = info->progress_at_idle;
     cancelled_at_idle = info->cancel_at_idle;
 
     info->start_at_idle = FALSE;
     info->finish_at_idle = FALSE;
     info->changed_at_idle = FALSE;
-    info->progress_at_idle = FALSE;
     info->cancel_at_idle = FALSE;
 
     G_UNLOCK (progress_info);
@@ -250,13 +258,6 @@ idle_callback (gpointer data)
                        0);
     }
 
-    if (progress_at_idle)
-    {
-        g_signal_emit (info,
-                       signals[PROGRESS_CHANGED],
-                       0);
-    }
-
     if (finish_at_idle)
     {
         g_signal_emit (info,
@@ -412,22 +413,15 @@ nautilus_progress_info_get_details (NautilusProgressInfo *info)
 double
 nautilus_progress_info_get_progress (NautilusProgressInfo *info)
 {
-    double res;
-
-    G_LOCK (progress_info);
+    gint progress;
 
-    if (info->activity_mode)
-    {
-        res = -1.0;
-    }
-    else
+    progress = g_atomic_int_get (&info->progress);
+    if (progress < 0)
     {
-        res = info->progress;
+        return -1.0;
     }
 
-    G_UNLOCK (progress_info);
-
-    return res;
+    return (double) progress / PROGRESS_SCALE;
 }
 
 void
@@ -660,14 +654,8 @@ nautilus_progress_info_set_details (NautilusProgressInfo *info,
 void
 nautilus_progress_info_pulse_progress (NautilusProgressInfo *info)
 {
-    G_LOCK (progress_info);
-
-    info->activity_mode = TRUE;
-    info->progress = 0.0;
-    info->progress_at_idle = TRUE;
-    queue_idle (info, FALSE);
-
-    G_UNLOCK (progress_info);
+    g_atomic_int_set (&info->progress, -1);
+    g_atomic_int_inc (&info->pulses);
 }
 
 void
@@ -696,61 +684,56 @@ nautilus_progress_info_set_progress (NautilusProgressInfo *info,
         }
     }
 
-    G_LOCK (progress_info);
+    if (!g_cancellable_is_cancelled (info->cancellable))
+    {
+        g_atomic_int_set (&info->progress, (gint) (current_percent * PROGRESS_SCALE));
+    }
+}
 
-    if ((info->activity_mode ||     /* emit on switch from activity mode */
-         fabs (current_percent - info->progress) > 0.005) &&    /* Emit on change of 0.5 percent */
-        !g_cancellable_is_cancelled (info->cancellable))
+void
+nautilus_progress_info_sample (NautilusProgressInfo *info)
+{
+    gint progress, pulses;
+
+    progress = g_atomic_int_get (&info->progress);
+    pulses = g_atomic_int_get (&info->pulses);
+
+    if (progress == info->sampled_progress &&
+        pulses == info->sampled_pulses)
     {
-        info->activity_mode = FALSE;
-        info->progress = current_percent;
-        info->progress_at_idle = TRUE;
-        queue_idle (info, FALSE);
+        return;
     }
 
-    G_UNLOCK (progress_info);
+    info->sampled_progress = progress;
+    info->sampled_pulses = pulses;
+
+    g_signal_emit (info, signals[PROGRESS_CHANGED], 0);
 }
 
 void
 nautilus_progress_info_set_remaining_time (NautilusProgressInfo *info,
                                            gdouble               time)
 {
-    G_LOCK (progress_info);
-    info->remaining_time = time;
-    G_UNLOCK (progress_info);
+    g_atomic_int_set (&info->remaining_time, (gint) MIN (time, G_MAXINT));
 }
 
 gdouble
 nautilus_progress_info_get_remaining_time (NautilusProgressInfo *info)
 {
-    gint remaining_time;
-
-    G_LOCK (progress_info);
-    remaining_time = info->remaining_time;
-    G_UNLOCK (progress_info);
-
-    return remaining_time;
+    return g_atomic_int_get (&info->remaining_time);
 }
 
 void
 nautilus_progress_info_set_elapsed_time (NautilusProgressInfo *info,
                                          gdouble               time)
 {
-    G_LOCK (progress_info);
-    info->elapsed_time = time;
-    G_UNLOCK (progress_info);
+    g_atomic_int_set (&info->elapsed_time, (gint) MIN (time, G_MAXINT));
 }
 
 gdouble
 nautilus_progress_info_get_elapsed_time (NautilusProgressInfo *info)
 {
-    gint elapsed_time;
-
-    G_LOCK (progress_info);
-    elapsed_time = info->elapsed_time;
-    G_UNLOCK (progress_info);
-
-    return elapsed_time;
+    return g_atomic_int_get (&info->elapsed_time);
 }
 
 gdouble
@@ -43,8 +43,9 @@ GType nautilus_progress_info_get_type (void) G_GNUC_CONST;
    "started" - emited on job start
    "finished" - emitted when job is done
    
-   All signals are emitted from idles in main loop.
-   All methods are threadsafe.
+   All signals are emitted from idles in main loop, "progress-changed"
+   from nautilus_progress_info_sample().
+   All methods are threadsafe, except nautilus_progress_info_sample().
  */
 
 NautilusProgressInfo *nautilus_progress_info_new (void);
@@ -78,6 +79,13 @@ void          nautilus_progress_info_set_progress    (NautilusProgressInfo *info
 						      double                total);
 void          nautilus_progress_info_pulse_progress  (NautilusProgressInfo *info);
 
+/* Emits "progress-changed" if the progress was set or pulsed since the
+ * last call. The progress setters take no lock, they leave it to this,
+ * which NautilusProgressInfoManager calls on the main thread ten times
+ * a second.
+ */
+void          nautilus_progress_info_sample          (NautilusProgressInfo *info);
+
 void          nautilus_progress_info_set_remaining_time (NautilusProgressInfo *info,
                                                          gdouble               time);
 gdouble       nautilus_progress_info_get_remaining_time (NautilusProgressInfo *info);
@@ -0,0 +1,536 @@
+/*
+ *  nautilus-query-matcher.c: Matching file names against search text.
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License as
+ *  published by the Free Software Foundation; either version 2 of the
+ *  License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public
+ *  License along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+#include "nautilus-query-matcher.h"
+
+#include <math.h>
+#include <string.h>
+
+/* Looking for more words in file contents than fit the bits of a state
+ * output isn't worth it, the first ones are rare enough.
+ */
+#define MAX_CONTENT_WORDS 32
+
+typedef struct
+{
+    char *text;
+    gsize length;
+} MatcherWord;
+
+struct NautilusQueryMatcher
+{
+    gint ref_count;
+
+    /* NULL if the matcher matches nothing. */
+    MatcherWord *words;
+    guint n_words;
+
+    /* Set if names made of ASCII only can be lowercased byte by byte.
+     * Not the case with Turkish rules, where 'I' becomes a dotless i.
+     */
+    gboolean ascii_fast_path;
+
+    /* Set if every word is ASCII, so an ASCII name can only contain
+     * them if it is lowercased byte by byte.
+     */
+    gboolean ascii_words;
+
+    /* Finds all words in one pass over file contents. A byte moves the
+     * automaton from one state to the next, in a table of 256
+     * transitions per state, and the output of a state has a bit set
+     * for each word ending there.
+     */
+    guint32 *transitions;
+    guint32 *outputs;
+    guint n_content_words;
+};
+
+struct NautilusQueryContentMatch
+{
+    NautilusQueryMatcher *matcher;
+    guint32 state;
+    guint counts[MAX_CONTENT_WORDS];
+};
+
+/* Names are lowercased into this, one per thread, so matching an ASCII
+ * name doesn't allocate.
+ */
+static GPrivate fold_buffer = G_PRIVATE_INIT ((GDestroyNotify) g_byte_array_unref);
+
+static char *
+prepare_string_for_compare (const char *string)
+{
+    char *normalized, *res;
+
+    normalized = g_utf8_normalize (string, -1, G_NORMALIZE_NFD);
+    res = g_utf8_strdown (normalized, -1);
+    g_free (normalized);
+
+    return res;
+}
+
+static gboolean
+is_ascii (const char *string)
+{
+    const guchar *p;
+
+    for (p = (const guchar *) string; *p != '\0'; p++)
+    {
+        if (*p >= 0x80)
+        {
+            return FALSE;
+        }
+    }
+
+    return TRUE;
+}
+
+/* Builds the automaton finding any of the words, Aho-Corasick style:
+ * first a trie of the words, then every missing transition is pointed
+ * to where the longest suffix found so far continues.
+ */
+static void
+build_content_automaton (NautilusQueryMatcher *matcher)
+{
+    GPtrArray *words;
+    GQueue queue = G_QUEUE_INIT;
+    guint32 *transitions, *outputs, *fallbacks;
+    guint32 state, next, fallback;
+    gsize n_states, max_states;
+    const guchar *p;
+    char *word;
+    guint i, c;
+
+    words = g_ptr_array_new_with_free_func (g_free);
+    max_states = 1;
+    for (i = 0; i < matcher->n_words && words->len < MAX_CONTENT_WORDS; i++)
+    {
+        /* Trailing or doubled spaces make empty words. */
+        if (matcher->words[i].length == 0)
+        {
+            continue;
+        }
+
+        /* Text in files is mostly precomposed. */
+        word = g_utf8_normalize (matcher->words[i].text, -1, G_NORMALIZE_NFC);
+        g_ptr_array_add (words, word);
+        max_states += strlen (word);
+    }
+    matcher->n_content_words = words->len;
+
+    transitions = g_new (guint32, max_states * 256);
+    outputs = g_new0 (guint32, max_states);
+    fallbacks = g_new0 (guint32, max_states);
+    memset (transitions, 0xff, max_states * 256 * sizeof (guint32));
+
+    n_states = 1;
+    for (i = 0; i < words->len; i++)
+    {
+        state = 0;
+        for (p = g_ptr_array_index (words, i); *p != '\0'; p++)
+        {
+            if (transitions[state * 256 + *p] == G_MAXUINT32)
+            {
+                transitions[state * 256 + *p] = n_states++;
+            }
+            state = transitions[state * 256 + *p];
+        }
+        /* An empty word is found anywhere. */
+        outputs[state] |= 1u << i;
+    }
+
+    for (c = 0; c < 256; c++)
+    {
+        next = transitions[c];
+        if (next == G_MAXUINT32)
+        {
+            transitions[c] = 0;
+        }
+        else
+        {
+            fallbacks[next] = 0;
+            g_queue_push_tail (&queue, GUINT_TO_POINTER (next));
+        }
+    }
+
+    /* Breadth first, so the fallback of a state is complete before it. */
+    while (!g_queue_is_empty (&queue))
+    {
+        state = GPOINTER_TO_UINT (g_queue_pop_head (&queue));
+        outputs[state] |= outputs[fallbacks[state]];
+
+        for (c = 0; c < 256; c++)
+        {
+            next = transitions[state * 256 + c];
+            fallback = transitions[fallbacks[state] * 256 + c];
+            if (next == G_MAXUINT32)
+            {
+                transitions[state * 256 + c] = fallback;
+            }
+            else
+            {
+                fallbacks[next] = fallback;
+                g_queue_push_tail (&queue, GUINT_TO_POINTER (next));
+            }
+        }
+    }
+
+    /* The words are lowercase, so upper case ASCII goes the same way. */
+    for (state = 0; state < n_states; state++)
+    {
+        for (c = 'A'; c <= 'Z'; c++)
+        {
+            transitions[state * 256 + c] = transitions[state * 256 + c + ('a' - 'A')];
+        }
+    }
+
+    matcher->transitions = g_renew (guint32, transitions, n_states * 256);
+    matcher->outputs = outputs;
+
+    g_free (fallbacks);
+    g_ptr_array_unref (words);
+}
+
+NautilusQueryMatcher *
+nautilus_query_matcher_new (const char *text)
+{
+    NautilusQueryMatcher *matcher;
+    char *prepared, *lowered;
+    char **words;
+    guint i;
+
+    matcher = g_new0 (NautilusQueryMatcher, 1);
+    matcher->ref_count = 1;
+
+    if (text == NULL)
+    {
+        return matcher;
+    }
+
+    prepared = prepare_string_for_compare (text);
+    words = g_strsplit (prepared, " ", -1);
+    g_free (prepared);
+
+    matcher->n_words = g_strv_length (words);
+    matcher->words = g_new (MatcherWord, MAX (matcher->n_words, 1));
+    matcher->ascii_words = TRUE;
+    for (i = 0; i < matcher->n_words; i++)
+    {
+        /* Owned by the matcher now, only the vector is freed. */
+        matcher->words[i].text = words[i];
+        matcher->words[i].length = strlen (words[i]);
+        matcher->ascii_words &= is_ascii (words[i]);
+    }
+    g_free (words);
+
+    lowered = g_utf8_strdown ("I", -1);
+    matcher->ascii_fast_path = strcmp (lowered, "i") == 0;
+    g_free (lowered);
+
+    build_content_automaton (matcher);
+
+    return matcher;
+}
+
+NautilusQueryMatcher *
+nautilus_query_matcher_ref (NautilusQueryMatcher *matcher)
+{
+    g_return_val_if_fail (matcher != NULL, NULL);
+
+    g_atomic_int_inc (&matcher->ref_count);
+
+    return matcher;
+}
+
+void
+nautilus_query_matcher_unref (NautilusQueryMatcher *matcher)
+{
+    guint i;
+
+    g_return_if_fail (matcher != NULL);
+
+    if (!g_atomic_int_dec_and_test (&matcher->ref_count))
+    {
+        return;
+    }
+
+    for (i = 0; i < matcher->n_words; i++)
+    {
+        g_free (matcher->words[i].text);
+    }
+    g_free (matcher->words);
+    g_free (matcher->transitions);
+    g_free (matcher->outputs);
+    g_free (matcher);
+}
+
+#define ONES G_GUINT64_CONSTANT (0x0101010101010101)
+#define HIGH_BITS (ONES * 0x80)
+
+/* Lowercases 8 ASCII characters at once. Adding to each byte sets its
+ * high bit if it is at least 'A', and another addition if it is past
+ * 'Z'. No byte carries into the next one, as none has its high bit set.
+ */
+static inline guint64
+fold_ascii_word (guint64 word)
+{
+    guint64 at_least_a, past_z;
+
+    at_least_a = word + ONES * (0x80 - 'A');
+    past_z = word + ONES * (0x7f - 'Z');
+
+    return word | (((at_least_a ^ past_z) & HIGH_BITS) >> 2);
+}
+
+/* Lowercases name into the buffer of this thread. Returns NULL if the
+ * name isn't ASCII.
+ */
+static const char *
+fold_ascii (const char *name,
+            gsize      *length)
+{
+    GByteArray *buffer;
+    guint64 word;
+    guchar c, *folded;
+    gsize i;
+
+    buffer = g_private_get (&fold_buffer);
+    if (buffer == NULL)
+    {
+        buffer = g_byte_array_sized_new (256);
+        g_private_set (&fold_buffer, buffer);
+    }
+
+    /* Never shrinks, so this only allocates for the longest names. */
+    *length = strlen (name);
+    g_byte_array_set_size (buffer, *length + 1);
+    folded = buffer->data;
+
+    for (i = 0; i + sizeof (word) <= *length; i += sizeof (word))
+    {
+        memcpy (&word, name + i, sizeof (word));
+        if ((word & HIGH_BITS) != 0)
+        {
+            return NULL;
+        }
+        word = fold_ascii_word (word);
+        memcpy (folded + i, &word, sizeof (word));
+    }
+
+    for (; i <= *length; i++)
+    {
+        c = name[i];
+        if (c >= 0x80)
+        {
+            return NULL;
+        }
+        folded[i] = (c >= 'A' && c <= 'Z') ? c + ('a' - 'A') : c;
+    }
+
+    return (const char *) folded;
+}
+
+/* Returns the offset of word in string, or -1. Looks for the first byte
+ * with memchr(), which checks many bytes at once, before comparing.
+ */
+static gssize
+find_word (const char        *string,
+           gsize              length,
+           const MatcherWord *word)
+{
+    const char *p, *last;
+
+    if (word->length == 0)
+    {
+        return 0;
+    }
+
+    if (word->length > length)
+    {
+        return -1;
+    }
+
+    p = string;
+    last = string + length - word->length;
+    while (p <= last &&
+           (p = memchr (p, word->text[0], last - p + 1)) != NULL)
+    {
+        if (memcmp (p + 1, word->text + 1, word->length - 1) == 0)
+        {
+            return p - string;
+        }
+        p++;
+    }
+
+    return -1;
+}
+
+gdouble
+nautilus_query_matcher_match (NautilusQueryMatcher *matcher,
+                              const char           *name)
+{
+    const char *folded;
+    char *prepared;
+    gsize length;
+    gssize offset;
+    gint nonexact_malus;
+    gdouble retval;
+    guint i;
+
+    g_return_val_if_fail (matcher != NULL, -1);
+
+    if (matcher->words == NULL)
+    {
+        return -1;
+    }
+
+    prepared = NULL;
+    folded = NULL;
+    if (matcher->ascii_fast_path)
+    {
+        folded = fold_ascii (name, &length);
+        if (folded != NULL && !matcher->ascii_words)
+        {
+            return -1;
+        }
+    }
+
+    if (folded == NULL)
+    {
+        prepared = prepare_string_for_compare (name);
+        folded = prepared;
+        length = strlen (prepared);
+    }
+
+    offset = 0;
+    nonexact_malus = 0;
+    for (i = 0; i < matcher->n_words; i++)
+    {
+        offset = find_word (folded, length, &matcher->words[i]);
+        if (offset < 0)
+        {
+            g_free (prepared);
+            return -1;
+        }
+
+        nonexact_malus += length - offset - matcher->words[i].length;
+    }
+
+    g_free (prepared);
+
+    /* Earlier and tighter matches of the last word score higher. */
+    retval = MAX (10.0, 50.0 - (gdouble) offset - nonexact_malus);
+
+    return retval;
+}
+
+NautilusQueryContentMatch *
+nautilus_query_content_match_new (NautilusQueryMatcher *matcher)
+{
+    NautilusQueryContentMatch *match;
+
+    g_return_val_if_fail (matcher != NULL, NULL);
+
+    match = g_new0 (NautilusQueryContentMatch, 1);
+    match->matcher = nautilus_query_matcher_ref (matcher);
+
+    return match;
+}
+
+void
+nautilus_query_content_match_feed (NautilusQueryContentMatch *match,
+                                   const char                *data,
+                                   gsize                      length)
+{
+    const guint32 *transitions, *outputs;
+    const guchar *p, *end;
+    guint32 state, output;
+    gint word;
+
+    transitions = match->matcher->transitions;
+    outputs = match->matcher->outputs;
+    if (transitions == NULL)
+    {
+        return;
+    }
+
+    state = match->state;
+    end = (const guchar *) data + length;
+    for (p = (const guchar *) data; p < end; p++)
+    {
+        /* Most bytes start no word, skip those without going through
+         * the states one after the other.
+         */
+        if (state == 0)
+        {
+            while (p < end && transitions[*p] == 0)
+            {
+                p++;
+            }
+            if (p == end)
+            {
+                break;
+            }
+        }
+
+        state = transitions[state * 256 + *p];
+        output = outputs[state];
+        if (G_UNLIKELY (output != 0))
+        {
+            for (word = g_bit_nth_lsf (output, -1); word >= 0; word = g_bit_nth_lsf (output, word))
+            {
+                match->counts[word]++;
+            }
+        }
+    }
+    match->state = state;
+}
+
+gdouble
+nautilus_query_content_match_finish (NautilusQueryContentMatch *match)
+{
+    gdouble rank;
+    guint i, n_words;
+
+    n_words = match->matcher->n_content_words;
+    rank = n_words > 0 ? 0.0 : -1;
+    for (i = 0; i < n_words && rank > -1; i++)
+    {
+        if (match->counts[i] == 0)
+        {
+            rank = -1;
+        }
+        else
+        {
+            rank += log (match->counts[i]);
+        }
+    }
+
+    if (rank > -1)
+    {
+        /* Like term frequency, the tenth occurrence adds less than the
+         * second one did.
+         */
+        rank = MIN (10.0, 1.0 + rank / n_words);
+    }
+
+    nautilus_query_matcher_unref (match->matcher);
+    g_free (match);
+
+    return rank;
+}
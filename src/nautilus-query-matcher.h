@@ -0,0 +1,57 @@
+/*
+   nautilus-query-matcher.h: Matching file names against search text.
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of the
+   License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public
+   License along with this program; if not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef NAUTILUS_QUERY_MATCHER_H
+#define NAUTILUS_QUERY_MATCHER_H
+
+#include <glib.h>
+
+/* The words of the search text, normalized and lowercased once. A
+ * matcher never changes after it is made, so any number of threads can
+ * use it at once without locking.
+ */
+typedef struct NautilusQueryMatcher NautilusQueryMatcher;
+
+/* A NULL text matches nothing. */
+NautilusQueryMatcher *nautilus_query_matcher_new   (const char           *text);
+NautilusQueryMatcher *nautilus_query_matcher_ref   (NautilusQueryMatcher *matcher);
+void                  nautilus_query_matcher_unref (NautilusQueryMatcher *matcher);
+
+/* Returns -1 if some word of the text is not in name, a score of at
+ * least 10 otherwise. Higher is better.
+ */
+gdouble               nautilus_query_matcher_match (NautilusQueryMatcher *matcher,
+						    const char           *name);
+
+/* Looks for the words of the text in the contents of a file, fed in
+ * chunks of any size, so the whole file never has to be in memory.
+ * ASCII letters are found regardless of case, other characters only as
+ * typed, precomposed. Only the first 32 words are looked for.
+ */
+typedef struct NautilusQueryContentMatch NautilusQueryContentMatch;
+
+NautilusQueryContentMatch *nautilus_query_content_match_new    (NautilusQueryMatcher      *matcher);
+void                       nautilus_query_content_match_feed   (NautilusQueryContentMatch *match,
+								const char                *data,
+								gsize                      length);
+
+/* Frees @match. Returns -1 if some word was not found, a rank between 1
+ * and 10 otherwise, growing with how often the words were found.
+ */
+gdouble                    nautilus_query_content_match_finish (NautilusQueryContentMatch *match);
+
+#endif /* NAUTILUS_QUERY_MATCHER_H */
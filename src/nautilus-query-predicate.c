@@ -0,0 +1,218 @@
+/*
+ *  nautilus-query-predicate.c: The date and mime type filters of a
+ *  query, checked cheaply for every file a search looks at.
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License as
+ *  published by the Free Software Foundation; either version 2 of the
+ *  License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public
+ *  License along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+#include "nautilus-query-predicate.h"
+
+#include <string.h>
+
+struct NautilusQueryPredicate
+{
+    /* In microseconds since the epoch. A file time has to be after
+     * the start and less than a day after the end, which is the day
+     * the range ends on, the same as nautilus_file_date_in_between().
+     */
+    gboolean has_date_range;
+    gboolean use_access_time;
+    gint64 date_start;
+    gint64 date_end;
+
+    /* The mime types asked for. */
+    GList *mime_types;
+
+    /* Mime types seen so far -> whether it is one of those asked for
+     * or a subtype of one. Filled in as files come, as a search sees
+     * few of all the known types. Lock it when accessing.
+     */
+    GRWLock mime_type_lock;
+    GHashTable *mime_type_matches;
+
+    const char *attributes;
+};
+
+static gint64
+date_time_to_usec (GDateTime *date)
+{
+    return g_date_time_to_unix (date) * G_USEC_PER_SEC + g_date_time_get_microsecond (date);
+}
+
+static gboolean
+is_one_of_mime_types (GList      *mime_types,
+                      const char *mime_type)
+{
+    GList *l;
+
+    for (l = mime_types; l != NULL; l = l->next)
+    {
+        if (g_content_type_is_a (mime_type, l->data))
+        {
+            return TRUE;
+        }
+    }
+
+    return FALSE;
+}
+
+NautilusQueryPredicate *
+nautilus_query_predicate_new (NautilusQuery *query)
+{
+    NautilusQueryPredicate *predicate;
+    GPtrArray *date_range;
+
+    predicate = g_new0 (NautilusQueryPredicate, 1);
+
+    date_range = nautilus_query_get_date_range (query);
+    if (date_range != NULL)
+    {
+        predicate->has_date_range = TRUE;
+        predicate->use_access_time = nautilus_query_get_search_type (query) == NAUTILUS_QUERY_SEARCH_TYPE_LAST_ACCESS;
+        predicate->date_start = date_time_to_usec (g_ptr_array_index (date_range, 0));
+        predicate->date_end = date_time_to_usec (g_ptr_array_index (date_range, 1)) + G_TIME_SPAN_DAY;
+        g_ptr_array_unref (date_range);
+    }
+
+    predicate->mime_types = nautilus_query_get_mime_types (query);
+    if (predicate->mime_types != NULL)
+    {
+        g_rw_lock_init (&predicate->mime_type_lock);
+        predicate->mime_type_matches = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+    }
+
+    if (predicate->mime_types != NULL && predicate->use_access_time)
+    {
+        predicate->attributes = G_FILE_ATTRIBUTE_STANDARD_CONTENT_TYPE "," G_FILE_ATTRIBUTE_TIME_ACCESS;
+    }
+    else if (predicate->mime_types != NULL)
+    {
+        predicate->attributes = G_FILE_ATTRIBUTE_STANDARD_CONTENT_TYPE;
+    }
+    else if (predicate->use_access_time)
+    {
+        predicate->attributes = G_FILE_ATTRIBUTE_TIME_ACCESS;
+    }
+
+    return predicate;
+}
+
+void
+nautilus_query_predicate_free (NautilusQueryPredicate *predicate)
+{
+    g_list_free_full (predicate->mime_types, g_free);
+    if (predicate->mime_type_matches != NULL)
+    {
+        g_hash_table_destroy (predicate->mime_type_matches);
+        g_rw_lock_clear (&predicate->mime_type_lock);
+    }
+    g_free (predicate);
+}
+
+const char *
+nautilus_query_predicate_get_attributes (NautilusQueryPredicate *predicate)
+{
+    return predicate->attributes;
+}
+
+gboolean
+nautilus_query_predicate_has_date_range (NautilusQueryPredicate *predicate)
+{
+    return predicate->has_date_range;
+}
+
+gboolean
+nautilus_query_predicate_has_mime_types (NautilusQueryPredicate *predicate)
+{
+    return predicate->mime_types != NULL;
+}
+
+gboolean
+nautilus_query_predicate_matches_date (NautilusQueryPredicate *predicate,
+                                       guint64                 mtime,
+                                       guint64                 atime)
+{
+    gint64 time;
+
+    if (!predicate->has_date_range)
+    {
+        return TRUE;
+    }
+
+    /* No time at all is an error, never in the range. */
+    time = predicate->use_access_time ? atime : mtime;
+    if (time == 0)
+    {
+        return FALSE;
+    }
+
+    time *= G_USEC_PER_SEC;
+
+    return time > predicate->date_start && time < predicate->date_end;
+}
+
+gboolean
+nautilus_query_predicate_matches_mime_type (NautilusQueryPredicate *predicate,
+                                            const char             *mime_type)
+{
+    gpointer value;
+    gboolean found;
+    gboolean matches;
+
+    if (predicate->mime_types == NULL)
+    {
+        return TRUE;
+    }
+
+    if (mime_type == NULL)
+    {
+        return FALSE;
+    }
+
+    g_rw_lock_reader_lock (&predicate->mime_type_lock);
+    found = g_hash_table_lookup_extended (predicate->mime_type_matches, mime_type, NULL, &value);
+    g_rw_lock_reader_unlock (&predicate->mime_type_lock);
+    if (found)
+    {
+        return GPOINTER_TO_INT (value);
+    }
+
+    /* Two threads may both get here for the same type, and both find
+     * the same answer.
+     */
+    matches = is_one_of_mime_types (predicate->mime_types, mime_type);
+
+    g_rw_lock_writer_lock (&predicate->mime_type_lock);
+    g_hash_table_replace (predicate->mime_type_matches, g_strdup (mime_type), GINT_TO_POINTER (matches));
+    g_rw_lock_writer_unlock (&predicate->mime_type_lock);
+
+    return matches;
+}
+
+gboolean
+nautilus_query_predicate_matches_info (NautilusQueryPredicate *predicate,
+                                       GFileInfo              *info)
+{
+    if (predicate->has_date_range &&
+        !nautilus_query_predicate_matches_date (predicate,
+                                                g_file_info_get_attribute_uint64 (info, G_FILE_ATTRIBUTE_TIME_MODIFIED),
+                                                g_file_info_get_attribute_uint64 (info, G_FILE_ATTRIBUTE_TIME_ACCESS)))
+    {
+        return FALSE;
+    }
+
+    return nautilus_query_predicate_matches_mime_type (predicate,
+                                                       g_file_info_get_content_type (info));
+}
@@ -0,0 +1,51 @@
+/*
+   nautilus-query-predicate.h: The date and mime type filters of a query,
+   checked cheaply for every file a search looks at.
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of the
+   License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public
+   License along with this program; if not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef NAUTILUS_QUERY_PREDICATE_H
+#define NAUTILUS_QUERY_PREDICATE_H
+
+#include <gio/gio.h>
+#include "nautilus-query.h"
+
+/* Made once when a search starts. Dates become plain numbers, and
+ * whether a mime type is one of those the query asks for is only
+ * worked out once per type. Any number of threads can use it at once.
+ */
+typedef struct NautilusQueryPredicate NautilusQueryPredicate;
+
+NautilusQueryPredicate *nautilus_query_predicate_new               (NautilusQuery          *query);
+void                    nautilus_query_predicate_free              (NautilusQueryPredicate *predicate);
+
+/* The attributes matches_info() needs, besides the standard ones. */
+const char *            nautilus_query_predicate_get_attributes    (NautilusQueryPredicate *predicate);
+
+gboolean                nautilus_query_predicate_has_date_range    (NautilusQueryPredicate *predicate);
+gboolean                nautilus_query_predicate_has_mime_types    (NautilusQueryPredicate *predicate);
+
+/* These return TRUE if the query doesn't filter on it. */
+gboolean                nautilus_query_predicate_matches_date      (NautilusQueryPredicate *predicate,
+								    guint64                 mtime,
+								    guint64                 atime);
+gboolean                nautilus_query_predicate_matches_mime_type (NautilusQueryPredicate *predicate,
+								    const char             *mime_type);
+
+/* Checks the date first, it is the cheapest. */
+gboolean                nautilus_query_predicate_matches_info      (NautilusQueryPredicate *predicate,
+								    GFileInfo              *info);
+
+#endif /* NAUTILUS_QUERY_PREDICATE_H */
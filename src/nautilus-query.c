@@ -45,8 +45,7 @@ struct _NautilusQuery
 
     gboolean searching;
     gboolean recursive;
-    char **prepared_words;
-    GMutex prepared_words_mutex;
+    NautilusQueryMatcher *matcher;
 };
 
 static void  nautilus_query_class_init (NautilusQueryClass *class);
@@ -76,10 +75,9 @@ finalize (GObject *object)
     query = NAUTILUS_QUERY (object);
 
     g_free (query->text);
-    g_strfreev (query->prepared_words);
+    nautilus_query_matcher_unref (query->matcher);
     g_clear_object (&query->location);
     g_clear_pointer (&query->date_range, g_ptr_array_unref);
-    g_mutex_clear (&query->prepared_words_mutex);
 
     G_OBJECT_CLASS (nautilus_query_parent_class)->finalize (object);
 }
@@ -339,70 +337,22 @@ nautilus_query_init (NautilusQuery *query)
     query->location = g_file_new_for_path (g_get_home_dir ());
     query->search_type = g_settings_get_enum (nautilus_preferences, "search-filter-time-type");
     query->search_content = NAUTILUS_QUERY_SEARCH_CONTENT_SIMPLE;
-    g_mutex_init (&query->prepared_words_mutex);
-}
-
-static gchar *
-prepare_string_for_compare (const gchar *string)
-{
-    gchar *normalized, *res;
-
-    normalized = g_utf8_normalize (string, -1, G_NORMALIZE_NFD);
-    res = g_utf8_strdown (normalized, -1);
-    g_free (normalized);
-
-    return res;
+    query->matcher = nautilus_query_matcher_new (NULL);
 }
 
 gdouble
 nautilus_query_matches_string (NautilusQuery *query,
                                const gchar   *string)
 {
-    gchar *prepared_string, *ptr;
-    gboolean found;
-    gdouble retval;
-    gint idx, nonexact_malus;
-
-    if (!query->text)
-    {
-        return -1;
-    }
-
-    g_mutex_lock (&query->prepared_words_mutex);
-    if (!query->prepared_words)
-    {
-        prepared_string = prepare_string_for_compare (query->text);
-        query->prepared_words = g_strsplit (prepared_string, " ", -1);
-        g_free (prepared_string);
-    }
-
-    prepared_string = prepare_string_for_compare (string);
-    found = TRUE;
-    ptr = NULL;
-    nonexact_malus = 0;
-
-    for (idx = 0; query->prepared_words[idx] != NULL; idx++)
-    {
-        if ((ptr = strstr (prepared_string, query->prepared_words[idx])) == NULL)
-        {
-            found = FALSE;
-            break;
-        }
-
-        nonexact_malus += strlen (ptr) - strlen (query->prepared_words[idx]);
-    }
-    g_mutex_unlock (&query->prepared_words_mutex);
-
-    if (!found)
-    {
-        g_free (prepared_string);
-        return -1;
-    }
+    return nautilus_query_matcher_match (query->matcher, string);
+}
 
-    retval = MAX (10.0, 50.0 - (gdouble) (ptr - prepared_string) - nonexact_malus);
-    g_free (prepared_string);
+NautilusQueryMatcher *
+nautilus_query_get_matcher (NautilusQuery *query)
+{
+    g_return_val_if_fail (NAUTILUS_IS_QUERY (query), NULL);
 
-    return retval;
+    return nautilus_query_matcher_ref (query->matcher);
 }
 
 NautilusQuery *
@@ -429,10 +379,9 @@ nautilus_query_set_text (NautilusQuery *query,
     g_free (query->text);
     query->text = g_strstrip (g_strdup (text));
 
-    g_mutex_lock (&query->prepared_words_mutex);
-    g_strfreev (query->prepared_words);
-    query->prepared_words = NULL;
-    g_mutex_unlock (&query->prepared_words_mutex);
+    /* Searches still running keep their own reference to the old one. */
+    nautilus_query_matcher_unref (query->matcher);
+    query->matcher = nautilus_query_matcher_new (query->text);
 
     g_object_notify (G_OBJECT (query), "text");
 }
@@ -668,3 +617,89 @@ nautilus_query_is_empty (NautilusQuery *query)
 
     return FALSE;
 }
+
+NautilusQuery *
+nautilus_query_copy (NautilusQuery *query)
+{
+    NautilusQuery *copy;
+
+    g_return_val_if_fail (NAUTILUS_IS_QUERY (query), NULL);
+
+    copy = nautilus_query_new ();
+
+    copy->text = g_strdup (query->text);
+    nautilus_query_matcher_unref (copy->matcher);
+    copy->matcher = nautilus_query_matcher_ref (query->matcher);
+    g_clear_object (&copy->location);
+    copy->location = query->location != NULL ? g_object_ref (query->location) : NULL;
+    copy->mime_types = g_list_copy_deep (query->mime_types, (GCopyFunc) g_strdup, NULL);
+    copy->show_hidden = query->show_hidden;
+    copy->date_range = query->date_range != NULL ? g_ptr_array_ref (query->date_range) : NULL;
+    copy->search_type = query->search_type;
+    copy->search_content = query->search_content;
+    copy->recursive = query->recursive;
+
+    return copy;
+}
+
+static gboolean
+date_ranges_equal (GPtrArray *a,
+                   GPtrArray *b)
+{
+    if (a == NULL || b == NULL)
+    {
+        return a == b;
+    }
+
+    return g_date_time_equal (g_ptr_array_index (a, 0), g_ptr_array_index (b, 0)) &&
+           g_date_time_equal (g_ptr_array_index (a, 1), g_ptr_array_index (b, 1));
+}
+
+static gboolean
+mime_types_equal (GList *a,
+                  GList *b)
+{
+    for (; a != NULL && b != NULL; a = a->next, b = b->next)
+    {
+        if (g_strcmp0 (a->data, b->data) != 0)
+        {
+            return FALSE;
+        }
+    }
+
+    return a == NULL && b == NULL;
+}
+
+gboolean
+nautilus_query_is_refinement (NautilusQuery *query,
+                              NautilusQuery *previous)
+{
+    g_return_val_if_fail (NAUTILUS_IS_QUERY (query), FALSE);
+    g_return_val_if_fail (NAUTILUS_IS_QUERY (previous), FALSE);
+
+    /* Contents are not matched again, only names. */
+    if (query->search_content == NAUTILUS_QUERY_SEARCH_CONTENT_FULL_TEXT ||
+        previous->search_content != query->search_content)
+    {
+        return FALSE;
+    }
+
+    /* The last word of the previous text is at the start of a word of
+     * the text, the others are the same. Whatever has all the words of
+     * the text has all the previous ones.
+     */
+    if (previous->text == NULL || previous->text[0] == '\0' || query->text == NULL ||
+        strlen (query->text) <= strlen (previous->text) ||
+        !g_str_has_prefix (query->text, previous->text))
+    {
+        return FALSE;
+    }
+
+    return query->location != NULL && previous->location != NULL &&
+           g_file_equal (query->location, previous->location) &&
+           query->recursive == previous->recursive &&
+           query->show_hidden == previous->show_hidden &&
+           query->search_type == previous->search_type &&
+           mime_types_equal (query->mime_types, previous->mime_types) &&
+           date_ranges_equal (query->date_range, previous->date_range);
+}
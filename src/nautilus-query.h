@@ -25,6 +25,8 @@
 #include <glib-object.h>
 #include <gio/gio.h>
 
+#include "nautilus-query-matcher.h"
+
 typedef enum {
         NAUTILUS_QUERY_SEARCH_TYPE_LAST_ACCESS,
         NAUTILUS_QUERY_SEARCH_TYPE_LAST_MODIFIED
@@ -77,10 +79,22 @@ gboolean       nautilus_query_get_searching      (NautilusQuery *query);
 void           nautilus_query_set_searching      (NautilusQuery *query,
                                                   gboolean       searching);
 
+/* Only call this from the thread setting the text. Searches running in
+ * other threads match with the matcher they got when they started.
+ */
 gdouble        nautilus_query_matches_string     (NautilusQuery *query, const gchar *string);
+NautilusQueryMatcher *nautilus_query_get_matcher (NautilusQuery *query);
 
 char *         nautilus_query_to_readable_string (NautilusQuery *query);
 
 gboolean       nautilus_query_is_empty           (NautilusQuery *query);
 
+NautilusQuery *nautilus_query_copy               (NautilusQuery *query);
+
+/* Whether everything @query matches was matched by @previous too, which
+ * is the case when only words were typed on and nothing else changed.
+ */
+gboolean       nautilus_query_is_refinement      (NautilusQuery *query,
+                                                  NautilusQuery *previous);
+
 #endif /* NAUTILUS_QUERY_H */
@@ -90,20 +90,47 @@ search_directory_file_check_if_ready (NautilusFile           *file,
     return TRUE;
 }
 
+typedef struct
+{
+    guint directories;
+    guint files;
+} FileCounts;
+
+static void
+count_file (NautilusFile *file,
+            gpointer      callback_data)
+{
+    guint *count = callback_data;
+
+    (*count)++;
+}
+
+static void
+count_file_by_type (NautilusFile *file,
+                    gpointer      callback_data)
+{
+    FileCounts *counts = callback_data;
+
+    if (nautilus_file_get_file_type (file) == G_FILE_TYPE_DIRECTORY)
+    {
+        counts->directories++;
+    }
+    else
+    {
+        counts->files++;
+    }
+}
+
 static gboolean
 search_directory_file_get_item_count (NautilusFile *file,
                                       guint        *count,
                                       gboolean     *count_unreadable)
 {
-    GList *file_list;
-
     if (count)
     {
-        file_list = nautilus_directory_get_file_list (file->details->directory);
-
-        *count = g_list_length (file_list);
-
-        nautilus_file_list_free (file_list);
+        *count = 0;
+        nautilus_directory_foreach_file (file->details->directory,
+                                         count_file, count);
     }
 
     return TRUE;
@@ -116,35 +143,19 @@ search_directory_file_get_deep_counts (NautilusFile *file,
                                        guint        *unreadable_directory_count,
                                        goffset      *total_size)
 {
-    NautilusFile *dir_file;
-    GList *file_list, *l;
-    guint dirs, files;
-    GFileType type;
+    FileCounts counts;
 
-    file_list = nautilus_directory_get_file_list (file->details->directory);
-
-    dirs = files = 0;
-    for (l = file_list; l != NULL; l = l->next)
-    {
-        dir_file = NAUTILUS_FILE (l->data);
-        type = nautilus_file_get_file_type (dir_file);
-        if (type == G_FILE_TYPE_DIRECTORY)
-        {
-            dirs++;
-        }
-        else
-        {
-            files++;
-        }
-    }
+    counts.directories = counts.files = 0;
+    nautilus_directory_foreach_file (file->details->directory,
+                                     count_file_by_type, &counts);
 
     if (directory_count != NULL)
     {
-        *directory_count = dirs;
+        *directory_count = counts.directories;
     }
     if (file_count != NULL)
     {
-        *file_count = files;
+        *file_count = counts.files;
     }
     if (unreadable_directory_count != NULL)
     {
@@ -156,8 +167,6 @@ search_directory_file_get_deep_counts (NautilusFile *file,
         *total_size = 0;
     }
 
-    nautilus_file_list_free (file_list);
-
     return NAUTILUS_REQUEST_DONE;
 }
 
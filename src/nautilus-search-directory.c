@@ -61,6 +61,27 @@ struct NautilusSearchDirectoryDetails
     GList *files;
     GHashTable *files_hash;
 
+    /* A copy of the query as it was when the search started, the
+     * query itself changes as the user types.
+     */
+    NautilusQuery *searched_query;
+
+    /* What the last stopped search had found, kept in case the next
+     * one only narrows it down. If it had found everything, the
+     * engine doesn't have to run again.
+     */
+    NautilusQuery *previous_query;
+    GList *previous_files;
+    gboolean previous_search_complete;
+
+    /* Hits of the previous search matching the query, added from an
+     * idle so the clients that start the search get them as if the
+     * engine had found them.
+     */
+    gboolean refining;
+    GList *refined_hits;
+    guint refine_id;
+
     GList *monitor_list;
     GList *callback_list;
     GList *pending_callback_list;
@@ -114,6 +135,9 @@ static void search_engine_hits_added (NautilusSearchEngine    *engine,
 static void search_engine_error (NautilusSearchEngine    *engine,
                                  const char              *error,
                                  NautilusSearchDirectory *search);
+static void search_engine_finished (NautilusSearchEngine         *engine,
+                                    NautilusSearchProviderStatus  status,
+                                    NautilusSearchDirectory      *search);
 static void search_callback_file_ready_callback (NautilusFile *file,
                                                  gpointer      data);
 static void file_changed (NautilusFile            *file,
@@ -170,6 +194,80 @@ set_hidden_files (NautilusSearchDirectory *search)
     nautilus_query_set_show_hidden_files (search->details->query, monitor_hidden);
 }
 
+static void
+clear_previous_results (NautilusSearchDirectory *search)
+{
+    g_clear_object (&search->details->previous_query);
+    nautilus_file_list_free (search->details->previous_files);
+    search->details->previous_files = NULL;
+}
+
+static GList *
+filter_previous_files (NautilusSearchDirectory *search)
+{
+    GList *l, *hits;
+    NautilusFile *file;
+    NautilusSearchHit *hit;
+    GDateTime *date;
+    char *name, *uri;
+    gdouble match;
+
+    hits = NULL;
+    for (l = search->details->previous_files; l != NULL; l = l->next)
+    {
+        file = l->data;
+
+        name = nautilus_file_get_display_name (file);
+        match = nautilus_query_matches_string (search->details->query, name);
+        g_free (name);
+
+        if (match <= -1)
+        {
+            continue;
+        }
+
+        uri = nautilus_file_get_uri (file);
+        hit = nautilus_search_hit_new (uri);
+        g_free (uri);
+
+        nautilus_search_hit_set_fts_rank (hit, match);
+        date = g_date_time_new_from_unix_local (nautilus_file_get_mtime (file));
+        nautilus_search_hit_set_modification_time (hit, date);
+        g_date_time_unref (date);
+        date = g_date_time_new_from_unix_local (nautilus_file_get_atime (file));
+        nautilus_search_hit_set_access_time (hit, date);
+        g_date_time_unref (date);
+
+        hits = g_list_prepend (hits, hit);
+    }
+
+    return g_list_reverse (hits);
+}
+
+static gboolean
+add_refined_hits (gpointer user_data)
+{
+    NautilusSearchDirectory *search = user_data;
+    GList *hits;
+
+    search->details->refine_id = 0;
+    hits = search->details->refined_hits;
+    search->details->refined_hits = NULL;
+
+    search_engine_hits_added (search->details->engine, hits, search);
+    g_list_free_full (hits, g_object_unref);
+
+    /* The engine wasn't started, there is nothing else to find. */
+    if (search->details->previous_search_complete)
+    {
+        search_engine_finished (search->details->engine,
+                                NAUTILUS_SEARCH_PROVIDER_STATUS_NORMAL,
+                                search);
+    }
+
+    return G_SOURCE_REMOVE;
+}
+
 static void
 start_search (NautilusSearchDirectory *search)
 {
@@ -209,7 +307,31 @@ start_search (NautilusSearchDirectory *search)
 
     reset_file_list (search);
 
-    nautilus_search_provider_start (NAUTILUS_SEARCH_PROVIDER (search->details->engine));
+    search->details->refining = search->details->previous_query != NULL &&
+                                nautilus_query_is_refinement (search->details->query,
+                                                              search->details->previous_query);
+    if (search->details->refining)
+    {
+        search->details->refined_hits = filter_previous_files (search);
+        search->details->refine_id = g_idle_add (add_refined_hits, search);
+    }
+    else
+    {
+        search->details->previous_search_complete = FALSE;
+    }
+    clear_previous_results (search);
+
+    g_clear_object (&search->details->searched_query);
+    search->details->searched_query = nautilus_query_copy (search->details->query);
+
+    /* Only what the previous search didn't get to is left to find, but
+     * there is no telling where that is, so the engine starts over and
+     * files found twice are skipped.
+     */
+    if (!search->details->refining || !search->details->previous_search_complete)
+    {
+        nautilus_search_provider_start (NAUTILUS_SEARCH_PROVIDER (search->details->engine));
+    }
 }
 
 static void
@@ -223,6 +345,23 @@ stop_search (NautilusSearchDirectory *search)
     search->details->search_running = FALSE;
     nautilus_search_provider_stop (NAUTILUS_SEARCH_PROVIDER (search->details->engine));
 
+    if (search->details->refine_id != 0)
+    {
+        g_source_remove (search->details->refine_id);
+        search->details->refine_id = 0;
+    }
+    g_list_free_full (search->details->refined_hits, g_object_unref);
+    search->details->refined_hits = NULL;
+    search->details->refining = FALSE;
+
+    /* Keep the results around, the next query might only narrow them
+     * down.
+     */
+    clear_previous_results (search);
+    search->details->previous_query = g_steal_pointer (&search->details->searched_query);
+    search->details->previous_files = nautilus_file_list_copy (search->details->files);
+    search->details->previous_search_complete = search->details->search_ready_and_valid;
+
     reset_file_list (search);
 }
 
@@ -627,6 +766,13 @@ search_engine_hits_added (NautilusSearchEngine    *engine,
         nautilus_search_hit_compute_scores (hit, search->details->query);
 
         file = nautilus_file_get_by_uri (uri);
+        if (g_hash_table_contains (search->details->files_hash, file))
+        {
+            /* Carried over from the search being refined. */
+            nautilus_file_unref (file);
+            continue;
+        }
+
         nautilus_file_set_search_relevance (file, nautilus_search_hit_get_relevance (hit));
 
         for (monitor_list = search->details->monitor_list; monitor_list; monitor_list = monitor_list->next)
@@ -686,10 +832,13 @@ search_engine_finished (NautilusSearchEngine         *engine,
         on_search_directory_search_ready_and_valid (search);
         nautilus_directory_emit_done_loading (NAUTILUS_DIRECTORY (search));
     }
-    else if (status == NAUTILUS_SEARCH_PROVIDER_STATUS_RESTARTING)
+    else if (status == NAUTILUS_SEARCH_PROVIDER_STATUS_RESTARTING &&
+             !search->details->refining)
     {
         /* Remove file monitors of the files from an old search that just
-         * actually finished */
+         * actually finished. Files carried over from a search being
+         * refined are still valid.
+         */
         reset_file_list (search);
     }
 }
@@ -707,11 +856,13 @@ search_force_reload (NautilusDirectory *directory)
         return;
     }
 
+    /* Stop first, so the files found so far are kept for refining. */
+    stop_search (search);
+
     search->details->search_ready_and_valid = FALSE;
 
     /* Remove file monitors */
     reset_file_list (search);
-    stop_search (search);
 
     file = nautilus_directory_get_corresponding_file (directory);
     nautilus_file_invalidate_all_attributes (file);
@@ -749,6 +900,18 @@ search_get_file_list (NautilusDirectory *directory)
     return nautilus_file_list_copy (search->details->files);
 }
 
+static void
+search_foreach_file (NautilusDirectory            *directory,
+                     NautilusDirectoryForeachFunc  func,
+                     gpointer                      callback_data)
+{
+    NautilusSearchDirectory *search;
+
+    search = NAUTILUS_SEARCH_DIRECTORY (directory);
+
+    g_list_foreach (search->details->files, (GFunc) func, callback_data);
+}
+
 
 static gboolean
 search_is_editable (NautilusDirectory *directory)
@@ -910,6 +1073,9 @@ search_dispose (GObject *object)
     stop_search (search);
     search_disconnect_engine (search);
 
+    clear_previous_results (search);
+    g_clear_object (&search->details->searched_query);
+
     g_clear_object (&search->details->engine);
 
     G_OBJECT_CLASS (nautilus_search_directory_parent_class)->dispose (object);
@@ -960,6 +1126,7 @@ nautilus_search_directory_class_init (NautilusSearchDirectoryClass *class)
     directory_class->file_monitor_remove = search_monitor_remove;
 
     directory_class->get_file_list = search_get_file_list;
+    directory_class->foreach_file = search_foreach_file;
     directory_class->is_editable = search_is_editable;
     directory_class->handles_location = real_handles_location;
 
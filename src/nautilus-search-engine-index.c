@@ -0,0 +1,298 @@
+/*
+ * Nautilus is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * Nautilus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program; see the file COPYING.  If not,
+ * see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <config.h>
+#include "nautilus-search-hit.h"
+#include "nautilus-search-provider.h"
+#include "nautilus-search-engine-index.h"
+#include "nautilus-file-name-index.h"
+#define DEBUG_FLAG NAUTILUS_DEBUG_SEARCH
+#include "nautilus-debug.h"
+
+#include <glib.h>
+#include <gio/gio.h>
+
+enum
+{
+    PROP_0,
+    PROP_RUNNING,
+    LAST_PROP
+};
+
+struct _NautilusSearchEngineIndex
+{
+    GObject parent_instance;
+    NautilusQuery *query;
+
+    /* Set while a search runs. */
+    GCancellable *cancellable;
+};
+
+static void nautilus_search_provider_init (NautilusSearchProviderInterface *iface);
+
+G_DEFINE_TYPE_WITH_CODE (NautilusSearchEngineIndex,
+                         nautilus_search_engine_index,
+                         G_TYPE_OBJECT,
+                         G_IMPLEMENT_INTERFACE (NAUTILUS_TYPE_SEARCH_PROVIDER,
+                                                nautilus_search_provider_init))
+
+static void
+finalize (GObject *object)
+{
+    NautilusSearchEngineIndex *engine = NAUTILUS_SEARCH_ENGINE_INDEX (object);
+
+    g_clear_object (&engine->query);
+
+    G_OBJECT_CLASS (nautilus_search_engine_index_parent_class)->finalize (object);
+}
+
+static void
+search_thread_func (GTask        *task,
+                    gpointer      source_object,
+                    gpointer      task_data,
+                    GCancellable *cancellable)
+{
+    NautilusQuery *query;
+    NautilusFileNameIndex *index;
+    GFile *location;
+    GList *hits;
+
+    query = task_data;
+    location = nautilus_query_get_location (query);
+    index = nautilus_file_name_index_lookup (location);
+    g_object_unref (location);
+
+    hits = NULL;
+    if (index != NULL)
+    {
+        hits = nautilus_file_name_index_search (index, query, cancellable);
+    }
+
+    g_task_return_pointer (task, hits, NULL);
+}
+
+static void
+search_done (GObject      *source_object,
+             GAsyncResult *result,
+             gpointer      user_data)
+{
+    NautilusSearchEngineIndex *engine;
+    GList *hits;
+
+    engine = NAUTILUS_SEARCH_ENGINE_INDEX (source_object);
+    hits = g_task_propagate_pointer (G_TASK (result), NULL);
+
+    if (g_cancellable_is_cancelled (engine->cancellable))
+    {
+        DEBUG ("Index engine finished and cancelled");
+    }
+    else
+    {
+        DEBUG ("Index engine finished, %u hits", g_list_length (hits));
+        if (hits != NULL)
+        {
+            nautilus_search_provider_hits_added (NAUTILUS_SEARCH_PROVIDER (engine), hits);
+        }
+    }
+    g_list_free_full (hits, g_object_unref);
+
+    g_clear_object (&engine->cancellable);
+    nautilus_search_provider_finished (NAUTILUS_SEARCH_PROVIDER (engine),
+                                       NAUTILUS_SEARCH_PROVIDER_STATUS_NORMAL);
+
+    g_object_notify (G_OBJECT (engine), "running");
+}
+
+static void
+nautilus_search_engine_index_start (NautilusSearchProvider *provider)
+{
+    NautilusSearchEngineIndex *engine;
+    GTask *task;
+
+    engine = NAUTILUS_SEARCH_ENGINE_INDEX (provider);
+
+    if (engine->cancellable != NULL)
+    {
+        return;
+    }
+
+    DEBUG ("Index engine start");
+
+    engine->cancellable = g_cancellable_new ();
+
+    task = g_task_new (engine, engine->cancellable, search_done, NULL);
+    g_task_set_task_data (task, g_object_ref (engine->query), g_object_unref);
+    g_task_run_in_thread (task, search_thread_func);
+    g_object_unref (task);
+
+    g_object_notify (G_OBJECT (provider), "running");
+}
+
+static void
+nautilus_search_engine_index_stop (NautilusSearchProvider *provider)
+{
+    NautilusSearchEngineIndex *engine = NAUTILUS_SEARCH_ENGINE_INDEX (provider);
+
+    if (engine->cancellable != NULL)
+    {
+        DEBUG ("Index engine stop");
+        g_cancellable_cancel (engine->cancellable);
+    }
+}
+
+static void
+nautilus_search_engine_index_set_query (NautilusSearchProvider *provider,
+                                        NautilusQuery          *query)
+{
+    NautilusSearchEngineIndex *engine = NAUTILUS_SEARCH_ENGINE_INDEX (provider);
+
+    g_object_ref (query);
+    g_clear_object (&engine->query);
+    engine->query = query;
+}
+
+static gboolean
+nautilus_search_engine_index_is_running (NautilusSearchProvider *provider)
+{
+    NautilusSearchEngineIndex *engine = NAUTILUS_SEARCH_ENGINE_INDEX (provider);
+
+    return engine->cancellable != NULL;
+}
+
+/* Returns the index that can answer the query set last, or NULL. */
+static NautilusFileNameIndex *
+lookup_index (NautilusSearchEngineIndex *engine)
+{
+    NautilusFileNameIndex *index;
+    GFile *location;
+
+    if (engine->query == NULL ||
+        nautilus_query_get_search_content (engine->query) != NAUTILUS_QUERY_SEARCH_CONTENT_SIMPLE)
+    {
+        return NULL;
+    }
+
+    location = nautilus_query_get_location (engine->query);
+    if (location == NULL)
+    {
+        return NULL;
+    }
+
+    index = nautilus_file_name_index_lookup (location);
+    if (index != NULL && !nautilus_file_name_index_covers (index, location))
+    {
+        index = NULL;
+    }
+    g_object_unref (location);
+
+    return index;
+}
+
+gboolean
+nautilus_search_engine_index_is_available (NautilusSearchEngineIndex *engine)
+{
+    return lookup_index (engine) != NULL;
+}
+
+gboolean
+nautilus_search_engine_index_is_ready (NautilusSearchEngineIndex *engine)
+{
+    NautilusFileNameIndex *index;
+
+    index = lookup_index (engine);
+
+    return index != NULL && nautilus_file_name_index_is_ready (index);
+}
+
+void
+nautilus_search_engine_index_prepare (NautilusSearchEngineIndex *engine)
+{
+    GFile *location;
+
+    if (engine->query == NULL)
+    {
+        return;
+    }
+
+    location = nautilus_query_get_location (engine->query);
+    if (location != NULL)
+    {
+        nautilus_file_name_index_prepare (location);
+        g_object_unref (location);
+    }
+}
+
+static void
+nautilus_search_engine_index_get_property (GObject    *object,
+                                           guint       arg_id,
+                                           GValue     *value,
+                                           GParamSpec *pspec)
+{
+    NautilusSearchProvider *self = NAUTILUS_SEARCH_PROVIDER (object);
+
+    switch (arg_id)
+    {
+        case PROP_RUNNING:
+        {
+            g_value_set_boolean (value, nautilus_search_engine_index_is_running (self));
+        }
+        break;
+
+        default:
+        {
+            G_OBJECT_WARN_INVALID_PROPERTY_ID (object, arg_id, pspec);
+        }
+        break;
+    }
+}
+
+static void
+nautilus_search_provider_init (NautilusSearchProviderInterface *iface)
+{
+    iface->set_query = nautilus_search_engine_index_set_query;
+    iface->start = nautilus_search_engine_index_start;
+    iface->stop = nautilus_search_engine_index_stop;
+    iface->is_running = nautilus_search_engine_index_is_running;
+}
+
+static void
+nautilus_search_engine_index_class_init (NautilusSearchEngineIndexClass *class)
+{
+    GObjectClass *gobject_class;
+
+    gobject_class = G_OBJECT_CLASS (class);
+    gobject_class->finalize = finalize;
+    gobject_class->get_property = nautilus_search_engine_index_get_property;
+
+    /**
+     * NautilusSearchEngine::running:
+     *
+     * Whether the search engine is running a search.
+     */
+    g_object_class_override_property (gobject_class, PROP_RUNNING, "running");
+}
+
+static void
+nautilus_search_engine_index_init (NautilusSearchEngineIndex *engine)
+{
+}
+
+NautilusSearchEngineIndex *
+nautilus_search_engine_index_new (void)
+{
+    return g_object_new (NAUTILUS_TYPE_SEARCH_ENGINE_INDEX, NULL);
+}
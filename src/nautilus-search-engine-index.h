@@ -0,0 +1,48 @@
+/*
+ * Nautilus is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * Nautilus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program; see the file COPYING.  If not,
+ * see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef NAUTILUS_SEARCH_ENGINE_INDEX_H
+#define NAUTILUS_SEARCH_ENGINE_INDEX_H
+
+#include <glib-object.h>
+
+G_BEGIN_DECLS
+
+#define NAUTILUS_TYPE_SEARCH_ENGINE_INDEX (nautilus_search_engine_index_get_type ())
+
+G_DECLARE_FINAL_TYPE (NautilusSearchEngineIndex, nautilus_search_engine_index, NAUTILUS, SEARCH_ENGINE_INDEX, GObject);
+
+NautilusSearchEngineIndex* nautilus_search_engine_index_new          (void);
+
+/* Whether the file name index can answer the query set last, if maybe
+ * not with what changed while Nautilus wasn't running.
+ */
+gboolean                   nautilus_search_engine_index_is_available (NautilusSearchEngineIndex *engine);
+
+/* Whether the file name index can answer the query set last with what
+ * is there now, so the tree doesn't have to be walked.
+ */
+gboolean                   nautilus_search_engine_index_is_ready     (NautilusSearchEngineIndex *engine);
+
+/* Starts indexing the location of the query set last, if it is in an
+ * indexed root, for the next searches.
+ */
+void                       nautilus_search_engine_index_prepare      (NautilusSearchEngineIndex *engine);
+
+G_END_DECLS
+
+#endif /* NAUTILUS_SEARCH_ENGINE_INDEX_H */
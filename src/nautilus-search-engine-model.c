@@ -26,7 +26,7 @@
 #include "nautilus-directory.h"
 #include "nautilus-directory-private.h"
 #include "nautilus-file.h"
-#include "nautilus-ui-utilities.h"
+#include "nautilus-query-predicate.h"
 #define DEBUG_FLAG NAUTILUS_DEBUG_SEARCH
 #include "nautilus-debug.h"
 
@@ -122,88 +122,72 @@ search_finished_idle (NautilusSearchEngineModel *model)
     model->details->finished_id = g_idle_add ((GSourceFunc) search_finished, model);
 }
 
+typedef struct
+{
+    NautilusQueryMatcher *matcher;
+    NautilusQueryPredicate *predicate;
+    GList *hits;
+} ModelSearch;
+
 static void
-model_directory_ready_cb (NautilusDirectory *directory,
-                          GList             *list,
-                          gpointer           user_data)
+model_search_file (NautilusFile *file,
+                   gpointer      callback_data)
 {
-    NautilusSearchEngineModel *model = user_data;
-    gchar *uri, *display_name;
-    GList *files, *hits, *mime_types, *l, *m;
-    NautilusFile *file;
+    ModelSearch *search = callback_data;
+    gchar *uri, *display_name, *mime_type;
     gdouble match;
     gboolean found;
     NautilusSearchHit *hit;
-    GDateTime *initial_date;
-    GDateTime *end_date;
-    GPtrArray *date_range;
-
-    files = nautilus_directory_get_file_list (directory);
-    mime_types = nautilus_query_get_mime_types (model->details->query);
-    hits = NULL;
 
-    for (l = files; l != NULL; l = l->next)
+    /* Cheapest checks first. */
+    found = nautilus_query_predicate_matches_date (search->predicate,
+                                                   nautilus_file_get_mtime (file),
+                                                   nautilus_file_get_atime (file));
+    if (!found)
     {
-        file = l->data;
+        return;
+    }
 
-        display_name = nautilus_file_get_display_name (file);
-        match = nautilus_query_matches_string (model->details->query, display_name);
-        found = (match > -1);
+    display_name = nautilus_file_get_display_name (file);
+    match = nautilus_query_matcher_match (search->matcher, display_name);
+    found = (match > -1);
+    g_free (display_name);
 
-        if (found && mime_types)
-        {
-            found = FALSE;
-
-            for (m = mime_types; m != NULL; m = m->next)
-            {
-                if (nautilus_file_is_mime_type (file, m->data))
-                {
-                    found = TRUE;
-                    break;
-                }
-            }
-        }
+    if (found && nautilus_query_predicate_has_mime_types (search->predicate))
+    {
+        mime_type = nautilus_file_get_mime_type (file);
+        found = nautilus_query_predicate_matches_mime_type (search->predicate, mime_type);
+        g_free (mime_type);
+    }
 
-        date_range = nautilus_query_get_date_range (model->details->query);
-        if (found && date_range != NULL)
-        {
-            NautilusQuerySearchType type;
-            guint64 current_file_unix_time;
-
-            type = nautilus_query_get_search_type (model->details->query);
-            initial_date = g_ptr_array_index (date_range, 0);
-            end_date = g_ptr_array_index (date_range, 1);
-
-            if (type == NAUTILUS_QUERY_SEARCH_TYPE_LAST_ACCESS)
-            {
-                current_file_unix_time = nautilus_file_get_atime (file);
-            }
-            else
-            {
-                current_file_unix_time = nautilus_file_get_mtime (file);
-            }
-
-            found = nautilus_file_date_in_between (current_file_unix_time,
-                                                   initial_date,
-                                                   end_date);
-            g_ptr_array_unref (date_range);
-        }
+    if (found)
+    {
+        uri = nautilus_file_get_uri (file);
+        hit = nautilus_search_hit_new (uri);
+        nautilus_search_hit_set_fts_rank (hit, match);
+        search->hits = g_list_prepend (search->hits, hit);
+        g_free (uri);
+    }
+}
 
-        if (found)
-        {
-            uri = nautilus_file_get_uri (file);
-            hit = nautilus_search_hit_new (uri);
-            nautilus_search_hit_set_fts_rank (hit, match);
-            hits = g_list_prepend (hits, hit);
-            g_free (uri);
-        }
+static void
+model_directory_ready_cb (NautilusDirectory *directory,
+                          GList             *list,
+                          gpointer           user_data)
+{
+    NautilusSearchEngineModel *model = user_data;
+    ModelSearch search;
 
-        g_free (display_name);
-    }
+    search.matcher = nautilus_query_get_matcher (model->details->query);
+    search.predicate = nautilus_query_predicate_new (model->details->query);
+    search.hits = NULL;
+
+    /* The directory may well be a large one, walk it in place. */
+    nautilus_directory_foreach_file (directory, model_search_file, &search);
 
-    g_list_free_full (mime_types, g_free);
-    nautilus_file_list_free (files);
-    model->details->hits = hits;
+    nautilus_query_matcher_unref (search.matcher);
+    nautilus_query_predicate_free (search.predicate);
+    model->details->hits = search.hits;
 
     search_finished (model);
 }
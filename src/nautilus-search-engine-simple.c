@@ -23,7 +23,7 @@
 #include "nautilus-search-hit.h"
 #include "nautilus-search-provider.h"
 #include "nautilus-search-engine-simple.h"
-#include "nautilus-ui-utilities.h"
+#include "nautilus-query-predicate.h"
 #define DEBUG_FLAG NAUTILUS_DEBUG_SEARCH
 #include "nautilus-debug.h"
 
@@ -33,6 +33,37 @@
 
 #define BATCH_SIZE 500
 
+/* Directories are enumerated by up to this many threads at once. */
+#define MAX_LOCAL_SEARCH_THREADS 8
+
+/* Remote servers don't like many requests at once, and don't answer
+ * them faster either.
+ */
+#define MAX_REMOTE_DIRECTORIES_READ 2
+
+/* Visited directory ids are spread over this many separately locked
+ * tables, so walkers rarely wait for each other.
+ */
+#define N_VISITED_SHARDS 16
+
+/* Contents of files bigger than this are not searched. */
+#define MAX_CONTENT_SEARCH_SIZE (16 * 1024 * 1024)
+
+/* Contents are read this much at a time. */
+#define CONTENT_CHUNK_SIZE (64 * 1024)
+
+/* Modification times are needed for the hits, the rest is asked for
+ * as the query needs it.
+ */
+#define STD_ATTRIBUTES \
+    G_FILE_ATTRIBUTE_STANDARD_NAME "," \
+    G_FILE_ATTRIBUTE_STANDARD_DISPLAY_NAME "," \
+    G_FILE_ATTRIBUTE_STANDARD_IS_BACKUP "," \
+    G_FILE_ATTRIBUTE_STANDARD_IS_HIDDEN "," \
+    G_FILE_ATTRIBUTE_STANDARD_TYPE "," \
+    G_FILE_ATTRIBUTE_TIME_MODIFIED "," \
+    G_FILE_ATTRIBUTE_ID_FILE
+
 enum
 {
     PROP_RECURSIVE = 1,
@@ -40,25 +71,61 @@ enum
     NUM_PROPERTIES
 };
 
+typedef struct
+{
+    GMutex mutex;
+    GHashTable *ids;
+} VisitedShard;
+
 typedef struct
 {
     NautilusSearchEngineSimple *engine;
     GCancellable *cancellable;
 
-    GList *mime_types;
-    GList *found_list;
-
-    GQueue *directories;     /* GFiles */
+    NautilusQueryMatcher *matcher;
+    NautilusQueryPredicate *predicate;
+    gboolean show_hidden;
+    gboolean search_content;
+    char *attributes;
 
-    GHashTable *visited;
+    VisitedShard visited[N_VISITED_SHARDS];
 
     gboolean recursive;
-    gint n_processed_files;
-    GList *hits;
 
     NautilusQuery *query;
+
+    /* Each search walks with threads of its own, as the walkers only
+     * return once the whole search is done, and another search would
+     * otherwise wait for them.
+     */
+    GThreadPool *threads;
+
+    /* Lock mutex when accessing the rest. */
+    GMutex mutex;
+    GCond cond;
+    GQueue local_directories;      /* GFiles */
+    GQueue remote_directories;     /* GFiles */
+    guint directories_being_read;
+    guint remote_directories_being_read;
+    guint threads_running;
+    gint n_processed_files;
+    GList *hits;
 } SearchThreadData;
 
+/* What one walker found since it last handed its hits over. */
+typedef struct
+{
+    SearchThreadData *data;
+    GList *hits;
+    gint n_processed_files;
+    GList *subdirectories;
+
+    /* Contents are read into this, so memory use doesn't depend on the
+     * size of the files.
+     */
+    char *content_buffer;
+} SearchWalker;
+
 
 struct _NautilusSearchEngineSimple
 {
@@ -93,18 +160,52 @@ search_thread_data_new (NautilusSearchEngineSimple *engine,
 {
     SearchThreadData *data;
     GFile *location;
+    GString *attributes;
+    guint i;
 
     data = g_new0 (SearchThreadData, 1);
 
     data->engine = g_object_ref (engine);
-    data->directories = g_queue_new ();
-    data->visited = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+    data->recursive = engine->recursive;
     data->query = g_object_ref (query);
 
+    for (i = 0; i < N_VISITED_SHARDS; i++)
+    {
+        g_mutex_init (&data->visited[i].mutex);
+        data->visited[i].ids = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+    }
+
+    g_mutex_init (&data->mutex);
+    g_cond_init (&data->cond);
+
     location = nautilus_query_get_location (query);
+    if (g_file_is_native (location))
+    {
+        g_queue_push_tail (&data->local_directories, location);
+    }
+    else
+    {
+        g_queue_push_tail (&data->remote_directories, location);
+    }
+
+    data->matcher = nautilus_query_get_matcher (query);
+    data->predicate = nautilus_query_predicate_new (query);
+    data->show_hidden = nautilus_query_get_show_hidden_files (query);
+    data->search_content = nautilus_query_get_search_content (query) == NAUTILUS_QUERY_SEARCH_CONTENT_FULL_TEXT;
 
-    g_queue_push_tail (data->directories, location);
-    data->mime_types = nautilus_query_get_mime_types (query);
+    /* Ask only for what is going to be looked at. */
+    attributes = g_string_new (STD_ATTRIBUTES);
+    if (nautilus_query_predicate_get_attributes (data->predicate) != NULL)
+    {
+        g_string_append_c (attributes, ',');
+        g_string_append (attributes, nautilus_query_predicate_get_attributes (data->predicate));
+    }
+    if (data->search_content)
+    {
+        g_string_append (attributes, "," G_FILE_ATTRIBUTE_STANDARD_CONTENT_TYPE
+                                     "," G_FILE_ATTRIBUTE_STANDARD_SIZE);
+    }
+    data->attributes = g_string_free (attributes, FALSE);
 
     data->cancellable = g_cancellable_new ();
 
@@ -114,13 +215,31 @@ search_thread_data_new (NautilusSearchEngineSimple *engine,
 static void
 search_thread_data_free (SearchThreadData *data)
 {
-    g_queue_foreach (data->directories,
+    guint i;
+
+    /* The threads may still be on their way out. */
+    if (data->threads != NULL)
+    {
+        g_thread_pool_free (data->threads, FALSE, TRUE);
+    }
+    g_queue_foreach (&data->local_directories,
+                     (GFunc) g_object_unref, NULL);
+    g_queue_clear (&data->local_directories);
+    g_queue_foreach (&data->remote_directories,
                      (GFunc) g_object_unref, NULL);
-    g_queue_free (data->directories);
-    g_hash_table_destroy (data->visited);
+    g_queue_clear (&data->remote_directories);
+    for (i = 0; i < N_VISITED_SHARDS; i++)
+    {
+        g_hash_table_destroy (data->visited[i].ids);
+        g_mutex_clear (&data->visited[i].mutex);
+    }
+    g_mutex_clear (&data->mutex);
+    g_cond_clear (&data->cond);
     g_object_unref (data->cancellable);
     g_object_unref (data->query);
-    g_list_free_full (data->mime_types, g_free);
+    nautilus_query_matcher_unref (data->matcher);
+    nautilus_query_predicate_free (data->predicate);
+    g_free (data->attributes);
     g_list_free_full (data->hits, g_object_unref);
     g_object_unref (data->engine);
 
@@ -177,6 +296,9 @@ search_thread_add_hits_idle (gpointer user_data)
     return FALSE;
 }
 
+/* Lock thread_data->mutex when calling this. Batches are handed to the
+ * main loop in the order they are sent, whichever walker sends them.
+ */
 static void
 send_batch (SearchThreadData *thread_data)
 {
@@ -194,43 +316,117 @@ send_batch (SearchThreadData *thread_data)
     thread_data->hits = NULL;
 }
 
-#define STD_ATTRIBUTES \
-    G_FILE_ATTRIBUTE_STANDARD_NAME "," \
-    G_FILE_ATTRIBUTE_STANDARD_DISPLAY_NAME "," \
-    G_FILE_ATTRIBUTE_STANDARD_IS_BACKUP "," \
-    G_FILE_ATTRIBUTE_STANDARD_IS_HIDDEN "," \
-    G_FILE_ATTRIBUTE_STANDARD_TYPE "," \
-    G_FILE_ATTRIBUTE_TIME_MODIFIED "," \
-    G_FILE_ATTRIBUTE_TIME_ACCESS "," \
-    G_FILE_ATTRIBUTE_ID_FILE
+/* Returns -1 if the contents of the file don't have all the words of
+ * the query, or a rank otherwise. Only local text files are read, the
+ * content type is sniffed so that programs and images are skipped.
+ */
+static gdouble
+match_contents (SearchWalker *walker,
+                GFile        *file,
+                GFileInfo    *info)
+{
+    NautilusQueryContentMatch *match;
+    GFileInputStream *stream;
+    const char *content_type;
+    gssize n_read;
+    goffset total_read;
+
+    content_type = g_file_info_get_content_type (info);
+    if (g_file_info_get_file_type (info) != G_FILE_TYPE_REGULAR ||
+        g_file_info_get_size (info) > MAX_CONTENT_SEARCH_SIZE ||
+        content_type == NULL ||
+        !g_content_type_is_a (content_type, "text/plain") ||
+        !g_file_is_native (file))
+    {
+        return -1;
+    }
+
+    stream = g_file_read (file, walker->data->cancellable, NULL);
+    if (stream == NULL)
+    {
+        return -1;
+    }
+
+    if (walker->content_buffer == NULL)
+    {
+        walker->content_buffer = g_malloc (CONTENT_CHUNK_SIZE);
+    }
+
+    /* The file may have grown since, never read more than the limit. */
+    match = nautilus_query_content_match_new (walker->data->matcher);
+    total_read = 0;
+    while (total_read < MAX_CONTENT_SEARCH_SIZE &&
+           (n_read = g_input_stream_read (G_INPUT_STREAM (stream),
+                                          walker->content_buffer,
+                                          MIN (CONTENT_CHUNK_SIZE, MAX_CONTENT_SEARCH_SIZE - total_read),
+                                          walker->data->cancellable, NULL)) > 0)
+    {
+        nautilus_query_content_match_feed (match, walker->content_buffer, n_read);
+        total_read += n_read;
+    }
+
+    g_object_unref (stream);
+
+    return nautilus_query_content_match_finish (match);
+}
+
+/* Returns TRUE if the directory with this id wasn't visited before. */
+static gboolean
+mark_visited (SearchThreadData *data,
+              const char       *id)
+{
+    VisitedShard *shard;
+    gboolean added;
+
+    shard = &data->visited[g_str_hash (id) % N_VISITED_SHARDS];
 
+    g_mutex_lock (&shard->mutex);
+    added = g_hash_table_add (shard->ids, g_strdup (id));
+    g_mutex_unlock (&shard->mutex);
+
+    return added;
+}
+
+/* Hands what the walker found over to the batch being collected. */
 static void
-visit_directory (GFile            *dir,
-                 SearchThreadData *data)
+flush_walker (SearchWalker *walker)
 {
+    SearchThreadData *data;
+
+    data = walker->data;
+
+    g_mutex_lock (&data->mutex);
+
+    data->hits = g_list_concat (walker->hits, data->hits);
+    data->n_processed_files += walker->n_processed_files;
+    if (data->n_processed_files > BATCH_SIZE)
+    {
+        send_batch (data);
+    }
+
+    g_mutex_unlock (&data->mutex);
+
+    walker->hits = NULL;
+    walker->n_processed_files = 0;
+}
+
+static void
+visit_directory (GFile        *dir,
+                 SearchWalker *walker)
+{
+    SearchThreadData *data;
     GFileEnumerator *enumerator;
     GFileInfo *info;
     GFile *child;
-    const char *mime_type, *display_name;
+    const char *display_name;
     gdouble match;
     gboolean is_hidden, found;
-    GList *l;
     const char *id;
-    gboolean visited;
-    guint64 atime;
     guint64 mtime;
-    GPtrArray *date_range;
-    GDateTime *initial_date;
-    GDateTime *end_date;
-
-
-    enumerator = g_file_enumerate_children (dir,
-                                            data->mime_types != NULL ?
-                                            STD_ATTRIBUTES ","
-                                            G_FILE_ATTRIBUTE_STANDARD_CONTENT_TYPE
-                                            :
-                                            STD_ATTRIBUTES
-                                            ,
+
+    data = walker->data;
+
+    enumerator = g_file_enumerate_children (dir, data->attributes,
                                             G_FILE_QUERY_INFO_NOFOLLOW_SYMLINKS,
                                             data->cancellable, NULL);
 
@@ -248,55 +444,29 @@ visit_directory (GFile            *dir,
         }
 
         is_hidden = g_file_info_get_is_hidden (info) || g_file_info_get_is_backup (info);
-        if (is_hidden && !nautilus_query_get_show_hidden_files (data->query))
+        if (is_hidden && !data->show_hidden)
         {
             goto next;
         }
 
         child = g_file_get_child (dir, g_file_info_get_name (info));
-        match = nautilus_query_matches_string (data->query, display_name);
-        found = (match > -1);
+        mtime = g_file_info_get_attribute_uint64 (info, G_FILE_ATTRIBUTE_TIME_MODIFIED);
 
-        if (found && data->mime_types)
+        /* Cheapest checks first, contents are only read if all the rest
+         * matches.
+         */
+        match = -1;
+        found = nautilus_query_predicate_matches_info (data->predicate, info);
+        if (found)
         {
-            mime_type = g_file_info_get_content_type (info);
-            found = FALSE;
-
-            for (l = data->mime_types; mime_type != NULL && l != NULL; l = l->next)
-            {
-                if (g_content_type_is_a (mime_type, l->data))
-                {
-                    found = TRUE;
-                    break;
-                }
-            }
+            match = nautilus_query_matcher_match (data->matcher, display_name);
+            found = (match > -1) || data->search_content;
         }
 
-        mtime = g_file_info_get_attribute_uint64 (info, "time::modified");
-        atime = g_file_info_get_attribute_uint64 (info, "time::access");
-
-        date_range = nautilus_query_get_date_range (data->query);
-        if (found && date_range != NULL)
+        if (found && match <= -1)
         {
-            NautilusQuerySearchType type;
-            guint64 current_file_time;
-
-            initial_date = g_ptr_array_index (date_range, 0);
-            end_date = g_ptr_array_index (date_range, 1);
-            type = nautilus_query_get_search_type (data->query);
-
-            if (type == NAUTILUS_QUERY_SEARCH_TYPE_LAST_ACCESS)
-            {
-                current_file_time = atime;
-            }
-            else
-            {
-                current_file_time = mtime;
-            }
-            found = nautilus_file_date_in_between (current_file_time,
-                                                   initial_date,
-                                                   end_date);
-            g_ptr_array_unref (date_range);
+            match = match_contents (walker, child, info);
+            found = (match > -1);
         }
 
         if (found)
@@ -313,35 +483,22 @@ visit_directory (GFile            *dir,
             nautilus_search_hit_set_modification_time (hit, date);
             g_date_time_unref (date);
 
-            data->hits = g_list_prepend (data->hits, hit);
+            walker->hits = g_list_prepend (walker->hits, hit);
         }
 
-        data->n_processed_files++;
-        if (data->n_processed_files > BATCH_SIZE)
+        walker->n_processed_files++;
+        if (walker->n_processed_files > BATCH_SIZE)
         {
-            send_batch (data);
+            flush_walker (walker);
         }
 
-        if (data->engine->recursive && g_file_info_get_file_type (info) == G_FILE_TYPE_DIRECTORY)
+        if (data->recursive && g_file_info_get_file_type (info) == G_FILE_TYPE_DIRECTORY)
         {
             id = g_file_info_get_attribute_string (info, G_FILE_ATTRIBUTE_ID_FILE);
-            visited = FALSE;
-            if (id)
-            {
-                if (g_hash_table_lookup_extended (data->visited,
-                                                  id, NULL, NULL))
-                {
-                    visited = TRUE;
-                }
-                else
-                {
-                    g_hash_table_insert (data->visited, g_strdup (id), NULL);
-                }
-            }
-
-            if (!visited)
+            if (id == NULL || mark_visited (data, id))
             {
-                g_queue_push_tail (data->directories, g_object_ref (child));
+                walker->subdirectories = g_list_prepend (walker->subdirectories,
+                                                         g_object_ref (child));
             }
         }
 
@@ -353,45 +510,178 @@ next:
     g_object_unref (enumerator);
 }
 
+/* Lock data->mutex when calling this. Remote directories are only
+ * handed out while fewer than MAX_REMOTE_DIRECTORIES_READ are read.
+ */
+static GFile *
+pop_directory (SearchThreadData *data,
+               gboolean         *is_remote)
+{
+    if (!g_queue_is_empty (&data->local_directories))
+    {
+        *is_remote = FALSE;
+        return g_queue_pop_head (&data->local_directories);
+    }
+
+    if (!g_queue_is_empty (&data->remote_directories) &&
+        data->remote_directories_being_read < MAX_REMOTE_DIRECTORIES_READ)
+    {
+        *is_remote = TRUE;
+        return g_queue_pop_head (&data->remote_directories);
+    }
+
+    return NULL;
+}
 
-static gpointer
-search_thread_func (gpointer user_data)
+/* Each walker takes directories from the shared queues until they are
+ * empty and no other walker is reading a directory that could add more.
+ */
+static void
+search_thread_func (gpointer thread_data,
+                    gpointer user_data)
 {
     SearchThreadData *data;
-    GFile *dir;
+    SearchWalker walker;
+    GFile *dir, *subdirectory;
+    GList *l;
+    gboolean is_remote;
+    gboolean last;
+
+    data = thread_data;
+
+    memset (&walker, 0, sizeof (walker));
+    walker.data = data;
+
+    g_mutex_lock (&data->mutex);
+
+    for (;;)
+    {
+        dir = NULL;
+        while (!g_cancellable_is_cancelled (data->cancellable) &&
+               (dir = pop_directory (data, &is_remote)) == NULL &&
+               data->directories_being_read > 0)
+        {
+            g_cond_wait (&data->cond, &data->mutex);
+        }
+
+        if (dir == NULL)
+        {
+            break;
+        }
+
+        data->directories_being_read++;
+        if (is_remote)
+        {
+            data->remote_directories_being_read++;
+        }
+
+        g_mutex_unlock (&data->mutex);
+
+        visit_directory (dir, &walker);
+        g_object_unref (dir);
+        flush_walker (&walker);
+
+        g_mutex_lock (&data->mutex);
+
+        /* Depth first keeps the queues short. */
+        for (l = walker.subdirectories; l != NULL; l = l->next)
+        {
+            subdirectory = l->data;
+            g_queue_push_head (g_file_is_native (subdirectory) ?
+                               &data->local_directories :
+                               &data->remote_directories,
+                               subdirectory);
+        }
+        g_list_free (walker.subdirectories);
+        walker.subdirectories = NULL;
+
+        data->directories_being_read--;
+        if (is_remote)
+        {
+            data->remote_directories_being_read--;
+        }
+        g_cond_broadcast (&data->cond);
+    }
+
+    g_free (walker.content_buffer);
+
+    data->threads_running--;
+    last = data->threads_running == 0;
+
+    if (last && !g_cancellable_is_cancelled (data->cancellable))
+    {
+        send_batch (data);
+    }
+
+    g_mutex_unlock (&data->mutex);
+
+    if (last)
+    {
+        g_idle_add (search_thread_done_idle, data);
+    }
+}
+
+static void
+mark_location_visited (SearchThreadData *data,
+                       GFile            *location)
+{
     GFileInfo *info;
     const char *id;
 
-    data = user_data;
-
-    /* Insert id for toplevel directory into visited */
-    dir = g_queue_peek_head (data->directories);
-    info = g_file_query_info (dir, G_FILE_ATTRIBUTE_ID_FILE, 0, data->cancellable, NULL);
+    info = g_file_query_info (location, G_FILE_ATTRIBUTE_ID_FILE, 0, data->cancellable, NULL);
     if (info)
     {
         id = g_file_info_get_attribute_string (info, G_FILE_ATTRIBUTE_ID_FILE);
         if (id)
         {
-            g_hash_table_insert (data->visited, g_strdup (id), NULL);
+            mark_visited (data, id);
         }
         g_object_unref (info);
     }
+}
+
+static void
+search_start_thread_func (GTask        *task,
+                          gpointer      source_object,
+                          gpointer      task_data,
+                          GCancellable *cancellable)
+{
+    SearchThreadData *data;
+    GFile *location;
+    guint i, n_walkers;
+
+    data = task_data;
+
+    /* Insert id for toplevel directory into visited */
+    location = g_queue_peek_head (g_queue_is_empty (&data->local_directories) ?
+                                  &data->remote_directories :
+                                  &data->local_directories);
+    mark_location_visited (data, location);
 
-    while (!g_cancellable_is_cancelled (data->cancellable) &&
-           (dir = g_queue_pop_head (data->directories)) != NULL)
+    if (!data->recursive)
     {
-        visit_directory (dir, data);
-        g_object_unref (dir);
+        n_walkers = 1;
     }
-
-    if (!g_cancellable_is_cancelled (data->cancellable))
+    else if (g_file_is_native (location))
     {
-        send_batch (data);
+        n_walkers = CLAMP (g_get_num_processors (), 2, MAX_LOCAL_SEARCH_THREADS);
+    }
+    else
+    {
+        n_walkers = MAX_REMOTE_DIRECTORIES_READ;
     }
 
-    g_idle_add (search_thread_done_idle, data);
+    /* Set before any of them can finish. */
+    g_mutex_lock (&data->mutex);
+    data->threads_running = n_walkers;
+    g_mutex_unlock (&data->mutex);
 
-    return NULL;
+    data->threads = g_thread_pool_new (search_thread_func, NULL,
+                                       n_walkers, FALSE, NULL);
+    for (i = 0; i < n_walkers; i++)
+    {
+        g_thread_pool_push (data->threads, data, NULL);
+    }
 }
 
 static void
@@ -399,7 +689,7 @@ nautilus_search_engine_simple_start (NautilusSearchProvider *provider)
 {
     NautilusSearchEngineSimple *simple;
     SearchThreadData *data;
-    GThread *thread;
+    GTask *task;
 
     simple = NAUTILUS_SEARCH_ENGINE_SIMPLE (provider);
 
@@ -412,12 +702,15 @@ nautilus_search_engine_simple_start (NautilusSearchProvider *provider)
 
     data = search_thread_data_new (simple, simple->query);
 
-    thread = g_thread_new ("nautilus-search-simple", search_thread_func, data);
+    /* Finding out about the location is blocking I/O too. */
+    task = g_task_new (NULL, NULL, NULL, NULL);
+    g_task_set_task_data (task, data, NULL);
+    g_task_run_in_thread (task, search_start_thread_func);
+    g_object_unref (task);
+
     simple->active_search = data;
 
     g_object_notify (G_OBJECT (provider), "running");
-
-    g_thread_unref (thread);
 }
 
 static void
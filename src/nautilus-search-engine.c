@@ -26,6 +26,7 @@
 #include "nautilus-search-engine.h"
 #include "nautilus-search-engine-simple.h"
 #include "nautilus-search-engine-model.h"
+#include "nautilus-search-engine-index.h"
 #define DEBUG_FLAG NAUTILUS_DEBUG_SEARCH
 #include "nautilus-debug.h"
 
@@ -40,6 +41,7 @@ typedef struct
 #endif
     NautilusSearchEngineSimple *simple;
     NautilusSearchEngineModel *model;
+    NautilusSearchEngineIndex *index;
 
     GHashTable *uris;
     guint providers_running;
@@ -83,6 +85,7 @@ nautilus_search_engine_set_query (NautilusSearchProvider *provider,
 #endif
     nautilus_search_provider_set_query (NAUTILUS_SEARCH_PROVIDER (priv->model), query);
     nautilus_search_provider_set_query (NAUTILUS_SEARCH_PROVIDER (priv->simple), query);
+    nautilus_search_provider_set_query (NAUTILUS_SEARCH_PROVIDER (priv->index), query);
 }
 
 static void
@@ -112,8 +115,24 @@ search_engine_start_real (NautilusSearchEngine *engine)
         priv->providers_running++;
     }
 
-    nautilus_search_provider_start (NAUTILUS_SEARCH_PROVIDER (priv->simple));
-    priv->providers_running++;
+    /* The index answers at once. The tree is only walked until the index
+     * was scanned again after loading, for what changed while Nautilus
+     * wasn't running. Hits found by both are only added once.
+     */
+    if (nautilus_search_engine_index_is_available (priv->index))
+    {
+        nautilus_search_provider_start (NAUTILUS_SEARCH_PROVIDER (priv->index));
+        priv->providers_running++;
+    }
+    else
+    {
+        nautilus_search_engine_index_prepare (priv->index);
+    }
+    if (!nautilus_search_engine_index_is_ready (priv->index))
+    {
+        nautilus_search_provider_start (NAUTILUS_SEARCH_PROVIDER (priv->simple));
+        priv->providers_running++;
+    }
 }
 
 static void
@@ -171,6 +190,7 @@ nautilus_search_engine_stop (NautilusSearchProvider *provider)
 #endif
     nautilus_search_provider_stop (NAUTILUS_SEARCH_PROVIDER (priv->model));
     nautilus_search_provider_stop (NAUTILUS_SEARCH_PROVIDER (priv->simple));
+    nautilus_search_provider_stop (NAUTILUS_SEARCH_PROVIDER (priv->index));
 
     priv->running = FALSE;
     priv->restart = FALSE;
@@ -348,6 +368,7 @@ nautilus_search_engine_finalize (GObject *object)
 #endif
     g_clear_object (&priv->model);
     g_clear_object (&priv->simple);
+    g_clear_object (&priv->index);
 
     G_OBJECT_CLASS (nautilus_search_engine_parent_class)->finalize (object);
 }
@@ -408,6 +429,9 @@ nautilus_search_engine_init (NautilusSearchEngine *engine)
 
     priv->simple = nautilus_search_engine_simple_new ();
     connect_provider_signals (engine, NAUTILUS_SEARCH_PROVIDER (priv->simple));
+
+    priv->index = nautilus_search_engine_index_new ();
+    connect_provider_signals (engine, NAUTILUS_SEARCH_PROVIDER (priv->index));
 }
 
 NautilusSearchEngine *
@@ -39,19 +39,60 @@
 #include "nautilus-shell-search-provider-generated.h"
 #include "nautilus-shell-search-provider.h"
 
+/* Only this many of the best hits are kept, the shell shows a handful. */
+#define MAX_RESULTS 100
+
+/* If the search is still running by then, the best hits so far are
+ * returned, so they show up while the rest of the tree is searched.
+ */
+#define INITIAL_RESULTS_TIMEOUT_MS 250
+
+/* Every hit is kept up to this many, so subsearches can be answered
+ * without searching again.
+ */
+#define MAX_CANDIDATES 10000
+
+#define MAX_CACHED_METAS 500
+
 typedef struct
 {
     NautilusShellSearchProvider *self;
 
     NautilusSearchEngine *engine;
     NautilusQuery *query;
+    gchar *text;
 
+    /* The best hits so far, as a heap with the worst one first. */
+    GPtrArray *top_hits;
+    /* URI -> hit, for the hits in top_hits. */
     GHashTable *hits;
+    /* URI -> name, for bookmarks and mounts, which don't go by the
+     * name of their file.
+     */
+    GHashTable *names;
+    /* URI -> hit, for all the hits, up to MAX_CANDIDATES. */
+    GHashTable *candidates;
+    /* Whether hits were left out of candidates. */
+    gboolean candidates_truncated;
+    /* Whether the engine searches for other terms, which the names of
+     * its hits have to be matched against.
+     */
+    gboolean filter_hits;
+    gboolean finished;
+
     GDBusMethodInvocation *invocation;
+    guint results_timeout_id;
 
     gint64 start_time;
 } PendingSearch;
 
+typedef struct
+{
+    GVariant *meta;
+    /* In metas_lru, holds the key of the cache entry. */
+    GList *link;
+} CachedMeta;
+
 struct _NautilusShellSearchProvider
 {
     GObject parent;
@@ -59,8 +100,14 @@ struct _NautilusShellSearchProvider
     NautilusShellSearchProvider2 *skeleton;
 
     PendingSearch *current_search;
+    /* The last search that finished. Subsearches refine it, or the
+     * current search if there is one.
+     */
+    PendingSearch *last_search;
 
+    /* URI -> CachedMeta, the least recently used last in metas_lru. */
     GHashTable *metas_cache;
+    GQueue metas_lru;
 };
 
 G_DEFINE_TYPE (NautilusShellSearchProvider, nautilus_shell_search_provider, G_TYPE_OBJECT)
@@ -113,10 +160,62 @@ get_gicon (NautilusShellSearchProvider *self,
     }
 }
 
+static NautilusQuery *
+create_query (const gchar *text)
+{
+    NautilusQuery *query;
+    GFile *home;
+
+    home = g_file_new_for_path (g_get_home_dir ());
+
+    query = nautilus_query_new ();
+    nautilus_query_set_show_hidden_files (query, FALSE);
+    nautilus_query_set_text (query, text);
+    nautilus_query_set_location (query, home);
+
+    g_object_unref (home);
+
+    return query;
+}
+
+static PendingSearch *
+pending_search_new (NautilusShellSearchProvider *self,
+                    const gchar                 *text)
+{
+    PendingSearch *search;
+
+    search = g_slice_new0 (PendingSearch);
+    search->self = self;
+    search->text = g_strdup (text);
+    search->query = create_query (text);
+    search->top_hits = g_ptr_array_new_with_free_func (g_object_unref);
+    search->hits = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+    search->candidates = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_object_unref);
+    search->start_time = g_get_monotonic_time ();
+
+    return search;
+}
+
 static void
 pending_search_free (PendingSearch *search)
 {
+    if (search->results_timeout_id != 0)
+    {
+        g_source_remove (search->results_timeout_id);
+    }
+    if (search->engine != NULL)
+    {
+        g_signal_handlers_disconnect_by_data (search->engine, search);
+    }
+
     g_hash_table_destroy (search->hits);
+    g_hash_table_destroy (search->candidates);
+    g_ptr_array_unref (search->top_hits);
+    if (search->names != NULL)
+    {
+        g_hash_table_unref (search->names);
+    }
+    g_free (search->text);
     g_clear_object (&search->query);
     g_clear_object (&search->engine);
     g_clear_object (&search->invocation);
@@ -125,13 +224,22 @@ pending_search_free (PendingSearch *search)
 }
 
 static void
-pending_search_finish (PendingSearch         *search,
-                       GDBusMethodInvocation *invocation,
-                       GVariant              *result)
+clear_last_search (NautilusShellSearchProvider *self)
 {
-    NautilusShellSearchProvider *self = search->self;
+    if (self->last_search != NULL)
+    {
+        pending_search_free (self->last_search);
+        self->last_search = NULL;
+    }
+}
 
-    g_dbus_method_invocation_return_value (invocation, result);
+/* Called once the engine is done with @search. A search that ran to
+ * the end is kept, so subsearches can refine it.
+ */
+static void
+pending_search_done (PendingSearch *search)
+{
+    NautilusShellSearchProvider *self = search->self;
 
     if (search == self->current_search)
     {
@@ -139,7 +247,19 @@ pending_search_finish (PendingSearch         *search,
     }
 
     g_application_release (g_application_get_default ());
-    pending_search_free (search);
+
+    if (search->finished)
+    {
+        g_signal_handlers_disconnect_by_data (search->engine, search);
+        g_clear_object (&search->engine);
+
+        clear_last_search (self);
+        self->last_search = search;
+    }
+    else
+    {
+        pending_search_free (search);
+    }
 }
 
 static void
@@ -152,28 +272,183 @@ cancel_current_search (NautilusShellSearchProvider *self)
 }
 
 static void
-search_hits_added_cb (NautilusSearchEngine *engine,
-                      GList                *hits,
-                      gpointer              user_data)
+top_hits_swap (GPtrArray *top_hits,
+               guint      a,
+               guint      b)
 {
-    PendingSearch *search = user_data;
-    GList *l;
-    NautilusSearchHit *hit;
-    const gchar *hit_uri;
+    gpointer hit;
 
-    g_debug ("*** Search engine hits added");
+    hit = top_hits->pdata[a];
+    top_hits->pdata[a] = top_hits->pdata[b];
+    top_hits->pdata[b] = hit;
+}
 
-    for (l = hits; l != NULL; l = l->next)
+static gdouble
+top_hits_relevance (GPtrArray *top_hits,
+                    guint      i)
+{
+    return nautilus_search_hit_get_relevance (g_ptr_array_index (top_hits, i));
+}
+
+static void
+top_hits_sift_up (GPtrArray *top_hits,
+                  guint      i)
+{
+    guint parent;
+
+    while (i > 0)
     {
-        hit = l->data;
-        nautilus_search_hit_compute_scores (hit, search->query);
-        hit_uri = nautilus_search_hit_get_uri (hit);
-        g_debug ("    %s", hit_uri);
+        parent = (i - 1) / 2;
+        if (top_hits_relevance (top_hits, parent) <= top_hits_relevance (top_hits, i))
+        {
+            break;
+        }
 
-        g_hash_table_replace (search->hits, g_strdup (hit_uri), g_object_ref (hit));
+        top_hits_swap (top_hits, parent, i);
+        i = parent;
     }
 }
 
+static void
+top_hits_sift_down (GPtrArray *top_hits,
+                    guint      i)
+{
+    guint child, worst;
+
+    while (TRUE)
+    {
+        worst = i;
+        for (child = 2 * i + 1; child <= 2 * i + 2 && child < top_hits->len; child++)
+        {
+            if (top_hits_relevance (top_hits, child) < top_hits_relevance (top_hits, worst))
+            {
+                worst = child;
+            }
+        }
+
+        if (worst == i)
+        {
+            break;
+        }
+
+        top_hits_swap (top_hits, worst, i);
+        i = worst;
+    }
+}
+
+/* Keeps @hit if it is one of the MAX_RESULTS best so far. Its scores
+ * have to be computed already.
+ */
+static void
+pending_search_add_hit (PendingSearch     *search,
+                        NautilusSearchHit *hit)
+{
+    NautilusSearchHit *worst;
+    const gchar *uri;
+
+    uri = nautilus_search_hit_get_uri (hit);
+    if (g_hash_table_contains (search->hits, uri))
+    {
+        return;
+    }
+
+    if (search->top_hits->len < MAX_RESULTS)
+    {
+        g_ptr_array_add (search->top_hits, g_object_ref (hit));
+        top_hits_sift_up (search->top_hits, search->top_hits->len - 1);
+    }
+    else
+    {
+        worst = g_ptr_array_index (search->top_hits, 0);
+        if (nautilus_search_hit_get_relevance (hit) <= nautilus_search_hit_get_relevance (worst))
+        {
+            return;
+        }
+
+        g_hash_table_remove (search->hits, nautilus_search_hit_get_uri (worst));
+        g_object_unref (worst);
+        search->top_hits->pdata[0] = g_object_ref (hit);
+        top_hits_sift_down (search->top_hits, 0);
+    }
+
+    g_hash_table_insert (search->hits, g_strdup (uri), hit);
+}
+
+/* Keeps @hit as a candidate for subsearches, and among the best hits
+ * if it is one of them. Its scores have to be computed already.
+ */
+static void
+pending_search_add_candidate (PendingSearch     *search,
+                              NautilusSearchHit *hit)
+{
+    const gchar *uri;
+
+    uri = nautilus_search_hit_get_uri (hit);
+    if (g_hash_table_contains (search->candidates, uri))
+    {
+        return;
+    }
+
+    if (g_hash_table_size (search->candidates) < MAX_CANDIDATES)
+    {
+        g_hash_table_insert (search->candidates, g_strdup (uri), g_object_ref (hit));
+    }
+    else
+    {
+        search->candidates_truncated = TRUE;
+    }
+
+    pending_search_add_hit (search, hit);
+}
+
+static gchar *
+get_hit_name (PendingSearch     *search,
+              NautilusSearchHit *hit)
+{
+    const gchar *name;
+    gchar *basename, *display_name;
+    GFile *location;
+
+    name = g_hash_table_lookup (search->names, nautilus_search_hit_get_uri (hit));
+    if (name != NULL)
+    {
+        return g_strdup (name);
+    }
+
+    location = g_file_new_for_uri (nautilus_search_hit_get_uri (hit));
+    basename = g_file_get_basename (location);
+    display_name = g_filename_display_name (basename);
+
+    g_free (basename);
+    g_object_unref (location);
+
+    return display_name;
+}
+
+/* Matches the name of @hit, found for other terms, against the terms
+ * of @search, and ranks it by that match.
+ */
+static gboolean
+pending_search_match_hit (PendingSearch     *search,
+                          NautilusSearchHit *hit)
+{
+    gchar *name;
+    gdouble match;
+
+    name = get_hit_name (search, hit);
+    match = nautilus_query_matches_string (search->query, name);
+    g_free (name);
+
+    if (match == -1)
+    {
+        return FALSE;
+    }
+
+    nautilus_search_hit_set_fts_rank (hit, match);
+
+    return TRUE;
+}
+
 static gint
 search_hit_compare_relevance (gconstpointer a,
                               gconstpointer b)
@@ -199,19 +474,19 @@ search_hit_compare_relevance (gconstpointer a,
     return 1;
 }
 
+/* Answers the method call @search came from with the best hits so far,
+ * the best one first.
+ */
 static void
-search_finished_cb (NautilusSearchEngine         *engine,
-                    NautilusSearchProviderStatus  status,
-                    gpointer                      user_data)
+pending_search_return_results (PendingSearch *search)
 {
-    PendingSearch *search = user_data;
     GList *hits, *l;
     NautilusSearchHit *hit;
     GVariantBuilder builder;
     gint64 current_time;
 
     current_time = g_get_monotonic_time ();
-    g_debug ("*** Search engine search finished - time elapsed %dms",
+    g_debug ("*** Returning %u results - time elapsed %dms", search->top_hits->len,
              (gint) ((current_time - search->start_time) / 1000));
 
     hits = g_hash_table_get_values (search->hits);
@@ -226,8 +501,87 @@ search_finished_cb (NautilusSearchEngine         *engine,
     }
 
     g_list_free (hits);
-    pending_search_finish (search, search->invocation,
-                           g_variant_new ("(as)", &builder));
+    g_dbus_method_invocation_return_value (search->invocation,
+                                           g_variant_new ("(as)", &builder));
+    g_clear_object (&search->invocation);
+
+    if (search->results_timeout_id != 0)
+    {
+        g_source_remove (search->results_timeout_id);
+        search->results_timeout_id = 0;
+    }
+}
+
+static gboolean
+results_timeout_cb (gpointer user_data)
+{
+    PendingSearch *search = user_data;
+
+    search->results_timeout_id = 0;
+
+    /* Nothing to show yet, the first hits are returned as they come. */
+    if (search->top_hits->len > 0)
+    {
+        g_debug ("*** Search engine still running, returning early results");
+        pending_search_return_results (search);
+    }
+
+    return G_SOURCE_REMOVE;
+}
+
+static void
+search_hits_added_cb (NautilusSearchEngine *engine,
+                      GList                *hits,
+                      gpointer              user_data)
+{
+    PendingSearch *search = user_data;
+    GList *l;
+    NautilusSearchHit *hit;
+
+    g_debug ("*** Search engine hits added");
+
+    for (l = hits; l != NULL; l = l->next)
+    {
+        hit = l->data;
+        if (search->filter_hits && !pending_search_match_hit (search, hit))
+        {
+            continue;
+        }
+
+        nautilus_search_hit_compute_scores (hit, search->query);
+        g_debug ("    %s", nautilus_search_hit_get_uri (hit));
+
+        pending_search_add_candidate (search, hit);
+    }
+
+    if (search->invocation != NULL && search->results_timeout_id == 0 &&
+        search->top_hits->len > 0)
+    {
+        pending_search_return_results (search);
+    }
+}
+
+static void
+search_finished_cb (NautilusSearchEngine         *engine,
+                    NautilusSearchProviderStatus  status,
+                    gpointer                      user_data)
+{
+    PendingSearch *search = user_data;
+    gint64 current_time;
+
+    current_time = g_get_monotonic_time ();
+    g_debug ("*** Search engine search finished - time elapsed %dms",
+             (gint) ((current_time - search->start_time) / 1000));
+
+    /* A stopped search finishes too, but it may have missed hits. */
+    search->finished = (search == search->self->current_search);
+
+    if (search->invocation != NULL)
+    {
+        pending_search_return_results (search);
+    }
+
+    pending_search_done (search);
 }
 
 static void
@@ -235,12 +589,18 @@ search_error_cb (NautilusSearchEngine *engine,
                  const gchar          *error_message,
                  gpointer              user_data)
 {
-    NautilusShellSearchProvider *self = user_data;
-    PendingSearch *search = self->current_search;
+    PendingSearch *search = user_data;
 
     g_debug ("*** Search engine search error");
-    pending_search_finish (search, search->invocation,
-                           g_variant_new ("(as)", NULL));
+
+    if (search->invocation != NULL)
+    {
+        g_dbus_method_invocation_return_value (search->invocation,
+                                               g_variant_new ("(as)", NULL));
+        g_clear_object (&search->invocation);
+    }
+
+    pending_search_done (search);
 }
 
 typedef struct
@@ -419,24 +779,42 @@ search_add_volumes_and_bookmarks (PendingSearch *search)
             hit = nautilus_search_hit_new (candidate->uri);
             nautilus_search_hit_set_fts_rank (hit, match);
             nautilus_search_hit_compute_scores (hit, search->query);
-            g_hash_table_replace (search->hits, g_strdup (candidate->uri), hit);
+            pending_search_add_candidate (search, hit);
+            g_object_unref (hit);
+
+            g_hash_table_replace (search->names, g_strdup (candidate->uri),
+                                  g_strdup (candidate->string_for_compare));
         }
     }
     g_list_free_full (candidates, (GDestroyNotify) search_hit_candidate_free);
     g_object_unref (volume_monitor);
 }
 
+/* Takes over @engine, @search gets its hits from now on. */
+static void
+pending_search_set_engine (PendingSearch        *search,
+                           NautilusSearchEngine *engine)
+{
+    search->engine = engine;
+
+    g_signal_connect (search->engine, "hits-added",
+                      G_CALLBACK (search_hits_added_cb), search);
+    g_signal_connect (search->engine, "finished",
+                      G_CALLBACK (search_finished_cb), search);
+    g_signal_connect (search->engine, "error",
+                      G_CALLBACK (search_error_cb), search);
+}
+
 static void
 execute_search (NautilusShellSearchProvider  *self,
                 GDBusMethodInvocation        *invocation,
                 gchar                       **terms)
 {
     gchar *terms_joined;
-    NautilusQuery *query;
     PendingSearch *pending_search;
-    GFile *home;
 
     cancel_current_search (self);
+    clear_last_search (self);
 
     /* don't attempt searches for a single character */
     if (g_strv_length (terms) == 1 &&
@@ -447,43 +825,117 @@ execute_search (NautilusShellSearchProvider  *self,
     }
 
     terms_joined = g_strjoinv (" ", terms);
-    home = g_file_new_for_path (g_get_home_dir ());
 
-    query = nautilus_query_new ();
-    nautilus_query_set_show_hidden_files (query, FALSE);
-    nautilus_query_set_text (query, terms_joined);
-    nautilus_query_set_location (query, home);
-
-    pending_search = g_slice_new0 (PendingSearch);
+    pending_search = pending_search_new (self, terms_joined);
     pending_search->invocation = g_object_ref (invocation);
-    pending_search->hits = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_object_unref);
-    pending_search->query = query;
-    pending_search->engine = nautilus_search_engine_new ();
-    pending_search->start_time = g_get_monotonic_time ();
-    pending_search->self = self;
-
-    g_signal_connect (pending_search->engine, "hits-added",
-                      G_CALLBACK (search_hits_added_cb), pending_search);
-    g_signal_connect (pending_search->engine, "finished",
-                      G_CALLBACK (search_finished_cb), pending_search);
-    g_signal_connect (pending_search->engine, "error",
-                      G_CALLBACK (search_error_cb), pending_search);
+    pending_search->names = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+    pending_search_set_engine (pending_search, nautilus_search_engine_new ());
 
     self->current_search = pending_search;
     g_application_hold (g_application_get_default ());
 
     search_add_volumes_and_bookmarks (pending_search);
 
+    pending_search->results_timeout_id = g_timeout_add (INITIAL_RESULTS_TIMEOUT_MS,
+                                                        results_timeout_cb,
+                                                        pending_search);
+
     /* start searching */
     g_debug ("*** Search engine search started");
     nautilus_search_provider_set_query (NAUTILUS_SEARCH_PROVIDER (pending_search->engine),
-                                        query);
+                                        pending_search->query);
     nautilus_search_provider_start (NAUTILUS_SEARCH_PROVIDER (pending_search->engine));
 
-    g_clear_object (&home);
     g_free (terms_joined);
 }
 
+/* Answers a subsearch from the hits of the current search, or of the
+ * last one, if the new terms only narrow it down and none of its hits
+ * were left out. A current search goes on, for its old terms, and the
+ * names of its hits are matched against the new ones. Returns FALSE if
+ * the engine has to be run again.
+ */
+static gboolean
+refine_previous_search (NautilusShellSearchProvider  *self,
+                        GDBusMethodInvocation        *invocation,
+                        gchar                       **terms)
+{
+    PendingSearch *previous_search, *search;
+    NautilusSearchHit *hit;
+    NautilusSearchEngine *engine;
+    GHashTableIter iter;
+    gchar *terms_joined;
+
+    previous_search = self->current_search != NULL ? self->current_search : self->last_search;
+    if (previous_search == NULL || previous_search->candidates_truncated)
+    {
+        return FALSE;
+    }
+
+    /* Every word of the old text is in a word of the new one, so
+     * whatever matches the new text matched the old one.
+     */
+    terms_joined = g_strjoinv (" ", terms);
+    if (!g_str_has_prefix (terms_joined, previous_search->text))
+    {
+        g_free (terms_joined);
+        return FALSE;
+    }
+
+    search = pending_search_new (self, terms_joined);
+    search->names = g_hash_table_ref (previous_search->names);
+    search->invocation = g_object_ref (invocation);
+
+    g_hash_table_iter_init (&iter, previous_search->candidates);
+    while (g_hash_table_iter_next (&iter, NULL, (gpointer *) &hit))
+    {
+        if (pending_search_match_hit (search, hit))
+        {
+            nautilus_search_hit_compute_scores (hit, search->query);
+            pending_search_add_candidate (search, hit);
+        }
+    }
+
+    g_debug ("*** Refined %u candidates to %u",
+             g_hash_table_size (previous_search->candidates),
+             g_hash_table_size (search->candidates));
+
+    if (previous_search == self->current_search)
+    {
+        /* The old call gets what was found for it, the engine and the
+         * hold on the application go to the new search.
+         */
+        if (previous_search->invocation != NULL)
+        {
+            pending_search_return_results (previous_search);
+        }
+
+        engine = g_steal_pointer (&previous_search->engine);
+        g_signal_handlers_disconnect_by_data (engine, previous_search);
+        pending_search_set_engine (search, engine);
+        search->filter_hits = TRUE;
+
+        self->current_search = search;
+        pending_search_free (previous_search);
+
+        search->results_timeout_id = g_timeout_add (INITIAL_RESULTS_TIMEOUT_MS,
+                                                    results_timeout_cb,
+                                                    search);
+    }
+    else
+    {
+        search->finished = TRUE;
+        pending_search_return_results (search);
+
+        clear_last_search (self);
+        self->last_search = search;
+    }
+
+    g_free (terms_joined);
+
+    return TRUE;
+}
+
 static gboolean
 handle_get_initial_result_set (NautilusShellSearchProvider2  *skeleton,
                                GDBusMethodInvocation         *invocation,
@@ -507,7 +959,10 @@ handle_get_subsearch_result_set (NautilusShellSearchProvider2  *skeleton,
     NautilusShellSearchProvider *self = user_data;
 
     g_debug ("****** GetSubSearchResultSet");
-    execute_search (self, invocation, terms);
+    if (!refine_previous_search (self, invocation, terms))
+    {
+        execute_search (self, invocation, terms);
+    }
     return TRUE;
 }
 
@@ -531,6 +986,62 @@ result_metas_data_free (ResultMetasData *data)
     g_slice_free (ResultMetasData, data);
 }
 
+static void
+cached_meta_free (CachedMeta *cached)
+{
+    g_variant_unref (cached->meta);
+
+    g_slice_free (CachedMeta, cached);
+}
+
+/* Returns the meta of @uri and makes it the most recently used. */
+static GVariant *
+metas_cache_lookup (NautilusShellSearchProvider *self,
+                    const gchar                 *uri)
+{
+    CachedMeta *cached;
+
+    cached = g_hash_table_lookup (self->metas_cache, uri);
+    if (cached == NULL)
+    {
+        return NULL;
+    }
+
+    g_queue_unlink (&self->metas_lru, cached->link);
+    g_queue_push_head_link (&self->metas_lru, cached->link);
+
+    return cached->meta;
+}
+
+/* Takes ownership of @uri and @meta. */
+static void
+metas_cache_insert (NautilusShellSearchProvider *self,
+                    gchar                       *uri,
+                    GVariant                    *meta)
+{
+    CachedMeta *cached;
+
+    cached = g_hash_table_lookup (self->metas_cache, uri);
+    if (cached != NULL)
+    {
+        g_queue_unlink (&self->metas_lru, cached->link);
+        g_list_free (cached->link);
+        g_hash_table_remove (self->metas_cache, uri);
+    }
+
+    while (self->metas_lru.length >= MAX_CACHED_METAS)
+    {
+        g_hash_table_remove (self->metas_cache, g_queue_pop_tail (&self->metas_lru));
+    }
+
+    cached = g_slice_new (CachedMeta);
+    cached->meta = meta;
+    g_queue_push_head (&self->metas_lru, uri);
+    cached->link = self->metas_lru.head;
+
+    g_hash_table_insert (self->metas_cache, uri, cached);
+}
+
 static void
 result_metas_return_from_cache (ResultMetasData *data)
 {
@@ -543,9 +1054,12 @@ result_metas_return_from_cache (ResultMetasData *data)
 
     for (idx = 0; data->uris[idx] != NULL; idx++)
     {
-        meta = g_hash_table_lookup (data->self->metas_cache,
-                                    data->uris[idx]);
-        g_variant_builder_add_value (&builder, meta);
+        meta = metas_cache_lookup (data->self, data->uris[idx]);
+        /* Only if the request was bigger than the whole cache. */
+        if (meta != NULL)
+        {
+            g_variant_builder_add_value (&builder, meta);
+        }
     }
 
     current_time = g_get_monotonic_time ();
@@ -621,8 +1135,7 @@ result_list_attributes_ready_cb (GList    *file_list,
         g_object_unref (gicon);
 
         meta_variant = g_variant_builder_end (&meta);
-        g_hash_table_insert (data->self->metas_cache,
-                             g_strdup (uri), g_variant_ref_sink (meta_variant));
+        metas_cache_insert (data->self, g_strdup (uri), g_variant_ref_sink (meta_variant));
 
         g_free (display_name);
         g_free (description);
@@ -651,7 +1164,7 @@ handle_get_result_metas (NautilusShellSearchProvider2  *skeleton,
     {
         uri = results[idx];
 
-        if (!g_hash_table_lookup (self->metas_cache, uri))
+        if (metas_cache_lookup (self, uri) == NULL)
         {
             missing_files = g_list_prepend (missing_files, nautilus_file_get_by_uri (uri));
         }
@@ -729,8 +1242,10 @@ search_provider_dispose (GObject *obj)
     NautilusShellSearchProvider *self = NAUTILUS_SHELL_SEARCH_PROVIDER (obj);
 
     g_clear_object (&self->skeleton);
-    g_hash_table_destroy (self->metas_cache);
+    g_clear_pointer (&self->metas_cache, g_hash_table_destroy);
+    g_queue_clear (&self->metas_lru);
     cancel_current_search (self);
+    clear_last_search (self);
 
     G_OBJECT_CLASS (nautilus_shell_search_provider_parent_class)->dispose (obj);
 }
@@ -739,7 +1254,8 @@ static void
 nautilus_shell_search_provider_init (NautilusShellSearchProvider *self)
 {
     self->metas_cache = g_hash_table_new_full (g_str_hash, g_str_equal,
-                                               g_free, (GDestroyNotify) g_variant_unref);
+                                               g_free, (GDestroyNotify) cached_meta_free);
+    g_queue_init (&self->metas_lru);
 
     self->skeleton = nautilus_shell_search_provider2_skeleton_new ();
 
@@ -55,10 +55,12 @@
 /* Cool-off period between last file modification time and thumbnail creation */
 #define THUMBNAIL_CREATION_DELAY_SECS 3
 
-static void thumbnail_thread_func (GTask        *task,
-                                   gpointer      source_object,
-                                   gpointer      task_data,
-                                   GCancellable *cancellable);
+/* Thumbnailers can need a lot of memory for big images, so never run
+ * more than this many at once, however many processors there are. */
+#define MAX_THUMBNAIL_THREADS 8
+
+static void thumbnail_thread_func (gpointer data,
+                                   gpointer user_data);
 
 /* structure used for making thumbnails, associating a uri with where the thumbnail is to be stored */
 
@@ -67,35 +69,42 @@ typedef struct
     char *image_uri;
     char *mime_type;
     time_t original_file_mtime;
+    NautilusThumbnailPriority priority;
+    /* Our node in the queue of our priority, unlinked while a
+     * thumbnail thread is making the thumbnail. */
+    GList *link;
+    gboolean in_progress;
 } NautilusThumbnailInfo;
 
 /*
  * Thumbnail thread state.
  */
 
-/* The id of the idle handler used to start the thumbnail thread, or 0 if no
+/* The id of the idle handler used to start the thumbnail threads, or 0 if no
  *  idle handler is currently registered. */
 static guint thumbnail_thread_starter_id = 0;
 
 /* Our mutex used when accessing data shared between the main thread and the
- *  thumbnail thread, i.e. the thumbnail_thread_is_running flag and the
- *  thumbnails_to_make list. */
+ *  thumbnail threads, i.e. the thumbnail_threads_running count and the
+ *  thumbnails_to_make queues. */
 static GMutex thumbnails_mutex;
 
-/* A flag to indicate whether a thumbnail thread is running, so we don't
- *  start more than one. Lock thumbnails_mutex when accessing this. */
-static volatile gboolean thumbnail_thread_is_running = FALSE;
+/* The pool the thumbnail threads run in. Each thread keeps making thumbnails
+ *  until the queues are empty. */
+static GThreadPool *thumbnail_thread_pool = NULL;
 
-/* The list of NautilusThumbnailInfo structs containing information about the
- *  thumbnails we are making. Lock thumbnails_mutex when accessing this. */
-static volatile GQueue thumbnails_to_make = G_QUEUE_INIT;
+/* The number of thumbnail threads running, so we don't start more than
+ *  get_max_thumbnail_threads(). Lock thumbnails_mutex when accessing this. */
+static guint thumbnail_threads_running = 0;
 
-/* Quickly check if uri is in thumbnails_to_make list */
-static GHashTable *thumbnails_to_make_hash = NULL;
+/* The queues of NautilusThumbnailInfo structs containing information about
+ *  the thumbnails we are making, one per priority. Lock thumbnails_mutex when
+ *  accessing this. */
+static GQueue thumbnails_to_make[NAUTILUS_THUMBNAIL_N_PRIORITIES];
 
-/* The currently thumbnailed icon. it also exists in the thumbnails_to_make list
- * to avoid adding it again. Lock thumbnails_mutex when accessing this. */
-static NautilusThumbnailInfo *currently_thumbnailing = NULL;
+/* Quickly find the NautilusThumbnailInfo for an uri. Thumbnails being made
+ *  stay in here to avoid adding them again. */
+static GHashTable *thumbnails_to_make_hash = NULL;
 
 static GnomeDesktopThumbnailFactory *thumbnail_factory = NULL;
 
@@ -130,11 +139,52 @@ get_file_mtime (const char *file_uri,
 static void
 free_thumbnail_info (NautilusThumbnailInfo *info)
 {
+    g_list_free_1 (info->link);
     g_free (info->image_uri);
     g_free (info->mime_type);
     g_free (info);
 }
 
+static guint
+get_max_thumbnail_threads (void)
+{
+    return CLAMP (g_get_num_processors (), 1, MAX_THUMBNAIL_THREADS);
+}
+
+/* Lock thumbnails_mutex when calling these. */
+static guint
+get_thumbnails_to_make_count (void)
+{
+    guint count;
+    int i;
+
+    count = 0;
+    for (i = 0; i < NAUTILUS_THUMBNAIL_N_PRIORITIES; i++)
+    {
+        count += g_queue_get_length (&thumbnails_to_make[i]);
+    }
+
+    return count;
+}
+
+static NautilusThumbnailInfo *
+pop_next_thumbnail_to_make (void)
+{
+    GList *link;
+    int i;
+
+    for (i = 0; i < NAUTILUS_THUMBNAIL_N_PRIORITIES; i++)
+    {
+        link = g_queue_pop_head_link (&thumbnails_to_make[i]);
+        if (link != NULL)
+        {
+            return link->data;
+        }
+    }
+
+    return NULL;
+}
+
 static GnomeDesktopThumbnailFactory *
 get_thumbnail_factory (void)
 {
@@ -150,13 +200,13 @@ get_thumbnail_factory (void)
 
 
 /* This function is added as a very low priority idle function to start the
- *  thread to create any needed thumbnails. It is added with a very low priority
+ *  threads to create any needed thumbnails. It is added with a very low priority
  *  so that it doesn't delay showing the directory in the icon/list views.
  *  We want to show the files in the directory as quickly as possible. */
 static gboolean
 thumbnail_thread_starter_cb (gpointer data)
 {
-    GTask *task;
+    guint count;
 
     /* Don't do this in thread, since g_object_ref is not threadsafe */
     if (thumbnail_factory == NULL)
@@ -164,20 +214,33 @@ thumbnail_thread_starter_cb (gpointer data)
         thumbnail_factory = get_thumbnail_factory ();
     }
 
+    /* A pool of our own, so long running thumbnailers don't starve the
+     *  threads GIO uses for async. operations. */
+    if (thumbnail_thread_pool == NULL)
+    {
+        thumbnail_thread_pool = g_thread_pool_new (thumbnail_thread_func, NULL,
+                                                   get_max_thumbnail_threads (),
+                                                   FALSE, NULL);
+    }
+
+    g_mutex_lock (&thumbnails_mutex);
+
+    /* Start a thread per queued thumbnail, up to the maximum. The count
+     *  is incremented here, so we don't start too many before they get
+     *  to run. */
+    count = get_thumbnails_to_make_count ();
+    while (thumbnail_threads_running < get_max_thumbnail_threads () &&
+           thumbnail_threads_running < count)
+    {
 #ifdef DEBUG_THUMBNAILS
-    g_message ("(Main Thread) Creating thumbnails thread\n");
+        g_message ("(Main Thread) Creating thumbnails thread\n");
 #endif
-    /* We set a flag to indicate the thread is running, so we don't create
-     *  a new one. We don't need to lock a mutex here, as the thumbnail
-     *  thread isn't running yet. And we know we won't create the thread
-     *  twice, as we also check thumbnail_thread_starter_id before
-     *  scheduling this idle function. */
-    thumbnail_thread_is_running = TRUE;
-    task = g_task_new (NULL, NULL, NULL, NULL);
-    g_task_run_in_thread (task, thumbnail_thread_func);
+        thumbnail_threads_running++;
+        g_thread_pool_push (thumbnail_thread_pool, GUINT_TO_POINTER (TRUE), NULL);
+    }
     thumbnail_thread_starter_id = 0;
 
-    g_object_unref (task);
+    g_mutex_unlock (&thumbnails_mutex);
 
     return FALSE;
 }
@@ -185,7 +248,7 @@ thumbnail_thread_starter_cb (gpointer data)
 void
 nautilus_thumbnail_remove_from_queue (const char *file_uri)
 {
-    GList *node;
+    NautilusThumbnailInfo *info;
 
 #ifdef DEBUG_THUMBNAILS
     g_message ("(Remove from queue) Locking mutex\n");
@@ -198,13 +261,13 @@ nautilus_thumbnail_remove_from_queue (const char *file_uri)
 
     if (thumbnails_to_make_hash)
     {
-        node = g_hash_table_lookup (thumbnails_to_make_hash, file_uri);
+        info = g_hash_table_lookup (thumbnails_to_make_hash, file_uri);
 
-        if (node && node->data != currently_thumbnailing)
+        if (info && !info->in_progress)
         {
             g_hash_table_remove (thumbnails_to_make_hash, file_uri);
-            free_thumbnail_info (node->data);
-            g_queue_delete_link ((GQueue *) &thumbnails_to_make, node);
+            g_queue_unlink (&thumbnails_to_make[info->priority], info->link);
+            free_thumbnail_info (info);
         }
     }
 
@@ -221,7 +284,16 @@ nautilus_thumbnail_remove_from_queue (const char *file_uri)
 void
 nautilus_thumbnail_prioritize (const char *file_uri)
 {
-    GList *node;
+    nautilus_thumbnail_set_priority (file_uri, NAUTILUS_THUMBNAIL_PRIORITY_VISIBLE);
+}
+
+void
+nautilus_thumbnail_set_priority (const char                *file_uri,
+                                 NautilusThumbnailPriority  priority)
+{
+    NautilusThumbnailInfo *info;
+
+    g_return_if_fail (priority < NAUTILUS_THUMBNAIL_N_PRIORITIES);
 
 #ifdef DEBUG_THUMBNAILS
     g_message ("(Prioritize) Locking mutex\n");
@@ -234,12 +306,18 @@ nautilus_thumbnail_prioritize (const char *file_uri)
 
     if (thumbnails_to_make_hash)
     {
-        node = g_hash_table_lookup (thumbnails_to_make_hash, file_uri);
-
-        if (node && node->data != currently_thumbnailing)
+        info = g_hash_table_lookup (thumbnails_to_make_hash, file_uri);
+
+        /* Visible thumbnails are moved to the head each time, so the
+         *  last one prioritized is made first. Leave the others alone
+         *  if their priority doesn't change. */
+        if (info && !info->in_progress &&
+            (info->priority != priority ||
+             priority == NAUTILUS_THUMBNAIL_PRIORITY_VISIBLE))
         {
-            g_queue_unlink ((GQueue *) &thumbnails_to_make, node);
-            g_queue_push_head_link ((GQueue *) &thumbnails_to_make, node);
+            g_queue_unlink (&thumbnails_to_make[info->priority], info->link);
+            info->priority = priority;
+            g_queue_push_head_link (&thumbnails_to_make[priority], info->link);
         }
     }
 
@@ -383,13 +461,15 @@ nautilus_create_thumbnail (NautilusFile *file)
     time_t file_mtime = 0;
     NautilusThumbnailInfo *info;
     NautilusThumbnailInfo *existing_info;
-    GList *existing, *node;
 
     nautilus_file_set_is_thumbnailing (file, TRUE);
 
     info = g_new0 (NautilusThumbnailInfo, 1);
     info->image_uri = nautilus_file_get_uri (file);
     info->mime_type = nautilus_file_get_mime_type (file);
+    info->priority = NAUTILUS_THUMBNAIL_PRIORITY_DEFAULT;
+    info->link = g_list_alloc ();
+    info->link->data = info;
 
     /* Hopefully the NautilusFile will already have the image file mtime,
      *  so we can just use that. Otherwise we have to get it ourselves. */
@@ -423,24 +503,23 @@ nautilus_create_thumbnail (NautilusFile *file)
     }
 
     /* Check if it is already in the list of thumbnails to make. */
-    existing = g_hash_table_lookup (thumbnails_to_make_hash, info->image_uri);
-    if (existing == NULL)
+    existing_info = g_hash_table_lookup (thumbnails_to_make_hash, info->image_uri);
+    if (existing_info == NULL)
     {
         /* Add the thumbnail to the list. */
 #ifdef DEBUG_THUMBNAILS
         g_message ("(Main Thread) Adding thumbnail: %s\n",
                    info->image_uri);
 #endif
-        g_queue_push_tail ((GQueue *) &thumbnails_to_make, info);
-        node = g_queue_peek_tail_link ((GQueue *) &thumbnails_to_make);
+        g_queue_push_tail_link (&thumbnails_to_make[info->priority], info->link);
         g_hash_table_insert (thumbnails_to_make_hash,
                              info->image_uri,
-                             node);
-        /* If the thumbnail thread isn't running, and we haven't
-         *  scheduled an idle function to start it up, do that now.
-         *  We don't want to start it until all the other work is done,
+                             info);
+        /* If not all thumbnail threads are running, and we haven't
+         *  scheduled an idle function to start them up, do that now.
+         *  We don't want to start them until all the other work is done,
          *  so the GUI will be updated as quickly as possible.*/
-        if (thumbnail_thread_is_running == FALSE &&
+        if (thumbnail_threads_running < get_max_thumbnail_threads () &&
             thumbnail_thread_starter_id == 0)
         {
             thumbnail_thread_starter_id = g_idle_add_full (G_PRIORITY_LOW, thumbnail_thread_starter_cb, NULL, NULL);
@@ -453,7 +532,6 @@ nautilus_create_thumbnail (NautilusFile *file)
                    info->image_uri);
 #endif
         /* The file in the queue might need a new original mtime */
-        existing_info = existing->data;
         existing_info->original_file_mtime = info->original_file_mtime;
         free_thumbnail_info (info);
     }
@@ -468,18 +546,16 @@ nautilus_create_thumbnail (NautilusFile *file)
     g_mutex_unlock (&thumbnails_mutex);
 }
 
-/* thumbnail_thread is invoked as a separate thread to to make thumbnails. */
+/* thumbnail_thread is invoked in the thread pool to make thumbnails. Several
+ *  of them run at once, each taking the most important thumbnail left. */
 static void
-thumbnail_thread_func (GTask        *task,
-                       gpointer      source_object,
-                       gpointer      task_data,
-                       GCancellable *cancellable)
+thumbnail_thread_func (gpointer data,
+                       gpointer user_data)
 {
     NautilusThumbnailInfo *info = NULL;
     GdkPixbuf *pixbuf;
     time_t current_orig_mtime = 0;
     time_t current_time;
-    GList *node;
 
     /* We loop until there are no more thumbails to make, at which point
      *  we exit the thread. */
@@ -494,43 +570,46 @@ thumbnail_thread_func (GTask        *task,
          * MUTEX LOCKED
          *********************************/
 
-        /* Pop the last thumbnail we just made off the head of the
-         *  list and free it. I did this here so we only have to lock
-         *  the mutex once per thumbnail, rather than once before
-         *  creating it and once after.
-         *  Don't pop the thumbnail off the queue if the original file
-         *  mtime of the request changed. Then we need to redo the thumbnail.
+        /* Forget the last thumbnail we just made and free it. I did
+         *  this here so we only have to lock the mutex once per
+         *  thumbnail, rather than once before creating it and once after.
+         *  Put the thumbnail back at the head of its queue if the original
+         *  file mtime of the request changed. Then we need to redo the
+         *  thumbnail.
          */
-        if (currently_thumbnailing &&
-            currently_thumbnailing->original_file_mtime == current_orig_mtime)
+        if (info != NULL)
         {
-            g_assert (info == currently_thumbnailing);
-            node = g_hash_table_lookup (thumbnails_to_make_hash, info->image_uri);
-            g_assert (node != NULL);
-            g_hash_table_remove (thumbnails_to_make_hash, info->image_uri);
-            free_thumbnail_info (info);
-            g_queue_delete_link ((GQueue *) &thumbnails_to_make, node);
+            info->in_progress = FALSE;
+            if (info->original_file_mtime == current_orig_mtime)
+            {
+                g_hash_table_remove (thumbnails_to_make_hash, info->image_uri);
+                free_thumbnail_info (info);
+            }
+            else
+            {
+                g_queue_push_head_link (&thumbnails_to_make[info->priority], info->link);
+            }
         }
-        currently_thumbnailing = NULL;
 
-        /* If there are no more thumbnails to make, reset the
-         *  thumbnail_thread_is_running flag, unlock the mutex, and
+        /* Get the next one to make. We leave it in the hash table until
+         *  it is created so the main thread doesn't add it again while we
+         *  are creating it. */
+        info = pop_next_thumbnail_to_make ();
+
+        /* If there are no more thumbnails to make, decrement the
+         *  thumbnail_threads_running count, unlock the mutex, and
          *  exit the thread. */
-        if (g_queue_is_empty ((GQueue *) &thumbnails_to_make))
+        if (info == NULL)
         {
 #ifdef DEBUG_THUMBNAILS
             g_message ("(Thumbnail Thread) Exiting\n");
 #endif
-            thumbnail_thread_is_running = FALSE;
+            thumbnail_threads_running--;
             g_mutex_unlock (&thumbnails_mutex);
             return;
         }
 
-        /* Get the next one to make. We leave it on the list until it
-         *  is created so the main thread doesn't add it again while we
-         *  are creating it. */
-        info = g_queue_peek_head ((GQueue *) &thumbnails_to_make);
-        currently_thumbnailing = info;
+        info->in_progress = TRUE;
         current_orig_mtime = info->original_file_mtime;
         /*********************************
          * MUTEX UNLOCKED
@@ -32,9 +32,19 @@ gboolean   nautilus_can_thumbnail_internally        (NautilusFile *file);
 gboolean   nautilus_thumbnail_is_mimetype_limited_by_size
 						    (const char *mime_type);
 
+/* Thumbnails are made in this order, depending on where the file is shown. */
+typedef enum {
+	NAUTILUS_THUMBNAIL_PRIORITY_VISIBLE,
+	NAUTILUS_THUMBNAIL_PRIORITY_NEAR_VISIBLE,
+	NAUTILUS_THUMBNAIL_PRIORITY_DEFAULT,
+	NAUTILUS_THUMBNAIL_N_PRIORITIES
+} NautilusThumbnailPriority;
+
 /* Queue handling: */
 void       nautilus_thumbnail_remove_from_queue     (const char   *file_uri);
 void       nautilus_thumbnail_prioritize            (const char   *file_uri);
+void       nautilus_thumbnail_set_priority          (const char   *file_uri,
+						     NautilusThumbnailPriority priority);
 
 
 #endif /* NAUTILUS_THUMBNAILS_H */
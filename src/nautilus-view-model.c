@@ -9,6 +9,19 @@ struct _NautilusViewModel
     GHashTable *map_files_to_model;
     GListStore *internal_model;
     NautilusViewModelSortData *sort_data;
+
+    /* The items in the same order as internal_model, which can't tell
+     * where an item is without looking at all of them. Iters stay
+     * valid as items come and go, and know their position. It holds
+     * references of its own, so the store can be refilled from it.
+     */
+    GSequence *items;
+    GHashTable *map_items_to_iters;
+
+    /* Positions change whenever an item is added or removed, so the
+     * selection is kept by item.
+     */
+    GHashTable *selected_items;
 };
 
 G_DEFINE_TYPE (NautilusViewModel, nautilus_view_model, G_TYPE_OBJECT)
@@ -29,6 +42,9 @@ finalize (GObject *object)
     G_OBJECT_CLASS (nautilus_view_model_parent_class)->finalize (object);
 
     g_hash_table_destroy (self->map_files_to_model);
+    g_hash_table_destroy (self->map_items_to_iters);
+    g_hash_table_destroy (self->selected_items);
+    g_sequence_free (self->items);
     if (self->sort_data)
     {
         g_free (self->sort_data);
@@ -97,6 +113,9 @@ constructed (GObject *object)
 
     self->internal_model = g_list_store_new (NAUTILUS_TYPE_VIEW_ITEM_MODEL);
     self->map_files_to_model = g_hash_table_new (NULL, NULL);
+    self->items = g_sequence_new (g_object_unref);
+    self->map_items_to_iters = g_hash_table_new (NULL, NULL);
+    self->selected_items = g_hash_table_new (NULL, NULL);
 }
 
 static void
@@ -133,6 +152,69 @@ compare_data_func (gconstpointer a,
                                            self->sort_data->reversed);
 }
 
+static gint
+compare_data_ptr_func (gconstpointer a,
+                       gconstpointer b,
+                       gpointer      user_data)
+{
+    return compare_data_func (*(gpointer *) a, *(gpointer *) b, user_data);
+}
+
+static void
+track_item (NautilusViewModel     *self,
+            NautilusViewItemModel *item,
+            GSequenceIter         *iter)
+{
+    g_hash_table_insert (self->map_items_to_iters, item, iter);
+    g_hash_table_insert (self->map_files_to_model,
+                         nautilus_view_item_model_get_file (item),
+                         item);
+    if (nautilus_view_item_model_get_is_selected (item))
+    {
+        g_hash_table_add (self->selected_items, item);
+    }
+}
+
+/* Puts the items of internal_model in the order of the sequence. */
+static void
+sync_internal_model (NautilusViewModel *self)
+{
+    g_autofree gpointer *array = NULL;
+    GSequenceIter *iter;
+    guint n_items;
+    guint i;
+
+    n_items = g_sequence_get_length (self->items);
+    array = g_new (gpointer, MAX (n_items, 1));
+
+    i = 0;
+    for (iter = g_sequence_get_begin_iter (self->items);
+         !g_sequence_iter_is_end (iter);
+         iter = g_sequence_iter_next (iter))
+    {
+        array[i++] = g_sequence_get (iter);
+    }
+
+    g_list_store_splice (self->internal_model,
+                         0, g_list_model_get_n_items (G_LIST_MODEL (self->internal_model)),
+                         array, n_items);
+}
+
+static gint
+compare_positions (gconstpointer a,
+                   gconstpointer b,
+                   gpointer      user_data)
+{
+    NautilusViewModel *self = NAUTILUS_VIEW_MODEL (user_data);
+    gint position_a;
+    gint position_b;
+
+    position_a = g_sequence_iter_get_position (g_hash_table_lookup (self->map_items_to_iters, a));
+    position_b = g_sequence_iter_get_position (g_hash_table_lookup (self->map_items_to_iters, b));
+
+    return position_a - position_b;
+}
+
 NautilusViewModel *
 nautilus_view_model_new ()
 {
@@ -143,6 +225,8 @@ void
 nautilus_view_model_set_sort_type (NautilusViewModel         *self,
                                    NautilusViewModelSortData *sort_data)
 {
+    GSequenceIter *iter;
+
     if (self->sort_data)
     {
         g_free (self->sort_data);
@@ -153,7 +237,20 @@ nautilus_view_model_set_sort_type (NautilusViewModel         *self,
     self->sort_data->reversed = sort_data->reversed;
     self->sort_data->directories_first = sort_data->directories_first;
 
-    g_list_store_sort (self->internal_model, compare_data_func, self);
+    /* Types are the only keys not made already. */
+    if (self->sort_data->sort_type == NAUTILUS_FILE_SORT_BY_TYPE)
+    {
+        for (iter = g_sequence_get_begin_iter (self->items);
+             !g_sequence_iter_is_end (iter);
+             iter = g_sequence_iter_next (iter))
+        {
+            nautilus_file_prepare_sort_key_q (nautilus_view_item_model_get_file (g_sequence_get (iter)),
+                                              g_quark_from_static_string ("type"));
+        }
+    }
+
+    g_sequence_sort (self->items, compare_data_func, self);
+    sync_internal_model (self);
 }
 
 NautilusViewModelSortData *
@@ -179,26 +276,10 @@ nautilus_view_model_get_items_from_files (NautilusViewModel *self,
     item_models = g_queue_new ();
     for (l = g_queue_peek_head_link (files); l != NULL; l = l->next)
     {
-        NautilusFile *file1;
-        gint i = 0;
-
-        file1 = NAUTILUS_FILE (l->data);
-        while ((item_model = g_list_model_get_item (G_LIST_MODEL (self->internal_model), i)))
+        item_model = g_hash_table_lookup (self->map_files_to_model, l->data);
+        if (item_model != NULL)
         {
-            NautilusFile *file2;
-            g_autofree gchar *file1_uri;
-            g_autofree gchar *file2_uri;
-
-            file2 = nautilus_view_item_model_get_file (item_model);
-            file1_uri = nautilus_file_get_uri (file1);
-            file2_uri = nautilus_file_get_uri (file2);
-            if (g_strcmp0 (file1_uri, file2_uri) == 0)
-            {
-                g_queue_push_tail (item_models, item_model);
-                break;
-            }
-
-            i++;
+            g_queue_push_tail (item_models, item_model);
         }
     }
 
@@ -216,110 +297,187 @@ void
 nautilus_view_model_remove_item (NautilusViewModel     *self,
                                  NautilusViewItemModel *item)
 {
-    NautilusViewItemModel *item_model;
-    gint i;
+    GSequenceIter *iter;
+    NautilusFile *file;
+    guint position;
 
-    i = 0;
-    item_model = NULL;
-    while ((item_model = g_list_model_get_item (G_LIST_MODEL (self->internal_model), i)))
+    iter = item != NULL ? g_hash_table_lookup (self->map_items_to_iters, item) : NULL;
+    if (iter == NULL)
     {
-        if (item_model == item)
-        {
-            break;
-        }
-
-        i++;
+        return;
     }
 
-    if (item_model != NULL)
+    position = g_sequence_iter_get_position (iter);
+    g_sequence_remove (iter);
+    g_hash_table_remove (self->map_items_to_iters, item);
+    g_hash_table_remove (self->selected_items, item);
+
+    file = nautilus_view_item_model_get_file (item);
+    if (g_hash_table_lookup (self->map_files_to_model, file) == item)
     {
-        g_list_store_remove (self->internal_model, i);
+        g_hash_table_remove (self->map_files_to_model, file);
     }
+
+    /* Last, this might drop the last reference to the item. */
+    g_list_store_remove (self->internal_model, position);
+}
+
+void
+nautilus_view_model_remove_all_items (NautilusViewModel *self)
+{
+    g_hash_table_remove_all (self->map_files_to_model);
+    g_hash_table_remove_all (self->map_items_to_iters);
+    g_hash_table_remove_all (self->selected_items);
+    g_sequence_remove_range (g_sequence_get_begin_iter (self->items),
+                             g_sequence_get_end_iter (self->items));
+
+    g_list_store_remove_all (self->internal_model);
 }
 
 void
 nautilus_view_model_add_item (NautilusViewModel     *self,
                               NautilusViewItemModel *item)
 {
-    g_list_store_insert_sorted (self->internal_model, item, compare_data_func, self);
+    GSequenceIter *iter;
+
+    iter = g_sequence_insert_sorted (self->items, g_object_ref (item),
+                                     compare_data_func, self);
+    track_item (self, item, iter);
+
+    g_list_store_insert (self->internal_model, g_sequence_iter_get_position (iter), item);
 }
 
 void
 nautilus_view_model_set_selected (NautilusViewModel *self,
                                   GQueue            *item_models)
 {
+    GHashTable *selected_items;
+    GHashTableIter iter;
     GList *l;
-    NautilusViewItemModel *item_model;
+    gpointer item_model;
 
-    gint i = 0;
-    while ((item_model = g_list_model_get_item (G_LIST_MODEL (self->internal_model), i)))
+    selected_items = g_hash_table_new (NULL, NULL);
+    for (l = g_queue_peek_head_link (item_models); l != NULL; l = l->next)
     {
-        gboolean selected;
-
-        selected = FALSE;
-        for (l = g_queue_peek_head_link (item_models); l != NULL; l = l->next)
+        if (g_hash_table_contains (self->map_items_to_iters, l->data))
         {
-            NautilusViewItemModel *selected_item_model;
+            g_hash_table_add (selected_items, l->data);
+        }
+    }
 
-            selected_item_model = NAUTILUS_VIEW_ITEM_MODEL (l->data);
-            if (item_model == selected_item_model)
-            {
-                selected = TRUE;
-                break;
-            }
+    /* Only the items whose state changes are touched. */
+    g_hash_table_iter_init (&iter, self->selected_items);
+    while (g_hash_table_iter_next (&iter, &item_model, NULL))
+    {
+        if (!g_hash_table_contains (selected_items, item_model))
+        {
+            nautilus_view_item_model_set_selected (item_model, FALSE);
         }
-        i++;
+    }
 
-        nautilus_view_item_model_set_selected (item_model, selected);
+    g_hash_table_iter_init (&iter, selected_items);
+    while (g_hash_table_iter_next (&iter, &item_model, NULL))
+    {
+        nautilus_view_item_model_set_selected (item_model, TRUE);
     }
+
+    g_hash_table_destroy (self->selected_items);
+    self->selected_items = selected_items;
 }
 
 GQueue *
 nautilus_view_model_get_selected (NautilusViewModel *self)
 {
-    NautilusViewItemModel *item_model;
+    GList *items;
+    GList *l;
     GQueue *selected_items;
-    gint i;
 
-    i = 0;
+    /* In the order of the view. */
+    items = g_hash_table_get_keys (self->selected_items);
+    items = g_list_sort_with_data (items, compare_positions, self);
+
     selected_items = g_queue_new ();
-    while ((item_model = g_list_model_get_item (G_LIST_MODEL (self->internal_model), i)))
+    for (l = items; l != NULL; l = l->next)
     {
-        if (nautilus_view_item_model_get_is_selected (item_model))
-        {
-            g_queue_push_tail (selected_items,
-                               g_object_ref (nautilus_view_item_model_get_file (item_model)));
-        }
-        i++;
+        g_queue_push_tail (selected_items,
+                           g_object_ref (nautilus_view_item_model_get_file (l->data)));
     }
+    g_list_free (items);
 
     return selected_items;
 }
 
 void
-nautilus_view_model_set_items (NautilusViewModel *self,
+nautilus_view_model_add_items (NautilusViewModel *self,
                                GQueue            *items)
 {
-    g_autofree gpointer *array = NULL;
+    g_autoptr (GPtrArray) sorted = NULL;
+    g_autoptr (GPtrArray) run = NULL;
+    GSequenceIter *iter;
+    NautilusViewItemModel *item;
+    guint n_items;
+    guint position;
+    guint run_start;
+    guint i;
     GList *l;
-    int i = 0;
-
-    array = g_malloc_n (g_queue_get_length (items),
-                        sizeof (NautilusViewItemModel *));
 
-    g_hash_table_remove_all (self->map_files_to_model);
+    sorted = g_ptr_array_sized_new (g_queue_get_length (items));
     for (l = g_queue_peek_head_link (items); l != NULL; l = l->next)
     {
-        array[i] = l->data;
-        g_hash_table_insert (self->map_files_to_model,
-                             nautilus_view_item_model_get_file (l->data),
-                             l->data);
-        i++;
+        g_ptr_array_add (sorted, l->data);
     }
+    g_ptr_array_sort_with_data (sorted, compare_data_ptr_func, self);
 
-    g_list_store_splice (self->internal_model,
-                         g_list_model_get_n_items (G_LIST_MODEL (self->internal_model)),
-                         0, array, g_queue_get_length (items));
+    /* Merging walks over all the items, looking each new one up
+     * doesn't. Whichever takes fewer comparisons.
+     */
+    n_items = g_sequence_get_length (self->items);
+    if (sorted->len * g_bit_storage (n_items) < n_items + sorted->len)
+    {
+        for (i = 0; i < sorted->len; i++)
+        {
+            nautilus_view_model_add_item (self, g_ptr_array_index (sorted, i));
+        }
+
+        return;
+    }
+
+    /* New items next to each other go in the store with a single
+     * splice, in order, so the store always matches what it was told.
+     */
+    run = g_ptr_array_new ();
+    run_start = 0;
+    position = 0;
+    iter = g_sequence_get_begin_iter (self->items);
+    for (i = 0; i < sorted->len; i++)
+    {
+        item = g_ptr_array_index (sorted, i);
+
+        while (!g_sequence_iter_is_end (iter) &&
+               compare_data_func (g_sequence_get (iter), item, self) <= 0)
+        {
+            if (run->len > 0)
+            {
+                g_list_store_splice (self->internal_model, run_start, 0, run->pdata, run->len);
+                g_ptr_array_set_size (run, 0);
+            }
+
+            iter = g_sequence_iter_next (iter);
+            position++;
+        }
+
+        if (run->len == 0)
+        {
+            run_start = position;
+        }
+
+        track_item (self, item, g_sequence_insert_before (iter, g_object_ref (item)));
+        g_ptr_array_add (run, item);
+        position++;
+    }
 
-    g_list_store_sort (self->internal_model, compare_data_func, self);
+    if (run->len > 0)
+    {
+        g_list_store_splice (self->internal_model, run_start, 0, run->pdata, run->len);
+    }
 }
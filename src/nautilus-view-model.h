@@ -30,12 +30,14 @@ GQueue * nautilus_view_model_get_items_from_files (NautilusViewModel *self,
                                                    GQueue            *files);
 void nautilus_view_model_remove_item (NautilusViewModel     *self,
                                       NautilusViewItemModel *item);
+void nautilus_view_model_remove_all_items (NautilusViewModel *self);
 void nautilus_view_model_add_item (NautilusViewModel     *self,
                                    NautilusViewItemModel *item);
 void nautilus_view_model_set_selected (NautilusViewModel *self,
                                        GQueue            *item_models);
 GQueue * nautilus_view_model_get_selected (NautilusViewModel *self);
-void nautilus_view_model_set_items (NautilusViewModel *self,
+/* Adds a batch of items, merging them in if there are many. */
+void nautilus_view_model_add_items (NautilusViewModel *self,
                                     GQueue            *items);
 G_END_DECLS
 
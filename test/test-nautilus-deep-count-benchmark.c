@@ -0,0 +1,178 @@
+#include <gtk/gtk.h>
+#include <glib/gstdio.h>
+#include <src/nautilus-file.h>
+#include <src/nautilus-file-attributes.h>
+#include <src/nautilus-file-utilities.h>
+#include <sys/resource.h>
+#include <unistd.h>
+
+/* Counts a generated tree the way "Properties → Contents" does and
+ * reports the time it took and the peak memory use.
+ *
+ * Usage: test-nautilus-deep-count-benchmark [N_FILES]
+ */
+
+#define DEFAULT_N_FILES 1000000
+#define FILES_PER_DIRECTORY 1000
+
+/* Every this many files one is a hard link to the file before it, so
+ * the size of the linked inode must only be counted once.
+ */
+#define HARD_LINK_EVERY 10
+
+static gint64 start_time;
+static gboolean failed;
+
+static int n_files;
+static int n_directories;
+static goffset expected_size;
+
+static char *
+get_file_path (const char *root,
+               int         i)
+{
+    return g_strdup_printf ("%s/dir-%d/file-%d", root,
+                            i / FILES_PER_DIRECTORY,
+                            i % FILES_PER_DIRECTORY);
+}
+
+static void
+create_tree (const char *root)
+{
+    char *path, *previous;
+    int i;
+
+    n_directories = (n_files + FILES_PER_DIRECTORY - 1) / FILES_PER_DIRECTORY;
+    for (i = 0; i < n_directories; i++)
+    {
+        path = g_strdup_printf ("%s/dir-%d", root, i);
+        g_mkdir (path, 0700);
+        g_free (path);
+    }
+
+    for (i = 0; i < n_files; i++)
+    {
+        path = get_file_path (root, i);
+
+        if (i % FILES_PER_DIRECTORY != 0 && i % HARD_LINK_EVERY == HARD_LINK_EVERY - 1)
+        {
+            previous = get_file_path (root, i - 1);
+            if (link (previous, path) != 0)
+            {
+                g_error ("could not link %s", path);
+            }
+            g_free (previous);
+        }
+        else
+        {
+            g_file_set_contents (path, "x", 1, NULL);
+            expected_size++;
+        }
+
+        g_free (path);
+    }
+}
+
+static void
+remove_tree (const char *root)
+{
+    char *path;
+    int i;
+
+    for (i = 0; i < n_files; i++)
+    {
+        path = get_file_path (root, i);
+        g_unlink (path);
+        g_free (path);
+    }
+
+    for (i = 0; i < n_directories; i++)
+    {
+        path = g_strdup_printf ("%s/dir-%d", root, i);
+        g_rmdir (path);
+        g_free (path);
+    }
+
+    g_rmdir (root);
+}
+
+static void
+deep_counts_ready (NautilusFile *file,
+                   gpointer      callback_data)
+{
+    guint directory_count, file_count, unreadable_directory_count;
+    goffset total_size;
+    struct rusage usage;
+    gint64 elapsed;
+
+    elapsed = g_get_monotonic_time () - start_time;
+
+    nautilus_file_get_deep_counts (file,
+                                   &directory_count,
+                                   &file_count,
+                                   &unreadable_directory_count,
+                                   &total_size,
+                                   TRUE);
+
+    getrusage (RUSAGE_SELF, &usage);
+
+    g_print ("%u directories, %u files, %" G_GOFFSET_FORMAT " bytes\n",
+             directory_count, file_count, total_size);
+    g_print ("counted in %.3f s, peak memory %ld KiB\n",
+             elapsed / (double) G_USEC_PER_SEC, usage.ru_maxrss);
+
+    if (directory_count != (guint) n_directories ||
+        file_count != (guint) n_files ||
+        total_size != expected_size)
+    {
+        g_printerr ("expected %d directories, %d files, %" G_GOFFSET_FORMAT " bytes\n",
+                    n_directories, n_files, expected_size);
+        failed = TRUE;
+    }
+
+    gtk_main_quit ();
+}
+
+int
+main (int    argc,
+      char **argv)
+{
+    NautilusFile *file;
+    char *root;
+    char *uri;
+    gint64 create_time;
+
+    gtk_init (&argc, &argv);
+
+    nautilus_ensure_extension_points ();
+
+    n_files = argc > 1 ? atoi (argv[1]) : DEFAULT_N_FILES;
+
+    root = g_dir_make_tmp ("nautilus-deep-count-benchmark-XXXXXX", NULL);
+    g_assert (root != NULL);
+
+    g_print ("creating %d files in %s\n", n_files, root);
+    create_time = g_get_monotonic_time ();
+    create_tree (root);
+    g_print ("created in %.3f s\n",
+             (g_get_monotonic_time () - create_time) / (double) G_USEC_PER_SEC);
+
+    uri = g_filename_to_uri (root, NULL, NULL);
+    file = nautilus_file_get_by_uri (uri);
+
+    start_time = g_get_monotonic_time ();
+    nautilus_file_call_when_ready (file,
+                                   NAUTILUS_FILE_ATTRIBUTE_INFO |
+                                   NAUTILUS_FILE_ATTRIBUTE_DEEP_COUNTS,
+                                   deep_counts_ready, NULL);
+
+    gtk_main ();
+
+    nautilus_file_unref (file);
+
+    remove_tree (root);
+    g_free (uri);
+    g_free (root);
+
+    return failed ? 1 : 0;
+}
@@ -1,99 +1,227 @@
 #include <gtk/gtk.h>
+#include <glib/gstdio.h>
 #include <src/nautilus-directory.h>
+#include <src/nautilus-directory-private.h>
 #include <src/nautilus-file-utilities.h>
 #include <src/nautilus-search-directory.h>
 #include <src/nautilus-file.h>
 #include <unistd.h>
 
-void *client1, *client2;
+/* Number of files created in the test directory. */
+#define N_FILES 500
 
+/* Every this many files one is a folder, so its item count is asked
+ * for too, which is a low priority job.
+ */
+#define DIRECTORY_EVERY 5
+
+/* Invalidate the info of all files again after this many arrived,
+ * which cancels everything that is in flight at that point.
+ */
+#define CANCEL_AFTER 50
+
+void *client1;
+
+static NautilusDirectory *directory;
+static GList *files;
+static int files_requested;
+static int files_ready;
+static gboolean cancelled;
+static guint max_jobs_in_flight;
+static int max_async_jobs;
+static int max_low_priority_jobs;
+static gboolean failed;
+
+/* Called whenever something arrives, while the rest is in flight. */
 static void
-files_added (NautilusDirectory *directory,
-             GList             *added_files)
+check_bounds (void)
 {
-#if 0
-    GList *list;
+    guint jobs_in_flight;
+    int async_jobs, low_priority_jobs, budget;
+
+    jobs_in_flight = nautilus_directory_get_jobs_in_flight (directory);
+    max_jobs_in_flight = MAX (max_jobs_in_flight, jobs_in_flight);
 
-    for (list = added_files; list != NULL; list = list->next)
+    if (jobs_in_flight > nautilus_directory_get_jobs_per_kind (directory))
     {
-        NautilusFile *file = list->data;
+        g_printerr ("%u jobs in flight, limit is %u\n",
+                    jobs_in_flight,
+                    nautilus_directory_get_jobs_per_kind (directory));
+        failed = TRUE;
+    }
+
+    /* The same for all directories together. */
+    async_jobs = nautilus_directory_get_async_job_count ();
+    low_priority_jobs = nautilus_directory_get_async_low_priority_job_count ();
+    budget = nautilus_directory_get_async_job_budget ();
+    max_async_jobs = MAX (max_async_jobs, async_jobs);
+    max_low_priority_jobs = MAX (max_low_priority_jobs, low_priority_jobs);
 
-        g_print (" - %s\n", nautilus_file_get_uri (file));
+    if (budget < MIN_ASYNC_JOBS || budget > MAX_ASYNC_JOBS)
+    {
+        g_printerr ("job budget is %d, not between %d and %d\n",
+                    budget, MIN_ASYNC_JOBS, MAX_ASYNC_JOBS);
+        failed = TRUE;
     }
-#endif
 
-    g_print ("files added: %d files\n",
-             g_list_length (added_files));
+    if (async_jobs < 0 || async_jobs > MAX_ASYNC_JOBS)
+    {
+        g_printerr ("%d async jobs in flight, limit is %d\n",
+                    async_jobs, MAX_ASYNC_JOBS);
+        failed = TRUE;
+    }
+
+    /* The budget may have changed since they started, so only its
+     * largest share holds for sure.
+     */
+    if (low_priority_jobs < 0 || low_priority_jobs > async_jobs ||
+        low_priority_jobs > MAX_ASYNC_JOBS * ASYNC_JOB_LOW_PRIORITY_SHARE / 100)
+    {
+        g_printerr ("%d of %d async jobs in flight are low priority\n",
+                    low_priority_jobs, async_jobs);
+        failed = TRUE;
+    }
+}
+
+static gboolean
+timeout_callback (gpointer user_data)
+{
+    g_printerr ("timed out, %d of %d files ready\n", files_ready, files_requested);
+    failed = TRUE;
+    gtk_main_quit ();
+
+    return G_SOURCE_REMOVE;
 }
 
 static void
-files_changed (NautilusDirectory *directory,
-               GList             *changed_files)
+file_ready (NautilusFile *file,
+            gpointer      callback_data)
 {
-#if 0
-    GList *list;
+    GList *l;
+
+    check_bounds ();
 
-    for (list = changed_files; list != NULL; list = list->next)
+    files_ready++;
+
+    if (files_ready == CANCEL_AFTER && !cancelled)
     {
-        NautilusFile *file = list->data;
+        g_print ("invalidating after %d files\n", files_ready);
+        cancelled = TRUE;
 
-        g_print (" - %s\n", nautilus_file_get_uri (file));
+        for (l = files; l != NULL; l = l->next)
+        {
+            nautilus_file_invalidate_attributes (l->data, NAUTILUS_FILE_ATTRIBUTE_INFO);
+        }
     }
-#endif
-    g_print ("files changed: %d\n",
-             g_list_length (changed_files));
+
+    if (files_ready == files_requested)
+    {
+        gtk_main_quit ();
+    }
+}
+
+static void
+files_added (NautilusDirectory *directory,
+             GList             *added_files)
+{
+    g_print ("files added: %d files\n",
+             g_list_length (added_files));
+
+    check_bounds ();
 }
 
 static void
 done_loading (NautilusDirectory *directory)
 {
+    GList *l;
+
     g_print ("done loading\n");
-    gtk_main_quit ();
+
+    /* Make every file go through the file info pipeline again. */
+    files = nautilus_directory_get_file_list (directory);
+    for (l = files; l != NULL; l = l->next)
+    {
+        files_requested++;
+        nautilus_file_invalidate_attributes (l->data, NAUTILUS_FILE_ATTRIBUTE_INFO);
+        nautilus_file_call_when_ready (l->data,
+                                       NAUTILUS_FILE_ATTRIBUTE_INFO |
+                                       NAUTILUS_FILE_ATTRIBUTE_DIRECTORY_ITEM_COUNT,
+                                       file_ready, NULL);
+    }
 }
 
 int
 main (int    argc,
       char **argv)
 {
-    NautilusDirectory *directory;
-    NautilusFileAttributes attributes;
-    const char *uri;
+    char *path;
+    char *name;
+    char *uri;
+    int i;
 
     client1 = g_new0 (int, 1);
-    client2 = g_new0 (int, 1);
 
     gtk_init (&argc, &argv);
 
     nautilus_ensure_extension_points ();
 
-    if (argv[1] == NULL)
-    {
-        uri = "file:///tmp";
-    }
-    else
+    path = g_dir_make_tmp ("nautilus-test-directory-async-XXXXXX", NULL);
+    g_assert (path != NULL);
+
+    for (i = 0; i < N_FILES; i++)
     {
-        uri = argv[1];
+        name = g_strdup_printf ("%s/file-%d", path, i);
+        if (i % DIRECTORY_EVERY == 0)
+        {
+            g_mkdir (name, 0755);
+        }
+        else
+        {
+            g_file_set_contents (name, "", 0, NULL);
+        }
+        g_free (name);
     }
-    g_print ("loading %s", uri);
+
+    uri = g_filename_to_uri (path, NULL, NULL);
+    g_print ("loading %s\n", uri);
     directory = nautilus_directory_get_by_uri (uri);
 
     g_signal_connect (directory, "files-added", G_CALLBACK (files_added), NULL);
-    g_signal_connect (directory, "files-changed", G_CALLBACK (files_changed), NULL);
     g_signal_connect (directory, "done-loading", G_CALLBACK (done_loading), NULL);
 
-    attributes =
-        NAUTILUS_FILE_ATTRIBUTES_FOR_ICON |
-        NAUTILUS_FILE_ATTRIBUTE_DIRECTORY_ITEM_COUNT |
-        NAUTILUS_FILE_ATTRIBUTE_INFO |
-        NAUTILUS_FILE_ATTRIBUTE_LINK_INFO |
-        NAUTILUS_FILE_ATTRIBUTE_MOUNT |
-        NAUTILUS_FILE_ATTRIBUTE_EXTENSION_INFO;
-
     nautilus_directory_file_monitor_add (directory, client1, TRUE,
-                                         attributes,
+                                         NAUTILUS_FILE_ATTRIBUTE_INFO |
+                                         NAUTILUS_FILE_ATTRIBUTE_DIRECTORY_ITEM_COUNT,
                                          NULL, NULL);
 
+    g_timeout_add_seconds (60, timeout_callback, NULL);
 
     gtk_main ();
-    return 0;
+
+    g_print ("%d of %d files ready, at most %u jobs in flight\n",
+             files_ready, files_requested, max_jobs_in_flight);
+    g_print ("at most %d async jobs in flight, %d of them low priority\n",
+             max_async_jobs, max_low_priority_jobs);
+
+    if (files_requested != N_FILES || files_ready != files_requested)
+    {
+        failed = TRUE;
+    }
+
+    nautilus_file_list_free (files);
+    nautilus_directory_file_monitor_remove (directory, client1);
+    nautilus_directory_unref (directory);
+
+    for (i = 0; i < N_FILES; i++)
+    {
+        name = g_strdup_printf ("%s/file-%d", path, i);
+        g_remove (name);
+        g_free (name);
+    }
+    g_rmdir (path);
+
+    g_free (uri);
+    g_free (path);
+
+    return failed ? 1 : 0;
 }
@@ -0,0 +1,358 @@
+#include <gtk/gtk.h>
+#include <glib/gstdio.h>
+#include <src/nautilus-directory.h>
+#include <src/nautilus-file-attributes.h>
+#include <src/nautilus-file-changes-queue.h>
+#include <src/nautilus-file-utilities.h>
+#include <stdio.h>
+#include <string.h>
+
+/* Replays a storm of file monitor events for a monitored directory,
+ * the way a build rewriting all of its outputs produces them, and
+ * reports how long the main loop spent consuming it and how many
+ * batches views were sent.
+ *
+ * Usage: test-nautilus-file-changes-benchmark [N_FILES [RECORDING]]
+ *
+ * RECORDING has one event per line, "created", "deleted", "changed",
+ * "attribute-changed" or "changes-done" followed by the name of one of
+ * the generated files, file-0 to file-N. Without it every file is
+ * deleted, created, changed and changes-done in turn.
+ */
+
+#define DEFAULT_N_FILES 20000
+
+/* Report main loop stalls longer than this. */
+#define STALL_THRESHOLD_USEC (50 * 1000)
+
+typedef struct
+{
+    GFileMonitorEvent event_type;
+    int index;
+} RecordedEvent;
+
+static const struct
+{
+    const char *name;
+    GFileMonitorEvent event_type;
+} event_names[] =
+{
+    { "created", G_FILE_MONITOR_EVENT_CREATED },
+    { "deleted", G_FILE_MONITOR_EVENT_DELETED },
+    { "changed", G_FILE_MONITOR_EVENT_CHANGED },
+    { "attribute-changed", G_FILE_MONITOR_EVENT_ATTRIBUTE_CHANGED },
+    { "changes-done", G_FILE_MONITOR_EVENT_CHANGES_DONE_HINT },
+};
+
+static void *client;
+
+static int n_files;
+static GFile **locations;
+static GArray *events;
+static NautilusDirectory *directory;
+
+static gint64 consume_time;
+static gint64 longest_consume_time;
+static int n_consume_calls;
+static gint64 last_tick_time;
+static gint64 longest_stall;
+static int n_stalls;
+static int n_batches;
+static int n_files_notified;
+
+static char *
+get_file_path (const char *root,
+               int         i)
+{
+    return g_strdup_printf ("%s/file-%d", root, i);
+}
+
+static void
+create_tree (const char *root)
+{
+    char *path;
+    int i;
+
+    locations = g_new (GFile *, n_files);
+    for (i = 0; i < n_files; i++)
+    {
+        path = get_file_path (root, i);
+        g_file_set_contents (path, "x", 1, NULL);
+        locations[i] = g_file_new_for_path (path);
+        g_free (path);
+    }
+}
+
+static void
+remove_tree (const char *root)
+{
+    char *path;
+    int i;
+
+    for (i = 0; i < n_files; i++)
+    {
+        path = get_file_path (root, i);
+        g_unlink (path);
+        g_free (path);
+        g_object_unref (locations[i]);
+    }
+    g_free (locations);
+
+    g_rmdir (root);
+}
+
+static void
+add_event (GFileMonitorEvent event_type,
+           int               index)
+{
+    RecordedEvent event;
+
+    event.event_type = event_type;
+    event.index = index;
+    g_array_append_val (events, event);
+}
+
+static void
+generate_events (void)
+{
+    int i;
+
+    for (i = 0; i < n_files; i++)
+    {
+        add_event (G_FILE_MONITOR_EVENT_DELETED, i);
+        add_event (G_FILE_MONITOR_EVENT_CREATED, i);
+        add_event (G_FILE_MONITOR_EVENT_CHANGED, i);
+        add_event (G_FILE_MONITOR_EVENT_CHANGES_DONE_HINT, i);
+    }
+}
+
+static gboolean
+load_events (const char *recording)
+{
+    FILE *stream;
+    char event_name[64];
+    int index;
+    guint i;
+
+    stream = fopen (recording, "r");
+    if (stream == NULL)
+    {
+        return FALSE;
+    }
+
+    while (fscanf (stream, "%63s file-%d", event_name, &index) == 2)
+    {
+        if (index < 0 || index >= n_files)
+        {
+            continue;
+        }
+
+        for (i = 0; i < G_N_ELEMENTS (event_names); i++)
+        {
+            if (strcmp (event_name, event_names[i].name) == 0)
+            {
+                add_event (event_names[i].event_type, index);
+            }
+        }
+    }
+
+    fclose (stream);
+
+    return TRUE;
+}
+
+/* Same as dir_changed() in nautilus-monitor.c. */
+static void
+replay_event (RecordedEvent *event)
+{
+    GFile *child;
+
+    child = locations[event->index];
+
+    switch (event->event_type)
+    {
+        case G_FILE_MONITOR_EVENT_ATTRIBUTE_CHANGED:
+        case G_FILE_MONITOR_EVENT_CHANGES_DONE_HINT:
+        {
+            nautilus_file_changes_queue_file_changed (child);
+        }
+        break;
+
+        case G_FILE_MONITOR_EVENT_DELETED:
+        {
+            nautilus_file_changes_queue_file_removed (child);
+        }
+        break;
+
+        case G_FILE_MONITOR_EVENT_CREATED:
+        {
+            nautilus_file_changes_queue_file_added (child);
+        }
+        break;
+
+        default:
+        {
+        }
+        break;
+    }
+}
+
+static void
+files_notified (NautilusDirectory *directory,
+                GList             *files,
+                gpointer           callback_data)
+{
+    n_batches++;
+    n_files_notified += g_list_length (files);
+}
+
+static gboolean
+tick_callback (gpointer user_data)
+{
+    gint64 now, stall;
+
+    now = g_get_monotonic_time ();
+    stall = now - last_tick_time;
+    last_tick_time = now;
+
+    longest_stall = MAX (longest_stall, stall);
+    if (stall > STALL_THRESHOLD_USEC)
+    {
+        n_stalls++;
+    }
+
+    return G_SOURCE_CONTINUE;
+}
+
+static void
+report (void)
+{
+    g_print ("%u events replayed\n", events->len);
+    g_print ("consumed in %d slices, %.3f s total, longest %.3f ms\n",
+             n_consume_calls,
+             consume_time / (double) G_USEC_PER_SEC,
+             longest_consume_time / 1000.0);
+    g_print ("%d batches with %d files sent to views\n",
+             n_batches, n_files_notified);
+    g_print ("longest main loop stall %.3f ms, %d longer than %d ms\n",
+             longest_stall / 1000.0, n_stalls, STALL_THRESHOLD_USEC / 1000);
+}
+
+static void
+directory_ready_again (NautilusDirectory *directory,
+                       GList             *files,
+                       gpointer           callback_data)
+{
+    report ();
+    gtk_main_quit ();
+}
+
+/* Consumes the changes the way nautilus-monitor.c does, a slice at a
+ * time from an idle.
+ */
+static gboolean
+consume_changes_idle_callback (gpointer user_data)
+{
+    gint64 start, elapsed;
+    gboolean changes_left;
+
+    start = g_get_monotonic_time ();
+    changes_left = nautilus_file_changes_consume_changes (FALSE);
+    elapsed = g_get_monotonic_time () - start;
+
+    n_consume_calls++;
+    consume_time += elapsed;
+    longest_consume_time = MAX (longest_consume_time, elapsed);
+
+    if (changes_left)
+    {
+        return G_SOURCE_CONTINUE;
+    }
+
+    nautilus_directory_call_when_ready (directory,
+                                        NAUTILUS_FILE_ATTRIBUTE_INFO,
+                                        TRUE,
+                                        directory_ready_again, NULL);
+
+    return G_SOURCE_REMOVE;
+}
+
+static void
+directory_ready (NautilusDirectory *directory,
+                 GList             *files,
+                 gpointer           callback_data)
+{
+    guint i;
+
+    g_signal_connect (directory, "files-added",
+                      G_CALLBACK (files_notified), NULL);
+    g_signal_connect (directory, "files-changed",
+                      G_CALLBACK (files_notified), NULL);
+
+    for (i = 0; i < events->len; i++)
+    {
+        replay_event (&g_array_index (events, RecordedEvent, i));
+    }
+
+    last_tick_time = g_get_monotonic_time ();
+    g_timeout_add (1, tick_callback, NULL);
+    g_idle_add (consume_changes_idle_callback, NULL);
+}
+
+int
+main (int    argc,
+      char **argv)
+{
+    char *root;
+    char *uri;
+
+    gtk_init (&argc, &argv);
+
+    nautilus_ensure_extension_points ();
+
+    n_files = argc > 1 ? atoi (argv[1]) : DEFAULT_N_FILES;
+
+    root = g_dir_make_tmp ("nautilus-file-changes-benchmark-XXXXXX", NULL);
+    g_assert (root != NULL);
+
+    create_tree (root);
+
+    events = g_array_new (FALSE, FALSE, sizeof (RecordedEvent));
+    if (argc > 2)
+    {
+        if (!load_events (argv[2]))
+        {
+            g_printerr ("could not read %s\n", argv[2]);
+            remove_tree (root);
+            return 1;
+        }
+    }
+    else
+    {
+        generate_events ();
+    }
+
+    client = g_new0 (int, 1);
+    uri = g_filename_to_uri (root, NULL, NULL);
+    directory = nautilus_directory_get_by_uri (uri);
+    nautilus_directory_file_monitor_add (directory, client, TRUE,
+                                         NAUTILUS_FILE_ATTRIBUTE_INFO,
+                                         NULL, NULL);
+    nautilus_directory_call_when_ready (directory,
+                                        NAUTILUS_FILE_ATTRIBUTE_INFO,
+                                        TRUE,
+                                        directory_ready, NULL);
+
+    gtk_main ();
+
+    nautilus_directory_file_monitor_remove (directory, client);
+    nautilus_directory_unref (directory);
+    g_array_free (events, TRUE);
+
+    remove_tree (root);
+    g_free (uri);
+    g_free (root);
+    g_free (client);
+
+    return 0;
+}
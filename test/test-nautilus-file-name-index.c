@@ -0,0 +1,389 @@
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <string.h>
+#include <src/nautilus-file-name-index.h>
+#include <src/nautilus-global-preferences.h>
+#include <src/nautilus-query.h>
+#include <src/nautilus-search-hit.h>
+
+/* How long the index gets to catch up with the tree, in seconds. */
+#define WAIT_TIMEOUT 10
+
+static char *root_path;
+static GFile *root;
+static NautilusFileNameIndex *name_index;
+
+static void
+make_file (const char *path)
+{
+    char *full_path;
+
+    full_path = g_build_filename (root_path, path, NULL);
+    g_assert_true (g_file_set_contents (full_path, "", 0, NULL));
+    g_free (full_path);
+}
+
+static void
+make_directory (const char *path)
+{
+    char *full_path;
+
+    full_path = g_build_filename (root_path, path, NULL);
+    g_assert_cmpint (g_mkdir (full_path, 0755), ==, 0);
+    g_free (full_path);
+}
+
+static void
+remove_tree (const char *path)
+{
+    GDir *dir;
+    const char *name;
+    char *child;
+
+    dir = g_dir_open (path, 0, NULL);
+    if (dir != NULL)
+    {
+        while ((name = g_dir_read_name (dir)) != NULL)
+        {
+            child = g_build_filename (path, name, NULL);
+            remove_tree (child);
+            g_free (child);
+        }
+        g_dir_close (dir);
+        g_rmdir (path);
+    }
+    else
+    {
+        g_unlink (path);
+    }
+}
+
+static gint
+compare_paths (gconstpointer a,
+               gconstpointer b)
+{
+    return strcmp (*(char **) a, *(char **) b);
+}
+
+/* Returns the paths of the hits relative to the root, sorted and
+ * separated by commas.
+ */
+static char *
+search (const char *location_path,
+        const char *text,
+        gboolean    recursive,
+        gboolean    show_hidden)
+{
+    NautilusQuery *query;
+    GFile *location, *hit_location;
+    GPtrArray *paths;
+    GList *hits, *l;
+    char *result;
+
+    location = location_path != NULL ? g_file_get_child (root, location_path) : g_object_ref (root);
+    query = nautilus_query_new ();
+    nautilus_query_set_text (query, text);
+    nautilus_query_set_location (query, location);
+    nautilus_query_set_recursive (query, recursive);
+    nautilus_query_set_show_hidden_files (query, show_hidden);
+
+    hits = nautilus_file_name_index_search (name_index, query, NULL);
+
+    paths = g_ptr_array_new_with_free_func (g_free);
+    for (l = hits; l != NULL; l = l->next)
+    {
+        hit_location = g_file_new_for_uri (nautilus_search_hit_get_uri (l->data));
+        g_ptr_array_add (paths, g_file_get_relative_path (root, hit_location));
+        g_object_unref (hit_location);
+    }
+    g_ptr_array_sort (paths, compare_paths);
+    g_ptr_array_add (paths, NULL);
+    result = g_strjoinv (",", (char **) paths->pdata);
+
+    g_ptr_array_unref (paths);
+    g_list_free_full (hits, g_object_unref);
+    g_object_unref (query);
+    g_object_unref (location);
+
+    return result;
+}
+
+/* Changes are applied in the background, so searches are repeated
+ * until they find what is expected or time runs out.
+ */
+static char *
+search_until (const char *location_path,
+              const char *text,
+              gboolean    recursive,
+              gboolean    show_hidden,
+              const char *expected)
+{
+    gint64 end;
+    char *result;
+
+    end = g_get_monotonic_time () + WAIT_TIMEOUT * G_USEC_PER_SEC;
+    for (;;)
+    {
+        result = search (location_path, text, recursive, show_hidden);
+        if (strcmp (result, expected) == 0 || g_get_monotonic_time () > end)
+        {
+            return result;
+        }
+        g_free (result);
+        g_usleep (10 * 1000);
+    }
+}
+
+static void
+assert_search (const char *location_path,
+               const char *text,
+               gboolean    recursive,
+               gboolean    show_hidden,
+               const char *expected)
+{
+    char *result;
+
+    result = search (location_path, text, recursive, show_hidden);
+    g_assert_cmpstr (result, ==, expected);
+    g_free (result);
+}
+
+static void
+assert_search_until (const char *location_path,
+                     const char *text,
+                     gboolean    recursive,
+                     gboolean    show_hidden,
+                     const char *expected)
+{
+    char *result;
+
+    result = search_until (location_path, text, recursive, show_hidden, expected);
+    g_assert_cmpstr (result, ==, expected);
+    g_free (result);
+}
+
+static void
+test_not_recursive ()
+{
+    assert_search (NULL, "needle", FALSE, FALSE, "needle-top");
+    assert_search ("sub", "needle", FALSE, FALSE, "sub/needle-deep");
+}
+
+static void
+test_recursive ()
+{
+    assert_search (NULL, "needle", TRUE, FALSE,
+                   "needle-top,sub/needle-deep,sub/subsub/needle-deeper");
+    assert_search ("sub", "needle", TRUE, FALSE,
+                   "sub/needle-deep,sub/subsub/needle-deeper");
+    assert_search (NULL, "nothing", TRUE, FALSE, "");
+}
+
+static void
+test_hidden ()
+{
+    /* Dot files, backups and everything in hidden folders. */
+    assert_search (NULL, "needle", FALSE, TRUE,
+                   ".needle-hidden,needle-backup~,needle-top");
+    assert_search (NULL, "needle", TRUE, TRUE,
+                   ".hidden-dir/needle-in-hidden,.needle-hidden,needle-backup~,"
+                   "needle-top,sub/needle-deep,sub/subsub/needle-deeper");
+}
+
+static void
+test_in_hidden_location ()
+{
+    /* Like a walk of the tree, searching in a hidden folder finds what
+     * is in it.
+     */
+    assert_search (".hidden-dir", "needle", TRUE, FALSE,
+                   ".hidden-dir/needle-in-hidden");
+}
+
+static void
+test_covers ()
+{
+    GFile *location;
+
+    g_assert_true (nautilus_file_name_index_covers (name_index, root));
+
+    location = g_file_resolve_relative_path (root, "sub/subsub");
+    g_assert_true (nautilus_file_name_index_covers (name_index, location));
+    g_object_unref (location);
+
+    location = g_file_new_for_path ("/");
+    g_assert_false (nautilus_file_name_index_covers (name_index, location));
+    g_object_unref (location);
+}
+
+static void
+test_changes_added ()
+{
+    GFile *location;
+
+    make_file ("sub/needle-new");
+    location = g_file_resolve_relative_path (root, "sub/needle-new");
+    nautilus_file_name_index_file_added (location);
+    g_object_unref (location);
+
+    assert_search_until (NULL, "needle", TRUE, FALSE,
+                         "needle-top,sub/needle-deep,sub/needle-new,sub/subsub/needle-deeper");
+    assert_search (NULL, "needle", FALSE, FALSE, "needle-top");
+    assert_search ("sub", "needle", FALSE, FALSE, "sub/needle-deep,sub/needle-new");
+
+    /* A new folder comes with everything in it. */
+    make_directory ("new-dir");
+    make_file ("new-dir/needle-in-new");
+    location = g_file_get_child (root, "new-dir");
+    nautilus_file_name_index_file_added (location);
+    g_object_unref (location);
+
+    assert_search_until ("new-dir", "needle", TRUE, FALSE, "new-dir/needle-in-new");
+}
+
+static void
+test_changes_hidden ()
+{
+    GFile *location;
+
+    make_file (".hidden-dir/needle-later");
+    location = g_file_resolve_relative_path (root, ".hidden-dir/needle-later");
+    nautilus_file_name_index_file_added (location);
+    g_object_unref (location);
+
+    assert_search_until (".hidden-dir", "needle", FALSE, FALSE,
+                         ".hidden-dir/needle-in-hidden,.hidden-dir/needle-later");
+    assert_search (NULL, "later", TRUE, FALSE, "");
+    assert_search (NULL, "later", TRUE, TRUE, ".hidden-dir/needle-later");
+}
+
+static void
+test_changes_removed ()
+{
+    GFile *location;
+    char *path;
+
+    location = g_file_get_child (root, "needle-top");
+    g_assert_true (g_file_delete (location, NULL, NULL));
+    nautilus_file_name_index_file_removed (location);
+    g_object_unref (location);
+
+    assert_search_until (NULL, "needle", FALSE, FALSE, "");
+
+    /* Removing a folder removes everything in it. */
+    location = g_file_get_child (root, "new-dir");
+    path = g_file_get_path (location);
+    remove_tree (path);
+    g_free (path);
+    nautilus_file_name_index_file_removed (location);
+    g_object_unref (location);
+
+    assert_search_until (NULL, "needle-in-new", TRUE, FALSE, "");
+}
+
+static void
+test_changes_moved ()
+{
+    GFile *from, *to;
+
+    from = g_file_get_child (root, "sub");
+    to = g_file_get_child (root, "moved");
+    g_assert_true (g_file_move (from, to, G_FILE_COPY_NOFOLLOW_SYMLINKS, NULL, NULL, NULL, NULL));
+    nautilus_file_name_index_file_moved (from, to);
+    g_object_unref (from);
+    g_object_unref (to);
+
+    assert_search_until (NULL, "needle", TRUE, FALSE,
+                         "moved/needle-deep,moved/needle-new,moved/subsub/needle-deeper");
+    assert_search ("moved", "needle", FALSE, FALSE, "moved/needle-deep,moved/needle-new");
+}
+
+static void
+setup_test_suite ()
+{
+    g_test_add_func ("/file-name-index/snapshot/1.0",
+                     test_not_recursive);
+    g_test_add_func ("/file-name-index/snapshot/1.1",
+                     test_recursive);
+    g_test_add_func ("/file-name-index/snapshot/1.2",
+                     test_hidden);
+    g_test_add_func ("/file-name-index/snapshot/1.3",
+                     test_in_hidden_location);
+    g_test_add_func ("/file-name-index/snapshot/1.4",
+                     test_covers);
+
+    /* These change the tree, in this order. */
+    g_test_add_func ("/file-name-index/changes/2.0",
+                     test_changes_added);
+    g_test_add_func ("/file-name-index/changes/2.1",
+                     test_changes_hidden);
+    g_test_add_func ("/file-name-index/changes/2.2",
+                     test_changes_removed);
+    g_test_add_func ("/file-name-index/changes/2.3",
+                     test_changes_moved);
+}
+
+int
+main (int   argc,
+      char *argv[])
+{
+    char *home_path, *cache_path;
+    gint64 end;
+    int result;
+
+    /* The index is written to the cache, and only the home folder is
+     * indexed, so neither is the real one.
+     */
+    home_path = g_dir_make_tmp ("nautilus-test-home-XXXXXX", NULL);
+    g_assert (home_path != NULL);
+    cache_path = g_build_filename (home_path, ".cache", NULL);
+    g_setenv ("HOME", home_path, TRUE);
+    g_setenv ("XDG_CACHE_HOME", cache_path, TRUE);
+
+    g_test_init (&argc, &argv, NULL);
+    g_test_set_nonfatal_assertions ();
+
+    /* Queries read the default search type from the settings. */
+    nautilus_global_preferences_init ();
+
+    root_path = g_build_filename (home_path, "tree", NULL);
+    g_assert_cmpint (g_mkdir (root_path, 0755), ==, 0);
+    root = g_file_new_for_path (root_path);
+
+    make_file ("needle-top");
+    make_file ("haystack");
+    make_file (".needle-hidden");
+    make_file ("needle-backup~");
+    make_directory ("sub");
+    make_file ("sub/needle-deep");
+    make_directory ("sub/subsub");
+    make_file ("sub/subsub/needle-deeper");
+    make_directory (".hidden-dir");
+    make_file (".hidden-dir/needle-in-hidden");
+
+    /* Nothing is indexed until asked for. */
+    g_assert (nautilus_file_name_index_lookup (root) == NULL);
+    nautilus_file_name_index_prepare (root);
+
+    name_index = nautilus_file_name_index_lookup (root);
+    g_assert (name_index != NULL);
+
+    end = g_get_monotonic_time () + WAIT_TIMEOUT * G_USEC_PER_SEC;
+    while (!nautilus_file_name_index_is_ready (name_index))
+    {
+        g_assert_cmpint (g_get_monotonic_time (), <, end);
+        g_usleep (10 * 1000);
+    }
+
+    setup_test_suite ();
+
+    result = g_test_run ();
+
+    remove_tree (home_path);
+    g_object_unref (root);
+    g_free (root_path);
+    g_free (cache_path);
+    g_free (home_path);
+
+    return result;
+}
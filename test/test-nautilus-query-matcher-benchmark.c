@@ -0,0 +1,159 @@
+#include <glib.h>
+#include <src/nautilus-query-matcher.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Scores generated file names against search text, the way search
+ * engines do for every file they find, and reports how many names
+ * per second one matcher shared by all threads gets through.
+ *
+ * Usage: test-nautilus-query-matcher-benchmark [N_NAMES [N_THREADS [TEXT]]]
+ */
+
+#define DEFAULT_N_NAMES 10000000
+#define DEFAULT_TEXT "report 2016"
+
+/* Names are taken from a pool this big over and over. */
+#define N_DISTINCT_NAMES 100000
+
+/* Every this many names one is not ASCII. */
+#define NON_ASCII_EVERY 20
+
+static const char *words[] =
+{
+    "report", "Holiday", "IMG", "invoice", "draft", "final", "Notes",
+    "backup", "Screenshot", "budget", "thesis", "README", "copy",
+};
+
+static const char *non_ascii_words[] =
+{
+    "Résumé", "Übersicht", "Präsentation", "café", "naïve", "Ωmega",
+};
+
+static const char *extensions[] =
+{
+    "txt", "pdf", "jpg", "odt", "png", "tar.gz", "c", "",
+};
+
+typedef struct
+{
+    NautilusQueryMatcher *matcher;
+    char **names;
+    guint first;
+    guint n;
+    guint n_matches;
+} MatchJob;
+
+static char **
+generate_names (void)
+{
+    GRand *rand;
+    char **names;
+    const char *word, *other;
+    guint i;
+
+    /* Fixed seed, so runs can be compared. */
+    rand = g_rand_new_with_seed (2016);
+    names = g_new (char *, N_DISTINCT_NAMES);
+
+    for (i = 0; i < N_DISTINCT_NAMES; i++)
+    {
+        if (i % NON_ASCII_EVERY == 0)
+        {
+            word = non_ascii_words[g_rand_int_range (rand, 0, G_N_ELEMENTS (non_ascii_words))];
+        }
+        else
+        {
+            word = words[g_rand_int_range (rand, 0, G_N_ELEMENTS (words))];
+        }
+        other = words[g_rand_int_range (rand, 0, G_N_ELEMENTS (words))];
+
+        names[i] = g_strdup_printf ("%s %s-%d.%s", word, other,
+                                    g_rand_int_range (rand, 1990, 2030),
+                                    extensions[g_rand_int_range (rand, 0, G_N_ELEMENTS (extensions))]);
+    }
+
+    g_rand_free (rand);
+
+    return names;
+}
+
+static gpointer
+match_thread_func (gpointer user_data)
+{
+    MatchJob *job = user_data;
+    guint i;
+
+    for (i = job->first; i < job->first + job->n; i++)
+    {
+        if (nautilus_query_matcher_match (job->matcher,
+                                          job->names[i % N_DISTINCT_NAMES]) > -1)
+        {
+            job->n_matches++;
+        }
+    }
+
+    return NULL;
+}
+
+int
+main (int    argc,
+      char **argv)
+{
+    NautilusQueryMatcher *matcher;
+    MatchJob *jobs;
+    GThread **threads;
+    char **names;
+    const char *text;
+    guint n_names, n_threads, n_matches, i;
+    gint64 start_time, elapsed;
+
+    n_names = argc > 1 ? atoi (argv[1]) : DEFAULT_N_NAMES;
+    n_threads = argc > 2 ? MAX (atoi (argv[2]), 1) : 1;
+    text = argc > 3 ? argv[3] : DEFAULT_TEXT;
+
+    names = generate_names ();
+    matcher = nautilus_query_matcher_new (text);
+
+    jobs = g_new0 (MatchJob, n_threads);
+    threads = g_new (GThread *, n_threads);
+
+    start_time = g_get_monotonic_time ();
+
+    for (i = 0; i < n_threads; i++)
+    {
+        jobs[i].matcher = matcher;
+        jobs[i].names = names;
+        jobs[i].first = i * (n_names / n_threads);
+        jobs[i].n = i == n_threads - 1 ?
+                    n_names - jobs[i].first :
+                    n_names / n_threads;
+        threads[i] = g_thread_new ("matcher", match_thread_func, &jobs[i]);
+    }
+
+    n_matches = 0;
+    for (i = 0; i < n_threads; i++)
+    {
+        g_thread_join (threads[i]);
+        n_matches += jobs[i].n_matches;
+    }
+
+    elapsed = g_get_monotonic_time () - start_time;
+
+    g_print ("%u names matched against \"%s\" with %u threads, %u matches\n",
+             n_names, text, n_threads, n_matches);
+    g_print ("%.3f s, %.1f million names per second\n",
+             elapsed / (double) G_USEC_PER_SEC,
+             n_names / (double) MAX (elapsed, 1));
+
+    nautilus_query_matcher_unref (matcher);
+    for (i = 0; i < N_DISTINCT_NAMES; i++)
+    {
+        g_free (names[i]);
+    }
+    g_free (names);
+    g_free (jobs);
+    g_free (threads);
+
+    return 0;
+}
@@ -0,0 +1,172 @@
+#include <glib.h>
+#include <string.h>
+#include <src/nautilus-query-matcher.h>
+
+/* Looks for @text in the chunks, fed one after the other, and returns
+ * the rank.
+ */
+static gdouble
+content_rank (const char  *text,
+              const char **chunks)
+{
+    NautilusQueryMatcher *matcher;
+    NautilusQueryContentMatch *match;
+
+    matcher = nautilus_query_matcher_new (text);
+    match = nautilus_query_content_match_new (matcher);
+    nautilus_query_matcher_unref (matcher);
+
+    for (; *chunks != NULL; chunks++)
+    {
+        nautilus_query_content_match_feed (match, *chunks, strlen (*chunks));
+    }
+
+    return nautilus_query_content_match_finish (match);
+}
+
+static gdouble
+content_rank_in_one (const char *text,
+                     const char *content)
+{
+    const char *chunks[] = { content, NULL };
+
+    return content_rank (text, chunks);
+}
+
+static void
+assert_rank (gdouble rank,
+             gdouble expected)
+{
+    g_assert_cmpfloat (ABS (rank - expected), <, 1e-9);
+}
+
+static void
+test_word_found ()
+{
+    assert_rank (content_rank_in_one ("hello", "well, hello there"), 1.0);
+    assert_rank (content_rank_in_one ("hello", "hell, oh well"), -1);
+}
+
+static void
+test_word_split_across_chunks ()
+{
+    const char *two[] = { "say hel", "lo there", NULL };
+    const char *empty[] = { "say hel", "", "lo there", NULL };
+    const char *bytes[] = { "h", "e", "l", "l", "o", NULL };
+    const char *broken[] = { "say hel", "p lo", NULL };
+
+    assert_rank (content_rank ("hello", two), 1.0);
+    assert_rank (content_rank ("hello", empty), 1.0);
+    assert_rank (content_rank ("hello", bytes), 1.0);
+    assert_rank (content_rank ("hello", broken), -1);
+}
+
+static void
+test_upper_case_content ()
+{
+    assert_rank (content_rank_in_one ("hello world", "HELLO World"), 1.0);
+    assert_rank (content_rank_in_one ("Hello", "hello"), 1.0);
+    assert_rank (content_rank_in_one ("HELLO", "hElLo"), 1.0);
+}
+
+static void
+test_non_ascii_as_typed ()
+{
+    assert_rank (content_rank_in_one ("café", "un café noir"), 1.0);
+    assert_rank (content_rank_in_one ("Café", "un café noir"), 1.0);
+    assert_rank (content_rank_in_one ("café", "UN CAFÉ NOIR"), -1);
+}
+
+static void
+test_overlapping_occurrences ()
+{
+    /* Two occurrences each, sharing bytes. */
+    assert_rank (content_rank_in_one ("ana", "banana"), 1.0 + G_LN2);
+    assert_rank (content_rank_in_one ("aa", "aaa"), 1.0 + G_LN2);
+    assert_rank (content_rank_in_one ("aa", "aaaa"), content_rank_in_one ("aa", "aa aa aa"));
+}
+
+static void
+test_overlapping_words ()
+{
+    /* Each ends inside or at the end of another. */
+    assert_rank (content_rank_in_one ("he she hers", "ushers"), 1.0);
+    assert_rank (content_rank_in_one ("abc bc c", "xabcx"), 1.0);
+    assert_rank (content_rank_in_one ("abcd bcx", "abcx"), -1);
+}
+
+static void
+test_every_word_must_occur ()
+{
+    const char *split[] = { "the ca", "t sat by the d", "og", NULL };
+
+    assert_rank (content_rank_in_one ("cat dog", "the cat sat"), -1);
+    assert_rank (content_rank_in_one ("cat dog", "the dog sat"), -1);
+    assert_rank (content_rank_in_one ("cat dog", "the dog sat by the cat"), 1.0);
+    assert_rank (content_rank ("cat dog", split), 1.0);
+}
+
+static void
+test_rank_grows_with_occurrences ()
+{
+    gdouble once, twice;
+
+    once = content_rank_in_one ("cat dog", "cat dog");
+    twice = content_rank_in_one ("cat dog", "cat dog cat dog");
+
+    g_assert_cmpfloat (twice, >, once);
+    g_assert_cmpfloat (twice, <=, 10.0);
+}
+
+static void
+test_empty_words_ignored ()
+{
+    assert_rank (content_rank_in_one ("cat ", "a cat"), 1.0);
+    assert_rank (content_rank_in_one ("cat  dog", "a cat and a dog"), 1.0);
+}
+
+static void
+test_nothing_to_find ()
+{
+    assert_rank (content_rank_in_one (NULL, "anything"), -1);
+    assert_rank (content_rank_in_one ("", "anything"), -1);
+}
+
+static void
+setup_test_suite ()
+{
+    g_test_add_func ("/query-matcher/content/1.0",
+                     test_word_found);
+    g_test_add_func ("/query-matcher/content/1.1",
+                     test_word_split_across_chunks);
+    g_test_add_func ("/query-matcher/content/1.2",
+                     test_upper_case_content);
+    g_test_add_func ("/query-matcher/content/1.3",
+                     test_non_ascii_as_typed);
+
+    g_test_add_func ("/query-matcher/content/2.0",
+                     test_overlapping_occurrences);
+    g_test_add_func ("/query-matcher/content/2.1",
+                     test_overlapping_words);
+
+    g_test_add_func ("/query-matcher/content/3.0",
+                     test_every_word_must_occur);
+    g_test_add_func ("/query-matcher/content/3.1",
+                     test_rank_grows_with_occurrences);
+    g_test_add_func ("/query-matcher/content/3.2",
+                     test_empty_words_ignored);
+    g_test_add_func ("/query-matcher/content/3.3",
+                     test_nothing_to_find);
+}
+
+int
+main (int   argc,
+      char *argv[])
+{
+    g_test_init (&argc, &argv, NULL);
+    g_test_set_nonfatal_assertions ();
+
+    setup_test_suite ();
+
+    return g_test_run ();
+}